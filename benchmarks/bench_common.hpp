@@ -0,0 +1,124 @@
+/**
+ * \file bench_common.hpp
+ * \brief Общие данные бенчмарков: временные файлы и размер нагрузки
+ *
+ * Файлы нагрузки генерируются один раз на процесс во временной
+ * директории и удаляются при выходе. Объём задаёт CSV_MEDIAN_BENCH_MB
+ * (по умолчанию 64 МБ на файл); для прогонов на десятки ГБ данные
+ * лучше сгенерировать gen_data и читать приложением.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "workload.hpp"
+
+namespace csv_median::bench {
+
+    namespace fs = std::filesystem;
+
+    inline constexpr std::uint64_t k_default_bench_mb = 64;
+
+    /**
+     * \brief Временная директория, удаляемая вместе с содержимым
+     */
+    struct bench_dir {
+        fs::path path;
+
+        explicit bench_dir(const std::string& name_) {
+            path = fs::temp_directory_path()
+                / (name_ + "_" + std::to_string(
+                    std::chrono::steady_clock::now().time_since_epoch().count()));
+            fs::create_directories(path);
+        }
+
+        ~bench_dir() {
+            std::error_code err;
+            fs::remove_all(path, err);
+        }
+
+        bench_dir(const bench_dir&) = delete;
+        bench_dir& operator=(const bench_dir&) = delete;
+    };
+
+    /**
+     * \brief Размер файла нагрузки, МБ (CSV_MEDIAN_BENCH_MB)
+     */
+    [[nodiscard]] inline std::uint64_t bench_megabytes() noexcept {
+        if (const char* value = std::getenv("CSV_MEDIAN_BENCH_MB")) {
+            if (const auto mb = std::strtoull(value, nullptr, 10); mb != 0) {
+                return mb;
+            }
+        }
+        return k_default_bench_mb;
+    }
+
+    /**
+     * \brief Общая директория файлов нагрузки процесса
+     */
+    [[nodiscard]] inline const fs::path& workload_dir() {
+        static const bench_dir dir{ "csv_median_bench" };
+        return dir.path;
+    }
+
+    /**
+     * \brief Файл нагрузки kind_ размером bytes_, созданный при первом запросе
+     */
+    [[nodiscard]] inline const fs::path& workload_file(workload_kind kind_,
+        std::uint64_t bytes_, std::uint64_t seed_ = k_workload_seed)
+    {
+        static std::map<std::tuple<workload_kind, std::uint64_t, std::uint64_t>, fs::path> files;
+        const auto key = std::tuple{ kind_, bytes_, seed_ };
+        if (const auto it = files.find(key); it != files.end()) {
+            return it->second;
+        }
+
+        fs::path path = workload_dir() / (std::string{ kind_ == workload_kind::trade ? "trade" : "level" }
+            + "_" + std::to_string(bytes_) + "_" + std::to_string(seed_) + ".csv");
+        if (const auto [lines, err] = write_workload(path, kind_, bytes_, seed_); err) {
+            spdlog::critical("Can't write {}: {}", path.string(), err.message());
+            std::exit(EXIT_FAILURE);
+        }
+        return files.emplace(key, std::move(path)).first->second;
+    }
+
+    /**
+     * \brief Директория с k_ файлами level суммарно bytes_ байт
+     *
+     * У файлов разные seed, поэтому receive_ts перемежаются, как у
+     * нескольких инструментов одной биржи.
+     */
+    [[nodiscard]] inline const fs::path& workload_set(std::size_t k_, std::uint64_t bytes_) {
+        static std::map<std::pair<std::size_t, std::uint64_t>, fs::path> sets;
+        const auto key = std::pair{ k_, bytes_ };
+        if (const auto it = sets.find(key); it != sets.end()) {
+            return it->second;
+        }
+
+        fs::path dir = workload_dir() / ("set_" + std::to_string(k_) + "_" + std::to_string(bytes_));
+        fs::create_directories(dir);
+        for (std::size_t i = 0; i < k_; ++i) {
+            const fs::path path = dir / ("level_" + std::to_string(i) + ".csv");
+            if (const auto [lines, err] = write_workload(path, workload_kind::level,
+                bytes_ / k_, k_workload_seed + i); err)
+            {
+                spdlog::critical("Can't write {}: {}", path.string(), err.message());
+                std::exit(EXIT_FAILURE);
+            }
+        }
+        return sets.emplace(key, std::move(dir)).first->second;
+    }
+
+}
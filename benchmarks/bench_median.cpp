@@ -0,0 +1,139 @@
+/**
+ * \file bench_median.cpp
+ * \brief Бенчмарки калькуляторов медианы на потоке записей нагрузки
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "bench_common.hpp"
+#include "histogram.hpp"
+#include "median.hpp"
+#include "price.hpp"
+#include "sketch.hpp"
+#include "skiplist.hpp"
+#include "window.hpp"
+
+namespace {
+
+    using namespace csv_median;
+
+    inline constexpr std::size_t k_median_records = 1 << 21;
+    inline constexpr std::uint64_t k_window_us = 1'000'000;
+
+    // Шаг 0.01, как у BTCUSDT: при шаге 10^-8 блуждание цены занимает
+    // сотни миллиардов шагов сетки
+    inline constexpr fixed_price k_tick_units = 1'000'000;
+
+    template<class Price>
+    struct records {
+        std::vector<std::uint64_t> ts;
+        std::vector<Price>         price;
+    };
+
+    /**
+     * \brief Записи trade и level, слитые по receive_ts; одни на процесс
+     */
+    template<class Price>
+    [[nodiscard]] const records<Price>& workload() {
+        static const records<Price> data = [] {
+            records<Price> result;
+            for (const auto& [ts, price] : workload_records(k_median_records)) {
+                result.ts.push_back(ts);
+                if constexpr (std::is_floating_point_v<Price>) {
+                    result.price.push_back(price);
+                }
+                else {
+                    result.price.push_back(std::llround(price * static_cast<double>(price_scale<>)));
+                }
+            }
+            return result;
+        }();
+        return data;
+    }
+
+    /**
+     * \brief Весь поток через калькулятор make_(); медиана читается, как
+     *        у расчёта, только когда изменилась
+     */
+    template<class Price, class Make>
+    void run(benchmark::State& state_, Make make_) {
+        const auto& data = workload<Price>();
+        std::uint64_t changes = 0;
+        for (auto _ : state_) {
+            auto calc = make_();
+            for (std::size_t i = 0; i < data.ts.size(); ++i) {
+                if constexpr (requires { calc.add(data.ts[i], data.price[i]); }) {
+                    calc.add(data.ts[i], data.price[i]);
+                }
+                else {
+                    calc.add(data.price[i]);
+                }
+                if (calc.is_changed()) {
+                    benchmark::DoNotOptimize(calc.median());
+                    ++changes;
+                }
+            }
+        }
+        state_.SetItemsProcessed(static_cast<std::int64_t>(state_.iterations() * data.ts.size()));
+        state_.counters["changes"] = benchmark::Counter(static_cast<double>(changes),
+            benchmark::Counter::kAvgIterations);
+    }
+
+    template<class Price>
+    void BM_heap(benchmark::State& state_) {
+        run<Price>(state_, [] { return basic_calculator<Price>{}; });
+    }
+
+    template<class Price>
+    void BM_skiplist(benchmark::State& state_) {
+        run<Price>(state_, [] { return skiplist_calculator<Price>{}; });
+    }
+
+    template<class Price>
+    void BM_histogram(benchmark::State& state_) {
+        run<Price>(state_, [] {
+            return histogram_calculator<Price>{ tick_histogram<Price>{ k_tick_units } };
+            });
+    }
+
+    template<class Price>
+    void BM_tdigest(benchmark::State& state_) {
+        run<Price>(state_, [] {
+            return sketch_calculator<Price>{ tdigest<Price>{ k_default_sketch_error } };
+            });
+    }
+
+    template<class Price>
+    void BM_window_skiplist(benchmark::State& state_) {
+        run<Price>(state_, [] {
+            return sliding_window<skiplist_calculator<Price>>{ k_window_us };
+            });
+    }
+
+    template<class Price>
+    void BM_window_histogram(benchmark::State& state_) {
+        run<Price>(state_, [] {
+            return sliding_window<histogram_calculator<Price>>{ k_window_us,
+                histogram_calculator<Price>{ tick_histogram<Price>{ k_tick_units } } };
+            });
+    }
+
+    BENCHMARK(BM_heap<double>)->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_heap<fixed_price>)->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_skiplist<double>)->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_skiplist<fixed_price>)->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_histogram<double>)->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_histogram<fixed_price>)->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_tdigest<double>)->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_tdigest<fixed_price>)->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_window_skiplist<double>)->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_window_skiplist<fixed_price>)->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_window_histogram<double>)->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_window_histogram<fixed_price>)->Unit(benchmark::kMillisecond);
+
+}
@@ -0,0 +1,103 @@
+/**
+ * \file bench_merge.cpp
+ * \brief Бенчмарки k-way merge: дерево проигравших и csv_reader по k файлам
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "bench_common.hpp"
+#include "merge.hpp"
+#include "pool.hpp"
+#include "reader.hpp"
+
+namespace {
+
+    using namespace csv_median;
+
+    // Записей всего, поровну на k источников
+    inline constexpr std::size_t k_merge_records = 1 << 22;
+
+    /**
+     * \brief Только дерево: k отсортированных рядов receive_ts в памяти
+     *
+     * Записи выдаются по одной (replace после каждой) — худший случай,
+     * когда пакеты слияния вырождаются в одну запись.
+     */
+    void BM_loser_tree(benchmark::State& state_) {
+        const auto k = static_cast<std::size_t>(state_.range(0));
+        const std::size_t per_source = k_merge_records / k;
+
+        std::mt19937_64 rng{ k_workload_seed };
+        std::uniform_int_distribution<std::uint64_t> step{ k_workload_ts_step_min, k_workload_ts_step_max };
+        std::vector<std::vector<std::uint64_t>> sources(k);
+        for (auto& source : sources) {
+            source.resize(per_source);
+            std::uint64_t ts = k_workload_start_ts;
+            for (auto& value : source) {
+                value = ts += step(rng);
+            }
+        }
+
+        std::vector<std::size_t> positions(k);
+        std::vector<std::uint64_t> keys(k);
+        for (auto _ : state_) {
+            for (std::size_t i = 0; i < k; ++i) {
+                positions[i] = 0;
+                keys[i] = sources[i][0];
+            }
+            loser_tree tree{ keys };
+            std::uint64_t sum = 0;
+            while (!tree.empty()) {
+                const std::size_t idx = tree.winner();
+                sum += tree.key(idx);
+                if (++positions[idx] < per_source) {
+                    tree.replace(sources[idx][positions[idx]]);
+                }
+                else {
+                    tree.pop();
+                }
+            }
+            benchmark::DoNotOptimize(sum);
+        }
+        state_.SetItemsProcessed(static_cast<std::int64_t>(state_.iterations() * per_source * k));
+    }
+
+    /**
+     * \brief csv_reader::process_batches по k файлам level: разбор и слияние
+     */
+    void BM_merge_files(benchmark::State& state_) {
+        const auto k = static_cast<std::size_t>(state_.range(0));
+        const bool parallel = state_.range(1) != 0;
+        const auto& dir = bench::workload_set(k, bench::bench_megabytes() << 20);
+
+        thread_pool pool;
+        std::uint64_t records = 0;
+        for (auto _ : state_) {
+            csv_reader reader{ pool, read_mode::mmap, parallel };
+            double sum = 0;
+            const auto err = reader.process_batches(dir, {},
+                [&](std::span<const std::uint64_t> ts_, std::span<const double> price_) {
+                    records += ts_.size();
+                    sum += price_.front();
+                });
+            if (err) {
+                state_.SkipWithError(err.message().c_str());
+                break;
+            }
+            benchmark::DoNotOptimize(sum);
+        }
+        state_.SetItemsProcessed(static_cast<std::int64_t>(records));
+    }
+
+    BENCHMARK(BM_loser_tree)->ArgName("k")->RangeMultiplier(2)->Range(2, 512)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_merge_files)->ArgNames({ "k", "parallel" })
+        ->ArgsProduct({ benchmark::CreateRange(2, 512, 4), { 0, 1 } })
+        ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
@@ -0,0 +1,87 @@
+/**
+ * \file bench_reader.cpp
+ * \brief Бенчмарки разбора: basic_file_cursor по записи и пакетами
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <filesystem>
+
+#include "bench_common.hpp"
+#include "pool.hpp"
+#include "price.hpp"
+#include "reader.hpp"
+
+namespace {
+
+    namespace fs = std::filesystem;
+    using namespace csv_median;
+
+    [[nodiscard]] const fs::path& level_file() {
+        return bench::workload_file(workload_kind::level, bench::bench_megabytes() << 20);
+    }
+
+    void set_throughput(benchmark::State& state_, std::uint64_t records_) {
+        state_.SetItemsProcessed(static_cast<std::int64_t>(records_));
+        state_.SetBytesProcessed(static_cast<std::int64_t>(
+            state_.iterations() * fs::file_size(level_file())));
+    }
+
+    /**
+     * \brief advance() по одной записи, как у k-way merge по одной
+     */
+    template<class Price>
+    void BM_cursor_advance(benchmark::State& state_) {
+        const auto mode = static_cast<read_mode>(state_.range(0));
+        const auto& path = level_file();
+        std::uint64_t records = 0;
+        for (auto _ : state_) {
+            basic_file_cursor<Price> cursor{ path, mode };
+            std::uint64_t sum = 0;
+            for (bool valid = cursor.start(); valid; valid = cursor.advance()) {
+                sum += cursor.current().receive_ts;
+                ++records;
+            }
+            benchmark::DoNotOptimize(sum);
+        }
+        set_throughput(state_, records);
+    }
+
+    /**
+     * \brief Пакеты pending_ts() / skip(), как у слияния пакетами
+     */
+    template<class Price>
+    void BM_cursor_batches(benchmark::State& state_) {
+        const auto mode = static_cast<read_mode>(state_.range(0));
+        const bool parallel = state_.range(1) != 0;
+        const auto& path = level_file();
+        thread_pool pool;
+        std::uint64_t records = 0;
+        for (auto _ : state_) {
+            basic_file_cursor<Price> cursor{ path, mode, parallel ? &pool : nullptr };
+            Price sum{};
+            for (bool valid = cursor.start(); valid; ) {
+                const auto prices = cursor.pending_price();
+                for (const Price price : prices) {
+                    sum += price;
+                }
+                records += prices.size();
+                valid = cursor.skip(prices.size());
+            }
+            benchmark::DoNotOptimize(sum);
+        }
+        set_throughput(state_, records);
+    }
+
+    // Аргумент — read_mode: 0 stream, 1 mmap, 2 uring
+    BENCHMARK(BM_cursor_advance<double>)->ArgName("read_mode")->DenseRange(0, 2)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_cursor_advance<fixed_price>)->ArgName("read_mode")->DenseRange(0, 2)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_cursor_batches<double>)->ArgNames({ "read_mode", "parallel" })
+        ->ArgsProduct({ { 0, 1, 2 }, { 0, 1 } })->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK(BM_cursor_batches<fixed_price>)->ArgNames({ "read_mode", "parallel" })
+        ->ArgsProduct({ { 0, 1, 2 }, { 0, 1 } })->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
@@ -0,0 +1,69 @@
+/**
+ * \file bench_writer.cpp
+ * \brief Бенчмарки result_writer::write в каждом write_mode
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <filesystem>
+
+#include "bench_common.hpp"
+#include "price.hpp"
+#include "writer.hpp"
+
+namespace {
+
+    namespace fs = std::filesystem;
+    using namespace csv_median;
+
+    inline constexpr std::size_t k_writer_rows = 1 << 22;
+
+    /**
+     * \brief k_writer_rows строк с медианой, меняющейся по шагу 10^-8
+     */
+    template<class Price>
+    void BM_writer(benchmark::State& state_) {
+        const auto mode = static_cast<write_mode>(state_.range(0));
+        const bench::bench_dir dir{ "csv_median_bench_writer" };
+
+        std::uint64_t bytes = 0;
+        for (auto _ : state_) {
+            result_writer writer{ mode };
+            if (const auto err = writer.open(dir.path, "median_result.csv")) {
+                state_.SkipWithError(err.message().c_str());
+                break;
+            }
+            std::uint64_t ts = k_workload_start_ts;
+            fixed_price median = 6'800'000'000'000;
+            std::error_code err;
+            for (std::size_t i = 0; i < k_writer_rows && !err; ++i) {
+                ts += 100 + i % 4'900;
+                median += static_cast<fixed_price>(i % 7) - 3;
+                if constexpr (std::is_floating_point_v<Price>) {
+                    err = writer.write(ts, price_to_double(median));
+                }
+                else {
+                    err = writer.write(ts, median);
+                }
+            }
+            if (!err) {
+                err = writer.close();
+            }
+            if (err) {
+                state_.SkipWithError(err.message().c_str());
+                break;
+            }
+            bytes += fs::file_size(dir.path / "median_result.csv");
+        }
+        state_.SetItemsProcessed(static_cast<std::int64_t>(state_.iterations() * k_writer_rows));
+        state_.SetBytesProcessed(static_cast<std::int64_t>(bytes));
+    }
+
+    // Аргумент — write_mode: 0 sync, 1 async, 2 uring
+    BENCHMARK(BM_writer<double>)->ArgName("write_mode")->DenseRange(0, 2)
+        ->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK(BM_writer<fixed_price>)->ArgName("write_mode")->DenseRange(0, 2)
+        ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
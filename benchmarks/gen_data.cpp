@@ -0,0 +1,90 @@
+/**
+ * \file gen_data.cpp
+ * \brief Генератор входных данных: utils/gen_data.py без Python
+ *
+ * Пишет btcusdt_trade_2024.csv и btcusdt_level_2024.csv суммарно
+ * не меньше --size-mb МБ; десятки ГБ — со скоростью диска.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include <boost/program_options.hpp>
+#include <spdlog/spdlog.h>
+
+#include "workload.hpp"
+
+namespace po = boost::program_options;
+namespace fs = std::filesystem;
+
+int main(int argc, const char* argv[]) noexcept {
+    fs::path output_dir;
+    std::uint64_t size_mb = 0;
+    double trade_share = 0;
+    std::uint64_t seed = 0;
+
+    try {
+        po::options_description desc{ "gen_data options" };
+        desc.add_options()
+            ("help", "show options")
+            ("output", po::value<std::string>()->default_value("./input"), "output directory")
+            ("size-mb", po::value<std::uint64_t>()->default_value(100), "total size, MB")
+            ("trade-share", po::value<double>()->default_value(0.5), "trade file share, 0..1")
+            ("seed", po::value<std::uint64_t>()->default_value(csv_median::k_workload_seed), "random seed");
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("help")) {
+            std::cout << desc << '\n';
+            return EXIT_SUCCESS;
+        }
+        output_dir = vm["output"].as<std::string>();
+        size_mb = vm["size-mb"].as<std::uint64_t>();
+        trade_share = vm["trade-share"].as<double>();
+        seed = vm["seed"].as<std::uint64_t>();
+        if (!(trade_share >= 0.0 && trade_share <= 1.0)) {
+            spdlog::error("Invalid --trade-share {}, expected 0..1", trade_share);
+            return EXIT_FAILURE;
+        }
+
+        fs::create_directories(output_dir);
+    }
+    catch (const std::exception& e) {
+        spdlog::error("Options error: {}", e.what());
+        return EXIT_FAILURE;
+    }
+
+    const std::uint64_t target_bytes = size_mb * 1024 * 1024;
+    const auto trade_bytes = static_cast<std::uint64_t>(static_cast<double>(target_bytes) * trade_share);
+
+    // Разные seed: иначе блуждания цен двух файлов совпадут
+    const struct {
+        const char*                name;
+        csv_median::workload_kind  kind;
+        std::uint64_t              bytes;
+        std::uint64_t              seed;
+    } files[] = {
+        { "btcusdt_trade_2024.csv", csv_median::workload_kind::trade, trade_bytes, seed },
+        { "btcusdt_level_2024.csv", csv_median::workload_kind::level, target_bytes - trade_bytes, seed + 1 },
+    };
+
+    for (const auto& file : files) {
+        const fs::path path = output_dir / file.name;
+        spdlog::info("Generating {}...", path.string());
+        const auto [lines, err] = csv_median::write_workload(path, file.kind, file.bytes, file.seed);
+        if (err) {
+            spdlog::error("Can't write {}: {}", path.string(), err.message());
+            return EXIT_FAILURE;
+        }
+        spdlog::info("  {}: {} lines", file.name, lines);
+    }
+
+    spdlog::info("Done: {}", output_dir.string());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,311 @@
+/**
+ * \file workload.hpp
+ * \brief Синтетические входные данные для бенчмарков и gen_data
+ *
+ * То же распределение, что у utils/gen_data.py: цена — случайное
+ * блуждание от 68000 с шагом до ±0.05%, receive_ts растёт на 100..5000 мкс,
+ * exchange_ts меньше на 500..3000. В trade одна строка на метку времени,
+ * в level — 1..5 уровней у текущей цены (±50), первый с rebuild = 1.
+ * Цены и объёмы округляются до 8 знаков, как в Python.
+ *
+ * Последовательность воспроизводима по seed, но не совпадает побайтно
+ * с Python: генератор другой (mt19937_64).
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "price.hpp"
+#include "writer.hpp"
+
+namespace csv_median {
+
+    namespace fs = std::filesystem;
+
+    inline constexpr double        k_workload_base_price = 68'000.0;
+    inline constexpr double        k_workload_volatility = 0.0005;
+    inline constexpr std::uint64_t k_workload_start_ts = 1'716'810'808'000'000;
+    inline constexpr std::uint64_t k_workload_ts_step_min = 100;
+    inline constexpr std::uint64_t k_workload_ts_step_max = 5'000;
+    inline constexpr std::uint64_t k_workload_seed = 42;
+
+    /**
+     * \brief Тип генерируемого файла
+     */
+    enum class workload_kind {
+        trade, ///< receive_ts;exchange_ts;price;quantity;side
+        level  ///< receive_ts;exchange_ts;price;quantity;side;rebuild
+    };
+
+    /**
+     * \brief Одна строка данных
+     */
+    struct workload_row {
+        std::uint64_t receive_ts;
+        std::uint64_t exchange_ts;
+        double        price;
+        double        quantity;
+        bool          bid;
+        bool          rebuild;
+    };
+
+    /**
+     * \brief Генератор строк одного файла
+     */
+    class workload_generator {
+    public:
+        /**
+         * \param start_ts_ receive_ts до первой строки: у level gen_data.py
+         *                  добавляет к нему ещё 0..10000
+         */
+        explicit workload_generator(workload_kind kind_,
+            std::uint64_t seed_ = k_workload_seed,
+            std::uint64_t start_ts_ = k_workload_start_ts);
+
+        [[nodiscard]] workload_kind kind() const noexcept;
+
+        /**
+         * \brief Заголовок CSV с переводом строки
+         */
+        [[nodiscard]] std::string_view header() const noexcept;
+
+        /**
+         * \brief Строки следующей метки времени (в trade — одна)
+         * \param rows_ очищается и заполняется
+         */
+        void next(std::vector<workload_row>& rows_);
+
+        /**
+         * \brief Дописать строку в формате файла
+         */
+        void format(const workload_row& row_, std::string& out_) const;
+
+    private:
+        [[nodiscard]] double uniform(double from_, double to_);
+        [[nodiscard]] std::uint64_t uniform_int(std::uint64_t from_, std::uint64_t to_);
+
+        workload_kind   _kind;
+        std::mt19937_64 _rng;
+        std::uint64_t   _ts;
+        double          _price{ k_workload_base_price };
+    };
+
+    /**
+     * \brief Записать файл не меньше target_bytes_ байт данных
+     * \return число записанных строк данных и код ошибки
+     */
+    [[nodiscard]] std::tuple<std::uint64_t, std::error_code>
+        write_workload(const fs::path& path_, workload_kind kind_,
+            std::uint64_t target_bytes_, std::uint64_t seed_ = k_workload_seed) noexcept;
+
+    /**
+     * \brief Записи trade и level, слитые по receive_ts, как их видит калькулятор
+     * \return count_ пар (receive_ts, price)
+     */
+    [[nodiscard]] std::vector<std::pair<std::uint64_t, double>>
+        workload_records(std::size_t count_, std::uint64_t seed_ = k_workload_seed);
+
+    /**
+     * \brief Округлить как round(value, 8) в Python
+     */
+    [[nodiscard]] inline double round_price(double value_) noexcept {
+        constexpr auto scale = static_cast<double>(price_scale<>);
+        return std::round(value_ * scale) / scale;
+    }
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline workload_generator::workload_generator(workload_kind kind_,
+        std::uint64_t seed_, std::uint64_t start_ts_)
+        : _kind{ kind_ }
+        , _rng{ seed_ }
+        , _ts{ start_ts_ }
+    {
+        if (_kind == workload_kind::level) {
+            _ts += uniform_int(0, 10'000);
+        }
+    }
+
+    inline workload_kind workload_generator::kind() const noexcept {
+        return _kind;
+    }
+
+    inline std::string_view workload_generator::header() const noexcept {
+        return _kind == workload_kind::trade
+            ? "receive_ts;exchange_ts;price;quantity;side\n"
+            : "receive_ts;exchange_ts;price;quantity;side;rebuild\n";
+    }
+
+    inline void workload_generator::next(std::vector<workload_row>& rows_) {
+        rows_.clear();
+        _price = round_price(_price * (1.0 + uniform(-k_workload_volatility, k_workload_volatility)));
+
+        if (_kind == workload_kind::trade) {
+            _ts += uniform_int(k_workload_ts_step_min, k_workload_ts_step_max);
+            const std::uint64_t exchange_ts = _ts - uniform_int(500, 3'000);
+            const double quantity = round_price(uniform(0.001, 5.0));
+            rows_.push_back({ _ts, exchange_ts, _price, quantity, uniform_int(0, 1) == 0, false });
+            return;
+        }
+
+        // Несколько уровней стакана на одну метку времени
+        const std::uint64_t levels = uniform_int(1, 5);
+        _ts += uniform_int(k_workload_ts_step_min, k_workload_ts_step_max);
+        const std::uint64_t exchange_ts = _ts - uniform_int(500, 3'000);
+        for (std::uint64_t i = 0; i < levels; ++i) {
+            const double price = round_price(_price + uniform(-50.0, 50.0));
+            const double quantity = round_price(uniform(0.001, 20.0));
+            rows_.push_back({ _ts, exchange_ts, price, quantity, uniform_int(0, 1) == 0, i == 0 });
+        }
+    }
+
+    inline void workload_generator::format(const workload_row& row_, std::string& out_) const {
+        char line[128];
+        char* pos = line;
+        const auto put_uint = [&pos](std::uint64_t value_) {
+            char digits[20];
+            char* end = digits + sizeof(digits);
+            char* begin = end;
+            do {
+                *--begin = static_cast<char>('0' + value_ % 10);
+                value_ /= 10;
+            } while (value_ != 0);
+            while (begin != end) {
+                *pos++ = *begin++;
+            }
+        };
+        constexpr auto scale = static_cast<double>(price_scale<>);
+
+        put_uint(row_.receive_ts);
+        *pos++ = ';';
+        put_uint(row_.exchange_ts);
+        *pos++ = ';';
+        pos = format_fixed(pos, static_cast<fixed_price>(std::llround(row_.price * scale)));
+        *pos++ = ';';
+        pos = format_fixed(pos, static_cast<fixed_price>(std::llround(row_.quantity * scale)));
+        *pos++ = ';';
+        for (const char c : std::string_view{ row_.bid ? "bid" : "ask" }) {
+            *pos++ = c;
+        }
+        if (_kind == workload_kind::level) {
+            *pos++ = ';';
+            *pos++ = row_.rebuild ? '1' : '0';
+        }
+        *pos++ = '\n';
+        out_.append(line, pos);
+    }
+
+    inline double workload_generator::uniform(double from_, double to_) {
+        return std::uniform_real_distribution<double>{ from_, to_ }(_rng);
+    }
+
+    inline std::uint64_t workload_generator::uniform_int(std::uint64_t from_, std::uint64_t to_) {
+        return std::uniform_int_distribution<std::uint64_t>{ from_, to_ }(_rng);
+    }
+
+    inline std::tuple<std::uint64_t, std::error_code>
+        write_workload(const fs::path& path_, workload_kind kind_,
+            std::uint64_t target_bytes_, std::uint64_t seed_) noexcept
+    {
+        constexpr std::size_t flush_size = 1 << 20;
+
+        const int fd = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return { 0, std::error_code{ errno, std::system_category() } };
+        }
+
+        std::uint64_t lines = 0;
+        std::error_code err;
+        try {
+            workload_generator gen{ kind_, seed_ };
+            std::vector<workload_row> rows;
+            std::string buffer;
+            buffer.reserve(flush_size + 1024);
+            buffer.append(gen.header());
+
+            std::uint64_t written = 0;
+            while (!err && written < target_bytes_) {
+                gen.next(rows);
+                // Как в gen_data.py, size проверяется после каждой строки
+                for (const auto& row : rows) {
+                    const std::size_t before = buffer.size();
+                    gen.format(row, buffer);
+                    written += buffer.size() - before;
+                    ++lines;
+                    if (written >= target_bytes_) {
+                        break;
+                    }
+                }
+                if (buffer.size() >= flush_size) {
+                    err = write_all(fd, buffer.data(), buffer.size());
+                    buffer.clear();
+                }
+            }
+            if (!err) {
+                err = write_all(fd, buffer.data(), buffer.size());
+            }
+        }
+        catch (const std::exception&) {
+            err = std::make_error_code(std::errc::not_enough_memory);
+        }
+
+        if (::close(fd) != 0 && !err) {
+            err = { errno, std::system_category() };
+        }
+        return { lines, err };
+    }
+
+    inline std::vector<std::pair<std::uint64_t, double>>
+        workload_records(std::size_t count_, std::uint64_t seed_)
+    {
+        workload_generator trade{ workload_kind::trade, seed_ };
+        workload_generator level{ workload_kind::level, seed_ + 1 };
+        std::vector<workload_row> trade_rows;
+        std::vector<workload_row> level_rows;
+        std::size_t trade_pos = 0;
+        std::size_t level_pos = 0;
+
+        std::vector<std::pair<std::uint64_t, double>> records;
+        records.reserve(count_);
+        while (records.size() < count_) {
+            if (trade_pos == trade_rows.size()) {
+                trade.next(trade_rows);
+                trade_pos = 0;
+            }
+            if (level_pos == level_rows.size()) {
+                level.next(level_rows);
+                level_pos = 0;
+            }
+            // При равных receive_ts первым идёт trade
+            const auto& t = trade_rows[trade_pos];
+            const auto& l = level_rows[level_pos];
+            if (t.receive_ts <= l.receive_ts) {
+                records.emplace_back(t.receive_ts, t.price);
+                ++trade_pos;
+            }
+            else {
+                records.emplace_back(l.receive_ts, l.price);
+                ++level_pos;
+            }
+        }
+        return records;
+    }
+
+}
@@ -0,0 +1,291 @@
+/**
+ * \file bucket.hpp
+ * \brief Прореживание результата: не больше строки на интервал receive_ts
+ *
+ * bucket_sink — приёмник-обёртка: строки медианы копятся в текущей
+ * корзине [k * width, (k + 1) * width), и при переходе в следующую
+ * корзину (или при close()) во вложенный приёмник уходит одна строка:
+ * receive_ts начала корзины и последняя медиана корзины. Корзины без
+ * изменений медианы не пишутся — значение то же, что в прошлой строке.
+ *
+ * С OHLC после медианы (close) идут open, high и low ступенчатого ряда
+ * медианы внутри корзины: open — значение на начало корзины, то есть
+ * последняя медиана прошлой корзины (у самой первой — её первая
+ * медиана), high и low — крайние значения среди open и медиан корзины.
+ * Расчёт об этом не знает: обёртка видит те же вызовы write(), что
+ * и обычный приёмник.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "price.hpp"
+#include "sink.hpp"
+
+namespace csv_median {
+
+    /**
+     * \brief Приёмник, пишущий во вложенный по строке на корзину receive_ts
+     * \tparam Sink вложенный приёмник; для OHLC и статистик — statistics_sink
+     */
+    template<result_sink Sink>
+    class bucket_sink {
+    public:
+        /**
+         * \param sink_ вложенный приёмник, ещё не открытый
+         * \param width_us_ ширина корзины в микросекундах (> 0)
+         * \param ohlc_ колонки open, high, low после медианы
+         */
+        bucket_sink(std::unique_ptr<Sink> sink_, std::uint64_t width_us_, bool ohlc_);
+
+        bucket_sink(const bucket_sink&) = delete;
+        bucket_sink& operator=(const bucket_sink&) = delete;
+
+        /**
+         * \brief Колонки статистик после медианы (и после OHLC)
+         */
+        void set_columns(std::span<const std::string> names_)
+            requires statistics_sink<Sink>;
+
+        [[nodiscard]] std::error_code open(const fs::path& output_dir_);
+
+        [[nodiscard]] std::error_code open(const fs::path& output_dir_,
+            const std::string& filename_);
+
+        [[nodiscard]] std::error_code write(std::uint64_t receive_ts_, double price_median_) noexcept;
+
+        [[nodiscard]] std::error_code write(std::uint64_t receive_ts_,
+            fixed_price price_median_) noexcept;
+
+        /**
+         * \brief Медиана и значения статистик; в корзине остаются последние
+         */
+        [[nodiscard]] std::error_code write(std::uint64_t receive_ts_, double price_median_,
+            std::span<const double> values_) noexcept
+            requires statistics_sink<Sink>;
+
+        [[nodiscard]] std::error_code write(std::uint64_t receive_ts_, fixed_price price_median_,
+            std::span<const double> values_) noexcept
+            requires statistics_sink<Sink>;
+
+        /**
+         * \brief Сбросить буфер вложенного приёмника; текущая корзина
+         * ждёт своего конца
+         */
+        [[nodiscard]] std::error_code flush() noexcept
+            requires requires(Sink& sink_) { { sink_.flush() } -> std::same_as<std::error_code>; };
+
+        /**
+         * \brief Записать последнюю корзину и закрыть вложенный приёмник
+         */
+        std::error_code close() noexcept;
+
+        /**
+         * \brief Строк, записанных во вложенный приёмник
+         */
+        [[nodiscard]] std::size_t written_count() const noexcept;
+
+        [[nodiscard]] const fs::path& path() const noexcept;
+
+    private:
+        /**
+         * \brief Учесть медиану в корзине receive_ts_, выписав прошлую
+         */
+        template<class Price>
+        [[nodiscard]] std::error_code track(std::uint64_t receive_ts_, Price price_median_) noexcept;
+
+        /**
+         * \brief Записать накопленную корзину во вложенный приёмник
+         */
+        [[nodiscard]] std::error_code emit() noexcept;
+
+        std::unique_ptr<Sink> _sink;
+        std::uint64_t         _width;
+        bool                  _ohlc;
+
+        bool                  _pending{ false };
+        std::uint64_t         _bucket{ 0 };        ///< номер корзины
+        bool                  _close_fixed{ false };
+        fixed_price           _close_units{ 0 };   ///< close, если пришёл fixed_price
+        double                _close{ 0.0 };
+        double                _open{ 0.0 };
+        double                _high{ 0.0 };
+        double                _low{ 0.0 };
+        bool                  _has_prev{ false };  ///< была ли уже записана корзина
+        double                _prev_close{ 0.0 };
+        std::vector<double>   _values;             ///< последние статистики корзины
+        std::vector<double>   _row;                ///< OHLC и статистики строки
+        std::size_t           _columns{ 0 };       ///< статистик в строке
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    template<result_sink Sink>
+    inline bucket_sink<Sink>::bucket_sink(std::unique_ptr<Sink> sink_,
+        std::uint64_t width_us_, bool ohlc_)
+        : _sink{ std::move(sink_) }
+        , _width{ std::max<std::uint64_t>(1, width_us_) }
+        , _ohlc{ ohlc_ }
+    {
+        if constexpr (statistics_sink<Sink>) {
+            set_columns({});
+        }
+    }
+
+    template<result_sink Sink>
+    inline void bucket_sink<Sink>::set_columns(std::span<const std::string> names_)
+        requires statistics_sink<Sink>
+    {
+        std::vector<std::string> columns;
+        if (_ohlc) {
+            columns = { "open", "high", "low" };
+        }
+        columns.insert(columns.end(), names_.begin(), names_.end());
+        _sink->set_columns(columns);
+
+        // Ёмкость заранее: write() не выделяет память
+        _columns = names_.size();
+        _values.assign(_columns, 0.0);
+        _row.reserve(columns.size());
+    }
+
+    template<result_sink Sink>
+    inline std::error_code bucket_sink<Sink>::open(const fs::path& output_dir_) {
+        return _sink->open(output_dir_);
+    }
+
+    template<result_sink Sink>
+    inline std::error_code bucket_sink<Sink>::open(const fs::path& output_dir_,
+        const std::string& filename_)
+    {
+        return _sink->open(output_dir_, filename_);
+    }
+
+    template<result_sink Sink>
+    inline std::error_code bucket_sink<Sink>::write(std::uint64_t receive_ts_,
+        double price_median_) noexcept
+    {
+        return track(receive_ts_, price_median_);
+    }
+
+    template<result_sink Sink>
+    inline std::error_code bucket_sink<Sink>::write(std::uint64_t receive_ts_,
+        fixed_price price_median_) noexcept
+    {
+        return track(receive_ts_, price_median_);
+    }
+
+    template<result_sink Sink>
+    inline std::error_code bucket_sink<Sink>::write(std::uint64_t receive_ts_,
+        double price_median_, std::span<const double> values_) noexcept
+        requires statistics_sink<Sink>
+    {
+        const auto err = track(receive_ts_, price_median_);
+        std::copy_n(values_.begin(), std::min(values_.size(), _values.size()), _values.begin());
+        return err;
+    }
+
+    template<result_sink Sink>
+    inline std::error_code bucket_sink<Sink>::write(std::uint64_t receive_ts_,
+        fixed_price price_median_, std::span<const double> values_) noexcept
+        requires statistics_sink<Sink>
+    {
+        const auto err = track(receive_ts_, price_median_);
+        std::copy_n(values_.begin(), std::min(values_.size(), _values.size()), _values.begin());
+        return err;
+    }
+
+    template<result_sink Sink>
+    template<class Price>
+    inline std::error_code bucket_sink<Sink>::track(std::uint64_t receive_ts_,
+        Price price_median_) noexcept
+    {
+        std::error_code err;
+        const std::uint64_t bucket = receive_ts_ / _width;
+        if (_pending && bucket != _bucket) {
+            err = emit();
+        }
+
+        const double value = price_to_double(price_median_);
+        if (!_pending) {
+            _pending = true;
+            _bucket = bucket;
+            _open = _has_prev ? _prev_close : value;
+            _high = _open;
+            _low = _open;
+        }
+        _high = std::max(_high, value);
+        _low = std::min(_low, value);
+        _close = value;
+        if constexpr (std::is_floating_point_v<Price>) {
+            _close_fixed = false;
+        }
+        else {
+            _close_fixed = true;
+            _close_units = price_median_;
+        }
+        return err;
+    }
+
+    template<result_sink Sink>
+    inline std::error_code bucket_sink<Sink>::emit() noexcept {
+        _pending = false;
+        _has_prev = true;
+        _prev_close = _close;
+
+        const std::uint64_t ts = _bucket * _width;
+        if constexpr (statistics_sink<Sink>) {
+            if (_ohlc || _columns != 0) {
+                _row.clear();
+                if (_ohlc) {
+                    _row.insert(_row.end(), { _open, _high, _low });
+                }
+                _row.insert(_row.end(), _values.begin(), _values.end());
+                return _close_fixed
+                    ? _sink->write(ts, _close_units, std::span<const double>{ _row })
+                    : _sink->write(ts, _close, std::span<const double>{ _row });
+            }
+        }
+        return _close_fixed ? _sink->write(ts, _close_units) : _sink->write(ts, _close);
+    }
+
+    template<result_sink Sink>
+    inline std::error_code bucket_sink<Sink>::flush() noexcept
+        requires requires(Sink& sink_) { { sink_.flush() } -> std::same_as<std::error_code>; }
+    {
+        return _sink->flush();
+    }
+
+    template<result_sink Sink>
+    inline std::error_code bucket_sink<Sink>::close() noexcept {
+        std::error_code err;
+        if (_pending) {
+            err = emit();
+        }
+        const auto close_err = _sink->close();
+        return err ? err : close_err;
+    }
+
+    template<result_sink Sink>
+    inline std::size_t bucket_sink<Sink>::written_count() const noexcept {
+        return _sink->written_count();
+    }
+
+    template<result_sink Sink>
+    inline const fs::path& bucket_sink<Sink>::path() const noexcept {
+        return _sink->path();
+    }
+
+}
@@ -0,0 +1,576 @@
+/**
+ * \file cache.hpp
+ * \brief Бинарный колоночный кэш разобранных входных файлов
+ *
+ * Рядом с входным файлом пишется sidecar <имя>.cache: заголовок с
+ * размером, mtime и хэшем источника и блоки по k_cache_block_records
+ * записей. Блок колоночный: receive_ts — дельты от предыдущей записи
+ * (zigzag + LEB128, обычно 1-3 байта), price — int64 в единицах
+ * 10^-8 как есть. Блоки независимы, поэтому кэш пишется по мере
+ * разбора и читается из отображения блок за блоком без разбора CSV.
+ *
+ * Кэш действителен, пока у источника те же размер, mtime и хэш
+ * выборки (начало, середина и конец файла по k_cache_hash_sample
+ * байт) — полный хэш стоил бы чтения всего файла. Новый кэш пишется
+ * во временный файл и переименовывается только после того, как
+ * источник прочитан до конца без ошибок.
+ *
+ * Формат — в порядке байт машины; кэш с другой машины отбрасывается
+ * по маркеру порядка байт в заголовке.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+#include "columns.hpp"
+#include "mapped.hpp"
+#include "price.hpp"
+#include "varint.hpp"
+#include "writer.hpp"
+
+namespace csv_median {
+
+    namespace fs = std::filesystem;
+
+    // Записей в одном блоке кэша — и в одном пакете при чтении
+    inline constexpr std::size_t k_cache_block_records = 64 * 1024;
+
+    // Байт, хэшируемых в начале, середине и конце источника
+    inline constexpr std::size_t k_cache_hash_sample = 64 * 1024;
+
+    inline constexpr std::string_view k_cache_suffix = ".cache";
+
+    /**
+     * \brief Отпечаток источника, с которым сверяется кэш
+     */
+    struct cache_source_info {
+        std::uint64_t size{ 0 };
+        std::int64_t  mtime_ns{ 0 };
+        std::uint64_t hash{ 0 };
+
+        friend bool operator==(const cache_source_info&, const cache_source_info&) = default;
+    };
+
+    /**
+     * \brief Путь sidecar-файла кэша: "trade.csv" -> "trade.csv.cache"
+     */
+    [[nodiscard]] fs::path cache_path(const fs::path& source_) noexcept;
+
+    /**
+     * \brief Снять отпечаток источника: stat и хэш выборки
+     */
+    [[nodiscard]] std::error_code fingerprint(const fs::path& source_,
+        cache_source_info& info_) noexcept;
+
+    namespace detail {
+
+        /**
+         * \brief Заголовок файла кэша
+         */
+        struct cache_header {
+            std::array<char, 8> magic;
+            std::uint32_t       version;
+            std::uint32_t       byte_order;   ///< k_cache_byte_order в порядке байт машины
+            std::uint64_t       source_size;
+            std::int64_t        source_mtime_ns;
+            std::uint64_t       source_hash;
+            std::uint64_t       records;
+            std::uint64_t       lines;        ///< строк данных в источнике, включая пустые
+            std::uint64_t       skipped;      ///< строк, пропущенных из-за ошибок разбора
+        };
+
+        /**
+         * \brief Заголовок блока; за ним дельты ts, выравнивание до 8 и цены
+         */
+        struct cache_block_header {
+            std::uint32_t count;
+            std::uint32_t ts_bytes;
+            std::uint64_t first_ts;
+        };
+
+        inline constexpr std::array<char, 8> k_cache_magic{ 'C', 'S', 'V', 'M', 'C', 'O', 'L', '1' };
+        inline constexpr std::uint32_t k_cache_version = 1;
+        inline constexpr std::uint32_t k_cache_byte_order = 0x01020304;
+
+        [[nodiscard]] constexpr std::size_t align8(std::size_t n_) noexcept {
+            return (n_ + 7) & ~std::size_t{ 7 };
+        }
+
+        /**
+         * \brief FNV-1a, продолжая с hash_
+         */
+        [[nodiscard]] constexpr std::uint64_t fnv1a(std::uint64_t hash_,
+            std::string_view data_) noexcept
+        {
+            for (const char c : data_) {
+                hash_ ^= static_cast<unsigned char>(c);
+                hash_ *= 0x100000001b3ull;
+            }
+            return hash_;
+        }
+
+        /**
+         * \brief Цена из кэша тем же способом, что parse_price<double>
+         */
+        [[nodiscard]] inline double to_double(fixed_price value_) noexcept {
+            constexpr std::int64_t k_exact_limit = std::int64_t{ 1 } << 53;
+            if (value_ > -k_exact_limit && value_ < k_exact_limit) [[likely]] {
+                return static_cast<double>(value_) / static_cast<double>(price_scale<>);
+            }
+            // Строка с k_price_digits знаками — как в исходном файле
+            char text[32];
+            char* const end = format_fixed(text, value_);
+            double out = 0.0;
+            static_cast<void>(std::from_chars(text, end, out));
+            return out;
+        }
+
+        /**
+         * \brief Цена double в единицах 10^-8, если из неё однозначно
+         * восстанавливается то же значение
+         */
+        [[nodiscard]] inline bool to_fixed(double value_, fixed_price& out_) noexcept {
+            constexpr double k_limit = static_cast<double>(std::int64_t{ 1 } << 52);
+            const double scaled = value_ * static_cast<double>(price_scale<>);
+            if (!(std::fabs(scaled) < k_limit)) {
+                return false;
+            }
+            out_ = std::llround(scaled);
+            return to_double(out_) == value_;
+        }
+
+    }
+
+    /**
+     * \brief Чтение действительного кэша из отображения
+     */
+    class cache_reader {
+    public:
+        cache_reader() noexcept = default;
+
+        cache_reader(const cache_reader&) = delete;
+        cache_reader& operator=(const cache_reader&) = delete;
+
+        /**
+         * \param expected_ отпечаток источника сейчас
+         * \return код ошибки; bad_message — кэш устарел или повреждён
+         */
+        [[nodiscard]] std::error_code open(const fs::path& path_,
+            const cache_source_info& expected_) noexcept;
+
+        /**
+         * \brief Распаковать следующий блок в пакет
+         * \return false если блоки кончились или кэш повреждён (err_)
+         */
+        template<class Price>
+        [[nodiscard]] bool next(column_batch<Price>& batch_, std::error_code& err_);
+
+        [[nodiscard]] bool is_open() const noexcept;
+
+        [[nodiscard]] std::uint64_t records() const noexcept;
+
+        /**
+         * \brief Строк, пропущенных из-за ошибок, когда кэш строился
+         */
+        [[nodiscard]] std::uint64_t skipped() const noexcept;
+
+        void close() noexcept;
+
+    private:
+        mapped_file          _map;
+        detail::cache_header _header{};
+        std::size_t          _pos{ 0 };
+        std::uint64_t        _read{ 0 };
+    };
+
+    /**
+     * \brief Запись кэша по мере разбора источника
+     *
+     * Не закоммиченный кэш удаляется в деструкторе.
+     */
+    class cache_writer {
+    public:
+        cache_writer() noexcept = default;
+        ~cache_writer() noexcept;
+
+        cache_writer(const cache_writer&) = delete;
+        cache_writer& operator=(const cache_writer&) = delete;
+
+        /**
+         * \brief Создать временный файл рядом с path_
+         */
+        [[nodiscard]] std::error_code open(const fs::path& path_,
+            const cache_source_info& source_) noexcept;
+
+        /**
+         * \brief Добавить разобранный пакет
+         *
+         * Цены double, не восстановимые однозначно в единицах 10^-8,
+         * отменяют кэш файла (abandon()).
+         */
+        template<class Price>
+        void append(const column_batch<Price>& batch_) noexcept;
+
+        /**
+         * \brief Дописать последний блок и заголовок, заменить кэш
+         */
+        [[nodiscard]] std::error_code commit() noexcept;
+
+        /**
+         * \brief Отказаться от кэша: удалить временный файл
+         */
+        void abandon() noexcept;
+
+        [[nodiscard]] bool is_open() const noexcept;
+
+    private:
+        [[nodiscard]] std::error_code flush_block() noexcept;
+
+        fs::path                   _path;
+        fs::path                   _tmp_path;
+        int                        _fd{ -1 };
+        detail::cache_header       _header{};
+        std::vector<std::uint64_t> _ts;
+        std::vector<fixed_price>   _price;
+        std::vector<char>          _block;
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline fs::path cache_path(const fs::path& source_) noexcept {
+        auto path = source_;
+        path += k_cache_suffix;
+        return path;
+    }
+
+    inline std::error_code fingerprint(const fs::path& source_,
+        cache_source_info& info_) noexcept
+    {
+        const int fd = ::open(source_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return { errno, std::system_category() };
+        }
+
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            const std::error_code err{ errno, std::system_category() };
+            ::close(fd);
+            return err;
+        }
+        if (!S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return std::make_error_code(std::errc::not_supported);
+        }
+        info_.size = static_cast<std::uint64_t>(st.st_size);
+        info_.mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1'000'000'000
+            + st.st_mtim.tv_nsec;
+
+        // Начало, середина и конец: ловят перезапись с тем же размером
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+        std::vector<char> buf(k_cache_hash_sample);
+        const std::uint64_t middle = info_.size / 2;
+        for (const std::uint64_t offset : { std::uint64_t{ 0 }, middle,
+            info_.size - std::min<std::uint64_t>(info_.size, k_cache_hash_sample) })
+        {
+            const ::ssize_t n = ::pread(fd, buf.data(), buf.size(), static_cast<off_t>(offset));
+            if (n < 0) {
+                const std::error_code err{ errno, std::system_category() };
+                ::close(fd);
+                return err;
+            }
+            hash = detail::fnv1a(hash, { buf.data(), static_cast<std::size_t>(n) });
+        }
+        info_.hash = hash;
+
+        ::close(fd);
+        return {};
+    }
+
+    inline std::error_code cache_reader::open(const fs::path& path_,
+        const cache_source_info& expected_) noexcept
+    {
+        close();
+        if (const auto err = _map.open(path_)) {
+            return err;
+        }
+
+        const auto data = _map.view();
+        const auto stale = std::make_error_code(std::errc::bad_message);
+        if (data.size() < sizeof(detail::cache_header)) {
+            close();
+            return stale;
+        }
+        std::memcpy(&_header, data.data(), sizeof(_header));
+
+        const cache_source_info recorded{
+            _header.source_size, _header.source_mtime_ns, _header.source_hash };
+        if (_header.magic != detail::k_cache_magic
+            || _header.version != detail::k_cache_version
+            || _header.byte_order != detail::k_cache_byte_order
+            || recorded != expected_)
+        {
+            close();
+            return stale;
+        }
+
+        _pos = sizeof(detail::cache_header);
+        return {};
+    }
+
+    template<class Price>
+    inline bool cache_reader::next(column_batch<Price>& batch_, std::error_code& err_) {
+        const auto data = _map.view();
+        if (_pos == data.size() && _read == _header.records) {
+            return false;
+        }
+
+        const auto corrupt = [&] {
+            err_ = std::make_error_code(std::errc::bad_message);
+            _pos = data.size();
+            _read = _header.records;
+            return false;
+        };
+
+        detail::cache_block_header block{};
+        if (data.size() - _pos < sizeof(block)) {
+            return corrupt();
+        }
+        std::memcpy(&block, data.data() + _pos, sizeof(block));
+        const std::size_t ts_begin = _pos + sizeof(block);
+        const std::size_t price_begin = detail::align8(ts_begin + block.ts_bytes);
+        const std::size_t block_end = price_begin + std::size_t{ block.count } * sizeof(fixed_price);
+        if (block.count == 0 || block_end > data.size()
+            || _read + block.count > _header.records)
+        {
+            return corrupt();
+        }
+
+        batch_.ts.resize(block.count);
+        const auto* p = reinterpret_cast<const unsigned char*>(data.data() + ts_begin);
+        const auto* const p_end = p + block.ts_bytes;
+        std::uint64_t ts = block.first_ts;
+        batch_.ts[0] = ts;
+        for (std::size_t i = 1; i < block.count; ++i) {
+            if (!get_delta(p, p_end, ts)) [[unlikely]] {
+                return corrupt();
+            }
+            batch_.ts[i] = ts;
+        }
+
+        const char* const prices = data.data() + price_begin;
+        if constexpr (std::is_same_v<Price, fixed_price>) {
+            batch_.price.resize(block.count);
+            std::memcpy(batch_.price.data(), prices, std::size_t{ block.count } * sizeof(fixed_price));
+        }
+        else {
+            batch_.price.resize(block.count);
+            for (std::size_t i = 0; i < block.count; ++i) {
+                fixed_price value = 0;
+                std::memcpy(&value, prices + i * sizeof(fixed_price), sizeof(value));
+                batch_.price[i] = detail::to_double(value);
+            }
+        }
+
+        _pos = block_end;
+        _read += block.count;
+        if (_read == _header.records && _pos != data.size()) {
+            return corrupt();
+        }
+        return true;
+    }
+
+    inline bool cache_reader::is_open() const noexcept {
+        return _map.is_open();
+    }
+
+    inline std::uint64_t cache_reader::records() const noexcept {
+        return _header.records;
+    }
+
+    inline std::uint64_t cache_reader::skipped() const noexcept {
+        return _header.skipped;
+    }
+
+    inline void cache_reader::close() noexcept {
+        _map.close();
+        _header = {};
+        _pos = 0;
+        _read = 0;
+    }
+
+    inline cache_writer::~cache_writer() noexcept {
+        abandon();
+    }
+
+    inline std::error_code cache_writer::open(const fs::path& path_,
+        const cache_source_info& source_) noexcept
+    {
+        abandon();
+        try {
+            _path = path_;
+            _tmp_path = path_;
+            _tmp_path += ".tmp";
+            _ts.reserve(k_cache_block_records);
+            _price.reserve(k_cache_block_records);
+        }
+        catch (const std::exception&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+
+        _fd = ::open(_tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (_fd < 0) {
+            return { errno, std::system_category() };
+        }
+
+        _header = detail::cache_header{};
+        _header.magic = detail::k_cache_magic;
+        _header.version = detail::k_cache_version;
+        _header.byte_order = detail::k_cache_byte_order;
+        _header.source_size = source_.size;
+        _header.source_mtime_ns = source_.mtime_ns;
+        _header.source_hash = source_.hash;
+
+        // Место под заголовок; настоящий пишется в commit()
+        const detail::cache_header placeholder{};
+        if (const auto err = write_all(_fd, reinterpret_cast<const char*>(&placeholder),
+            sizeof(placeholder)))
+        {
+            abandon();
+            return err;
+        }
+        return {};
+    }
+
+    template<class Price>
+    inline void cache_writer::append(const column_batch<Price>& batch_) noexcept {
+        if (_fd < 0) {
+            return;
+        }
+        _header.lines += batch_.lines;
+        _header.skipped += batch_.issues.size();
+
+        for (std::size_t i = 0; i < batch_.size(); ++i) {
+            fixed_price value = 0;
+            if constexpr (std::is_same_v<Price, fixed_price>) {
+                value = batch_.price[i];
+            }
+            else if (!detail::to_fixed(batch_.price[i], value)) [[unlikely]] {
+                spdlog::warn("Price {} can't be cached exactly, not caching {}",
+                    batch_.price[i], _path.string());
+                abandon();
+                return;
+            }
+            _ts.push_back(batch_.ts[i]);
+            _price.push_back(value);
+
+            if (_ts.size() == k_cache_block_records) {
+                if (const auto err = flush_block()) {
+                    spdlog::warn("Can't write cache {}: {}", _tmp_path.string(), err.message());
+                    abandon();
+                    return;
+                }
+            }
+        }
+    }
+
+    inline std::error_code cache_writer::flush_block() noexcept {
+        if (_ts.empty()) {
+            return {};
+        }
+
+        detail::cache_block_header block{};
+        block.count = static_cast<std::uint32_t>(_ts.size());
+        block.first_ts = _ts[0];
+
+        try {
+            _block.resize(sizeof(block) + _ts.size() * k_max_varint_size + 8
+                + _price.size() * sizeof(fixed_price));
+        }
+        catch (const std::exception&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+
+        auto* p = reinterpret_cast<unsigned char*>(_block.data() + sizeof(block));
+        const auto* const ts_begin = p;
+        for (std::size_t i = 1; i < _ts.size(); ++i) {
+            p = put_delta(p, _ts[i], _ts[i - 1]);
+        }
+        block.ts_bytes = static_cast<std::uint32_t>(p - ts_begin);
+        std::memcpy(_block.data(), &block, sizeof(block));
+
+        const std::size_t price_begin = detail::align8(sizeof(block) + block.ts_bytes);
+        std::memset(_block.data() + sizeof(block) + block.ts_bytes, 0,
+            price_begin - sizeof(block) - block.ts_bytes);
+        std::memcpy(_block.data() + price_begin, _price.data(), _price.size() * sizeof(fixed_price));
+        const std::size_t size = price_begin + _price.size() * sizeof(fixed_price);
+
+        _header.records += _ts.size();
+        _ts.clear();
+        _price.clear();
+        return write_all(_fd, _block.data(), size);
+    }
+
+    inline std::error_code cache_writer::commit() noexcept {
+        if (_fd < 0) {
+            return std::make_error_code(std::errc::bad_file_descriptor);
+        }
+
+        auto err = flush_block();
+        if (!err) {
+            err = write_all_at(_fd, reinterpret_cast<const char*>(&_header), sizeof(_header), 0);
+        }
+        if (!err && ::close(_fd) != 0) {
+            err = { errno, std::system_category() };
+        }
+        else if (err) {
+            ::close(_fd);
+        }
+        _fd = -1;
+
+        if (!err && std::rename(_tmp_path.c_str(), _path.c_str()) != 0) {
+            err = { errno, std::system_category() };
+        }
+        if (err) {
+            ::unlink(_tmp_path.c_str());
+        }
+        return err;
+    }
+
+    inline void cache_writer::abandon() noexcept {
+        if (_fd >= 0) {
+            ::close(_fd);
+            _fd = -1;
+            ::unlink(_tmp_path.c_str());
+        }
+        _ts.clear();
+        _price.clear();
+    }
+
+    inline bool cache_writer::is_open() const noexcept {
+        return _fd >= 0;
+    }
+
+}
@@ -0,0 +1,292 @@
+/**
+ * \file checkpoint.hpp
+ * \brief Контрольная точка расчёта: позиции файлов, калькулятор и вывод
+ *
+ * Снимок берётся между пакетами слияния, когда все записи до позиций
+ * курсоров уже переданы калькулятору. Позиция файла — начало строки
+ * текущего блока разбора (смещение и номер строки) и число уже
+ * выданных записей этого блока: продолжение разбирает с диска только
+ * остаток блока, а не весь файл. Если смещение строки неизвестно
+ * (сжатый файл, кэш, параллельный разбор фрагментов), позиция — число
+ * выданных записей от начала файла, и при продолжении они пропускаются.
+ *
+ * Вместе с позициями сохраняются отпечатки файлов (как у кэша), подпись
+ * конфигурации, размер и число строк файла результата после sync() и
+ * снимок калькулятора (state.hpp). Файл пишется во временный и
+ * переименовывается, поэтому на диске всегда целый последний снимок;
+ * в конце — FNV-1a всего содержимого.
+ */
+
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "cache.hpp"
+#include "mapped.hpp"
+#include "state.hpp"
+#include "writer.hpp"
+
+namespace csv_median {
+
+    namespace fs = std::filesystem;
+
+    inline constexpr std::string_view k_checkpoint_filename = "median_result.ckpt";
+
+    /**
+     * \brief Где продолжить чтение файла
+     */
+    struct cursor_position {
+        std::uint64_t offset{ 0 }; ///< начало строки; 0 — сразу после заголовка
+        std::uint64_t line{ 0 };   ///< строк данных до offset; 0 — неизвестно
+        std::uint64_t skip{ 0 };   ///< записей после offset, уже выданных
+        bool          done{ false }; ///< файл дочитан
+
+        friend bool operator==(const cursor_position&, const cursor_position&) = default;
+    };
+
+    /**
+     * \brief Входной файл в контрольной точке
+     */
+    struct file_checkpoint {
+        fs::path          path;
+        cache_source_info source;   ///< отпечаток на момент снимка
+        cursor_position   position;
+    };
+
+    /**
+     * \brief Содержимое файла контрольной точки
+     */
+    struct checkpoint {
+        std::uint64_t                signature{ 0 };   ///< подпись конфигурации расчёта
+        std::uint64_t                records{ 0 };     ///< записей передано калькулятору
+        std::uint64_t                output_size{ 0 }; ///< байт файла результата
+        std::uint64_t                output_rows{ 0 }; ///< строк в них
+        std::vector<file_checkpoint> files;            ///< все файлы под маски, по имени
+        std::vector<unsigned char>   state;            ///< снимок калькулятора
+    };
+
+    /**
+     * \brief FNV-1a байтов data_, продолжая с hash_
+     */
+    [[nodiscard]] std::uint64_t checkpoint_hash(std::span<const unsigned char> data_,
+        std::uint64_t hash_ = 0xcbf29ce484222325ull) noexcept;
+
+    /**
+     * \brief Записать data_ и FNV-1a в конце: временный файл, fdatasync, rename
+     *
+     * На диске всегда целый файл: прошлый или новый.
+     */
+    [[nodiscard]] std::error_code replace_hashed_file(const fs::path& path_,
+        std::span<const unsigned char> data_) noexcept;
+
+    /**
+     * \brief Отобразить файл replace_hashed_file() и проверить FNV-1a
+     * \param body_ содержимое без хеша; живёт, пока открыт map_
+     * \return bad_message — хеш не совпал
+     */
+    [[nodiscard]] std::error_code map_hashed_file(const fs::path& path_, mapped_file& map_,
+        std::span<const unsigned char>& body_) noexcept;
+
+    /**
+     * \brief Путь контрольной точки рядом с результатом
+     */
+    [[nodiscard]] fs::path checkpoint_path(const fs::path& output_dir_);
+
+    /**
+     * \brief Записать контрольную точку: временный файл, fdatasync, rename
+     */
+    [[nodiscard]] std::error_code save_checkpoint(const fs::path& path_,
+        const checkpoint& checkpoint_) noexcept;
+
+    /**
+     * \brief Прочитать контрольную точку
+     * \return bad_message — файл другой версии или повреждён
+     */
+    [[nodiscard]] std::error_code load_checkpoint(const fs::path& path_,
+        checkpoint& checkpoint_) noexcept;
+
+    namespace detail {
+
+        inline constexpr std::array<char, 8> k_checkpoint_magic{ 'C', 'S', 'V', 'M', 'C', 'K', 'P', '1' };
+        inline constexpr std::uint32_t k_checkpoint_version = 1;
+
+    }
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline std::uint64_t checkpoint_hash(std::span<const unsigned char> data_,
+        std::uint64_t hash_) noexcept
+    {
+        for (const unsigned char byte : data_) {
+            hash_ = (hash_ ^ byte) * 0x100000001b3ull;
+        }
+        return hash_;
+    }
+
+    inline fs::path checkpoint_path(const fs::path& output_dir_) {
+        return output_dir_ / k_checkpoint_filename;
+    }
+
+    inline std::error_code replace_hashed_file(const fs::path& path_,
+        std::span<const unsigned char> data_) noexcept
+    {
+        fs::path tmp_path;
+        std::uint64_t hash = 0;
+        try {
+            tmp_path = path_;
+            tmp_path += ".tmp";
+            hash = checkpoint_hash(data_);
+        }
+        catch (const std::exception&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+
+        const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return { errno, std::system_category() };
+        }
+        auto err = write_all(fd, reinterpret_cast<const char*>(data_.data()), data_.size());
+        if (!err) {
+            err = write_all(fd, reinterpret_cast<const char*>(&hash), sizeof(hash));
+        }
+        // Снимок не должен оказаться на диске раньше файла результата
+        if (!err && ::fdatasync(fd) != 0) {
+            err = { errno, std::system_category() };
+        }
+        if (::close(fd) != 0 && !err) {
+            err = { errno, std::system_category() };
+        }
+        if (!err && std::rename(tmp_path.c_str(), path_.c_str()) != 0) {
+            err = { errno, std::system_category() };
+        }
+        if (err) {
+            ::unlink(tmp_path.c_str());
+        }
+        return err;
+    }
+
+    inline std::error_code map_hashed_file(const fs::path& path_, mapped_file& map_,
+        std::span<const unsigned char>& body_) noexcept
+    {
+        if (const auto err = map_.open(path_)) {
+            return err;
+        }
+
+        const auto view = map_.view();
+        const std::span<const unsigned char> data{
+            reinterpret_cast<const unsigned char*>(view.data()), view.size() };
+        std::uint64_t stored_hash = 0;
+        if (data.size() < sizeof(stored_hash)) {
+            return std::make_error_code(std::errc::bad_message);
+        }
+        body_ = data.first(data.size() - sizeof(stored_hash));
+        std::memcpy(&stored_hash, body_.data() + body_.size(), sizeof(stored_hash));
+        if (checkpoint_hash(body_) != stored_hash) {
+            return std::make_error_code(std::errc::bad_message);
+        }
+        return {};
+    }
+
+    inline std::error_code save_checkpoint(const fs::path& path_,
+        const checkpoint& checkpoint_) noexcept
+    {
+        state_writer out;
+        try {
+            out.put(detail::k_checkpoint_magic);
+            out.put(detail::k_checkpoint_version);
+            out.put(detail::k_cache_byte_order);
+            out.put(checkpoint_.signature);
+            out.put(checkpoint_.records);
+            out.put(checkpoint_.output_size);
+            out.put(checkpoint_.output_rows);
+            out.put_varint(checkpoint_.files.size());
+            for (const auto& file : checkpoint_.files) {
+                const auto& name = file.path.native();
+                out.put_bytes({ reinterpret_cast<const unsigned char*>(name.data()), name.size() });
+                out.put(file.source.size);
+                out.put(file.source.mtime_ns);
+                out.put(file.source.hash);
+                out.put_varint(file.position.offset);
+                out.put_varint(file.position.line);
+                out.put_varint(file.position.skip);
+                out.put(file.position.done);
+            }
+            out.put_bytes(checkpoint_.state);
+        }
+        catch (const std::exception&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+        return replace_hashed_file(path_, out.data());
+    }
+
+    inline std::error_code load_checkpoint(const fs::path& path_,
+        checkpoint& checkpoint_) noexcept
+    {
+        mapped_file map;
+        std::span<const unsigned char> body;
+        if (const auto err = map_hashed_file(path_, map, body)) {
+            return err;
+        }
+        const auto corrupt = std::make_error_code(std::errc::bad_message);
+
+        try {
+            state_reader in{ body };
+            std::array<char, 8> magic{};
+            std::uint32_t version = 0;
+            std::uint32_t byte_order = 0;
+            if (!in.get(magic) || magic != detail::k_checkpoint_magic
+                || !in.get(version) || version != detail::k_checkpoint_version
+                || !in.get(byte_order) || byte_order != detail::k_cache_byte_order)
+            {
+                return corrupt;
+            }
+
+            checkpoint result;
+            std::uint64_t files = 0;
+            if (!in.get(result.signature) || !in.get(result.records)
+                || !in.get(result.output_size) || !in.get(result.output_rows)
+                || !in.get_varint(files))
+            {
+                return corrupt;
+            }
+            std::vector<unsigned char> name;
+            for (std::uint64_t i = 0; i < files; ++i) {
+                file_checkpoint file;
+                if (!in.get_bytes(name) || !in.get(file.source.size)
+                    || !in.get(file.source.mtime_ns) || !in.get(file.source.hash)
+                    || !in.get_varint(file.position.offset) || !in.get_varint(file.position.line)
+                    || !in.get_varint(file.position.skip) || !in.get(file.position.done))
+                {
+                    return corrupt;
+                }
+                file.path = fs::path{ std::string{ name.begin(), name.end() } };
+                result.files.push_back(std::move(file));
+            }
+            if (!in.get_bytes(result.state) || !in.done()) {
+                return corrupt;
+            }
+            checkpoint_ = std::move(result);
+        }
+        catch (const std::exception&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+        return {};
+    }
+
+}
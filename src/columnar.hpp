@@ -0,0 +1,561 @@
+/**
+ * \file columnar.hpp
+ * \brief Колоночный бинарный файл результатов: запись и чтение
+ *
+ * Вместо строк "receive_ts;price_median" результат копится блоками по
+ * k_columnar_chunk_rows строк и пишется двумя колонками: receive_ts и
+ * медиана в единицах 10^-8, обе — дельтами от предыдущей строки блока
+ * (zigzag + LEB128, varint.hpp). Медиана меняется на единицы шага
+ * цены, ts растут, поэтому строка занимает 3-5 байт вместо ~30
+ * текстом, а загрузчику не нужно разбирать числа. Блок опционально
+ * сжимается zstd.
+ *
+ * Формат (порядок байт машины, проверяется маркером):
+ *
+ *     file_header   magic "CSVMRES1", version, byte_order, price_digits
+ *     chunk*        chunk_header{ rows, codec, raw_size, stored_size }
+ *                   + stored_size байт: rows дельт ts, затем rows дельт цены
+ *     trailer       magic "CSVMEND1", rows, chunks
+ *
+ * Без trailer файл неполный (запись прервалась) — columnar_reader
+ * сообщает об ошибке. Значения совпадают с CSV выводом: медиана double
+ * переводится в 10^-8 с тем же округлением, что и текст {:.8f}.
+ */
+
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+#include <zstd.h>
+#endif
+
+#include <spdlog/spdlog.h>
+
+#include "mapped.hpp"
+#include "options.hpp"
+#include "price.hpp"
+#include "varint.hpp"
+#include "writer.hpp"
+
+namespace csv_median {
+
+    namespace fs = std::filesystem;
+
+    // Строк в одном блоке колоночного файла (~ 4-5 МБ до сжатия)
+    inline constexpr std::size_t k_columnar_chunk_rows = 1024 * 1024;
+
+    // Уровень zstd: быстрый, дельты и так компактны
+    inline constexpr int k_columnar_zstd_level = 3;
+
+    namespace detail {
+
+        struct columnar_file_header {
+            std::array<char, 8> magic;
+            std::uint32_t       version;
+            std::uint32_t       byte_order;
+            std::uint32_t       price_digits;
+            std::uint32_t       reserved;
+        };
+
+        struct columnar_chunk_header {
+            std::uint32_t rows;
+            std::uint32_t codec;        ///< compression: none или zstd
+            std::uint64_t raw_size;     ///< байт дельт до сжатия
+            std::uint64_t stored_size;  ///< байт в файле
+        };
+
+        struct columnar_trailer {
+            std::array<char, 8> magic;
+            std::uint64_t       rows;
+            std::uint64_t       chunks;
+        };
+
+        inline constexpr std::array<char, 8> k_columnar_magic{ 'C', 'S', 'V', 'M', 'R', 'E', 'S', '1' };
+        inline constexpr std::array<char, 8> k_columnar_end{ 'C', 'S', 'V', 'M', 'E', 'N', 'D', '1' };
+        inline constexpr std::uint32_t k_columnar_version = 1;
+        inline constexpr std::uint32_t k_columnar_byte_order = 0x01020304;
+
+        /**
+         * \brief Медиана double в единицах 10^-8, как её печатает {:.8f}
+         *
+         * Произведение на 10^8 отличается от точного не больше чем на
+         * |x| * 2^-53; если до середины между целыми дальше, округление
+         * то же, что у точного значения. Иначе — через текст.
+         */
+        [[nodiscard]] inline bool nearest_fixed(double value_, fixed_price& out_) noexcept {
+            const double scaled = value_ * static_cast<double>(price_scale<>);
+            if (std::fabs(scaled) < 0x1p52) [[likely]] {
+                const double frac = std::fabs(scaled - std::trunc(scaled));
+                if (std::fabs(frac - 0.5) > std::fabs(scaled) * 0x1p-51) {
+                    out_ = std::llround(scaled);
+                    return true;
+                }
+            }
+
+            char text[k_max_line_size];
+            const auto [end, err] = std::to_chars(text, text + sizeof(text),
+                value_, std::chars_format::fixed, static_cast<int>(k_price_digits));
+            return err == std::errc{}
+                && parse_fixed<k_price_digits>({ text, static_cast<std::size_t>(end - text) }, out_);
+        }
+
+    }
+
+    /**
+     * \brief Писатель результатов в колоночный бинарный файл
+     *
+     * Тот же интерфейс, что у result_writer (концепт result_sink).
+     * Ошибка записи запоминается; после неё все операции возвращают её.
+     */
+    class columnar_writer {
+    public:
+        /**
+         * \param codec_ сжатие блоков: none или zstd
+         * \param chunk_rows_ строк в блоке
+         */
+        explicit columnar_writer(compression codec_ = compression::none,
+            std::size_t chunk_rows_ = k_columnar_chunk_rows) noexcept;
+
+        ~columnar_writer() noexcept;
+
+        columnar_writer(const columnar_writer&) = delete;
+        columnar_writer& operator=(const columnar_writer&) = delete;
+
+        /**
+         * \return код ошибки; not_supported — кодек не собран
+         */
+        [[nodiscard]] std::error_code
+            open(const fs::path& output_dir_,
+                const std::string& filename_ = "median_result.col") noexcept;
+
+        [[nodiscard]] std::error_code
+            write(std::uint64_t receive_ts_, double price_median_) noexcept;
+
+        [[nodiscard]] std::error_code
+            write(std::uint64_t receive_ts_, fixed_price price_median_) noexcept;
+
+        /**
+         * \brief Записать накопленные строки блоком
+         */
+        [[nodiscard]] std::error_code flush() noexcept;
+
+        [[nodiscard]] std::size_t written_count() const noexcept;
+
+        [[nodiscard]] const fs::path& path() const noexcept;
+
+        /**
+         * \brief Последний блок, trailer и закрытие файла
+         */
+        std::error_code close() noexcept;
+
+    private:
+        void fail(std::error_code err_) noexcept;
+
+        compression                _codec;
+        std::size_t                _chunk_rows;
+        int                        _fd{ -1 };
+        fs::path                   _output_path;
+        std::error_code            _error;
+        std::vector<std::uint64_t> _ts;
+        std::vector<fixed_price>   _price;
+        std::vector<char>          _raw;
+        std::vector<char>          _stored;
+        std::size_t                _written_count{ 0 };
+        std::uint64_t              _chunks{ 0 };
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+        ZSTD_CCtx*                 _zstd{ nullptr };
+#endif
+    };
+
+    /**
+     * \brief Чтение колоночного файла результатов блок за блоком
+     */
+    class columnar_reader {
+    public:
+        columnar_reader() noexcept = default;
+
+        columnar_reader(const columnar_reader&) = delete;
+        columnar_reader& operator=(const columnar_reader&) = delete;
+
+        /**
+         * \return код ошибки; bad_message — не колоночный файл результатов
+         */
+        [[nodiscard]] std::error_code open(const fs::path& path_) noexcept;
+
+        /**
+         * \brief Следующий блок: receive_ts и медианы в 10^-8
+         * \return false в конце файла или при ошибке (err_); файл без
+         *         trailer — bad_message
+         */
+        [[nodiscard]] bool next(std::vector<std::uint64_t>& ts_,
+            std::vector<fixed_price>& price_, std::error_code& err_);
+
+        [[nodiscard]] bool is_open() const noexcept;
+
+        void close() noexcept;
+
+    private:
+        mapped_file       _map;
+        std::size_t       _pos{ 0 };
+        std::uint64_t     _rows{ 0 };
+        std::uint64_t     _chunks{ 0 };
+        std::vector<char> _raw;
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline columnar_writer::columnar_writer(compression codec_, std::size_t chunk_rows_) noexcept
+        : _codec{ codec_ }
+        , _chunk_rows{ chunk_rows_ < 1 ? std::size_t{ 1 } : chunk_rows_ }
+    {
+    }
+
+    inline columnar_writer::~columnar_writer() noexcept {
+        static_cast<void>(close());
+    }
+
+    inline std::error_code columnar_writer::open(const fs::path& output_dir_,
+        const std::string& filename_) noexcept
+    {
+        if (_codec != compression::none && _codec != compression::zstd) [[unlikely]] {
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        if (!compression_supported(_codec)) [[unlikely]] {
+            return std::make_error_code(std::errc::not_supported);
+        }
+
+        try {
+            fs::create_directories(output_dir_);
+            _output_path = output_dir_ / filename_;
+            _ts.reserve(_chunk_rows);
+            _price.reserve(_chunk_rows);
+        }
+        catch (const fs::filesystem_error& e) {
+            spdlog::error("Can't create output directory: {}", e.what());
+            return e.code();
+        }
+        catch (const std::exception&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+        if (_codec == compression::zstd) {
+            _zstd = ZSTD_createCCtx();
+            if (_zstd == nullptr) {
+                return std::make_error_code(std::errc::not_enough_memory);
+            }
+        }
+#endif
+
+        _fd = ::open(_output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (_fd < 0) {
+            const std::error_code err{ errno, std::system_category() };
+            spdlog::error("Can't open output file: {}: {}", _output_path.string(), err.message());
+            return err;
+        }
+
+        detail::columnar_file_header header{};
+        header.magic = detail::k_columnar_magic;
+        header.version = detail::k_columnar_version;
+        header.byte_order = detail::k_columnar_byte_order;
+        header.price_digits = k_price_digits;
+        if (const auto err = write_all(_fd, reinterpret_cast<const char*>(&header), sizeof(header))) {
+            fail(err);
+            return err;
+        }
+
+        _error.clear();
+        _written_count = 0;
+        _chunks = 0;
+        spdlog::info("Output file opened: {} (columnar, {})",
+            _output_path.string(), compression_name(_codec));
+        return {};
+    }
+
+    inline std::error_code columnar_writer::write(std::uint64_t receive_ts_,
+        double price_median_) noexcept
+    {
+        fixed_price value = 0;
+        if (!detail::nearest_fixed(price_median_, value)) [[unlikely]] {
+            spdlog::error("Median {} is out of fixed-point range", price_median_);
+            fail(std::make_error_code(std::errc::value_too_large));
+            return _error;
+        }
+        return write(receive_ts_, value);
+    }
+
+    inline std::error_code columnar_writer::write(std::uint64_t receive_ts_,
+        fixed_price price_median_) noexcept
+    {
+        if (_error) [[unlikely]] {
+            return _error;
+        }
+        if (_fd < 0) [[unlikely]] {
+            return std::make_error_code(std::errc::bad_file_descriptor);
+        }
+
+        // Ёмкость зарезервирована в open() — без выделений
+        _ts.push_back(receive_ts_);
+        _price.push_back(price_median_);
+        ++_written_count;
+
+        if (_ts.size() >= _chunk_rows) {
+            return flush();
+        }
+        return {};
+    }
+
+    inline std::error_code columnar_writer::flush() noexcept {
+        if (_error || _ts.empty() || _fd < 0) {
+            return _error;
+        }
+
+        try {
+            _raw.resize(2 * _ts.size() * k_max_varint_size);
+        }
+        catch (const std::exception&) {
+            fail(std::make_error_code(std::errc::not_enough_memory));
+            return _error;
+        }
+
+        auto* p = reinterpret_cast<unsigned char*>(_raw.data());
+        std::uint64_t prev = 0;
+        for (const auto ts : _ts) {
+            p = put_delta(p, ts, prev);
+            prev = ts;
+        }
+        prev = 0;
+        for (const auto price : _price) {
+            const auto value = static_cast<std::uint64_t>(price);
+            p = put_delta(p, value, prev);
+            prev = value;
+        }
+
+        detail::columnar_chunk_header chunk{};
+        chunk.rows = static_cast<std::uint32_t>(_ts.size());
+        chunk.codec = static_cast<std::uint32_t>(compression::none);
+        chunk.raw_size = static_cast<std::uint64_t>(p - reinterpret_cast<unsigned char*>(_raw.data()));
+        chunk.stored_size = chunk.raw_size;
+        const char* stored = _raw.data();
+
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+        if (_codec == compression::zstd) {
+            try {
+                _stored.resize(ZSTD_compressBound(chunk.raw_size));
+            }
+            catch (const std::exception&) {
+                fail(std::make_error_code(std::errc::not_enough_memory));
+                return _error;
+            }
+            const std::size_t n = ZSTD_compressCCtx(_zstd, _stored.data(), _stored.size(),
+                _raw.data(), chunk.raw_size, k_columnar_zstd_level);
+            // Несжимаемый блок хранится как есть
+            if (!ZSTD_isError(n) && n < chunk.raw_size) {
+                chunk.codec = static_cast<std::uint32_t>(compression::zstd);
+                chunk.stored_size = n;
+                stored = _stored.data();
+            }
+        }
+#endif
+
+        _ts.clear();
+        _price.clear();
+
+        if (auto err = write_all(_fd, reinterpret_cast<const char*>(&chunk), sizeof(chunk));
+            err || (err = write_all(_fd, stored, chunk.stored_size)))
+        {
+            fail(err);
+            return _error;
+        }
+        ++_chunks;
+        return {};
+    }
+
+    inline std::size_t columnar_writer::written_count() const noexcept {
+        return _written_count;
+    }
+
+    inline const fs::path& columnar_writer::path() const noexcept {
+        return _output_path;
+    }
+
+    inline void columnar_writer::fail(std::error_code err_) noexcept {
+        if (!_error) {
+            spdlog::error("error during writing file: {}: {}",
+                _output_path.string(), err_.message());
+            _error = err_;
+        }
+    }
+
+    inline std::error_code columnar_writer::close() noexcept {
+        if (_fd < 0) {
+            return _error;
+        }
+
+        static_cast<void>(flush());
+        if (!_error) {
+            detail::columnar_trailer trailer{};
+            trailer.magic = detail::k_columnar_end;
+            trailer.rows = _written_count;
+            trailer.chunks = _chunks;
+            if (const auto err = write_all(_fd,
+                reinterpret_cast<const char*>(&trailer), sizeof(trailer)))
+            {
+                fail(err);
+            }
+        }
+        if (::close(_fd) != 0) {
+            fail({ errno, std::system_category() });
+        }
+        _fd = -1;
+
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+        if (_zstd != nullptr) {
+            ZSTD_freeCCtx(_zstd);
+            _zstd = nullptr;
+        }
+#endif
+        return _error;
+    }
+
+    inline std::error_code columnar_reader::open(const fs::path& path_) noexcept {
+        close();
+        if (const auto err = _map.open(path_)) {
+            return err;
+        }
+
+        const auto data = _map.view();
+        detail::columnar_file_header header{};
+        if (data.size() < sizeof(header)) {
+            close();
+            return std::make_error_code(std::errc::bad_message);
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (header.magic != detail::k_columnar_magic
+            || header.version != detail::k_columnar_version
+            || header.byte_order != detail::k_columnar_byte_order
+            || header.price_digits != k_price_digits)
+        {
+            close();
+            return std::make_error_code(std::errc::bad_message);
+        }
+
+        _pos = sizeof(header);
+        return {};
+    }
+
+    inline bool columnar_reader::next(std::vector<std::uint64_t>& ts_,
+        std::vector<fixed_price>& price_, std::error_code& err_)
+    {
+        const auto data = _map.view();
+        const auto corrupt = [&] {
+            err_ = std::make_error_code(std::errc::bad_message);
+            _pos = data.size();
+            return false;
+        };
+        if (_pos >= data.size()) {
+            return false;
+        }
+
+        // Trailer: конец данных, итоги должны сойтись
+        detail::columnar_trailer trailer{};
+        if (data.size() - _pos == sizeof(trailer)) {
+            std::memcpy(&trailer, data.data() + _pos, sizeof(trailer));
+            if (trailer.magic == detail::k_columnar_end
+                && trailer.rows == _rows && trailer.chunks == _chunks)
+            {
+                _pos = data.size();
+                return false;
+            }
+            return corrupt();
+        }
+
+        detail::columnar_chunk_header chunk{};
+        if (data.size() - _pos < sizeof(chunk) + sizeof(trailer)) {
+            return corrupt();
+        }
+        std::memcpy(&chunk, data.data() + _pos, sizeof(chunk));
+        const std::size_t begin = _pos + sizeof(chunk);
+        if (chunk.stored_size > data.size() - begin - sizeof(trailer)
+            || chunk.raw_size > 2 * std::uint64_t{ chunk.rows } * k_max_varint_size)
+        {
+            return corrupt();
+        }
+
+        const char* raw = data.data() + begin;
+        if (chunk.codec == static_cast<std::uint32_t>(compression::zstd)) {
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+            _raw.resize(chunk.raw_size);
+            const std::size_t n = ZSTD_decompress(_raw.data(), _raw.size(), raw, chunk.stored_size);
+            if (ZSTD_isError(n) || n != chunk.raw_size) {
+                return corrupt();
+            }
+            raw = _raw.data();
+#else
+            err_ = std::make_error_code(std::errc::not_supported);
+            _pos = data.size();
+            return false;
+#endif
+        }
+        else if (chunk.codec != static_cast<std::uint32_t>(compression::none)
+            || chunk.stored_size != chunk.raw_size)
+        {
+            return corrupt();
+        }
+
+        ts_.resize(chunk.rows);
+        price_.resize(chunk.rows);
+        const auto* p = reinterpret_cast<const unsigned char*>(raw);
+        const auto* const end = p + chunk.raw_size;
+        std::uint64_t value = 0;
+        for (auto& ts : ts_) {
+            if (!get_delta(p, end, value)) {
+                return corrupt();
+            }
+            ts = value;
+        }
+        value = 0;
+        for (auto& price : price_) {
+            if (!get_delta(p, end, value)) {
+                return corrupt();
+            }
+            price = static_cast<fixed_price>(value);
+        }
+        if (p != end) {
+            return corrupt();
+        }
+
+        _pos = begin + chunk.stored_size;
+        _rows += chunk.rows;
+        ++_chunks;
+        return true;
+    }
+
+    inline bool columnar_reader::is_open() const noexcept {
+        return _map.is_open();
+    }
+
+    inline void columnar_reader::close() noexcept {
+        _map.close();
+        _pos = 0;
+        _rows = 0;
+        _chunks = 0;
+    }
+
+}
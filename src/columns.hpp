@@ -0,0 +1,283 @@
+/**
+ * \file columns.hpp
+ * \brief Разбор блоков CSV в колонки receive_ts / price (и quantity, группы)
+ *
+ * Общий код последовательного чтения (курсор разбирает блок за блоком)
+ * и параллельного (задачи пула разбирают фрагменты файла по диапазонам
+ * байт). Результат — пакет в виде колонок (SoA) и список ошибочных
+ * строк: сообщения о них пишет курсор, когда знает абсолютный номер
+ * строки, поэтому лог одинаков в обоих режимах.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "group.hpp"
+#include "mapped.hpp"
+#include "price.hpp"
+#include "scanner.hpp"
+
+namespace csv_median {
+
+    // Размер фрагмента файла для одной задачи параллельного разбора
+    inline constexpr std::size_t k_parse_chunk_size = 4 * 1024 * 1024;
+
+    // Поля line_fields, в которые сканер кладёт колонки записи
+    inline constexpr std::size_t k_ts_field = 0;
+    inline constexpr std::size_t k_price_field = 1;
+    inline constexpr std::size_t k_group_field = 2; ///< только если группы по колонке
+    inline constexpr std::size_t k_quantity_field = 3; ///< только для VWAP (stats.hpp)
+
+    /**
+     * \brief Строка, пропущенная из-за ошибки разбора
+     */
+    struct parse_issue {
+        enum class field : std::uint8_t { receive_ts, price, quantity };
+
+        std::uint32_t line;  ///< номер строки от начала пакета, с 0
+        field         what;
+    };
+
+    /**
+     * \brief Разобранные записи в виде колонок
+     * \tparam Price тип цены: double или fixed_price
+     */
+    template<class Price>
+    struct column_batch {
+        std::vector<std::uint64_t> ts;
+        std::vector<Price>         price;
+        std::vector<std::uint64_t> group;      ///< group_key() записей; пусто без групп
+        std::vector<double>        quantity;   ///< объёмы записей; пусто, если не запрошены
+        std::vector<parse_issue>   issues;
+        std::size_t                lines{ 0 }; ///< пройдено строк, включая пустые
+
+        void clear() noexcept {
+            ts.clear();
+            price.clear();
+            group.clear();
+            quantity.clear();
+            issues.clear();
+            lines = 0;
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept {
+            return ts.size();
+        }
+
+        [[nodiscard]] bool empty() const noexcept {
+            return ts.empty();
+        }
+    };
+
+    /**
+     * \brief Источник данных файла для задач разбора: отображение или pread
+     */
+    struct chunk_source {
+        std::string_view       map;             ///< всё отображение (mmap)
+        const positional_file* file{ nullptr }; ///< иначе чтение по смещению
+        std::size_t            size{ 0 };       ///< размер файла
+
+        /**
+         * \brief Байты [from_, to_) файла; при pread — через buf_
+         */
+        [[nodiscard]] std::string_view bytes(std::size_t from_, std::size_t to_,
+            std::vector<char>& buf_, std::error_code& err_) const noexcept;
+    };
+
+    /**
+     * \brief Номер колонки col_ в строке заголовка header_
+     * \return номер с 0 или -1, если колонки нет
+     */
+    [[nodiscard]] int find_column(std::string_view header_, std::string_view col_) noexcept;
+
+    /**
+     * \brief Разметить полные строки блока и разобрать их в пакет
+     *
+     * Номера ошибочных строк считаются от начала пакета (batch_.lines
+     * до вызова), так что несколько блоков можно копить в один пакет.
+     *
+     * \param fields_ рабочий буфер разметки
+     * \return число байт, занятых разобранными строками
+     */
+    template<class Price>
+    std::size_t parse_lines(const line_scanner& scanner_, std::string_view data_,
+        bool final_, std::vector<line_fields>& fields_, column_batch<Price>& batch_);
+
+    /**
+     * \brief Разобрать строки, начинающиеся в диапазоне [begin_, end_) файла
+     *
+     * Строка принадлежит фрагменту, в котором лежит её первый байт,
+     * поэтому соседние фрагменты разбираются независимо и вместе дают
+     * ровно те же строки, что и последовательное чтение.
+     *
+     * \param data_begin_ смещение первой строки данных (после заголовка)
+     */
+    template<class Price>
+    [[nodiscard]] column_batch<Price> parse_chunk(const chunk_source& source_,
+        const line_scanner& scanner_, std::size_t data_begin_,
+        std::size_t begin_, std::size_t end_, std::error_code& err_);
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline int find_column(std::string_view header_, std::string_view col_) noexcept {
+        std::size_t start = 0;
+        int idx = 0;
+
+        while (start <= header_.size()) {
+            const auto pos = header_.find(';', start);
+            const auto end = (pos == std::string_view::npos)
+                ? header_.size() : pos;
+
+            if (header_.substr(start, end - start) == col_) {
+                return idx;
+            }
+            ++idx;
+            start = (pos == std::string_view::npos) ? header_.size() + 1 : pos + 1;
+        }
+        return -1;
+    }
+
+    inline std::string_view chunk_source::bytes(std::size_t from_, std::size_t to_,
+        std::vector<char>& buf_, std::error_code& err_) const noexcept
+    {
+        to_ = std::min(to_, size);
+        if (from_ >= to_) {
+            return {};
+        }
+        if (file == nullptr) {
+            return map.substr(from_, to_ - from_);
+        }
+        buf_.resize(to_ - from_);
+        const auto n = file->read_at(from_, buf_.data(), buf_.size(), err_);
+        return { buf_.data(), n };
+    }
+
+    template<class Price>
+    inline std::size_t parse_lines(const line_scanner& scanner_, std::string_view data_,
+        bool final_, std::vector<line_fields>& fields_, column_batch<Price>& batch_)
+    {
+        fields_.clear();
+        std::size_t lines = 0;
+        const auto consumed = scanner_.scan(data_, final_, fields_, lines);
+        if (consumed == 0) {
+            return 0;
+        }
+
+        const auto base = static_cast<std::uint32_t>(batch_.lines);
+        const bool grouped = scanner_.has_field(k_group_field);
+        const bool weighted = scanner_.has_field(k_quantity_field);
+        batch_.ts.reserve(batch_.ts.size() + fields_.size());
+        batch_.price.reserve(batch_.price.size() + fields_.size());
+        if (grouped) {
+            batch_.group.reserve(batch_.group.size() + fields_.size());
+        }
+        if (weighted) {
+            batch_.quantity.reserve(batch_.quantity.size() + fields_.size());
+        }
+
+        for (const auto& line : fields_) {
+            const auto& ts_ref = line.fields[k_ts_field];
+            const auto& price_ref = line.fields[k_price_field];
+            if (ts_ref.size == 0 || price_ref.size == 0) [[unlikely]] {
+                continue;
+            }
+
+            const char* const ts_begin = data_.data() + ts_ref.offset;
+            std::uint64_t ts = 0;
+            const auto [ts_end, ts_err] = std::from_chars(ts_begin, ts_begin + ts_ref.size, ts);
+            if (ts_err != std::errc{}) [[unlikely]] {
+                batch_.issues.push_back({ base + line.line, parse_issue::field::receive_ts });
+                continue;
+            }
+
+            Price price{};
+            if (!parse_price<k_price_digits>(
+                data_.substr(price_ref.offset, price_ref.size), price)) [[unlikely]]
+            {
+                batch_.issues.push_back({ base + line.line, parse_issue::field::price });
+                continue;
+            }
+
+            if (weighted) {
+                const auto& quantity_ref = line.fields[k_quantity_field];
+                double quantity = 0.0;
+                if (!parse_price<k_price_digits>(
+                    data_.substr(quantity_ref.offset, quantity_ref.size), quantity)) [[unlikely]]
+                {
+                    batch_.issues.push_back({ base + line.line, parse_issue::field::quantity });
+                    continue;
+                }
+                batch_.quantity.push_back(quantity);
+            }
+
+            batch_.ts.push_back(ts);
+            batch_.price.push_back(price);
+            if (grouped) {
+                const auto& group_ref = line.fields[k_group_field];
+                batch_.group.push_back(group_key(data_.substr(group_ref.offset, group_ref.size)));
+            }
+        }
+
+        batch_.lines += lines;
+        return consumed;
+    }
+
+    template<class Price>
+    inline column_batch<Price> parse_chunk(const chunk_source& source_,
+        const line_scanner& scanner_, std::size_t data_begin_,
+        std::size_t begin_, std::size_t end_, std::error_code& err_)
+    {
+        column_batch<Price> batch;
+        end_ = std::min(end_, source_.size);
+        if (begin_ >= end_) {
+            return batch;
+        }
+
+        // С байта перед фрагментом: по нему видно, начинается ли строка в begin_
+        const std::size_t from = (begin_ > data_begin_) ? begin_ - 1 : begin_;
+        std::vector<char> buf;
+        std::size_t to = std::min(source_.size, end_ + 64 * 1024);
+        std::string_view data = source_.bytes(from, to, buf, err_);
+
+        // Первый '\n' не раньше pos_; окно дочитывается, пока его нет
+        const auto find_newline = [&](std::size_t pos_) {
+            auto nl = data.find('\n', pos_);
+            while (nl == std::string_view::npos && to < source_.size && !err_) {
+                to = std::min(source_.size, std::max(to + 64 * 1024, from + data.size() * 2));
+                data = source_.bytes(from, to, buf, err_);
+                nl = data.find('\n', pos_);
+            }
+            return nl;
+        };
+
+        std::size_t start = 0;
+        if (begin_ > data_begin_) {
+            const auto nl = find_newline(0);
+            start = (nl == std::string_view::npos) ? data.size() : nl + 1;
+        }
+
+        // Ни одна строка не начинается внутри фрагмента
+        if (from + start >= end_) {
+            return batch;
+        }
+
+        // Конец: первая строка, начинающаяся не раньше end_
+        const auto nl = find_newline(end_ - 1 - from);
+        const std::size_t stop = (nl == std::string_view::npos) ? data.size() : nl + 1;
+
+        std::vector<line_fields> fields;
+        static_cast<void>(parse_lines(scanner_, data.substr(start, stop - start),
+            true, fields, batch));
+        return batch;
+    }
+
+}
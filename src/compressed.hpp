@@ -0,0 +1,701 @@
+/**
+ * \file compressed.hpp
+ * \brief Потоковая распаковка сжатых CSV файлов: gzip, zstd, lz4
+ *
+ * compressed_reader читает сжатый файл через небольшой входной буфер
+ * и распаковывает его прямо в буфер разбора курсора, так что файл
+ * целиком не разжимается ни на диск, ни в память.
+ *
+ * zstd-файл из нескольких независимых кадров (pzstd, склейка
+ * cat a.zst b.zst) с пулом потоков отображается
+ * в память и распаковывается группами кадров параллельно: в полёте
+ * до thread_count() групп, read() забирает их строго по порядку.
+ * Задача, ещё не взятая пулом, выполняется ожидающим потоком сама —
+ * курсор, создаваемый задачей пула, не ждёт очереди того же пула.
+ *
+ * Кодеки подключаются при сборке: макросы CSV_MEDIAN_HAS_ZLIB,
+ * CSV_MEDIAN_HAS_ZSTD, CSV_MEDIAN_HAS_LZ4 (CMake включает их, если
+ * библиотека найдена). Без кодека open() возвращает not_supported.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(CSV_MEDIAN_HAS_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(CSV_MEDIAN_HAS_LZ4)
+#include <lz4frame.h>
+#endif
+
+#include "mapped.hpp"
+#include "options.hpp"
+#include "pool.hpp"
+
+namespace csv_median {
+
+    namespace fs = std::filesystem;
+
+    // Размер буфера сжатых данных при потоковой распаковке
+    inline constexpr std::size_t k_compressed_input_size = 256 * 1024;
+
+    // Минимум сжатых байт в одной задаче параллельной распаковки zstd;
+    // CSV сжимается в 10-20 раз — это несколько МБ текста
+    inline constexpr std::size_t k_zstd_job_size = 256 * 1024;
+
+    /**
+     * \brief Формат сжатия по последнему расширению файла
+     */
+    [[nodiscard]] compression compression_of(const fs::path& path_) noexcept;
+
+    /**
+     * \brief Имя файла без расширения сжатия: "a.csv.zst" -> "a.csv"
+     */
+    [[nodiscard]] fs::path uncompressed_name(const fs::path& path_) noexcept;
+
+    /**
+     * \brief Последовательное чтение распакованного содержимого файла
+     *
+     * Не копируется и не перемещается.
+     */
+    class compressed_reader {
+    public:
+        compressed_reader() noexcept = default;
+        ~compressed_reader() noexcept;
+
+        compressed_reader(const compressed_reader&) = delete;
+        compressed_reader& operator=(const compressed_reader&) = delete;
+
+        /**
+         * \param codec_ формат; compression::none — invalid_argument
+         * \param pool_  пул для параллельной распаковки кадров zstd;
+         *               nullptr — распаковка в потоке, вызывающем read()
+         * \return код ошибки; not_supported — кодек не собран
+         */
+        [[nodiscard]] std::error_code open(const fs::path& path_, compression codec_,
+            thread_pool* pool_ = nullptr) noexcept;
+
+        /**
+         * \brief Распаковать следующие до size_ байт
+         * \return число байт; 0 — конец данных или ошибка (err_)
+         */
+        [[nodiscard]] std::size_t read(char* out_, std::size_t size_,
+            std::error_code& err_) noexcept;
+
+        [[nodiscard]] bool is_open() const noexcept;
+
+        /**
+         * \brief Кадры распаковываются задачами пула
+         */
+        [[nodiscard]] bool parallel() const noexcept;
+
+        void close() noexcept;
+
+    private:
+        /**
+         * \brief Группа кадров zstd для одной задачи пула
+         */
+        struct zstd_job {
+            std::string_view           src;
+            std::vector<char>          out;
+            std::error_code            err;
+            std::atomic<std::uint8_t>  state{ 0 };  ///< 0 ждёт, 1 выполняется, 2 готова
+        };
+
+        /**
+         * \brief Дочитать сжатые данные во входной буфер
+         */
+        [[nodiscard]] std::error_code refill_input() noexcept;
+
+        /**
+         * \brief Один шаг кодека над входным буфером
+         *
+         * Сдвигает _in_pos на поглощённые байты, отмечает _finished
+         * на границе потока (кадра, члена gzip).
+         */
+        [[nodiscard]] std::error_code step(char* out_, std::size_t size_,
+            std::size_t& produced_) noexcept;
+
+        /**
+         * \brief read() при параллельной распаковке кадров
+         */
+        [[nodiscard]] std::size_t read_frames(char* out_, std::size_t size_,
+            std::error_code& err_) noexcept;
+
+        /**
+         * \brief Разбить отображение на группы кадров
+         * \return false если файл не из нескольких кадров zstd
+         */
+        [[nodiscard]] bool split_frames() noexcept;
+
+        /**
+         * \brief Поставить задачи следующих групп, пока очередь не заполнена
+         */
+        [[nodiscard]] std::error_code submit_jobs() noexcept;
+
+        /**
+         * \brief Выполнить задачу, если её ещё никто не взял
+         * \return false если задачу уже выполняет или выполнил другой поток
+         */
+        static bool run_job(zstd_job& job_) noexcept;
+
+        /**
+         * \brief Дождаться готовности задачи, при необходимости выполнив её
+         */
+        static void await_job(zstd_job& job_) noexcept;
+
+        static void decode_job(zstd_job& job_) noexcept;
+
+        /**
+         * \brief Отменить невзятые задачи и дождаться выполняющихся
+         */
+        void cancel_jobs() noexcept;
+
+        /**
+         * \brief Прекратить чтение после ошибки: дальше read() вернёт 0
+         */
+        void fail() noexcept;
+
+        compression       _codec{ compression::none };
+        int               _fd{ -1 };
+        std::vector<char> _in;
+        std::size_t       _in_pos{ 0 };
+        std::size_t       _in_end{ 0 };
+        bool              _in_eof{ false };
+        bool              _finished{ true };  ///< поток кончился на границе кадра
+
+#if defined(CSV_MEDIAN_HAS_ZLIB)
+        z_stream          _zlib{};
+        bool              _zlib_init{ false };
+#endif
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+        ZSTD_DCtx*        _zstd{ nullptr };
+#endif
+#if defined(CSV_MEDIAN_HAS_LZ4)
+        LZ4F_dctx*        _lz4{ nullptr };
+#endif
+
+        thread_pool*                             _pool{ nullptr };
+        mapped_file                              _map;
+        std::vector<std::pair<std::size_t, std::size_t>> _groups;  ///< [begin, end) сжатых байт
+        std::size_t                              _next_group{ 0 };
+        std::size_t                              _depth{ 0 };
+        std::deque<std::shared_ptr<zstd_job>>    _jobs;
+        std::size_t                              _job_pos{ 0 };
+        bool                                     _open{ false };
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline compression compression_of(const fs::path& path_) noexcept {
+        const auto ext = path_.extension();
+        if (ext == ".gz") {
+            return compression::gzip;
+        }
+        if (ext == ".zst") {
+            return compression::zstd;
+        }
+        if (ext == ".lz4") {
+            return compression::lz4;
+        }
+        return compression::none;
+    }
+
+    inline fs::path uncompressed_name(const fs::path& path_) noexcept {
+        if (compression_of(path_) == compression::none) {
+            return path_;
+        }
+        return path_.parent_path() / path_.stem();
+    }
+
+    inline compressed_reader::~compressed_reader() noexcept {
+        close();
+    }
+
+    inline std::error_code compressed_reader::open(const fs::path& path_,
+        compression codec_, thread_pool* pool_) noexcept
+    {
+        close();
+        if (codec_ == compression::none) {
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        if (!compression_supported(codec_)) {
+            return std::make_error_code(std::errc::not_supported);
+        }
+        _codec = codec_;
+
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+        // Несколько кадров zstd — параллельно; иначе отображение не нужно
+        if (codec_ == compression::zstd && pool_ != nullptr && !_map.open(path_)) {
+            if (split_frames()) {
+                _pool = pool_;
+                _depth = std::max<std::size_t>(2, pool_->thread_count());
+                _open = true;
+                if (const auto err = submit_jobs()) {
+                    close();
+                    return err;
+                }
+                return {};
+            }
+            _map.close();
+            _groups.clear();
+        }
+#else
+        static_cast<void>(pool_);
+#endif
+
+        _fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (_fd < 0) {
+            const std::error_code err{ errno, std::system_category() };
+            close();
+            return err;
+        }
+#if defined(POSIX_FADV_SEQUENTIAL)
+        static_cast<void>(::posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL));
+#endif
+
+        try {
+            _in.resize(k_compressed_input_size);
+        }
+        catch (const std::exception&) {
+            close();
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+
+        bool ok = false;
+        switch (codec_) {
+        case compression::gzip:
+#if defined(CSV_MEDIAN_HAS_ZLIB)
+            // 15 + 32: окно 32 КБ, автоопределение заголовка gzip / zlib
+            _zlib_init = (inflateInit2(&_zlib, 15 + 32) == Z_OK);
+            ok = _zlib_init;
+#endif
+            break;
+        case compression::zstd:
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+            _zstd = ZSTD_createDCtx();
+            ok = (_zstd != nullptr);
+#endif
+            break;
+        case compression::lz4:
+#if defined(CSV_MEDIAN_HAS_LZ4)
+            ok = !LZ4F_isError(LZ4F_createDecompressionContext(&_lz4, LZ4F_VERSION));
+#endif
+            break;
+        case compression::none:
+            break;
+        }
+        if (!ok) {
+            close();
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+
+        _open = true;
+        return {};
+    }
+
+    inline std::error_code compressed_reader::refill_input() noexcept {
+        if (_in_pos < _in_end || _in_eof) {
+            return {};
+        }
+        _in_pos = 0;
+        _in_end = 0;
+        for (;;) {
+            const auto n = ::read(_fd, _in.data(), _in.size());
+            if (n > 0) {
+                _in_end = static_cast<std::size_t>(n);
+                return {};
+            }
+            if (n == 0) {
+                _in_eof = true;
+                return {};
+            }
+            if (errno != EINTR) {
+                return { errno, std::system_category() };
+            }
+        }
+    }
+
+    inline std::error_code compressed_reader::step([[maybe_unused]] char* out_,
+        [[maybe_unused]] std::size_t size_, [[maybe_unused]] std::size_t& produced_) noexcept
+    {
+        [[maybe_unused]] const char* const src = _in.data() + _in_pos;
+        [[maybe_unused]] const std::size_t src_size = _in_end - _in_pos;
+        [[maybe_unused]] const auto corrupt = std::make_error_code(std::errc::bad_message);
+
+        switch (_codec) {
+        case compression::gzip: {
+#if defined(CSV_MEDIAN_HAS_ZLIB)
+            const auto out_size = static_cast<uInt>(std::min<std::size_t>(size_, UINT_MAX));
+            const auto in_size = static_cast<uInt>(src_size);
+            _zlib.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(src));
+            _zlib.avail_in = in_size;
+            _zlib.next_out = reinterpret_cast<Bytef*>(out_);
+            _zlib.avail_out = out_size;
+
+            const int ret = inflate(&_zlib, Z_NO_FLUSH);
+            _in_pos += in_size - _zlib.avail_in;
+            produced_ = out_size - _zlib.avail_out;
+
+            if (ret == Z_STREAM_END) {
+                // Следом может идти следующий член gzip (склейка файлов)
+                _finished = true;
+                inflateReset(&_zlib);
+                return {};
+            }
+            if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                return corrupt;
+            }
+            _finished = false;
+            return {};
+#else
+            break;
+#endif
+        }
+        case compression::zstd: {
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+            ZSTD_inBuffer in{ src, src_size, 0 };
+            ZSTD_outBuffer out{ out_, size_, 0 };
+            const std::size_t ret = ZSTD_decompressStream(_zstd, &out, &in);
+            if (ZSTD_isError(ret)) {
+                return corrupt;
+            }
+            _in_pos += in.pos;
+            produced_ = out.pos;
+            _finished = (ret == 0);
+            return {};
+#else
+            break;
+#endif
+        }
+        case compression::lz4: {
+#if defined(CSV_MEDIAN_HAS_LZ4)
+            std::size_t in_size = src_size;
+            std::size_t out_size = size_;
+            const std::size_t ret = LZ4F_decompress(_lz4, out_, &out_size, src, &in_size, nullptr);
+            if (LZ4F_isError(ret)) {
+                return corrupt;
+            }
+            _in_pos += in_size;
+            produced_ = out_size;
+            _finished = (ret == 0);
+            return {};
+#else
+            break;
+#endif
+        }
+        case compression::none:
+            break;
+        }
+        return std::make_error_code(std::errc::not_supported);
+    }
+
+    inline std::size_t compressed_reader::read(char* out_, std::size_t size_,
+        std::error_code& err_) noexcept
+    {
+        if (!_open || size_ == 0) {
+            return 0;
+        }
+        if (_pool != nullptr) {
+            return read_frames(out_, size_, err_);
+        }
+
+        std::size_t produced = 0;
+        while (produced == 0) {
+            if (const auto err = refill_input()) {
+                err_ = err;
+                fail();
+                return 0;
+            }
+
+            const bool no_input = (_in_pos == _in_end);
+            if (no_input && _finished) {
+                return 0;
+            }
+
+            const std::size_t in_before = _in_pos;
+            if (const auto err = step(out_, size_, produced)) {
+                err_ = err;
+                fail();
+                return 0;
+            }
+
+            // Вход кончился посреди кадра, или кодек стоит на месте
+            if (produced == 0 && (no_input || _in_pos == in_before)) {
+                err_ = std::make_error_code(std::errc::bad_message);
+                fail();
+                return 0;
+            }
+        }
+        return produced;
+    }
+
+    inline bool compressed_reader::split_frames() noexcept {
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+        const auto data = _map.view();
+        std::size_t frames = 0;
+        std::size_t group_begin = 0;
+        std::size_t offset = 0;
+        try {
+            while (offset < data.size()) {
+                const std::size_t n = ZSTD_findFrameCompressedSize(
+                    data.data() + offset, data.size() - offset);
+                if (ZSTD_isError(n) || n == 0) {
+                    // Повреждённый хвост: ошибку сообщит потоковая распаковка
+                    return false;
+                }
+                offset += n;
+                ++frames;
+                if (offset - group_begin >= k_zstd_job_size) {
+                    _groups.emplace_back(group_begin, offset);
+                    group_begin = offset;
+                }
+            }
+            if (group_begin < offset) {
+                _groups.emplace_back(group_begin, offset);
+            }
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+        return frames > 1 && _groups.size() > 1;
+#else
+        return false;
+#endif
+    }
+
+    inline std::error_code compressed_reader::submit_jobs() noexcept {
+        try {
+            while (_jobs.size() < _depth && _next_group < _groups.size()) {
+                const auto [begin, end] = _groups[_next_group];
+                auto job = std::make_shared<zstd_job>();
+                job->src = _map.view().substr(begin, end - begin);
+                _jobs.push_back(job);
+                ++_next_group;
+                try {
+                    static_cast<void>(_pool->submit([job] { run_job(*job); }));
+                }
+                catch (const std::exception&) {
+                    // Пул не принял задачу — её выполнит await_job()
+                }
+            }
+        }
+        catch (const std::exception&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+        return {};
+    }
+
+    inline bool compressed_reader::run_job(zstd_job& job_) noexcept {
+        std::uint8_t expected = 0;
+        if (!job_.state.compare_exchange_strong(expected, 1, std::memory_order_acq_rel)) {
+            return false;
+        }
+        decode_job(job_);
+        job_.state.store(2, std::memory_order_release);
+        job_.state.notify_all();
+        return true;
+    }
+
+    inline void compressed_reader::await_job(zstd_job& job_) noexcept {
+        if (run_job(job_)) {
+            return;
+        }
+        for (auto s = job_.state.load(std::memory_order_acquire); s != 2;
+            s = job_.state.load(std::memory_order_acquire))
+        {
+            job_.state.wait(s, std::memory_order_acquire);
+        }
+    }
+
+    inline void compressed_reader::decode_job(zstd_job& job_) noexcept {
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+        const auto corrupt = std::make_error_code(std::errc::bad_message);
+        const char* const src = job_.src.data();
+        const std::size_t src_size = job_.src.size();
+
+        try {
+            // Размер известен из заголовков всех кадров — распаковка за один вызов
+            std::size_t total = 0;
+            bool known = true;
+            for (std::size_t offset = 0; offset < src_size && known;) {
+                const auto content = ZSTD_getFrameContentSize(src + offset, src_size - offset);
+                if (content == ZSTD_CONTENTSIZE_UNKNOWN || content == ZSTD_CONTENTSIZE_ERROR) {
+                    known = false;
+                    break;
+                }
+                total += static_cast<std::size_t>(content);
+                offset += ZSTD_findFrameCompressedSize(src + offset, src_size - offset);
+            }
+
+            if (known) {
+                job_.out.resize(total);
+                const std::size_t n = ZSTD_decompress(job_.out.data(), total, src, src_size);
+                if (ZSTD_isError(n)) {
+                    job_.err = corrupt;
+                    return;
+                }
+                job_.out.resize(n);
+                return;
+            }
+
+            std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> ctx{
+                ZSTD_createDCtx(), &ZSTD_freeDCtx };
+            if (!ctx) {
+                job_.err = std::make_error_code(std::errc::not_enough_memory);
+                return;
+            }
+
+            ZSTD_inBuffer in{ src, src_size, 0 };
+            std::size_t used = 0;
+            std::size_t ret = 1;
+            while (in.pos < in.size || ret != 0) {
+                if (job_.out.size() - used < ZSTD_DStreamOutSize()) {
+                    job_.out.resize(std::max(job_.out.size() * 2, used + ZSTD_DStreamOutSize()));
+                }
+                ZSTD_outBuffer out{ job_.out.data() + used, job_.out.size() - used, 0 };
+                const std::size_t in_before = in.pos;
+                ret = ZSTD_decompressStream(ctx.get(), &out, &in);
+                if (ZSTD_isError(ret) || (out.pos == 0 && in.pos == in_before)) {
+                    job_.err = corrupt;
+                    return;
+                }
+                used += out.pos;
+            }
+            job_.out.resize(used);
+        }
+        catch (const std::exception&) {
+            job_.err = std::make_error_code(std::errc::not_enough_memory);
+        }
+#else
+        job_.err = std::make_error_code(std::errc::not_supported);
+#endif
+    }
+
+    inline std::size_t compressed_reader::read_frames(char* out_, std::size_t size_,
+        std::error_code& err_) noexcept
+    {
+        std::size_t produced = 0;
+        while (produced < size_) {
+            if (_jobs.empty()) {
+                break;
+            }
+
+            auto& job = *_jobs.front();
+            await_job(job);
+            if (job.err) [[unlikely]] {
+                err_ = job.err;
+                fail();
+                return produced;
+            }
+
+            const std::size_t n = std::min(size_ - produced, job.out.size() - _job_pos);
+            std::memcpy(out_ + produced, job.out.data() + _job_pos, n);
+            produced += n;
+            _job_pos += n;
+
+            if (_job_pos == job.out.size()) {
+                _jobs.pop_front();
+                _job_pos = 0;
+                if (const auto err = submit_jobs()) [[unlikely]] {
+                    err_ = err;
+                    fail();
+                    return produced;
+                }
+            }
+        }
+        return produced;
+    }
+
+    inline void compressed_reader::cancel_jobs() noexcept {
+        for (auto& job : _jobs) {
+            std::uint8_t expected = 0;
+            if (!job->state.compare_exchange_strong(expected, 2, std::memory_order_acq_rel)) {
+                await_job(*job);
+            }
+        }
+        _jobs.clear();
+        _job_pos = 0;
+    }
+
+    inline void compressed_reader::fail() noexcept {
+        cancel_jobs();
+        _next_group = _groups.size();
+        _in_pos = _in_end;
+        _in_eof = true;
+        _finished = true;
+    }
+
+    inline bool compressed_reader::is_open() const noexcept {
+        return _open;
+    }
+
+    inline bool compressed_reader::parallel() const noexcept {
+        return _pool != nullptr;
+    }
+
+    inline void compressed_reader::close() noexcept {
+        // Задачи пула читают отображение — до его закрытия
+        cancel_jobs();
+        _groups.clear();
+        _next_group = 0;
+        _map.close();
+        _pool = nullptr;
+
+#if defined(CSV_MEDIAN_HAS_ZLIB)
+        if (_zlib_init) {
+            inflateEnd(&_zlib);
+            _zlib = z_stream{};
+            _zlib_init = false;
+        }
+#endif
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+        if (_zstd != nullptr) {
+            ZSTD_freeDCtx(_zstd);
+            _zstd = nullptr;
+        }
+#endif
+#if defined(CSV_MEDIAN_HAS_LZ4)
+        if (_lz4 != nullptr) {
+            LZ4F_freeDecompressionContext(_lz4);
+            _lz4 = nullptr;
+        }
+#endif
+
+        if (_fd >= 0) {
+            ::close(_fd);
+            _fd = -1;
+        }
+        _in.clear();
+        _in_pos = 0;
+        _in_end = 0;
+        _in_eof = false;
+        _finished = true;
+        _codec = compression::none;
+        _open = false;
+    }
+
+}
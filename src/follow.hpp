@@ -0,0 +1,610 @@
+/**
+ * \file follow.hpp
+ * \brief Чтение дописываемых CSV файлов: ожидание, хвосты и водяной знак
+ *
+ * dir_watch ждёт изменений во входной директории через inotify
+ * (Linux); без него — опрос с интервалом follow_options::poll_ms.
+ *
+ * file_tail читает файл по смещению (pread) от места, где остановился,
+ * и разбирает только полные строки: недописанная строка ждёт своего
+ * '\n' в буфере до следующего чтения.
+ *
+ * watermark_merge сливает записи хвостов по (receive_ts, источник).
+ * Запись выдаётся, когда её уже не обгонит запись другого файла:
+ * её receive_ts меньше последнего прочитанного у файлов, дочитанных
+ * не до конца, и не больше самого свежего receive_ts минус
+ * lateness_us. Дочитанный до конца файл выдачу не держит — он может
+ * молчать сколько угодно; на lateness_us ему разрешено отставать.
+ * Записи, пришедшие после выдачи более поздних, отбрасываются.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "columns.hpp"
+#include "group.hpp"
+#include "mapped.hpp"
+#include "merge.hpp"
+#include "metrics.hpp"
+#include "scanner.hpp"
+
+#if defined(__linux__) && __has_include(<sys/inotify.h>)
+#define CSV_MEDIAN_INOTIFY 1
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace csv_median {
+
+    namespace fs = std::filesystem;
+
+    /**
+     * \brief Ожидание изменений файлов директории
+     *
+     * Не копируется. Без inotify open() возвращает not_supported,
+     * а wait() просто выжидает интервал.
+     */
+    class dir_watch {
+    public:
+        dir_watch() noexcept = default;
+        ~dir_watch() noexcept;
+
+        dir_watch(const dir_watch&) = delete;
+        dir_watch& operator=(const dir_watch&) = delete;
+
+        /**
+         * \brief Следить за дописыванием, созданием и переносом файлов в dir_
+         */
+        [[nodiscard]] std::error_code open(const fs::path& dir_) noexcept;
+
+        /**
+         * \brief Ждать изменений не дольше timeout_ms_
+         * \param created_ выставляется, если в директории могли
+         *        появиться новые файлы
+         * \return false — за интервал изменений не было
+         */
+        [[nodiscard]] bool wait(std::uint32_t timeout_ms_, bool& created_) noexcept;
+
+        [[nodiscard]] bool is_open() const noexcept;
+
+    private:
+        int _fd{ -1 };
+    };
+
+    /**
+     * \brief Дописываемый CSV файл, читаемый с места остановки
+     * \tparam Price тип цены записей: double или fixed_price
+     */
+    template<class Price>
+    class file_tail {
+    public:
+        /**
+         * \param groups_ ключи групп записей, как у basic_file_cursor
+         * \param quantity_ разбирать колонку quantity
+         */
+        file_tail(const fs::path& path_, const record_groups& groups_, bool quantity_) noexcept;
+
+        /**
+         * \brief Прочитать до max_bytes_ новых байт и разобрать полные строки
+         * \param batch_ очищается; сюда — записи полных строк
+         * \return false, если файл больше не читается (ошибка в логе)
+         */
+        [[nodiscard]] bool read(column_batch<Price>& batch_, std::size_t max_bytes_) noexcept;
+
+        /**
+         * \brief Узнать новый размер файла; усечённый файл закрывается
+         */
+        void refresh() noexcept;
+
+        /**
+         * \brief Прочитано всё, что было в файле при последнем refresh()
+         */
+        [[nodiscard]] bool caught_up() const noexcept;
+
+        [[nodiscard]] bool is_open() const noexcept;
+
+        [[nodiscard]] std::string filename() const noexcept;
+
+    private:
+        /**
+         * \brief Найти колонки в строке заголовка
+         */
+        [[nodiscard]] bool read_header(std::string_view header_) noexcept;
+
+        /**
+         * \brief Учесть пакет в метриках и записать в лог пропущенные строки (до лимита файла)
+         * \param bytes_ разобрано байт файла
+         */
+        void report(column_batch<Price>& batch_, std::size_t bytes_) noexcept;
+
+        fs::path                 _path;
+        file_metrics*            _metrics;
+        positional_file          _file;
+        std::vector<char>        _buffer;       ///< прочитанные, но не разобранные байты
+        std::size_t              _offset{ 0 };  ///< прочитано байт файла
+        line_scanner             _scanner;
+        std::vector<line_fields> _fields;
+        record_groups            _groups;
+        bool                     _quantity{ false };
+        bool                     _header{ false };
+        std::size_t              _line_num{ 0 }; ///< строк данных до пакета
+    };
+
+    /**
+     * \brief Слияние дописываемых источников по водяному знаку receive_ts
+     * \tparam Price тип цены записей: double или fixed_price
+     */
+    template<class Price>
+    class watermark_merge {
+    public:
+        /**
+         * \param lateness_us_ на сколько дочитанный источник может
+         *        отставать от самого свежего
+         */
+        explicit watermark_merge(std::uint64_t lateness_us_) noexcept;
+
+        /**
+         * \brief Новый источник, пока не дочитанный
+         * \return его индекс
+         */
+        [[nodiscard]] std::size_t add_source();
+
+        /**
+         * \brief Записи источника в порядке receive_ts
+         *
+         * Записи раньше уже выданных отбрасываются (late_count()).
+         */
+        void push(std::size_t source_, const column_batch<Price>& batch_);
+
+        /**
+         * \brief Источник дочитан до конца и не держит выдачу
+         */
+        void set_caught_up(std::size_t source_, bool caught_up_) noexcept;
+
+        /**
+         * \brief Последний receive_ts источника; 0, если записей не было
+         */
+        [[nodiscard]] std::uint64_t frontier(std::size_t source_) const noexcept;
+
+        /**
+         * \brief Выдать по порядку записи не позже водяного знака
+         *
+         * on_batch_(batch, pos, n) получает n подряд идущих записей
+         * одного источника с позиции pos его пакета.
+         * \param all_ выдать всё накопленное (завершение)
+         * \return число выданных записей
+         */
+        template<class OnBatch>
+        std::size_t release(OnBatch&& on_batch_, bool all_ = false);
+
+        /**
+         * \brief Отброшено записей, пришедших позже более новых
+         */
+        [[nodiscard]] std::size_t late_count() const noexcept;
+
+        /**
+         * \brief Записей ждёт водяного знака
+         */
+        [[nodiscard]] std::size_t pending_count() const noexcept;
+
+    private:
+        struct source {
+            column_batch<Price> batch;
+            std::size_t         pos{ 0 };
+            std::uint64_t       frontier{ 0 };
+            bool                seen{ false };
+            bool                caught_up{ false };
+        };
+
+        std::vector<source>        _sources;
+        std::uint64_t              _lateness;
+        std::uint64_t              _released{ 0 };   ///< receive_ts последней выданной
+        bool                       _any_released{ false };
+        std::size_t                _late{ 0 };
+        std::vector<std::size_t>   _active;          ///< источники с записями
+        std::vector<std::uint64_t> _keys;
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline dir_watch::~dir_watch() noexcept {
+#if defined(CSV_MEDIAN_INOTIFY)
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+#endif
+    }
+
+    inline std::error_code dir_watch::open(const fs::path& dir_) noexcept {
+#if defined(CSV_MEDIAN_INOTIFY)
+        const int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            return { errno, std::system_category() };
+        }
+        if (::inotify_add_watch(fd, dir_.c_str(),
+            IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO) < 0)
+        {
+            const std::error_code err{ errno, std::system_category() };
+            ::close(fd);
+            return err;
+        }
+        _fd = fd;
+        return {};
+#else
+        static_cast<void>(dir_);
+        return std::make_error_code(std::errc::not_supported);
+#endif
+    }
+
+    inline bool dir_watch::wait(std::uint32_t timeout_ms_, bool& created_) noexcept {
+#if defined(CSV_MEDIAN_INOTIFY)
+        if (_fd >= 0) {
+            pollfd pfd{ _fd, POLLIN, 0 };
+            if (::poll(&pfd, 1, static_cast<int>(timeout_ms_)) <= 0) {
+                // Таймаут или сигнал: вызывающий проверит остановку
+                return false;
+            }
+
+            alignas(inotify_event) char events[4096];
+            while (true) {
+                const auto n = ::read(_fd, events, sizeof(events));
+                if (n <= 0) {
+                    break;
+                }
+                for (std::size_t pos = 0; pos < static_cast<std::size_t>(n);) {
+                    inotify_event event{};
+                    std::memcpy(&event, events + pos, sizeof(event));
+                    if ((event.mask & (IN_CREATE | IN_MOVED_TO | IN_Q_OVERFLOW)) != 0) {
+                        created_ = true;
+                    }
+                    pos += sizeof(inotify_event) + event.len;
+                }
+            }
+            return true;
+        }
+#endif
+        std::this_thread::sleep_for(std::chrono::milliseconds{ timeout_ms_ });
+        created_ = true;
+        return true;
+    }
+
+    inline bool dir_watch::is_open() const noexcept {
+        return _fd >= 0;
+    }
+
+    template<class Price>
+    inline file_tail<Price>::file_tail(const fs::path& path_, const record_groups& groups_,
+        bool quantity_) noexcept
+        : _path{ path_ }
+        , _metrics{ &file_metrics_for(path_) }
+        , _groups{ groups_ }
+        , _quantity{ quantity_ }
+    {
+        if (const auto err = _file.open(path_)) {
+            spdlog::error("Can't follow {}: {}", path_.string(), err.message());
+        }
+    }
+
+    template<class Price>
+    inline bool file_tail<Price>::read_header(std::string_view header_) noexcept {
+        if (!header_.empty() && header_.back() == '\r') {
+            header_.remove_suffix(1);
+        }
+
+        const int ts_col = find_column(header_, "receive_ts");
+        const int price_col = find_column(header_, "price");
+        if (ts_col < 0 || price_col < 0) {
+            spdlog::error("File {} missing required columns receive_ts/price", _path.string());
+            return false;
+        }
+
+        int group_col = -1;
+        if (_groups.mode == group_mode::column) {
+            group_col = find_column(header_, _groups.column);
+            if (group_col < 0) {
+                spdlog::error("File {} missing group column {}", _path.string(), _groups.column);
+                return false;
+            }
+        }
+
+        int quantity_col = -1;
+        if (_quantity) {
+            quantity_col = find_column(header_, "quantity");
+            if (quantity_col < 0) {
+                spdlog::error("File {} missing column quantity", _path.string());
+                return false;
+            }
+        }
+
+        // Порядок полей — k_ts_field, k_price_field, k_group_field, k_quantity_field
+        const int columns[] = { ts_col, price_col, group_col, quantity_col };
+        _scanner = line_scanner{ columns };
+        _header = true;
+        return true;
+    }
+
+    template<class Price>
+    inline void file_tail<Price>::report(column_batch<Price>& batch_, std::size_t bytes_) noexcept {
+        add_metric(counter::bytes_read, bytes_);
+        add_metric(counter::records_parsed, batch_.size());
+        add_metric(counter::records_skipped, batch_.issues.size());
+        _metrics->add(bytes_, batch_.size(), batch_.issues.size());
+
+        const std::size_t shown = _metrics->log_slots(batch_.issues.size());
+        if (shown != 0) {
+            const std::string name = _path.filename().string();
+            for (const auto& issue : std::span{ batch_.issues }.first(shown)) {
+                const auto* const what =
+                    issue.what == parse_issue::field::receive_ts ? "receive_ts"
+                    : issue.what == parse_issue::field::price ? "price" : "quantity";
+                spdlog::warn("{}:{} - invalid {}, skipping", name, _line_num + issue.line + 1, what);
+            }
+        }
+        if (shown < batch_.issues.size()) {
+            _metrics->mute();
+        }
+        _line_num += batch_.lines;
+        batch_.issues.clear();
+        batch_.lines = 0;
+    }
+
+    template<class Price>
+    inline bool file_tail<Price>::read(column_batch<Price>& batch_, std::size_t max_bytes_) noexcept {
+        batch_.clear();
+        if (!_file.is_open()) {
+            return false;
+        }
+
+        const std::size_t n = std::min(_file.size() - _offset, max_bytes_);
+        if (n == 0) {
+            return true;
+        }
+
+        try {
+            const std::size_t tail = _buffer.size();
+            _buffer.resize(tail + n);
+            std::error_code err;
+            const auto got = _file.read_at(_offset, _buffer.data() + tail, n, err);
+            _buffer.resize(tail + got);
+            _offset += got;
+            if (err) {
+                spdlog::error("Read error: {}: {}", _path.string(), err.message());
+                _file.close();
+                return false;
+            }
+
+            const std::string_view data{ _buffer.data(), _buffer.size() };
+            std::size_t used = 0;
+            if (!_header) {
+                const auto pos = data.find('\n');
+                if (pos == std::string_view::npos) {
+                    // Заголовок ещё дописывается
+                    return true;
+                }
+                if (!read_header(data.substr(0, pos))) {
+                    _file.close();
+                    return false;
+                }
+                used = pos + 1;
+            }
+
+            // Только полные строки: хвост без '\n' ждёт следующего чтения
+            const std::size_t parsed = parse_lines(_scanner, data.substr(used), false, _fields, batch_);
+            report(batch_, used + parsed);
+            used += parsed;
+            if (_groups.mode == group_mode::mask) {
+                batch_.group.assign(batch_.size(), _groups.key);
+            }
+            _buffer.erase(_buffer.begin(), _buffer.begin() + static_cast<std::ptrdiff_t>(used));
+            return true;
+        }
+        catch (const std::bad_alloc&) {
+            spdlog::error("Out of memory reading {}", _path.string());
+            batch_.clear();
+            _file.close();
+            return false;
+        }
+    }
+
+    template<class Price>
+    inline void file_tail<Price>::refresh() noexcept {
+        if (!_file.is_open()) {
+            return;
+        }
+        if (const auto err = _file.refresh()) {
+            spdlog::error("Can't follow {}: {}", _path.string(), err.message());
+            _file.close();
+            return;
+        }
+        if (_file.size() < _offset) {
+            spdlog::warn("{} was truncated, no longer followed", _path.string());
+            _file.close();
+        }
+    }
+
+    template<class Price>
+    inline bool file_tail<Price>::caught_up() const noexcept {
+        return !_file.is_open() || _offset >= _file.size();
+    }
+
+    template<class Price>
+    inline bool file_tail<Price>::is_open() const noexcept {
+        return _file.is_open();
+    }
+
+    template<class Price>
+    inline std::string file_tail<Price>::filename() const noexcept {
+        return _path.filename().string();
+    }
+
+    template<class Price>
+    inline watermark_merge<Price>::watermark_merge(std::uint64_t lateness_us_) noexcept
+        : _lateness{ lateness_us_ }
+    {
+    }
+
+    template<class Price>
+    inline std::size_t watermark_merge<Price>::add_source() {
+        _sources.emplace_back();
+        return _sources.size() - 1;
+    }
+
+    template<class Price>
+    inline void watermark_merge<Price>::push(std::size_t source_, const column_batch<Price>& batch_) {
+        auto& src = _sources[source_];
+        auto& out = src.batch;
+        const bool grouped = !batch_.group.empty();
+        const bool weighted = !batch_.quantity.empty();
+
+        for (std::size_t i = 0; i < batch_.size(); ++i) {
+            const std::uint64_t ts = batch_.ts[i];
+            if (_any_released && ts < _released) [[unlikely]] {
+                ++_late;
+                continue;
+            }
+            out.ts.push_back(ts);
+            out.price.push_back(batch_.price[i]);
+            if (grouped) {
+                out.group.push_back(batch_.group[i]);
+            }
+            if (weighted) {
+                out.quantity.push_back(batch_.quantity[i]);
+            }
+            src.frontier = std::max(src.frontier, ts);
+            src.seen = true;
+        }
+    }
+
+    template<class Price>
+    inline void watermark_merge<Price>::set_caught_up(std::size_t source_, bool caught_up_) noexcept {
+        _sources[source_].caught_up = caught_up_;
+    }
+
+    template<class Price>
+    inline std::uint64_t watermark_merge<Price>::frontier(std::size_t source_) const noexcept {
+        return _sources[source_].frontier;
+    }
+
+    template<class Price>
+    template<class OnBatch>
+    inline std::size_t watermark_merge<Price>::release(OnBatch&& on_batch_, bool all_) {
+        constexpr auto k_max = std::numeric_limits<std::uint64_t>::max();
+
+        // Недочитанный источник ещё может дать записи от своего frontier,
+        // поэтому до него — строго меньше (равные ts идут по индексу)
+        std::uint64_t below = k_max;
+        std::uint64_t newest = 0;
+        for (const auto& src : _sources) {
+            if (!src.caught_up) {
+                below = std::min(below, src.seen ? src.frontier : 0);
+            }
+            newest = std::max(newest, src.frontier);
+        }
+        const std::uint64_t bound = newest >= _lateness ? newest - _lateness : 0;
+        const auto releasable = [&](std::uint64_t ts_) {
+            return all_ || (ts_ < below && ts_ <= bound);
+        };
+
+        _active.clear();
+        _keys.clear();
+        for (std::size_t i = 0; i < _sources.size(); ++i) {
+            const auto& src = _sources[i];
+            if (src.pos < src.batch.size() && releasable(src.batch.ts[src.pos])) {
+                _active.push_back(i);
+                _keys.push_back(src.batch.ts[src.pos]);
+            }
+        }
+        if (_active.empty()) {
+            return 0;
+        }
+
+        std::size_t total = 0;
+        loser_tree tree{ _keys };
+        while (!tree.empty()) {
+            const std::size_t idx = tree.winner();
+            auto& src = _sources[_active[idx]];
+            const std::span<const std::uint64_t> ts{ src.batch.ts };
+            if (!releasable(ts[src.pos])) {
+                break;
+            }
+
+            // Подряд, пока ключ (ts, idx) меньше ключа второго источника
+            std::size_t run = 1;
+            const auto next = tree.runner_up();
+            const std::uint64_t next_ts = next != loser_tree::npos ? tree.key(next) : k_max;
+            const bool wins_ties = next == loser_tree::npos || idx < next;
+            while (src.pos + run < ts.size()) {
+                const std::uint64_t t = ts[src.pos + run];
+                if (!releasable(t) || t > next_ts || (t == next_ts && !wins_ties)) {
+                    break;
+                }
+                ++run;
+            }
+
+            on_batch_(src.batch, src.pos, run);
+            _released = ts[src.pos + run - 1];
+            _any_released = true;
+            total += run;
+            add_metric(counter::merge_batches);
+            add_metric(counter::records_merged, run);
+            src.pos += run;
+
+            if (src.pos < ts.size() && releasable(ts[src.pos])) {
+                tree.replace(ts[src.pos]);
+            }
+            else {
+                tree.pop();
+            }
+        }
+
+        // Выданное начало пакетов больше не нужно
+        for (const std::size_t i : _active) {
+            auto& src = _sources[i];
+            const auto n = static_cast<std::ptrdiff_t>(src.pos);
+            src.batch.ts.erase(src.batch.ts.begin(), src.batch.ts.begin() + n);
+            src.batch.price.erase(src.batch.price.begin(), src.batch.price.begin() + n);
+            if (!src.batch.group.empty()) {
+                src.batch.group.erase(src.batch.group.begin(), src.batch.group.begin() + n);
+            }
+            if (!src.batch.quantity.empty()) {
+                src.batch.quantity.erase(src.batch.quantity.begin(), src.batch.quantity.begin() + n);
+            }
+            src.pos = 0;
+        }
+        return total;
+    }
+
+    template<class Price>
+    inline std::size_t watermark_merge<Price>::late_count() const noexcept {
+        return _late;
+    }
+
+    template<class Price>
+    inline std::size_t watermark_merge<Price>::pending_count() const noexcept {
+        std::size_t n = 0;
+        for (const auto& src : _sources) {
+            n += src.batch.size() - src.pos;
+        }
+        return n;
+    }
+
+}
@@ -0,0 +1,203 @@
+/**
+ * \file group.hpp
+ * \brief Ключи групп записей и таблица состояний групп
+ *
+ * Группа — поток записей со своим калькулятором и своим файлом
+ * результата: маска имени файла ('level', 'trade') или значение
+ * колонки ('bid', 'ask'). Значение группы сводится к 64-битному ключу
+ * при разборе строки: до 8 байт укладываются в ключ как есть (и имя
+ * группы восстанавливается из ключа), длиннее — FNV-1a с взведённым
+ * старшим битом, который у упакованного ASCII всегда ноль.
+ *
+ * Групп обычно единицы, поэтому таблица — открытая адресация по
+ * массиву ключей без узлов: поиск в горячем цикле — пара сравнений
+ * в одной кэш-линии.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "options.hpp"
+
+namespace csv_median {
+
+    // Старший бит ключа: значение длиннее 8 байт, ключ — хэш
+    inline constexpr std::uint64_t k_group_hashed_bit = std::uint64_t{ 1 } << 63;
+
+    /**
+     * \brief Откуда курсор берёт ключ группы записей
+     */
+    struct record_groups {
+        group_mode       mode{ group_mode::none };
+        std::uint64_t    key{ 0 };  ///< group_mode::mask: ключ всех записей файла
+        std::string_view column;    ///< group_mode::column: имя колонки
+    };
+
+    /**
+     * \brief Ключ группы по её значению
+     */
+    [[nodiscard]] inline std::uint64_t group_key(std::string_view value_) noexcept {
+        if (value_.size() <= sizeof(std::uint64_t)) {
+            unsigned char bytes[sizeof(std::uint64_t)]{};
+            std::memcpy(bytes, value_.data(), value_.size());
+            std::uint64_t key = 0;
+            for (std::size_t i = 0; i < sizeof(bytes); ++i) {
+                key |= std::uint64_t{ bytes[i] } << (8 * i);
+            }
+            if ((key & k_group_hashed_bit) == 0) {
+                return key;
+            }
+        }
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+        for (const char c : value_) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3ull;
+        }
+        return hash | k_group_hashed_bit;
+    }
+
+    /**
+     * \brief Имя группы для имени файла результата
+     *
+     * Упакованное значение из [A-Za-z0-9_-] — как есть, иначе ключ
+     * в hex: имя файла не должно зависеть от содержимого колонки.
+     */
+    [[nodiscard]] inline std::string group_name(std::uint64_t key_) {
+        std::string name;
+        if ((key_ & k_group_hashed_bit) == 0) {
+            for (std::uint64_t rest = key_; rest != 0; rest >>= 8) {
+                const auto c = static_cast<char>(rest & 0xff);
+                const bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+                    || (c >= '0' && c <= '9') || c == '_' || c == '-';
+                if (!plain) {
+                    name.clear();
+                    break;
+                }
+                name.push_back(c);
+            }
+        }
+        return name.empty() ? std::format("{:016x}", key_) : name;
+    }
+
+    /**
+     * \brief Состояния групп по ключу
+     *
+     * Значения не перемещаются: таблица хранит указатели, а порядок
+     * values() — порядок появления групп.
+     */
+    template<class Value>
+    class group_table {
+    public:
+        /**
+         * \brief Значение группы или nullptr
+         */
+        [[nodiscard]] Value* find(std::uint64_t key_) const noexcept;
+
+        /**
+         * \brief Добавить группу, которой ещё нет
+         */
+        Value& insert(std::uint64_t key_, std::unique_ptr<Value> value_);
+
+        [[nodiscard]] std::size_t size() const noexcept;
+
+        [[nodiscard]] const std::vector<std::unique_ptr<Value>>& values() const noexcept;
+
+    private:
+        struct slot {
+            std::uint64_t key{ 0 };
+            Value*        value{ nullptr };
+        };
+
+        void grow();
+
+        std::vector<slot>                   _slots;
+        std::vector<std::unique_ptr<Value>> _values;
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    namespace detail {
+
+        [[nodiscard]] constexpr std::size_t group_slot(std::uint64_t key_,
+            std::size_t mask_) noexcept
+        {
+            // Упакованные ключи отличаются младшими байтами: перемешиваем
+            return static_cast<std::size_t>((key_ * 0x9e3779b97f4a7c15ull) >> 32) & mask_;
+        }
+
+    }
+
+    template<class Value>
+    inline Value* group_table<Value>::find(std::uint64_t key_) const noexcept {
+        if (_slots.empty()) {
+            return nullptr;
+        }
+        const std::size_t mask = _slots.size() - 1;
+        for (std::size_t i = detail::group_slot(key_, mask);; i = (i + 1) & mask) {
+            const auto& s = _slots[i];
+            if (s.value == nullptr) {
+                return nullptr;
+            }
+            if (s.key == key_) {
+                return s.value;
+            }
+        }
+    }
+
+    template<class Value>
+    inline Value& group_table<Value>::insert(std::uint64_t key_, std::unique_ptr<Value> value_) {
+        // Заполнение не больше половины: цепочки короткие
+        if ((_values.size() + 1) * 2 > _slots.size()) {
+            grow();
+        }
+        _values.push_back(std::move(value_));
+        Value* const value = _values.back().get();
+
+        const std::size_t mask = _slots.size() - 1;
+        std::size_t i = detail::group_slot(key_, mask);
+        while (_slots[i].value != nullptr) {
+            i = (i + 1) & mask;
+        }
+        _slots[i] = { key_, value };
+        return *value;
+    }
+
+    template<class Value>
+    inline void group_table<Value>::grow() {
+        std::vector<slot> old = std::move(_slots);
+        _slots.assign(std::max<std::size_t>(8, old.size() * 2), slot{});
+        const std::size_t mask = _slots.size() - 1;
+        for (const auto& s : old) {
+            if (s.value == nullptr) {
+                continue;
+            }
+            std::size_t i = detail::group_slot(s.key, mask);
+            while (_slots[i].value != nullptr) {
+                i = (i + 1) & mask;
+            }
+            _slots[i] = s;
+        }
+    }
+
+    template<class Value>
+    inline std::size_t group_table<Value>::size() const noexcept {
+        return _values.size();
+    }
+
+    template<class Value>
+    inline const std::vector<std::unique_ptr<Value>>& group_table<Value>::values() const noexcept {
+        return _values;
+    }
+
+}
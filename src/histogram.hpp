@@ -0,0 +1,672 @@
+/**
+ * \file histogram.hpp
+ * \brief Медиана по гистограмме цен на сетке шага цены (tick)
+ *
+ * Биржевые цены лежат на сетке с фиксированным шагом, поэтому различных
+ * значений мало по сравнению с числом записей. Движок хранит счётчик на
+ * каждый шаг сетки в плотных страницах по 2048 шагов, выделяемых при
+ * первом обращении. Каталог разрежен (отсортированные номера страниц),
+ * поэтому память зависит от числа страниц, а не от размаха цен.
+ * Число страниц ограничено (k_histogram_max_pages): цены, для которых
+ * шаг сетки слишком мелок, дают ошибку вместо исчерпания памяти.
+ *
+ * Указатель медианы (шаг и число значений ниже него) сдвигается
+ * инкрементально: вставка и удаление меняют ранг медианы не больше
+ * чем на единицу, поэтому add() — O(1) в среднем без обращений к куче.
+ * Опустевшая страница уходит из каталога, поэтому в скользящем окне
+ * память ограничена ценами окна, а не всеми встреченными ценами.
+ *
+ * Две гистограммы одной сетки складываются точно (merge): счётчики
+ * суммируются, указатель медианы сдвигается от текущего положения.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "price.hpp"
+#include "state.hpp"
+
+namespace csv_median {
+
+    /**
+     * \brief Предел страниц счётчиков одной гистограммы по умолчанию:
+     *        страница — 16 КиБ, всего 1 ГиБ
+     */
+    inline constexpr std::size_t k_histogram_max_pages = std::size_t{ 1 } << 16;
+
+    /**
+     * \brief Движок медианы на счётчиках шагов цены
+     *
+     * Цены вне сетки округляются до ближайшего шага и учитываются
+     * в off_grid(). При шаге 1 (10^-8) округления нет.
+     *
+     * \tparam T тип цены: double или fixed_price
+     */
+    template<class T>
+    class tick_histogram {
+    public:
+        using value_type = T;
+
+        /**
+         * \param tick_units_ шаг сетки в единицах 10^-8 (>= 1)
+         * \param max_pages_  предел страниц счётчиков
+         */
+        explicit tick_histogram(fixed_price tick_units_ = 1,
+            std::size_t max_pages_ = k_histogram_max_pages) noexcept;
+
+        /**
+         * \brief Добавить значение
+         * \return value_too_large — нужна страница сверх max_pages_:
+         *         значение не добавлено
+         * \throws std::bad_alloc
+         */
+        [[nodiscard]] std::error_code insert(T value_);
+
+        /**
+         * \brief Удалить одно вхождение значения (с тем же округлением)
+         * \return false если значения нет
+         */
+        bool erase(T value_) noexcept;
+
+        /**
+         * \brief Элемент с рангом rank_ (с 0) в порядке возрастания
+         * \warning rank_ >= size() — UB
+         */
+        [[nodiscard]] T select(std::size_t rank_) const noexcept;
+
+        /**
+         * \brief Центральные элементы: ранги (n-1)/2 и n/2
+         */
+        [[nodiscard]] std::pair<T, T> middle() const noexcept;
+
+        [[nodiscard]] std::size_t size() const noexcept;
+
+        /**
+         * \brief Число цен, округлённых до сетки
+         */
+        [[nodiscard]] std::size_t off_grid() const noexcept;
+
+        /**
+         * \brief Число непустых страниц счётчиков в каталоге
+         */
+        [[nodiscard]] std::size_t page_count() const noexcept;
+
+        /**
+         * \brief Добавить все значения other_ с тем же шагом сетки
+         * \return value_too_large — слияние превысило бы max_pages_ страниц
+         *         или 2^64 значений: гистограмма не изменена
+         * \throws std::bad_alloc
+         */
+        [[nodiscard]] std::error_code merge(const tick_histogram& other_);
+
+        /**
+         * \brief Непустые шаги со счётчиками и указатель медианы
+         */
+        void save(state_writer& out_) const;
+
+        /**
+         * \brief Восстановить счётчики из save() при том же шаге сетки
+         * \return false если снимок повреждён, шаг другой или страниц
+         *         больше max_pages_
+         */
+        [[nodiscard]] bool load(state_reader& in_);
+
+    private:
+        static constexpr unsigned     k_page_bits = 11;
+        static constexpr std::int64_t k_page_size = std::int64_t{ 1 } << k_page_bits;
+
+        static constexpr std::size_t  k_page_slots = static_cast<std::size_t>(k_page_size);
+
+        struct page {
+            std::array<std::uint64_t, k_page_slots>      counts{};
+            std::array<std::uint64_t, k_page_slots / 64> used{};    ///< бит на непустой шаг
+            std::uint64_t                                total{ 0 };
+        };
+
+        /**
+         * \brief Элемент каталога: номер страницы и её счётчики
+         */
+        struct page_entry {
+            std::int64_t          index;
+            std::unique_ptr<page> counts;
+        };
+
+        [[nodiscard]] std::int64_t to_tick(T value_, bool& exact_) const noexcept;
+        [[nodiscard]] T from_tick(std::int64_t tick_) const noexcept;
+
+        [[nodiscard]] static std::int64_t page_of(std::int64_t tick_) noexcept;
+        [[nodiscard]] static std::size_t slot_of(std::int64_t tick_) noexcept;
+
+        /**
+         * \brief Позиция первой страницы каталога с номером >= page_
+         *
+         * Сначала проверяется _hint: вставки подряд обычно на одной странице.
+         */
+        [[nodiscard]] std::size_t lower_page(std::int64_t page_) const noexcept;
+
+        /**
+         * \brief Страница с номером page_, nullptr если ещё не выделена
+         */
+        [[nodiscard]] const page* find_page(std::int64_t page_) const noexcept;
+
+        /**
+         * \brief Страница с номером page_; новая вставляется в каталог
+         * \return nullptr — новая страница превысила бы _max_pages
+         */
+        [[nodiscard]] page* touch_page(std::int64_t page_);
+
+        [[nodiscard]] std::uint64_t count_at(std::int64_t tick_) const noexcept;
+
+        /**
+         * \brief Первый непустой шаг страницы не меньше from_
+         * \return k_page_slots, если такого нет
+         */
+        [[nodiscard]] static std::size_t next_used(const page& p_, std::size_t from_) noexcept;
+
+        /**
+         * \brief Последний непустой шаг страницы не больше from_
+         * \return -1, если такого нет
+         */
+        [[nodiscard]] static std::int64_t prev_used(const page& p_, std::int64_t from_) noexcept;
+
+        /**
+         * \brief Убрать опустевшую страницу at_ из каталога
+         *
+         * Память страницы остаётся запасной для следующей touch_page():
+         * со скользящим окном цены уходят с одних страниц и приходят
+         * на другие, каталог — только страницы значений окна.
+         */
+        void release_page(std::size_t at_) noexcept;
+
+        /**
+         * \brief Счётчик шага указателя медианы
+         */
+        [[nodiscard]] std::uint64_t cursor_count() const noexcept;
+
+        // Ближайший непустой шаг выше / ниже tick_ со страницы каталога
+        // at_ (должен существовать): позиция его страницы и шаг
+        [[nodiscard]] std::pair<std::size_t, std::int64_t>
+            next_nonempty(std::size_t at_, std::int64_t tick_) const noexcept;
+        [[nodiscard]] std::pair<std::size_t, std::int64_t>
+            prev_nonempty(std::size_t at_, std::int64_t tick_) const noexcept;
+
+        /**
+         * \brief Сдвинуть указатель к шагу, содержащему ранг (n-1)/2
+         */
+        void settle() noexcept;
+
+        std::vector<page_entry> _pages;             ///< непустые, по возрастанию index
+        std::unique_ptr<page>   _spare;             ///< обнулённая страница для touch_page()
+        std::size_t             _hint{ 0 };         ///< позиция последней touch_page()
+        fixed_price             _tick;
+        std::size_t             _max_pages;
+
+        std::int64_t            _cursor{ 0 };       ///< шаг нижней медианы
+        std::size_t             _cursor_at{ 0 };    ///< позиция страницы _cursor в каталоге
+        std::uint64_t           _below{ 0 };        ///< значений ниже _cursor
+        std::size_t             _size{ 0 };
+        std::size_t             _off_grid{ 0 };
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    template<class T>
+    inline tick_histogram<T>::tick_histogram(fixed_price tick_units_,
+        std::size_t max_pages_) noexcept
+        : _tick{ tick_units_ }
+        , _max_pages{ max_pages_ }
+    {
+    }
+
+    template<class T>
+    inline std::int64_t tick_histogram<T>::page_of(std::int64_t tick_) noexcept {
+        return tick_ >> k_page_bits;
+    }
+
+    template<class T>
+    inline std::size_t tick_histogram<T>::slot_of(std::int64_t tick_) noexcept {
+        return static_cast<std::size_t>(tick_ & (k_page_size - 1));
+    }
+
+    template<class T>
+    inline std::int64_t tick_histogram<T>::to_tick(T value_, bool& exact_) const noexcept {
+        fixed_price units;
+        if constexpr (std::is_floating_point_v<T>) {
+            units = static_cast<fixed_price>(std::llround(value_
+                * static_cast<double>(price_scale<>)));
+        }
+        else {
+            units = value_;
+        }
+
+        // Деление с округлением вниз, затем к ближайшему шагу
+        std::int64_t tick = units / _tick;
+        std::int64_t rem = units % _tick;
+        if (rem < 0) {
+            rem += _tick;
+            --tick;
+        }
+        exact_ = (rem == 0);
+        return (2 * rem >= _tick) ? tick + 1 : tick;
+    }
+
+    template<class T>
+    inline T tick_histogram<T>::from_tick(std::int64_t tick_) const noexcept {
+        const fixed_price units = tick_ * _tick;
+        if constexpr (std::is_floating_point_v<T>) {
+            // Так же, как parse_price: точное целое / 10^8
+            return static_cast<T>(units) / static_cast<T>(price_scale<>);
+        }
+        else {
+            return units;
+        }
+    }
+
+    template<class T>
+    inline std::size_t tick_histogram<T>::lower_page(std::int64_t page_) const noexcept {
+        if (_hint < _pages.size() && _pages[_hint].index == page_) {
+            return _hint;
+        }
+        const auto it = std::ranges::lower_bound(_pages, page_, {}, &page_entry::index);
+        return static_cast<std::size_t>(it - _pages.begin());
+    }
+
+    template<class T>
+    inline auto tick_histogram<T>::find_page(std::int64_t page_) const noexcept -> const page* {
+        const std::size_t at = lower_page(page_);
+        if (at == _pages.size() || _pages[at].index != page_) {
+            return nullptr;
+        }
+        return _pages[at].counts.get();
+    }
+
+    template<class T>
+    inline auto tick_histogram<T>::touch_page(std::int64_t page_) -> page* {
+        const std::size_t at = lower_page(page_);
+        if (at != _pages.size() && _pages[at].index == page_) {
+            _hint = at;
+            return _pages[at].counts.get();
+        }
+        if (_pages.size() >= _max_pages) {
+            return nullptr;
+        }
+
+        auto counts = _spare ? std::move(_spare) : std::make_unique<page>();
+        page* p = counts.get();
+        _pages.insert(_pages.begin() + static_cast<std::ptrdiff_t>(at),
+            page_entry{ page_, std::move(counts) });
+        _hint = at;
+        return p;
+    }
+
+    template<class T>
+    inline std::uint64_t tick_histogram<T>::count_at(std::int64_t tick_) const noexcept {
+        const page* p = find_page(page_of(tick_));
+        return p ? p->counts[slot_of(tick_)] : 0;
+    }
+
+    template<class T>
+    inline void tick_histogram<T>::release_page(std::size_t at_) noexcept {
+        // Все счётчики страницы уже нулевые
+        _spare = std::move(_pages[at_].counts);
+        _pages.erase(_pages.begin() + static_cast<std::ptrdiff_t>(at_));
+        if (_cursor_at > at_) {
+            --_cursor_at;
+        }
+    }
+
+    template<class T>
+    inline std::uint64_t tick_histogram<T>::cursor_count() const noexcept {
+        return _pages[_cursor_at].counts->counts[slot_of(_cursor)];
+    }
+
+    template<class T>
+    inline std::size_t tick_histogram<T>::next_used(const page& p_, std::size_t from_) noexcept {
+        std::size_t word = from_ / 64;
+        if (word == p_.used.size()) {
+            return k_page_slots;
+        }
+        std::uint64_t bits = p_.used[word] & (~std::uint64_t{ 0 } << (from_ % 64));
+        while (bits == 0) {
+            if (++word == p_.used.size()) {
+                return k_page_slots;
+            }
+            bits = p_.used[word];
+        }
+        return word * 64 + static_cast<std::size_t>(std::countr_zero(bits));
+    }
+
+    template<class T>
+    inline std::int64_t tick_histogram<T>::prev_used(const page& p_, std::int64_t from_) noexcept {
+        if (from_ < 0) {
+            return -1;
+        }
+        std::size_t word = static_cast<std::size_t>(from_) / 64;
+        std::uint64_t bits = p_.used[word] & (~std::uint64_t{ 0 } >> (63 - from_ % 64));
+        while (bits == 0) {
+            if (word == 0) {
+                return -1;
+            }
+            bits = p_.used[--word];
+        }
+        return static_cast<std::int64_t>(word * 64) + 63 - std::countl_zero(bits);
+    }
+
+    template<class T>
+    inline auto tick_histogram<T>::next_nonempty(std::size_t at_, std::int64_t tick_) const noexcept
+        -> std::pair<std::size_t, std::int64_t>
+    {
+        std::size_t slot = slot_of(tick_) + 1;
+        for (std::size_t at = at_;; ++at, slot = 0) {
+            const std::size_t found = next_used(*_pages[at].counts, slot);
+            if (found != k_page_slots) {
+                return { at, (_pages[at].index << k_page_bits) + static_cast<std::int64_t>(found) };
+            }
+        }
+    }
+
+    template<class T>
+    inline auto tick_histogram<T>::prev_nonempty(std::size_t at_, std::int64_t tick_) const noexcept
+        -> std::pair<std::size_t, std::int64_t>
+    {
+        auto slot = static_cast<std::int64_t>(slot_of(tick_)) - 1;
+        for (std::size_t at = at_;; --at, slot = k_page_size - 1) {
+            const std::int64_t found = prev_used(*_pages[at].counts, slot);
+            if (found >= 0) {
+                return { at, (_pages[at].index << k_page_bits) + found };
+            }
+        }
+    }
+
+    template<class T>
+    inline void tick_histogram<T>::settle() noexcept {
+        const std::uint64_t rank = (_size - 1) / 2;
+        std::uint64_t here = cursor_count();
+        while (rank < _below) {
+            std::tie(_cursor_at, _cursor) = prev_nonempty(_cursor_at, _cursor);
+            here = cursor_count();
+            _below -= here;
+        }
+        while (rank >= _below + here) {
+            _below += here;
+            std::tie(_cursor_at, _cursor) = next_nonempty(_cursor_at, _cursor);
+            here = cursor_count();
+        }
+    }
+
+    template<class T>
+    inline std::error_code tick_histogram<T>::insert(T value_) {
+        bool exact = true;
+        const std::int64_t tick = to_tick(value_, exact);
+
+        const std::size_t pages = _pages.size();
+        page* p = touch_page(page_of(tick));
+        if (p == nullptr) [[unlikely]] {
+            return std::make_error_code(std::errc::value_too_large);
+        }
+        if (p->counts[slot_of(tick)]++ == 0) {
+            p->used[slot_of(tick) / 64] |= std::uint64_t{ 1 } << (slot_of(tick) % 64);
+        }
+        ++p->total;
+        if (!exact) {
+            ++_off_grid;
+        }
+        if (_pages.size() != pages && _hint <= _cursor_at) {
+            // Новая страница перед страницей указателя
+            ++_cursor_at;
+        }
+
+        if (_size == 0) {
+            _cursor = tick;
+            _cursor_at = _hint;
+            _below = 0;
+        }
+        else if (tick < _cursor) {
+            ++_below;
+        }
+        ++_size;
+        settle();
+        return {};
+    }
+
+    template<class T>
+    inline bool tick_histogram<T>::erase(T value_) noexcept {
+        bool exact = true;
+        const std::int64_t tick = to_tick(value_, exact);
+
+        const std::size_t at = lower_page(page_of(tick));
+        if (at == _pages.size() || _pages[at].index != page_of(tick)
+            || _pages[at].counts->counts[slot_of(tick)] == 0)
+        {
+            return false;
+        }
+        page& p = *_pages[at].counts;
+        if (--p.counts[slot_of(tick)] == 0) {
+            p.used[slot_of(tick) / 64] &= ~(std::uint64_t{ 1 } << (slot_of(tick) % 64));
+        }
+        --p.total;
+
+        if (tick < _cursor) {
+            --_below;
+        }
+        if (--_size == 0) {
+            _below = 0;
+        }
+        else {
+            // Указатель уходит с опустевшей страницы до её удаления
+            settle();
+        }
+        if (p.total == 0) {
+            release_page(at);
+        }
+        return true;
+    }
+
+    template<class T>
+    inline T tick_histogram<T>::select(std::size_t rank_) const noexcept {
+        std::uint64_t left = rank_;
+        for (const auto& entry : _pages) {
+            const page& p = *entry.counts;
+            if (p.total <= left) {
+                left -= p.total;
+                continue;
+            }
+            for (std::size_t slot = 0;; ++slot) {
+                if (p.counts[slot] > left) {
+                    return from_tick((entry.index << k_page_bits) + static_cast<std::int64_t>(slot));
+                }
+                left -= p.counts[slot];
+            }
+        }
+        return T{};
+    }
+
+    template<class T>
+    inline std::pair<T, T> tick_histogram<T>::middle() const noexcept {
+        const T lower = from_tick(_cursor);
+        if (_size % 2 != 0 || _size / 2 < _below + cursor_count()) {
+            return { lower, lower };
+        }
+        return { lower, from_tick(next_nonempty(_cursor_at, _cursor).second) };
+    }
+
+    template<class T>
+    inline std::size_t tick_histogram<T>::size() const noexcept {
+        return _size;
+    }
+
+    template<class T>
+    inline std::size_t tick_histogram<T>::off_grid() const noexcept {
+        return _off_grid;
+    }
+
+    template<class T>
+    inline std::size_t tick_histogram<T>::page_count() const noexcept {
+        return _pages.size();
+    }
+
+    template<class T>
+    inline std::error_code tick_histogram<T>::merge(const tick_histogram& other_) {
+        if (other_._size == 0) {
+            return {};
+        }
+        // Счётчик шага не больше _size: без переполнения размера нет и его
+        if (other_._size > std::numeric_limits<std::size_t>::max() - _size) {
+            return std::make_error_code(std::errc::value_too_large);
+        }
+
+        // Новые страницы выделяются до изменения счётчиков
+        const auto missing = [this](const page_entry& entry_) {
+            return entry_.counts->total != 0 && find_page(entry_.index) == nullptr;
+            };
+        const auto added = static_cast<std::size_t>(std::ranges::count_if(other_._pages, missing));
+        if (_pages.size() + added > _max_pages) {
+            return std::make_error_code(std::errc::value_too_large);
+        }
+        if (added != 0) {
+            std::vector<page_entry> fresh;
+            fresh.reserve(added);
+            for (const auto& entry : other_._pages) {
+                if (missing(entry)) {
+                    fresh.push_back(page_entry{ entry.index, std::make_unique<page>() });
+                }
+            }
+            std::vector<page_entry> pages;
+            pages.reserve(_pages.size() + fresh.size());
+            std::merge(std::make_move_iterator(_pages.begin()), std::make_move_iterator(_pages.end()),
+                std::make_move_iterator(fresh.begin()), std::make_move_iterator(fresh.end()),
+                std::back_inserter(pages), [](const page_entry& lhs_, const page_entry& rhs_) {
+                    return lhs_.index < rhs_.index;
+                });
+            _pages = std::move(pages);
+        }
+
+        std::uint64_t below = 0; // значений other_ ниже _cursor
+        for (const auto& entry : other_._pages) {
+            const page& from = *entry.counts;
+            if (from.total == 0) {
+                continue;
+            }
+            page& to = *touch_page(entry.index); // уже в каталоге
+            for (std::size_t slot = 0; slot < from.counts.size(); ++slot) {
+                to.counts[slot] += from.counts[slot];
+            }
+            for (std::size_t word = 0; word < from.used.size(); ++word) {
+                to.used[word] |= from.used[word];
+            }
+            to.total += from.total;
+
+            if (_size != 0 && entry.index < page_of(_cursor)) {
+                below += from.total;
+            }
+            else if (_size != 0 && entry.index == page_of(_cursor)) {
+                for (std::size_t slot = 0; slot < slot_of(_cursor); ++slot) {
+                    below += from.counts[slot];
+                }
+            }
+        }
+
+        if (_size == 0) {
+            _cursor = other_._cursor;
+            _below = other_._below;
+        }
+        else {
+            _below += below;
+        }
+        _cursor_at = lower_page(page_of(_cursor));
+        _size += other_._size;
+        _off_grid += other_._off_grid;
+        settle();
+        return {};
+    }
+
+    template<class T>
+    inline void tick_histogram<T>::save(state_writer& out_) const {
+        std::uint64_t ticks = 0;
+        for (const auto& entry : _pages) {
+            if (entry.counts->total != 0) {
+                ticks += static_cast<std::uint64_t>(std::ranges::count_if(entry.counts->counts,
+                    [](std::uint64_t count_) { return count_ != 0; }));
+            }
+        }
+
+        out_.put(_tick);
+        out_.put_varint(ticks);
+        std::int64_t prev = 0;
+        for (const auto& entry : _pages) {
+            const page& p = *entry.counts;
+            if (p.total == 0) {
+                continue;
+            }
+            const auto first = entry.index << k_page_bits;
+            for (std::size_t slot = 0; slot < p.counts.size(); ++slot) {
+                if (p.counts[slot] != 0) {
+                    out_.put_value(first + static_cast<std::int64_t>(slot), prev);
+                    out_.put_varint(p.counts[slot]);
+                }
+            }
+        }
+        out_.put(_cursor);
+        out_.put_varint(_below);
+        out_.put_varint(_off_grid);
+    }
+
+    template<class T>
+    inline bool tick_histogram<T>::load(state_reader& in_) {
+        fixed_price tick = 0;
+        std::uint64_t ticks = 0;
+        if (!in_.get(tick) || tick != _tick || !in_.get_varint(ticks)) {
+            return false;
+        }
+
+        _pages.clear();
+        _size = 0;
+        std::int64_t prev = 0;
+        for (std::uint64_t i = 0; i < ticks; ++i) {
+            std::int64_t at = 0;
+            std::uint64_t count = 0;
+            if (!in_.get_value(at, prev) || !in_.get_varint(count)
+                || count == 0 || count > std::numeric_limits<std::size_t>::max() - _size)
+            {
+                return false;
+            }
+            page* p = touch_page(page_of(at));
+            if (p == nullptr) {
+                return false;
+            }
+            p->counts[slot_of(at)] = count;
+            p->used[slot_of(at) / 64] |= std::uint64_t{ 1 } << (slot_of(at) % 64);
+            p->total += count;
+            _size += static_cast<std::size_t>(count);
+        }
+
+        std::uint64_t below = 0;
+        std::uint64_t off_grid = 0;
+        if (!in_.get(_cursor) || !in_.get_varint(below) || !in_.get_varint(off_grid)
+            || below > _size || (_size != 0 && count_at(_cursor) == 0))
+        {
+            return false;
+        }
+        _cursor_at = lower_page(page_of(_cursor));
+        _below = below;
+        _off_grid = static_cast<std::size_t>(off_grid);
+        return true;
+    }
+
+}
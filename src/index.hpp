@@ -0,0 +1,530 @@
+/**
+ * \file index.hpp
+ * \brief Разреженный индекс receive_ts -> смещение строки во входном файле
+ *
+ * Записи в файле упорядочены по receive_ts, поэтому для перехода к
+ * моменту T достаточно редких опорных точек: пар (смещение начала
+ * строки, её receive_ts). Индекс строится пробами: через каждые stride
+ * байт отображения файла читается одна строка — одна страница на
+ * пробу, без разбора файла целиком.
+ *
+ * Смещение для T — у последней точки с ts < T: все строки до неё
+ * имеют ts < T, и курсор, начав с неё, пропускает остаток отсеивания.
+ *
+ * Для запросов [from_ts, to_ts) индекс строится полным проходом —
+ * точка через каждые N записей или M микросекунд — и сохраняется рядом
+ * с файлом в <имя>.idx. Файл действителен, пока у источника тот же
+ * отпечаток, что у колоночного кэша (размер, mtime, хэш выборки), и
+ * те же N и M.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+#include "cache.hpp"
+#include "mapped.hpp"
+#include "options.hpp"
+#include "pool.hpp"
+#include "writer.hpp"
+
+namespace csv_median {
+
+    namespace fs = std::filesystem;
+
+    // Байт между пробами индекса по умолчанию
+    inline constexpr std::size_t k_index_probe_stride = 4 * 1024 * 1024;
+
+    // Строк подряд, которые проба пробует, если receive_ts не разбирается
+    inline constexpr std::size_t k_index_probe_lines = 16;
+
+    inline constexpr std::string_view k_index_suffix = ".idx";
+
+    /**
+     * \brief Опорные точки одного файла
+     */
+    class ts_index {
+    public:
+        struct entry {
+            std::uint64_t offset; ///< начало строки
+            std::uint64_t ts;     ///< её receive_ts
+        };
+
+        /**
+         * \brief Построить индекс пробами через stride_ байт
+         * \return код ошибки; not_supported — файл не отображается
+         *         (сжатый, pipe), bad_message — нет receive_ts или
+         *         receive_ts опорных точек убывают
+         */
+        [[nodiscard]] std::error_code probe(const fs::path& path_,
+            std::size_t stride_ = k_index_probe_stride) noexcept;
+
+        /**
+         * \brief Построить индекс полным проходом по файлу
+         * \return код ошибки, как у probe()
+         */
+        [[nodiscard]] std::error_code build(const fs::path& path_,
+            const index_options& options_ = {}) noexcept;
+
+        /**
+         * \brief Прочитать сохранённый индекс
+         * \return bad_message — файл другой версии, повреждён или
+         *         построен для другого источника или шага
+         */
+        [[nodiscard]] std::error_code load(const fs::path& path_,
+            const cache_source_info& source_, const index_options& options_) noexcept;
+
+        /**
+         * \brief Сохранить индекс: временный файл и переименование
+         */
+        [[nodiscard]] std::error_code save(const fs::path& path_,
+            const cache_source_info& source_, const index_options& options_) const noexcept;
+
+        /**
+         * \brief Смещение, с которого идут все записи с ts >= ts_
+         * \return 0, если индекс пуст (читать с начала)
+         */
+        [[nodiscard]] std::uint64_t seek_offset(std::uint64_t ts_) const noexcept;
+
+        [[nodiscard]] const std::vector<entry>& entries() const noexcept;
+
+        [[nodiscard]] bool empty() const noexcept;
+
+        /**
+         * \brief receive_ts последней строки файла
+         */
+        [[nodiscard]] std::uint64_t last_ts() const noexcept;
+
+        /**
+         * \brief Размер файла на момент построения
+         */
+        [[nodiscard]] std::uint64_t file_size() const noexcept;
+
+    private:
+        std::vector<entry> _entries;
+        std::uint64_t      _last_ts{ 0 };
+        std::uint64_t      _file_size{ 0 };
+    };
+
+    /**
+     * \brief Индексы входных файлов по пути
+     */
+    using index_table = std::map<fs::path, ts_index>;
+
+    /**
+     * \brief Путь sidecar-файла индекса: "trade.csv" -> "trade.csv.idx"
+     */
+    [[nodiscard]] fs::path index_path(const fs::path& source_) noexcept;
+
+    /**
+     * \brief Индексы файлов из <имя>.idx; устаревшие строятся заново
+     *
+     * Файлы строятся задачами пула. Если индекс не удалось сохранить
+     * (директория только для чтения), он используется из памяти.
+     * Файлы без индекса (сжатые, неупорядоченные) в table_ не попадают
+     * и читаются с начала.
+     */
+    void load_indexes(thread_pool& pool_, std::span<const fs::path> paths_,
+        const index_options& options_, index_table& table_) noexcept;
+
+    namespace detail {
+
+        /**
+         * \brief Заголовок файла индекса; за ним entries точек ts_index::entry
+         */
+        struct index_header {
+            std::array<char, 8> magic;
+            std::uint32_t       version;
+            std::uint32_t       byte_order;   ///< k_cache_byte_order в порядке байт машины
+            std::uint64_t       source_size;
+            std::int64_t        source_mtime_ns;
+            std::uint64_t       source_hash;
+            std::uint64_t       every_records;
+            std::uint64_t       every_us;
+            std::uint64_t       entries;
+            std::uint64_t       last_ts;
+        };
+
+        inline constexpr std::array<char, 8> k_index_magic{ 'C', 'S', 'V', 'M', 'I', 'D', 'X', '1' };
+        inline constexpr std::uint32_t k_index_version = 1;
+
+        /**
+         * \brief receive_ts строки, начинающейся в data_[pos_]
+         */
+        [[nodiscard]] inline bool line_ts(std::string_view data_, std::size_t pos_,
+            int column_, std::uint64_t& ts_) noexcept
+        {
+            for (int i = 0; i < column_; ++i) {
+                const auto sep = data_.find_first_of(";\n", pos_);
+                if (sep == std::string_view::npos || data_[sep] == '\n') {
+                    return false;
+                }
+                pos_ = sep + 1;
+            }
+            const char* const begin = data_.data() + pos_;
+            const char* const end = data_.data() + data_.size();
+            const auto [ptr, err] = std::from_chars(begin, end, ts_);
+            return err == std::errc{} && ptr != begin
+                && (ptr == end || *ptr == ';' || *ptr == '\n' || *ptr == '\r');
+        }
+
+        /**
+         * \brief Номер колонки receive_ts в заголовке
+         */
+        [[nodiscard]] inline int ts_column(std::string_view header_) noexcept {
+            int column = 0;
+            std::size_t pos = 0;
+            while (true) {
+                const auto sep = header_.find(';', pos);
+                auto name = header_.substr(pos, sep == std::string_view::npos ? sep : sep - pos);
+                if (!name.empty() && name.back() == '\r') {
+                    name.remove_suffix(1);
+                }
+                if (name == "receive_ts") {
+                    return column;
+                }
+                if (sep == std::string_view::npos) {
+                    return -1;
+                }
+                pos = sep + 1;
+                ++column;
+            }
+        }
+
+    }
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline std::error_code ts_index::probe(const fs::path& path_, std::size_t stride_) noexcept {
+        _entries.clear();
+        _last_ts = 0;
+        _file_size = 0;
+
+        mapped_file map;
+        if (const auto err = map.open(path_)) {
+            return err;
+        }
+        const auto data = map.view();
+        _file_size = data.size();
+
+        const auto header_end = data.find('\n');
+        if (header_end == std::string_view::npos) {
+            return {};
+        }
+        const int column = detail::ts_column(data.substr(0, header_end));
+        if (column < 0) {
+            return std::make_error_code(std::errc::bad_message);
+        }
+
+        // Первая разбираемая строка, начиная со строки в pos_
+        const auto sample = [&](std::size_t pos_, entry& out_) {
+            for (std::size_t i = 0; i < k_index_probe_lines && pos_ < data.size(); ++i) {
+                std::uint64_t ts = 0;
+                if (detail::line_ts(data, pos_, column, ts)) {
+                    out_ = { pos_, ts };
+                    return true;
+                }
+                const auto nl = data.find('\n', pos_);
+                if (nl == std::string_view::npos) {
+                    break;
+                }
+                pos_ = nl + 1;
+            }
+            return false;
+        };
+
+        try {
+            _entries.reserve(data.size() / std::max<std::size_t>(1, stride_) + 1);
+            for (std::size_t pos = header_end + 1; pos < data.size(); ) {
+                entry e{};
+                if (sample(pos, e)) {
+                    if (!_entries.empty() && e.ts < _entries.back().ts) {
+                        _entries.clear();
+                        return std::make_error_code(std::errc::bad_message);
+                    }
+                    if (_entries.empty() || e.offset > _entries.back().offset) {
+                        _entries.push_back(e);
+                    }
+                }
+
+                // Следующая проба — с первой строки после pos + stride
+                const std::size_t next = pos + std::max<std::size_t>(1, stride_);
+                if (next >= data.size()) {
+                    break;
+                }
+                const auto nl = data.find('\n', next - 1);
+                if (nl == std::string_view::npos) {
+                    break;
+                }
+                pos = nl + 1;
+            }
+        }
+        catch (const std::exception&) {
+            _entries.clear();
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+
+        // Последняя строка: с конца, пропуская завершающие переводы строк
+        std::size_t end = data.size();
+        while (end > header_end + 1 && (data[end - 1] == '\n' || data[end - 1] == '\r')) {
+            --end;
+        }
+        for (std::size_t i = 0; i < k_index_probe_lines && end > header_end + 1; ++i) {
+            const auto nl = data.rfind('\n', end - 1);
+            const std::size_t start = (nl == std::string_view::npos) ? 0 : nl + 1;
+            std::uint64_t ts = 0;
+            if (detail::line_ts(data, start, column, ts)) {
+                _last_ts = ts;
+                break;
+            }
+            end = start > 0 ? start - 1 : 0;
+        }
+        if (!_entries.empty()) {
+            _last_ts = std::max(_last_ts, _entries.back().ts);
+        }
+        return {};
+    }
+
+    inline std::error_code ts_index::build(const fs::path& path_,
+        const index_options& options_) noexcept
+    {
+        _entries.clear();
+        _last_ts = 0;
+        _file_size = 0;
+
+        mapped_file map;
+        if (const auto err = map.open(path_)) {
+            return err;
+        }
+        const auto data = map.view();
+        _file_size = data.size();
+
+        const auto header_end = data.find('\n');
+        if (header_end == std::string_view::npos) {
+            return {};
+        }
+        const int column = detail::ts_column(data.substr(0, header_end));
+        if (column < 0) {
+            return std::make_error_code(std::errc::bad_message);
+        }
+
+        const std::size_t every = std::max<std::size_t>(1, options_.every_records);
+        try {
+            std::size_t since = every;
+            std::uint64_t prev = 0;
+            for (std::size_t pos = header_end + 1; pos < data.size(); ) {
+                const auto nl = data.find('\n', pos);
+                std::uint64_t ts = 0;
+                if (detail::line_ts(data, pos, column, ts)) {
+                    if (ts < prev) {
+                        _entries.clear();
+                        return std::make_error_code(std::errc::bad_message);
+                    }
+                    const bool by_time = options_.every_us != 0 && !_entries.empty()
+                        && ts - _entries.back().ts >= options_.every_us;
+                    if (since >= every || by_time) {
+                        _entries.push_back({ pos, ts });
+                        since = 0;
+                    }
+                    ++since;
+                    prev = ts;
+                }
+                if (nl == std::string_view::npos) {
+                    break;
+                }
+                pos = nl + 1;
+            }
+            _last_ts = prev;
+        }
+        catch (const std::exception&) {
+            _entries.clear();
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+        return {};
+    }
+
+    inline std::error_code ts_index::load(const fs::path& path_,
+        const cache_source_info& source_, const index_options& options_) noexcept
+    {
+        _entries.clear();
+        mapped_file map;
+        if (const auto err = map.open(path_)) {
+            return err;
+        }
+
+        const auto data = map.view();
+        const auto stale = std::make_error_code(std::errc::bad_message);
+        detail::index_header header{};
+        if (data.size() < sizeof(header)) {
+            return stale;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        const cache_source_info recorded{
+            header.source_size, header.source_mtime_ns, header.source_hash };
+        if (header.magic != detail::k_index_magic
+            || header.version != detail::k_index_version
+            || header.byte_order != detail::k_cache_byte_order
+            || recorded != source_
+            || header.every_records != options_.every_records
+            || header.every_us != options_.every_us
+            || data.size() != sizeof(header) + header.entries * sizeof(entry))
+        {
+            return stale;
+        }
+
+        try {
+            _entries.resize(static_cast<std::size_t>(header.entries));
+        }
+        catch (const std::exception&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+        std::memcpy(_entries.data(), data.data() + sizeof(header), _entries.size() * sizeof(entry));
+        _last_ts = header.last_ts;
+        _file_size = header.source_size;
+        return {};
+    }
+
+    inline std::error_code ts_index::save(const fs::path& path_,
+        const cache_source_info& source_, const index_options& options_) const noexcept
+    {
+        detail::index_header header{};
+        header.magic = detail::k_index_magic;
+        header.version = detail::k_index_version;
+        header.byte_order = detail::k_cache_byte_order;
+        header.source_size = source_.size;
+        header.source_mtime_ns = source_.mtime_ns;
+        header.source_hash = source_.hash;
+        header.every_records = options_.every_records;
+        header.every_us = options_.every_us;
+        header.entries = _entries.size();
+        header.last_ts = _last_ts;
+
+        fs::path tmp_path;
+        try {
+            tmp_path = path_;
+            tmp_path += ".tmp";
+        }
+        catch (const std::exception&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+
+        const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return { errno, std::system_category() };
+        }
+        auto err = write_all(fd, reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!err) {
+            err = write_all(fd, reinterpret_cast<const char*>(_entries.data()),
+                _entries.size() * sizeof(entry));
+        }
+        if (::close(fd) != 0 && !err) {
+            err = { errno, std::system_category() };
+        }
+        if (!err && std::rename(tmp_path.c_str(), path_.c_str()) != 0) {
+            err = { errno, std::system_category() };
+        }
+        if (err) {
+            ::unlink(tmp_path.c_str());
+        }
+        return err;
+    }
+
+    inline std::uint64_t ts_index::seek_offset(std::uint64_t ts_) const noexcept {
+        // Первая точка с ts >= ts_; нужна предыдущая
+        const auto it = std::ranges::lower_bound(_entries, ts_, {}, &entry::ts);
+        if (it == _entries.begin()) {
+            return 0;
+        }
+        return std::prev(it)->offset;
+    }
+
+    inline const std::vector<ts_index::entry>& ts_index::entries() const noexcept {
+        return _entries;
+    }
+
+    inline bool ts_index::empty() const noexcept {
+        return _entries.empty();
+    }
+
+    inline std::uint64_t ts_index::last_ts() const noexcept {
+        return _last_ts;
+    }
+
+    inline std::uint64_t ts_index::file_size() const noexcept {
+        return _file_size;
+    }
+
+    inline fs::path index_path(const fs::path& source_) noexcept {
+        auto path = source_;
+        path += k_index_suffix;
+        return path;
+    }
+
+    inline void load_indexes(thread_pool& pool_, std::span<const fs::path> paths_,
+        const index_options& options_, index_table& table_) noexcept
+    {
+        table_.clear();
+        try {
+            std::vector<ts_index> indexes(paths_.size());
+            std::vector<std::error_code> errors(paths_.size());
+            pool_.parallel_for(paths_.size(), [&](std::size_t i_) {
+                const auto& path = paths_[i_];
+                cache_source_info source;
+                if (const auto err = fingerprint(path, source)) {
+                    errors[i_] = err;
+                    return;
+                }
+                const auto sidecar = index_path(path);
+                if (!indexes[i_].load(sidecar, source, options_)) {
+                    return;
+                }
+
+                spdlog::info("Indexing {}", path.filename().string());
+                if (const auto err = indexes[i_].build(path, options_)) {
+                    errors[i_] = err;
+                    return;
+                }
+                if (const auto err = indexes[i_].save(sidecar, source, options_)) {
+                    spdlog::warn("Can't save index {}: {}", sidecar.string(), err.message());
+                }
+                }, 1);
+
+            for (std::size_t i = 0; i < paths_.size(); ++i) {
+                if (errors[i]) {
+                    spdlog::warn("No index for {} ({}), reading it from the start",
+                        paths_[i].filename().string(), errors[i].message());
+                    continue;
+                }
+                table_.emplace(paths_[i], std::move(indexes[i]));
+            }
+        }
+        catch (const std::exception& e) {
+            // Без индексов файлы просто читаются с начала
+            spdlog::warn("Can't load indexes: {}", e.what());
+            table_.clear();
+        }
+    }
+
+}
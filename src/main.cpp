@@ -2,27 +2,52 @@
  * \file main.cpp
  */
 
+#include <algorithm>
 #include <atomic>
+#include <concepts>
 #include <csignal>
+#include <cstdint>
 #include <cstdlib>
+#include <filesystem>
 #include <format>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
 
 #include <spdlog/spdlog.h>
+#include <spdlog/async.h>
 #include <spdlog/sinks/rotating_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
 #include "parser.hpp"
+#include "checkpoint.hpp"
+#include "shard.hpp"
 #include "reader.hpp"
 #include "median.hpp"
-#include "writer.hpp"
+#include "window.hpp"
+#include "stats.hpp"
+#include "sink.hpp"
+#include "bucket.hpp"
+#include "group.hpp"
+#include "partition.hpp"
+#include "pages.hpp"
 #include "pool.hpp"
+#include "metrics.hpp"
 
 namespace {
     inline constexpr std::size_t k_min_threads = 1;
     inline constexpr std::size_t k_log_max_size = 10 * 1024 * 1024; // 10 MB
     inline constexpr std::size_t k_log_max_files = 3;
+    inline constexpr std::size_t k_log_queue_size = 8192; // сообщений
     volatile std::sig_atomic_t g_shutdown{ 0 };
 
+    /**
+     * \brief Лог в консоль и файл; форматирует и пишет отдельный поток
+     *
+     * Заполненная очередь задерживает вызывающего, сообщения не теряются.
+     */
     void setup_logger() noexcept {
         try {
             auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
@@ -30,9 +55,12 @@ namespace {
                 "logs/app.log", k_log_max_size, k_log_max_files
             );
 
-            auto logger = std::make_shared<spdlog::logger>(
+            spdlog::init_thread_pool(k_log_queue_size, 1);
+            auto logger = std::make_shared<spdlog::async_logger>(
                 "main",
-                spdlog::sinks_init_list{ console_sink, file_sink }
+                spdlog::sinks_init_list{ console_sink, file_sink },
+                spdlog::thread_pool(),
+                spdlog::async_overflow_policy::block
             );
 
             spdlog::set_default_logger(logger);
@@ -44,15 +72,1241 @@ namespace {
         }
     }
 
+    /**
+     * \brief Дописать очередь лога при выходе из main
+     */
+    struct logger_guard {
+        logger_guard() = default;
+        logger_guard(const logger_guard&) = delete;
+        logger_guard& operator=(const logger_guard&) = delete;
+
+        ~logger_guard() {
+            spdlog::shutdown();
+        }
+    };
+
     void setup_signals() noexcept {
         // Graceful shutdown
         std::signal(SIGINT, [](int) { g_shutdown = 1; });
         std::signal(SIGTERM, [](int) { g_shutdown = 1; });
     }
 
+    /**
+     * \brief Прервать расчёт по сигналу
+     *
+     * В follow сигнал — штатная остановка: записи, ждущие водяного
+     * знака, ещё считаются и пишутся.
+     */
+    [[nodiscard]] bool interrupted(const csv_median::app_config& config_) noexcept {
+        return g_shutdown != 0 && !config_.follow;
+    }
+
+    /**
+     * \brief Сообщить об остановке по сигналу
+     *
+     * В follow сигнал — штатная остановка после сброса вывода.
+     */
+    void report_signal_stop(const csv_median::app_config& config_) noexcept {
+        if (g_shutdown == 0) {
+            return;
+        }
+        if (config_.follow) {
+            spdlog::info("stopped by system signal, follow finished");
+        }
+        else {
+            spdlog::warn("stopped by system signal");
+        }
+    }
+
+    /**
+     * \brief Сообщить, почему калькулятор не принял значение
+     */
+    void report_calc_error(std::error_code err_) noexcept {
+        if (err_ == std::errc::value_too_large) {
+            spdlog::error("Price histogram needs more than {} pages of counters, "
+                "increase tick_size", csv_median::k_histogram_max_pages);
+        }
+        else {
+            spdlog::error("Out of memory computing median");
+        }
+    }
+
+    /**
+     * \brief Сбросить буфер приёмника, если он это умеет
+     */
+    template<class Sink>
+    [[nodiscard]] std::error_code flush_sink(Sink& sink_) noexcept {
+        if constexpr (requires { { sink_.flush() } -> std::same_as<std::error_code>; }) {
+            return sink_.flush();
+        }
+        else {
+            return {};
+        }
+    }
+
+    /**
+     * \brief Прочитать входные файлы: один раз или с [main].follow до сигнала
+     *
+     * В follow после каждой порции выданных записей вызывается flush_,
+     * чтобы новые строки сразу попадали в файл результата.
+     * \param flush_ () -> std::error_code
+     */
+    template<class Price, class OnBatch, class Flush>
+    [[nodiscard]] std::error_code read_input(
+        const csv_median::app_config& config_,
+        csv_median::csv_reader&       reader_,
+        OnBatch&&                     on_batch_,
+        Flush&&                       flush_) noexcept
+    {
+        if (!config_.follow) {
+            return reader_.template process_batches<Price>(
+                config_.input_dir, config_.filename_masks, on_batch_);
+        }
+        std::error_code flush_err;
+        const auto read_err = reader_.template follow_batches<Price>(
+            config_.input_dir, config_.filename_masks, config_.follow_settings, on_batch_,
+            [&flush_, &flush_err] {
+                if (const auto err = flush_()) {
+                    spdlog::error("error writer: {}", err.message());
+                    flush_err = err;
+                    g_shutdown = 1;
+                }
+                return g_shutdown == 0;
+            });
+        return read_err ? read_err : flush_err;
+    }
+
+    /**
+     * \brief Контрольные точки расчёта [main].checkpoint_records
+     */
+    struct checkpoint_run {
+        std::uint64_t                         signature{ 0 }; ///< config_signature()
+        std::optional<csv_median::checkpoint> resume;         ///< с --resume
+        bool                                  stopped{ false }; ///< чтение прервано после снимка
+    };
+
+    /**
+     * \brief Подпись параметров, от которых зависят позиции и результат
+     *
+     * Продолжение с другими параметрами дало бы не тот результат,
+     * что расчёт с начала.
+     */
+    [[nodiscard]] std::uint64_t config_signature(const csv_median::app_config& config_) {
+        std::string text = std::format("{}|{}|{}|{}|{}|{}|{}|{}",
+            config_.input_dir.string(), static_cast<int>(config_.prices),
+            static_cast<int>(config_.backend), config_.window_us, config_.tick_units,
+            config_.sketch_error, config_.parallel_parse, config_.checkpoint_records);
+        for (const auto& mask : config_.filename_masks) {
+            text += '|';
+            text += mask;
+        }
+        return csv_median::checkpoint_hash({
+            reinterpret_cast<const unsigned char*>(text.data()), text.size() });
+    }
+
+    /**
+     * \brief Подпись параметров, от которых зависит снимок калькулятора части
+     *
+     * Сливаются только части с одинаковыми ценами, движком, сеткой
+     * гистограммы и ошибкой t-digest; файлы и диапазоны у частей свои.
+     */
+    [[nodiscard]] std::uint64_t shard_signature(const csv_median::app_config& config_) {
+        const std::string text = std::format("{}|{}|{}|{}",
+            static_cast<int>(config_.prices), static_cast<int>(config_.backend),
+            config_.tick_units, config_.sketch_error);
+        return csv_median::checkpoint_hash({
+            reinterpret_cast<const unsigned char*>(text.data()), text.size() });
+    }
+
+    /**
+     * \brief Снимать контрольные точки расчёта; с --resume — продолжить
+     *        с загруженной
+     *
+     * Снимок: sync() файла результата, состояние калькулятора и позиции
+     * файлов. По сигналу снимается последний снимок и чтение прекращается.
+     */
+    template<class Calc, csv_median::result_sink Sink>
+    [[nodiscard]] std::error_code setup_checkpoints(
+        const csv_median::app_config& config_,
+        csv_median::csv_reader&       reader_,
+        Sink&                         writer_,
+        Calc&                         calc_,
+        std::size_t&                  written_,
+        checkpoint_run&               checkpoints_,
+        std::error_code&              error_) noexcept
+    {
+        if constexpr (csv_median::checkpointable<Calc>
+            && requires { writer_.sync(); })
+        {
+            if (checkpoints_.resume) {
+                csv_median::state_reader state{ checkpoints_.resume->state };
+                if (!calc_.load(state) || !state.done()) {
+                    spdlog::error("Checkpoint state is corrupt");
+                    return std::make_error_code(std::errc::bad_message);
+                }
+                reader_.set_resume(checkpoints_.resume->files, checkpoints_.resume->records);
+                written_ = static_cast<std::size_t>(checkpoints_.resume->output_rows);
+            }
+
+            reader_.set_checkpoints(config_.checkpoint_records,
+                [&, path = csv_median::checkpoint_path(config_.output_dir)](
+                    std::span<const csv_median::file_checkpoint> files_, std::uint64_t records_)
+                {
+                    if (error_) {
+                        return false;
+                    }
+                    const auto [size, sync_err] = writer_.sync();
+                    if (sync_err) {
+                        spdlog::error("error writer: {}", sync_err.message());
+                        error_ = sync_err;
+                        g_shutdown = 1;
+                        return false;
+                    }
+
+                    std::error_code err;
+                    try {
+                        csv_median::state_writer state;
+                        calc_.save(state);
+                        const auto bytes = state.data();
+                        const csv_median::checkpoint snapshot{ checkpoints_.signature, records_,
+                            size, writer_.written_count(), { files_.begin(), files_.end() },
+                            { bytes.begin(), bytes.end() } };
+                        err = csv_median::save_checkpoint(path, snapshot);
+                    }
+                    catch (const std::bad_alloc&) {
+                        err = std::make_error_code(std::errc::not_enough_memory);
+                    }
+                    if (err) {
+                        spdlog::warn("Can't save checkpoint {}: {}", path.string(), err.message());
+                    }
+
+                    checkpoints_.stopped = interrupted(config_);
+                    return !checkpoints_.stopped;
+                });
+            return {};
+        }
+        else {
+            // Парсер допускает контрольные точки только с output_format = 'csv'
+            return std::make_error_code(std::errc::not_supported);
+        }
+    }
+
+    /**
+     * \brief Потоковый расчёт медианы заданным калькулятором
+     * \tparam Calc     basic_calculator или sliding_window
+     * \tparam Sink     приёмник результатов (result_sink)
+     * \param calc_     калькулятор
+     * \param written_  число записанных строк
+     * \return код ошибки чтения
+     */
+    template<class Calc, csv_median::result_sink Sink>
+    [[nodiscard]] std::error_code run(
+        const csv_median::app_config& config_,
+        csv_median::csv_reader&       reader_,
+        Sink&                         writer_,
+        Calc&                         calc_,
+        std::size_t&                  written_,
+        checkpoint_run&               checkpoints_) noexcept
+    {
+        using Price = typename Calc::value_type;
+
+        std::error_code error;
+        const bool checkpoints = config_.checkpoint_records != 0;
+        if (checkpoints) {
+            if (const auto err = setup_checkpoints(config_, reader_, writer_, calc_, written_,
+                checkpoints_, error))
+            {
+                return err;
+            }
+        }
+
+        const auto add = [&calc_](std::uint64_t ts_, Price price_) noexcept {
+            if constexpr (csv_median::timed_calculator<Calc>) {
+                return calc_.add(ts_, price_);
+            }
+            else {
+                return calc_.add(price_);
+            }
+            };
+        // Замер каждой записи стоил бы больше самого add()
+        csv_median::op_sampler sampler;
+
+        // Пакет записей одного файла: цикл встраивается вместе с калькулятором
+        const auto on_batch = [&](std::span<const std::uint64_t> ts_,
+            std::span<const Price> price_)
+        {
+            if (error) [[unlikely]] {
+                return;
+            }
+            if (interrupted(config_)) [[unlikely]] {
+                // Пакет уже отдан читателем: он войдёт в последний снимок
+                if (!checkpoints) {
+                    return;
+                }
+                reader_.request_checkpoint();
+            }
+
+            csv_median::add_metric(csv_median::counter::calc_ops, ts_.size());
+            for (std::size_t i = 0; i < ts_.size(); ++i) {
+                std::error_code add_err;
+                if (sampler.due()) [[unlikely]] {
+                    const csv_median::stopwatch op;
+                    add_err = add(ts_[i], price_[i]);
+                    csv_median::record_latency(csv_median::latency::calc_op, op.elapsed_ns());
+                }
+                else {
+                    add_err = add(ts_[i], price_[i]);
+                }
+                if (add_err) [[unlikely]] {
+                    report_calc_error(add_err);
+                    error = add_err;
+                    g_shutdown = 1;
+                    return;
+                }
+
+                if (calc_.is_changed()) {
+                    if (const auto err = writer_.write(ts_[i], calc_.median())) {
+                        spdlog::error("error writer: {}", err.message());
+                        error = err;
+                        g_shutdown = 1;
+                        return;
+                    }
+                    ++written_;
+                }
+            }
+            };
+
+        const auto err = read_input<Price>(config_, reader_, on_batch,
+            [&writer_] { return flush_sink(writer_); });
+        return err ? err : error;
+    }
+
+    /**
+     * \brief Предупредить, если цены пришлось округлять до сетки
+     */
+    void report_off_grid(std::size_t off_grid_) noexcept {
+        if (off_grid_ != 0) {
+            spdlog::warn("{} prices are off the tick_size grid, "
+                "rounded to the nearest tick", off_grid_);
+        }
+    }
+
+    /**
+     * \brief Число цен вне сетки tick_size у калькулятора на гистограмме
+     */
+    template<class Calc>
+    [[nodiscard]] std::size_t off_grid_count(const Calc& calc_) noexcept {
+        if constexpr (requires { calc_.calculator().engine().off_grid(); }) {
+            return calc_.calculator().engine().off_grid();
+        }
+        else if constexpr (requires { calc_.engine().off_grid(); }) {
+            return calc_.engine().off_grid();
+        }
+        else {
+            return 0;
+        }
+    }
+
+    /**
+     * \brief Выбрать тип калькулятора по конфигурации
+     *
+     * fn_ получает фабрику: make_() возвращает новый калькулятор —
+     * один на весь расчёт, на участок или на группу.
+     *
+     * \return результат fn_(make)
+     */
+    template<class Price, class Fn>
+    [[nodiscard]] auto with_calculator(const csv_median::app_config& config_, Fn&& fn_) noexcept {
+        if (config_.window_us != 0) {
+            // Окно требует удаления: парсер гарантирует skiplist или histogram
+            if (config_.backend == csv_median::median_backend::histogram) {
+                return fn_([&config_] {
+                    return csv_median::sliding_window<csv_median::histogram_calculator<Price>>{
+                        config_.window_us,
+                        csv_median::histogram_calculator<Price>{
+                            csv_median::tick_histogram<Price>{ config_.tick_units } } };
+                    });
+            }
+            return fn_([&config_] {
+                return csv_median::sliding_window<csv_median::skiplist_calculator<Price>>{
+                    config_.window_us };
+                });
+        }
+
+        switch (config_.backend) {
+        case csv_median::median_backend::histogram:
+            return fn_([&config_] {
+                return csv_median::histogram_calculator<Price>{
+                    csv_median::tick_histogram<Price>{ config_.tick_units } };
+                });
+        case csv_median::median_backend::tdigest:
+            return fn_([&config_] {
+                return csv_median::sketch_calculator<Price>{
+                    csv_median::tdigest<Price>{ config_.sketch_error } };
+                });
+        case csv_median::median_backend::skiplist:
+            return fn_([] { return csv_median::skiplist_calculator<Price>{}; });
+        case csv_median::median_backend::heap:
+        default:
+            return fn_([] { return csv_median::basic_calculator<Price>{}; });
+        }
+    }
+
+    /**
+     * \brief Калькулятор медианы со статистиками [main].statistics
+     *
+     * Парсер гарантирует skiplist или histogram: нужны ранги и удаление.
+     * \return результат fn_(make)
+     */
+    template<class Price, class Fn>
+    [[nodiscard]] auto with_statistics_calculator(const csv_median::app_config& config_,
+        Fn&& fn_) noexcept
+    {
+        if (config_.backend == csv_median::median_backend::histogram) {
+            return fn_([&config_] {
+                return csv_median::statistics_calculator<csv_median::histogram_calculator<Price>>{
+                    config_.window_us, config_.statistics,
+                    csv_median::histogram_calculator<Price>{
+                        csv_median::tick_histogram<Price>{ config_.tick_units } } };
+                });
+        }
+        return fn_([&config_] {
+            return csv_median::statistics_calculator<csv_median::skiplist_calculator<Price>>{
+                config_.window_us, config_.statistics };
+            });
+    }
+
+    /**
+     * \brief Ограничить чтение [from_ts, to_ts): файлы открываются
+     * сразу на from_ts по <имя>.idx
+     * \param index_ индексы; должны жить, пока читатель используется
+     */
+    [[nodiscard]] std::error_code apply_range(
+        const csv_median::app_config& config_,
+        csv_median::thread_pool&      pool_,
+        csv_median::csv_reader&       reader_,
+        csv_median::index_table&      index_) noexcept
+    {
+        if (config_.range.whole()) {
+            return {};
+        }
+        auto [paths, scan_err] = reader_.scan_directory(config_.input_dir,
+            config_.filename_masks);
+        if (scan_err) {
+            return scan_err;
+        }
+        csv_median::load_indexes(pool_, paths, config_.index, index_);
+        reader_.set_range(config_.range, &index_);
+        return {};
+    }
+
+    /**
+     * \brief Место в калькуляторе под все записи входных файлов заранее
+     *
+     * Кучи и skip list хранят каждую запись и иначе растут удвоением,
+     * копируя весь массив. Оценка берётся с запасом: не тронутые
+     * страницы резерва не занимают память (pages.hpp).
+     */
+    template<class Calc>
+    void reserve_records(const csv_median::app_config& config_,
+        csv_median::csv_reader& reader_, Calc& calc_) noexcept
+    {
+        if constexpr (requires(typename Calc::engine_type& engine_) {
+            engine_.reserve(std::size_t{}); })
+        {
+            if (!config_.range.whole()) {
+                return;
+            }
+            auto [paths, err] = reader_.scan_directory(config_.input_dir, config_.filename_masks);
+            if (err) {
+                return;
+            }
+            const auto hint = static_cast<std::size_t>(csv_median::estimate_records(paths));
+            try {
+                calc_.reserve(hint);
+                spdlog::info("reserved:   {} records", hint);
+            }
+            catch (const std::exception& e) {
+                spdlog::warn("Can't reserve memory for {} records: {}", hint, e.what());
+            }
+        }
+    }
+
+    /**
+     * \brief Начать с префикса [main].shard_prefix: калькулятор уже
+     *        содержит записи частей до этой
+     *
+     * С --resume снимок контрольной точки затем заменяет префикс:
+     * он сделан после него.
+     */
+    template<class Calc>
+    [[nodiscard]] std::error_code seed_prefix(const csv_median::app_config& config_,
+        Calc& calc_) noexcept
+    {
+        if (config_.shard_prefix.empty()) {
+            return {};
+        }
+        if constexpr (csv_median::mergeable<Calc>) {
+            csv_median::shard_state prefix;
+            if (const auto err = csv_median::load_shard(config_.shard_prefix, prefix)) {
+                spdlog::error("Can't read shard prefix {}: {}",
+                    config_.shard_prefix.string(), err.message());
+                return err;
+            }
+            try {
+                if (prefix.signature != shard_signature(config_)) {
+                    spdlog::error("Shard prefix {} is computed with different prices, "
+                        "median_backend, tick_size or sketch_error", config_.shard_prefix.string());
+                    return std::make_error_code(std::errc::invalid_argument);
+                }
+                csv_median::state_reader state{ prefix.state };
+                if (!calc_.load(state) || !state.done()) {
+                    spdlog::error("Shard prefix state is corrupt");
+                    return std::make_error_code(std::errc::bad_message);
+                }
+            }
+            catch (const std::bad_alloc&) {
+                return std::make_error_code(std::errc::not_enough_memory);
+            }
+            spdlog::info("prefix:     {} records up to receive_ts {}", prefix.records, prefix.last_ts);
+            return {};
+        }
+        else {
+            // Парсер допускает shard_prefix только с histogram или tdigest без окна
+            return std::make_error_code(std::errc::not_supported);
+        }
+    }
+
+    /**
+     * \brief Расчёт одним проходом по всем файлам
+     */
+    template<class Price, csv_median::result_sink Sink>
+    [[nodiscard]] std::error_code run_sequential(
+        const csv_median::app_config& config_,
+        csv_median::thread_pool&      pool_,
+        csv_median::csv_reader&       reader_,
+        Sink&                         writer_,
+        std::size_t&                  written_,
+        checkpoint_run&               checkpoints_) noexcept
+    {
+        csv_median::index_table index;
+        if (const auto err = apply_range(config_, pool_, reader_, index)) {
+            return err;
+        }
+
+        return with_calculator<Price>(config_, [&](auto make_) {
+            auto calc = make_();
+            reserve_records(config_, reader_, calc);
+            if (const auto err = seed_prefix(config_, calc)) {
+                return err;
+            }
+            const auto err = run(config_, reader_, writer_, calc, written_, checkpoints_);
+            report_off_grid(off_grid_count(calc));
+            return err;
+            });
+    }
+
+    /**
+     * \brief Расчёт медианы и статистик одним проходом
+     *
+     * Строка — при изменении медианы, как без статистик; колонка
+     * quantity разбирается, только если нужен VWAP.
+     */
+    template<class Price, csv_median::statistics_sink Sink>
+    [[nodiscard]] std::error_code run_statistics(
+        const csv_median::app_config& config_,
+        csv_median::thread_pool&      pool_,
+        csv_median::csv_reader&       reader_,
+        Sink&                         writer_,
+        std::size_t&                  written_) noexcept
+    {
+        csv_median::index_table index;
+        if (const auto err = apply_range(config_, pool_, reader_, index)) {
+            return err;
+        }
+        reader_.set_quantity(csv_median::uses_quantity(config_.statistics));
+
+        return with_statistics_calculator<Price>(config_, [&](auto make_) -> std::error_code {
+            using Calc = decltype(make_());
+            std::optional<Calc> calc;
+            try {
+                calc.emplace(make_());
+            }
+            catch (const std::bad_alloc&) {
+                return std::make_error_code(std::errc::not_enough_memory);
+            }
+
+            std::error_code error;
+            const auto on_batch = [&](const csv_median::batch_view<Price>& batch_) {
+                if (interrupted(config_) || error) [[unlikely]] {
+                    return;
+                }
+
+                for (std::size_t i = 0; i < batch_.ts.size(); ++i) {
+                    if (const auto err = calc->add(batch_.ts[i], batch_.price[i],
+                        batch_.quantity.empty() ? 0.0 : batch_.quantity[i]))
+                    {
+                        report_calc_error(err);
+                        error = err;
+                        return;
+                    }
+
+                    if (calc->is_changed()) {
+                        if (const auto err = writer_.write(batch_.ts[i], calc->median(),
+                            calc->values()))
+                        {
+                            spdlog::error("error writer: {}", err.message());
+                            error = err;
+                            return;
+                        }
+                        ++written_;
+                    }
+                }
+                };
+
+            const auto err = read_input<Price>(config_, reader_, on_batch,
+                [&writer_] { return flush_sink(writer_); });
+            report_off_grid(off_grid_count(*calc));
+            return err ? err : error;
+            });
+    }
+
+    /**
+     * \brief Расчёт окна участками receive_ts задачами пула
+     *
+     * Участок читает свои записи отдельным читателем без параллельного
+     * разбора: параллельны сами участки.
+     */
+    template<class Price, csv_median::result_sink Sink>
+    [[nodiscard]] std::error_code run_partitioned(
+        const csv_median::app_config& config_,
+        csv_median::thread_pool&      pool_,
+        csv_median::csv_reader&       reader_,
+        Sink&                         writer_,
+        std::size_t&                  written_) noexcept
+    {
+        csv_median::index_table index;
+        auto [parts, plan_err] = csv_median::plan_partitions(pool_, reader_,
+            config_.input_dir, config_.filename_masks, config_.partitions, config_.range, index);
+        if (plan_err) {
+            return plan_err;
+        }
+        spdlog::info("partitions: {}", parts.size());
+
+        // Записи прогрева окна попадают в два участка и могут быть
+        // посчитаны среди цен вне сетки дважды
+        std::atomic<std::size_t> off_grid{ 0 };
+        const auto err = with_calculator<Price>(config_, [&](auto make_) {
+            return csv_median::run_partitions<Price>(pool_, parts, writer_, written_,
+                [&](const csv_median::time_partition& part_) {
+                    csv_median::csv_reader reader{
+                        pool_, config_.input_mode, false, config_.direct_io, false };
+                    auto calc = make_();
+                    auto result = csv_median::compute_partition(reader, config_.input_dir,
+                        config_.filename_masks, index, part_, config_.window_us,
+                        config_.range.from, calc,
+                        [] { return g_shutdown != 0; });
+                    off_grid += off_grid_count(calc);
+                    if (result.error == std::errc::value_too_large) {
+                        report_calc_error(result.error);
+                    }
+                    return result;
+                });
+            });
+        report_off_grid(off_grid);
+        return err;
+    }
+
+    /**
+     * \brief Посчитать свою часть входа и сохранить её состояние
+     *        ([main].shard_mode = 'partial')
+     *
+     * Строк медианы узел не пишет: они зависят от частей до него.
+     * \return EXIT_SUCCESS или EXIT_FAILURE
+     */
+    template<class Price>
+    [[nodiscard]] int run_shard_partial(
+        const csv_median::app_config& config_,
+        csv_median::thread_pool&      pool_,
+        csv_median::csv_reader&       reader_) noexcept
+    {
+        csv_median::index_table index;
+        if (const auto err = apply_range(config_, pool_, reader_, index)) {
+            spdlog::error("error during work: {}", err.message());
+            return EXIT_FAILURE;
+        }
+
+        return with_calculator<Price>(config_, [&](auto make_) -> int {
+            using Calc = decltype(make_());
+            if constexpr (csv_median::mergeable<Calc>) {
+                auto calc = make_();
+                csv_median::shard_state shard;
+                std::error_code error;
+
+                const auto on_batch = [&](std::span<const std::uint64_t> ts_,
+                    std::span<const Price> price_)
+                {
+                    if (interrupted(config_) || error || ts_.empty()) [[unlikely]] {
+                        return;
+                    }
+                    const auto [first, last] = std::ranges::minmax(ts_);
+                    shard.first_ts = (shard.records == 0) ? first : std::min(shard.first_ts, first);
+                    shard.last_ts = (shard.records == 0) ? last : std::max(shard.last_ts, last);
+                    shard.records += ts_.size();
+
+                    csv_median::add_metric(csv_median::counter::calc_ops, ts_.size());
+                    for (const Price price : price_) {
+                        if (const auto err = calc.add(price)) [[unlikely]] {
+                            report_calc_error(err);
+                            error = err;
+                            return;
+                        }
+                    }
+                    };
+
+                const auto read_err = read_input<Price>(config_, reader_, on_batch,
+                    [] { return std::error_code{}; });
+                if (const auto err = read_err ? read_err : error) {
+                    spdlog::error("error during work: {}", err.message());
+                    return EXIT_FAILURE;
+                }
+                report_off_grid(off_grid_count(calc));
+                if (g_shutdown) {
+                    spdlog::warn("stopped by system signal, shard is not saved");
+                    return EXIT_FAILURE;
+                }
+
+                const auto path = csv_median::shard_path(config_.output_dir);
+                std::error_code err;
+                try {
+                    shard.signature = shard_signature(config_);
+                    auto [paths, scan_err] = reader_.scan_directory(config_.input_dir,
+                        config_.filename_masks);
+                    for (auto& file : paths) {
+                        csv_median::cache_source_info source;
+                        if (const auto fp_err = csv_median::fingerprint(file, source)) {
+                            spdlog::warn("Can't fingerprint {}: {}", file.string(), fp_err.message());
+                        }
+                        shard.files.push_back({ std::move(file), source });
+                    }
+
+                    csv_median::state_writer state;
+                    calc.save(state);
+                    const auto bytes = state.data();
+                    shard.state.assign(bytes.begin(), bytes.end());
+
+                    std::filesystem::create_directories(config_.output_dir, err);
+                    if (!err) {
+                        err = csv_median::save_shard(path, shard);
+                    }
+                }
+                catch (const std::bad_alloc&) {
+                    err = std::make_error_code(std::errc::not_enough_memory);
+                }
+                if (err) {
+                    spdlog::error("Can't save shard {}: {}", path.string(), err.message());
+                    return EXIT_FAILURE;
+                }
+
+                spdlog::info("shard: {} records, receive_ts [{}, {}], {} bytes of state",
+                    shard.records, shard.first_ts, shard.last_ts, shard.state.size());
+                spdlog::info("records: {}", path.string());
+                return EXIT_SUCCESS;
+            }
+            else {
+                // Парсер допускает shard_mode только с histogram или tdigest без окна
+                spdlog::error("shard_mode requires median_backend 'histogram' or 'tdigest'");
+                return EXIT_FAILURE;
+            }
+            });
+    }
+
+    /**
+     * \brief Слить части [main].shard_inputs без исходных CSV
+     *        ([main].shard_mode = 'merge')
+     *
+     * Части идут по receive_ts; после каждой пишется строка с последним
+     * receive_ts части и медианой всех частей до неё включительно —
+     * та же, что у сквозного расчёта после этой записи. Для части k >= 1
+     * сохраняется префикс median_result.prefix_<k>.part: с ним узел
+     * части выводит все её строки ([main].shard_prefix).
+     */
+    template<class Price, csv_median::result_sink Sink>
+    [[nodiscard]] std::error_code run_shard_merge(
+        const csv_median::app_config& config_,
+        Sink&                         writer_,
+        std::size_t&                  written_) noexcept
+    {
+        std::vector<csv_median::shard_state> shards;
+        std::uint64_t signature = 0;
+        try {
+            signature = shard_signature(config_);
+            for (const auto& path : config_.shard_inputs) {
+                csv_median::shard_state shard;
+                if (const auto err = csv_median::load_shard(path, shard)) {
+                    spdlog::error("Can't read shard {}: {}", path.string(), err.message());
+                    return err;
+                }
+                if (shard.signature != signature) {
+                    spdlog::error("Shard {} is computed with different prices, "
+                        "median_backend, tick_size or sketch_error", path.string());
+                    return std::make_error_code(std::errc::invalid_argument);
+                }
+                spdlog::info("shard {}: {} records, receive_ts [{}, {}]", path.string(),
+                    shard.records, shard.first_ts, shard.last_ts);
+                shards.push_back(std::move(shard));
+            }
+        }
+        catch (const std::bad_alloc&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+
+        // Один файл, изменившийся между узлами, дал бы части разных версий
+        for (std::size_t i = 0; i < shards.size(); ++i) {
+            for (std::size_t j = i + 1; j < shards.size(); ++j) {
+                for (const auto& a : shards[i].files) {
+                    for (const auto& b : shards[j].files) {
+                        if (a.path == b.path && a.source != b.source) {
+                            spdlog::warn("{} differs between shards", a.path.string());
+                        }
+                    }
+                }
+            }
+        }
+        if (const auto err = csv_median::order_shards(shards)) {
+            return err;
+        }
+
+        return with_calculator<Price>(config_, [&](auto make_) -> std::error_code {
+            using Calc = decltype(make_());
+            if constexpr (csv_median::mergeable<Calc>) {
+                std::uint64_t records = 0;
+                const auto err = csv_median::merge_shards(shards, make_,
+                    [&](std::size_t index_, const csv_median::shard_state& shard_, Calc& calc_)
+                    -> std::error_code
+                {
+                    records += shard_.records;
+                    if (const auto write_err = writer_.write(shard_.last_ts, calc_.median())) {
+                        spdlog::error("error writer: {}", write_err.message());
+                        return write_err;
+                    }
+                    ++written_;
+                    spdlog::info("  - [{}, {}]: {} records merged", shard_.first_ts,
+                        shard_.last_ts, records);
+
+                    if (index_ + 1 == shards.size()) {
+                        return {};
+                    }
+                    const auto path = csv_median::shard_prefix_path(config_.output_dir, index_ + 1);
+                    csv_median::state_writer state;
+                    calc_.save(state);
+                    const auto bytes = state.data();
+                    const csv_median::shard_state prefix{ signature, records,
+                        shards.front().first_ts, shard_.last_ts, {},
+                        { bytes.begin(), bytes.end() } };
+                    if (const auto save_err = csv_median::save_shard(path, prefix)) {
+                        spdlog::error("Can't save shard prefix {}: {}", path.string(),
+                            save_err.message());
+                        return save_err;
+                    }
+                    spdlog::info("    prefix of [{}, ...]: {}", shards[index_ + 1].first_ts,
+                        path.string());
+                    return {};
+                });
+                if (err == std::errc::bad_message) {
+                    spdlog::error("Shard state is corrupt");
+                }
+                else if (err == std::errc::value_too_large) {
+                    report_calc_error(err);
+                }
+                return err;
+            }
+            else {
+                // Парсер допускает shard_mode только с histogram или tdigest без окна
+                return std::make_error_code(std::errc::not_supported);
+            }
+            });
+    }
+
+    /**
+     * \brief Выбор способа расчёта по конфигурации
+     */
+    template<class Price, csv_median::result_sink Sink>
+    [[nodiscard]] std::error_code run_backend(
+        const csv_median::app_config& config_,
+        csv_median::thread_pool&      pool_,
+        csv_median::csv_reader&       reader_,
+        Sink&                         writer_,
+        std::size_t&                  written_,
+        checkpoint_run&               checkpoints_) noexcept
+    {
+        if (config_.shard == csv_median::shard_mode::merge) {
+            return run_shard_merge<Price>(config_, writer_, written_);
+        }
+        if (!config_.statistics.empty()) {
+            if constexpr (csv_median::statistics_sink<Sink>) {
+                return run_statistics<Price>(config_, pool_, reader_, writer_, written_);
+            }
+            else {
+                // Парсер допускает статистики только с output_format = 'csv'
+                return std::make_error_code(std::errc::not_supported);
+            }
+        }
+        if (config_.partitions > 1) {
+            return run_partitioned<Price>(config_, pool_, reader_, writer_, written_);
+        }
+        return run_sequential<Price>(config_, pool_, reader_, writer_, written_, checkpoints_);
+    }
+
+    /**
+     * \brief Калькулятор и файл результата одной группы
+     */
+    template<class Calc, class Sink>
+    struct group_output {
+        std::string           name;
+        Calc                  calc;
+        std::unique_ptr<Sink> sink;
+        std::size_t           written{ 0 };
+    };
+
+    /**
+     * \brief Имя группы: маска filename_mask или значение колонки
+     */
+    [[nodiscard]] std::string group_label(const csv_median::app_config& config_,
+        std::uint64_t key_)
+    {
+        if (config_.groups == csv_median::group_mode::mask) {
+            for (const auto& mask : config_.filename_masks) {
+                if (csv_median::group_key(mask) == key_) {
+                    return mask;
+                }
+            }
+        }
+        return csv_median::group_name(key_);
+    }
+
+    /**
+     * \brief Расчёт по группам за один проход слияния
+     *
+     * Калькулятор и приёмник группы создаются при её первой записи;
+     * файл — median_result_<группа> с расширением формата.
+     *
+     * \param make_sink_ () -> std::unique_ptr<Sink>, ещё не открытый
+     * \return EXIT_SUCCESS или EXIT_FAILURE
+     */
+    template<class Price, csv_median::result_sink Sink, class MakeSink>
+    [[nodiscard]] int run_grouped(
+        const csv_median::app_config& config_,
+        csv_median::thread_pool&      pool_,
+        csv_median::csv_reader&       reader_,
+        MakeSink&&                    make_sink_) noexcept
+    {
+        csv_median::index_table index;
+        if (const auto err = apply_range(config_, pool_, reader_, index)) {
+            spdlog::error("error during work: {}", err.message());
+            return EXIT_FAILURE;
+        }
+        reader_.set_groups(config_.groups, config_.group_column);
+
+        const std::string_view extension =
+            (config_.format == csv_median::output_format::columnar) ? ".col" : ".csv";
+
+        return with_calculator<Price>(config_, [&](auto make_) {
+            using Calc = decltype(make_());
+            using group = group_output<Calc, Sink>;
+
+            csv_median::group_table<group> groups;
+            group* last = nullptr;
+            std::uint64_t last_key = 0;
+            bool failed = false;
+
+            // Записи одной группы обычно идут подряд: сначала последняя
+            const auto find_group = [&](std::uint64_t key_) -> group* {
+                if (last != nullptr && last_key == key_) [[likely]] {
+                    return last;
+                }
+                group* found = groups.find(key_);
+                if (found == nullptr) {
+                    auto name = group_label(config_, key_);
+                    auto sink = make_sink_();
+                    const auto filename = std::format("median_result_{}{}", name, extension);
+                    if (const auto err = sink->open(config_.output_dir, filename)) {
+                        spdlog::error("Ошибка открытия выходного файла {}: {}",
+                            filename, err.message());
+                        return nullptr;
+                    }
+                    found = &groups.insert(key_, std::unique_ptr<group>(
+                        new group{ std::move(name), make_(), std::move(sink) }));
+                }
+                last = found;
+                last_key = key_;
+                return found;
+            };
+
+            const auto on_batch = [&](const csv_median::batch_view<Price>& batch_) {
+                if (interrupted(config_) || failed) [[unlikely]] {
+                    return;
+                }
+
+                try {
+                    for (std::size_t i = 0; i < batch_.ts.size(); ++i) {
+                        group* const g = find_group(batch_.group[i]);
+                        if (g == nullptr) [[unlikely]] {
+                            failed = true;
+                            return;
+                        }
+                        std::error_code add_err;
+                        if constexpr (csv_median::timed_calculator<Calc>) {
+                            add_err = g->calc.add(batch_.ts[i], batch_.price[i]);
+                        }
+                        else {
+                            add_err = g->calc.add(batch_.price[i]);
+                        }
+                        if (add_err) [[unlikely]] {
+                            report_calc_error(add_err);
+                            failed = true;
+                            return;
+                        }
+
+                        if (g->calc.is_changed()) {
+                            if (const auto err = g->sink->write(batch_.ts[i], g->calc.median())) {
+                                spdlog::error("error writer: {}", err.message());
+                                failed = true;
+                                return;
+                            }
+                            ++g->written;
+                        }
+                    }
+                }
+                catch (const std::exception& e) {
+                    spdlog::error("Can't add group: {}", e.what());
+                    failed = true;
+                }
+                };
+
+            const auto process_err = read_input<Price>(config_, reader_, on_batch, [&] {
+                for (const auto& g : groups.values()) {
+                    if (const auto err = flush_sink(*g->sink)) {
+                        return err;
+                    }
+                }
+                return std::error_code{};
+                });
+
+            // Хвосты буферов всех групп, даже если расчёт прерван
+            std::size_t off_grid = 0;
+            for (const auto& g : groups.values()) {
+                if (const auto err = g->sink->close()) {
+                    spdlog::error("error writer: {}", err.message());
+                    failed = true;
+                }
+                off_grid += off_grid_count(g->calc);
+            }
+            report_off_grid(off_grid);
+
+            if (process_err) {
+                spdlog::error("error during work: {}", process_err.message());
+                return EXIT_FAILURE;
+            }
+            if (failed) {
+                return EXIT_FAILURE;
+            }
+            report_signal_stop(config_);
+
+            spdlog::info("groups: {}", groups.size());
+            for (const auto& g : groups.values()) {
+                spdlog::info("  - {}: {} medians, {}", g->name, g->written, g->sink->path().string());
+            }
+            return EXIT_SUCCESS;
+            });
+    }
+
+    /**
+     * \brief Открыть приёмник, выполнить расчёт и закрыть приёмник
+     * \param make_sink_ () -> std::unique_ptr<Sink>, ещё не открытый
+     * \return EXIT_SUCCESS или EXIT_FAILURE
+     */
+    template<csv_median::result_sink Sink, class MakeSink>
+    [[nodiscard]] int run_sink(
+        const csv_median::app_config& config_,
+        csv_median::thread_pool&      pool_,
+        csv_median::csv_reader&       reader_,
+        MakeSink&&                    make_sink_) noexcept
+    {
+        if (config_.groups != csv_median::group_mode::none) {
+            return (config_.prices == csv_median::price_mode::fixed)
+                ? run_grouped<csv_median::fixed_price, Sink>(config_, pool_, reader_, make_sink_)
+                : run_grouped<double, Sink>(config_, pool_, reader_, make_sink_);
+        }
+
+        std::unique_ptr<Sink> writer;
+        try {
+            writer = make_sink_();
+            if constexpr (csv_median::statistics_sink<Sink>) {
+                std::vector<std::string> columns;
+                for (const auto& stat : config_.statistics) {
+                    columns.push_back(csv_median::statistic_name(stat));
+                }
+                writer->set_columns(columns);
+            }
+        }
+        catch (const std::exception& e) {
+            spdlog::error("Ошибка создания приёмника: {}", e.what());
+            return EXIT_FAILURE;
+        }
+        checkpoint_run checkpoints;
+        const auto checkpoint_file = csv_median::checkpoint_path(config_.output_dir);
+        if (config_.checkpoint_records != 0) {
+            try {
+                checkpoints.signature = config_signature(config_);
+            }
+            catch (const std::exception& e) {
+                spdlog::error("Ошибка подписи конфигурации: {}", e.what());
+                return EXIT_FAILURE;
+            }
+        }
+
+        std::error_code open_err;
+        if (config_.resume) {
+            csv_median::checkpoint loaded;
+            if (const auto err = csv_median::load_checkpoint(checkpoint_file, loaded)) {
+                spdlog::error("Ошибка чтения контрольной точки {}: {}",
+                    checkpoint_file.string(), err.message());
+                return EXIT_FAILURE;
+            }
+            if (loaded.signature != checkpoints.signature) {
+                spdlog::error("Контрольная точка {} снята с другой конфигурацией",
+                    checkpoint_file.string());
+                return EXIT_FAILURE;
+            }
+            if constexpr (requires { writer->resume(config_.output_dir, 0, 0); }) {
+                open_err = writer->resume(config_.output_dir, loaded.output_size,
+                    static_cast<std::size_t>(loaded.output_rows));
+            }
+            else {
+                open_err = std::make_error_code(std::errc::not_supported);
+            }
+            spdlog::info("resume:     {} records, {} medians", loaded.records, loaded.output_rows);
+            checkpoints.resume = std::move(loaded);
+        }
+        else {
+            // Снимок прошлого расчёта не относится к перезаписанному файлу
+            std::error_code remove_err;
+            if (config_.checkpoint_records != 0) {
+                std::filesystem::remove(checkpoint_file, remove_err);
+            }
+            if (remove_err) {
+                spdlog::warn("Can't remove checkpoint {}: {}", checkpoint_file.string(),
+                    remove_err.message());
+            }
+            open_err = writer->open(config_.output_dir);
+        }
+        if (open_err) {
+            spdlog::error("Ошибка открытия выходного файла: {}", open_err.message());
+            return EXIT_FAILURE;
+        }
+
+        std::size_t written = 0;
+        const auto process_err = (config_.prices == csv_median::price_mode::fixed)
+            ? run_backend<csv_median::fixed_price>(config_, pool_, reader_, *writer, written,
+                checkpoints)
+            : run_backend<double>(config_, pool_, reader_, *writer, written, checkpoints);
+
+        if (process_err) {
+            spdlog::error("error during work: {}", process_err.message());
+            return EXIT_FAILURE;
+        }
+
+        // Хвост буфера записи: ошибка сброса здесь тоже означает неполный вывод
+        if (const auto err = writer->close()) {
+            spdlog::error("error writer: {}", err.message());
+            return EXIT_FAILURE;
+        }
+
+        if (config_.checkpoint_records != 0) {
+            if (checkpoints.stopped) {
+                spdlog::warn("checkpoint saved: {}, continue with --resume",
+                    checkpoint_file.string());
+            }
+            else if (std::error_code err; !std::filesystem::remove(checkpoint_file, err) && err) {
+                spdlog::warn("Can't remove checkpoint {}: {}", checkpoint_file.string(),
+                    err.message());
+            }
+        }
+
+        report_signal_stop(config_);
+
+        // ── 5. Итоги ─────────────────────────────────────
+        spdlog::info("median: {}", written);
+        if (config_.bucket_us != 0) {
+            spdlog::info("rows: {}", writer->written_count());
+        }
+        spdlog::info("records: {}", writer->path().string());
+        return EXIT_SUCCESS;
+    }
+
+    /**
+     * \brief run_sink, с [main].bucket_us — через bucket_sink
+     * \param make_sink_ () -> std::unique_ptr<Sink>, ещё не открытый
+     * \return EXIT_SUCCESS или EXIT_FAILURE
+     */
+    template<csv_median::result_sink Sink, class MakeSink>
+    [[nodiscard]] int run_output(
+        const csv_median::app_config& config_,
+        csv_median::thread_pool&      pool_,
+        csv_median::csv_reader&       reader_,
+        MakeSink&&                    make_sink_) noexcept
+    {
+        if (config_.bucket_us == 0) {
+            return run_sink<Sink>(config_, pool_, reader_, make_sink_);
+        }
+        return run_sink<csv_median::bucket_sink<Sink>>(config_, pool_, reader_, [&] {
+            return std::make_unique<csv_median::bucket_sink<Sink>>(
+                make_sink_(), config_.bucket_us, config_.bucket_ohlc);
+            });
+    }
+
+    /**
+     * \brief Итог строк с ошибкой разбора по файлам
+     *
+     * По одной в лог выводятся только первые parse_error_limit строк
+     * файла, здесь — сколько пропущено всего.
+     */
+    void report_skipped_lines() noexcept {
+        try {
+            for (const auto& file : csv_median::take_metrics_snapshot().files) {
+                if (file.skipped != 0) {
+                    spdlog::warn("{}: {} invalid lines skipped",
+                        std::filesystem::path{ file.path }.filename().string(), file.skipped);
+                }
+            }
+        }
+        catch (const std::exception&) {
+            spdlog::error("Out of memory reporting invalid lines");
+        }
+    }
+
+    /**
+     * \brief Итог метрик: строка лога за весь расчёт и JSON в output_dir
+     */
+    void write_metrics_summary(const csv_median::app_config& config_) noexcept {
+        try {
+            const auto snapshot = csv_median::take_metrics_snapshot();
+            spdlog::info("{}", csv_median::format_metrics_line(snapshot, {}));
+            const auto path = config_.output_dir / csv_median::k_metrics_filename;
+            if (const auto err = csv_median::write_metrics_json(path, snapshot)) {
+                spdlog::error("Can't write {}: {}", path.string(), err.message());
+            }
+        }
+        catch (const std::exception&) {
+            spdlog::error("Out of memory writing metrics");
+        }
+    }
+
 }
 
 int main(int argc, const char* argv[]) noexcept {
+    const logger_guard logs;
     setup_logger();
     setup_signals();
 
@@ -67,64 +1321,123 @@ int main(int argc, const char* argv[]) noexcept {
         return EXIT_FAILURE;
     }
 
-    spdlog::info("input dir:  {}", config.input_dir.string());
+    if (config.shard == csv_median::shard_mode::merge) {
+        spdlog::info("shards:     {}", config.shard_inputs.size());
+    }
+    else {
+        spdlog::info("input dir:  {}", config.input_dir.string());
+    }
     spdlog::info("output dir: {}", config.output_dir.string());
+    if (config.window_us != 0) {
+        spdlog::info("window:     {} us", config.window_us);
+    }
+    if (config.follow) {
+        spdlog::info("follow:     lateness {} us", config.follow_settings.lateness_us);
+    }
+    if (config.bucket_us != 0) {
+        spdlog::info("bucket:     {} us{}", config.bucket_us, config.bucket_ohlc ? ", ohlc" : "");
+    }
+    if (!config.range.whole()) {
+        spdlog::info("range:      [{}, {})", config.range.from, config.range.to);
+    }
+    if (config.groups != csv_median::group_mode::none) {
+        spdlog::info("groups:     by {}", config.groups == csv_median::group_mode::mask
+            ? std::string{ "filename_mask" } : config.group_column);
+    }
+    if (!config.statistics.empty()) {
+        std::string names;
+        for (const auto& stat : config.statistics) {
+            names += names.empty() ? "" : ", ";
+            names += csv_median::statistic_name(stat);
+        }
+        spdlog::info("statistics: {}", names);
+    }
+    if (config.output_mode != csv_median::write_mode::sync) {
+        spdlog::info("write mode: {}, {} buffers{}",
+            config.output_mode == csv_median::write_mode::async ? "async" : "uring",
+            config.write_buffers, config.direct_io ? ", O_DIRECT" : "");
+    }
+    if (config.cache) {
+        spdlog::info("input cache: on");
+        if (config.partitions > 1 || !config.range.whole()
+            || config.groups == csv_median::group_mode::column
+            || csv_median::uses_quantity(config.statistics) || config.follow)
+        {
+            spdlog::warn("input cache is not used with partitions, from_ts / to_ts, "
+                "group_by = 'column', 'vwap' in statistics or follow");
+        }
+    }
+    csv_median::set_parse_error_limit(config.parse_error_limit);
+    if (config.pages != csv_median::huge_pages::off) {
+        csv_median::set_huge_pages(config.pages);
+        spdlog::info("huge pages: {}",
+            config.pages == csv_median::huge_pages::thp ? "thp" : "hugetlb");
+    }
+    if (config.checkpoint_records != 0) {
+        spdlog::info("checkpoint: every {} records{}", config.checkpoint_records,
+            config.resume ? ", resume" : "");
+    }
+    if (config.format == csv_median::output_format::columnar) {
+        spdlog::info("output:     columnar, {}",
+            csv_median::compression_name(config.output_compression));
+    }
 
     const std::size_t thread_count = std::max(
         k_min_threads,
         static_cast<std::size_t>(std::thread::hardware_concurrency())
     );
 
-    csv_median::thread_pool pool{ thread_count };
-    spdlog::info("Thread pool: {}", pool.thread_count());
-
-    csv_median::result_writer writer;
-    if (const auto err = writer.open(config.output_dir)) {
-        spdlog::error("Ошибка открытия выходного файла: {}", err.message());
-        return EXIT_FAILURE;
+    csv_median::thread_pool pool{ thread_count, config.pin_threads };
+    if (config.pin_threads) {
+        spdlog::info("Thread pool: {}, pinned: {}", pool.thread_count(), pool.pinned_count());
     }
+    else {
+        spdlog::info("Thread pool: {}", pool.thread_count());
+    }
+    spdlog::info("CSV scanner: {}", csv_median::scanner_kernel_name());
 
-    csv_median::calculator calc;
-    csv_median::csv_reader reader{ pool };
-    std::size_t written = 0;
+    csv_median::csv_reader reader{
+        pool, config.input_mode, config.parallel_parse, config.direct_io, config.cache };
 
-    const auto on_record = [&](const csv_median::csv_record& rec) {
-        if (g_shutdown) [[unlikely]] {
-            return;
+    csv_median::metrics_reporter reporter;
+    if (config.metrics.enabled) {
+        csv_median::set_metrics_enabled(true);
+        if (const auto err = reporter.start(config.metrics)) {
+            spdlog::error("metrics: can't listen on {}: {}", config.metrics.listen, err.message());
+            return EXIT_FAILURE;
         }
-
-        calc.add(rec.price);
-
-        if (calc.is_changed()) {
-            if (const auto err = writer.write(rec.receive_ts, calc.median())) {
-                spdlog::error("error writer: {}", err.message());
-                g_shutdown = 1;
-                return;
-            }
-            ++written;
+        if (!config.metrics.listen.empty()) {
+            spdlog::info("metrics:    http://{}/metrics, port {}", config.metrics.listen, reporter.port());
         }
-        };
-
-    const auto process_err = reader.process(
-        config.input_dir,
-        config.filename_masks,
-        on_record
-    );
-
-    if (process_err) {
-        spdlog::error("error during work: {}", process_err.message());
-        return EXIT_FAILURE;
     }
 
-    if (g_shutdown) {
-        spdlog::warn("stopped by system signal");
+    int status = EXIT_SUCCESS;
+    if (config.shard == csv_median::shard_mode::partial) {
+        status = (config.prices == csv_median::price_mode::fixed)
+            ? run_shard_partial<csv_median::fixed_price>(config, pool, reader)
+            : run_shard_partial<double>(config, pool, reader);
+    }
+    else if (config.format == csv_median::output_format::columnar) {
+        status = run_output<csv_median::columnar_writer>(config, pool, reader, [&config] {
+            return std::make_unique<csv_median::columnar_writer>(config.output_compression);
+            });
+    }
+    else {
+        status = run_output<csv_median::result_writer>(config, pool, reader, [&config] {
+            return std::make_unique<csv_median::result_writer>(
+                config.output_mode, config.write_buffers, config.direct_io);
+            });
+    }
+    report_skipped_lines();
+    if (config.metrics.enabled) {
+        reporter.stop();
+        write_metrics_summary(config);
+    }
+    if (status != EXIT_SUCCESS) {
+        return status;
     }
-
-    // ── 5. Итоги ─────────────────────────────────────
-    spdlog::info("median: {}", written);
-    spdlog::info("records: {}",
-        (config.output_dir / "median_result.csv").string());
     spdlog::info("closing");
 
-    return g_shutdown ? EXIT_FAILURE : EXIT_SUCCESS;
+    // В follow сигнал — штатный способ остановки: вывод уже сброшен
+    return (g_shutdown && !config.follow) ? EXIT_FAILURE : EXIT_SUCCESS;
 }
\ No newline at end of file
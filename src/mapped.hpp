@@ -0,0 +1,310 @@
+/**
+ * \file mapped.hpp
+ * \brief RAII-обёртка над отображением файла в память (POSIX mmap)
+ *
+ * Файл отображается целиком только для чтения. Ядру сообщается о
+ * последовательном доступе (MADV_SEQUENTIAL), а курсор по мере
+ * продвижения запрашивает упреждающее чтение следующего окна.
+ *
+ * Здесь же positional_file — дескриптор для чтения по смещению (pread),
+ * которым параллельные задачи разбора читают свои фрагменты файла
+ * без общей позиции чтения.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace csv_median {
+
+    namespace fs = std::filesystem;
+
+    // Окно упреждающего чтения для MADV_WILLNEED
+    inline constexpr std::size_t k_readahead_size = 8 * 1024 * 1024;
+
+    /**
+     * \brief Отображённый в память файл только для чтения
+     *
+     * Не копируется, только перемещается. Пустой файл открывается
+     * успешно и даёт пустой view().
+     */
+    class mapped_file {
+    public:
+        mapped_file() noexcept = default;
+        ~mapped_file() noexcept;
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        mapped_file(mapped_file&& other_) noexcept;
+        mapped_file& operator=(mapped_file&& other_) noexcept;
+
+        /**
+         * \brief Отобразить файл в память
+         * \param path_ путь к файлу
+         * \return код ошибки; not_supported — файл не регулярный (pipe, fifo)
+         */
+        [[nodiscard]] std::error_code open(const fs::path& path_) noexcept;
+
+        /**
+         * \brief Запросить упреждающее чтение окна начиная с offset_
+         */
+        void prefetch(std::size_t offset_) const noexcept;
+
+        /**
+         * \brief Содержимое файла
+         */
+        [[nodiscard]] std::string_view view() const noexcept;
+
+        [[nodiscard]] bool is_open() const noexcept;
+
+        void close() noexcept;
+
+    private:
+        const char* _data{ nullptr };
+        std::size_t _size{ 0 };
+        bool        _open{ false };
+    };
+
+    /**
+     * \brief Регулярный файл для чтения по смещению из нескольких потоков
+     *
+     * Не копируется, только перемещается.
+     */
+    class positional_file {
+    public:
+        positional_file() noexcept = default;
+        ~positional_file() noexcept;
+
+        positional_file(const positional_file&) = delete;
+        positional_file& operator=(const positional_file&) = delete;
+        positional_file(positional_file&& other_) noexcept;
+        positional_file& operator=(positional_file&& other_) noexcept;
+
+        /**
+         * \brief Открыть файл
+         * \return код ошибки; not_supported — файл не регулярный (pipe, fifo)
+         */
+        [[nodiscard]] std::error_code open(const fs::path& path_) noexcept;
+
+        /**
+         * \brief Прочитать до size_ байт начиная с offset_
+         * \return число прочитанных байт (меньше size_ только у конца файла)
+         */
+        [[nodiscard]] std::size_t read_at(std::size_t offset_, char* out_,
+            std::size_t size_, std::error_code& err_) const noexcept;
+
+        /**
+         * \brief Размер файла на момент открытия или последнего refresh()
+         */
+        [[nodiscard]] std::size_t size() const noexcept;
+
+        /**
+         * \brief Перечитать размер файла (файл дописывается)
+         */
+        [[nodiscard]] std::error_code refresh() noexcept;
+
+        [[nodiscard]] bool is_open() const noexcept;
+
+        void close() noexcept;
+
+    private:
+        int         _fd{ -1 };
+        std::size_t _size{ 0 };
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline mapped_file::~mapped_file() noexcept {
+        close();
+    }
+
+    inline mapped_file::mapped_file(mapped_file&& other_) noexcept
+        : _data{ std::exchange(other_._data, nullptr) }
+        , _size{ std::exchange(other_._size, 0) }
+        , _open{ std::exchange(other_._open, false) }
+    {
+    }
+
+    inline mapped_file& mapped_file::operator=(mapped_file&& other_) noexcept {
+        if (this != &other_) {
+            close();
+            _data = std::exchange(other_._data, nullptr);
+            _size = std::exchange(other_._size, 0);
+            _open = std::exchange(other_._open, false);
+        }
+        return *this;
+    }
+
+    inline std::error_code mapped_file::open(const fs::path& path_) noexcept {
+        close();
+
+        const int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return { errno, std::system_category() };
+        }
+
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            const std::error_code err{ errno, std::system_category() };
+            ::close(fd);
+            return err;
+        }
+
+        if (!S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return std::make_error_code(std::errc::not_supported);
+        }
+
+        _size = static_cast<std::size_t>(st.st_size);
+        if (_size > 0) {
+            void* addr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                const std::error_code err{ errno, std::system_category() };
+                ::close(fd);
+                _size = 0;
+                return err;
+            }
+            _data = static_cast<const char*>(addr);
+            ::madvise(addr, _size, MADV_SEQUENTIAL);
+        }
+
+        // Отображение живёт и без дескриптора
+        ::close(fd);
+        _open = true;
+        prefetch(0);
+        return {};
+    }
+
+    inline void mapped_file::prefetch(std::size_t offset_) const noexcept {
+        if (_data == nullptr || offset_ >= _size) {
+            return;
+        }
+        // madvise требует адрес, выровненный по странице
+        const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        const std::size_t begin = offset_ - offset_ % page;
+        const std::size_t len = std::min(k_readahead_size, _size - begin);
+        ::madvise(const_cast<char*>(_data + begin), len, MADV_WILLNEED);
+    }
+
+    inline std::string_view mapped_file::view() const noexcept {
+        return { _data, _size };
+    }
+
+    inline bool mapped_file::is_open() const noexcept {
+        return _open;
+    }
+
+    inline void mapped_file::close() noexcept {
+        if (_data != nullptr) {
+            ::munmap(const_cast<char*>(_data), _size);
+        }
+        _data = nullptr;
+        _size = 0;
+        _open = false;
+    }
+
+    inline positional_file::~positional_file() noexcept {
+        close();
+    }
+
+    inline positional_file::positional_file(positional_file&& other_) noexcept
+        : _fd{ std::exchange(other_._fd, -1) }
+        , _size{ std::exchange(other_._size, 0) }
+    {
+    }
+
+    inline positional_file& positional_file::operator=(positional_file&& other_) noexcept {
+        if (this != &other_) {
+            close();
+            _fd = std::exchange(other_._fd, -1);
+            _size = std::exchange(other_._size, 0);
+        }
+        return *this;
+    }
+
+    inline std::error_code positional_file::open(const fs::path& path_) noexcept {
+        close();
+
+        const int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return { errno, std::system_category() };
+        }
+
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            const std::error_code err{ errno, std::system_category() };
+            ::close(fd);
+            return err;
+        }
+
+        if (!S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return std::make_error_code(std::errc::not_supported);
+        }
+
+        _fd = fd;
+        _size = static_cast<std::size_t>(st.st_size);
+        return {};
+    }
+
+    inline std::size_t positional_file::read_at(std::size_t offset_, char* out_,
+        std::size_t size_, std::error_code& err_) const noexcept
+    {
+        std::size_t done = 0;
+        while (done < size_) {
+            const auto n = ::pread(_fd, out_ + done, size_ - done,
+                static_cast<off_t>(offset_ + done));
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                err_ = { errno, std::system_category() };
+                break;
+            }
+            if (n == 0) {
+                break;
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        return done;
+    }
+
+    inline std::size_t positional_file::size() const noexcept {
+        return _size;
+    }
+
+    inline std::error_code positional_file::refresh() noexcept {
+        struct stat st {};
+        if (::fstat(_fd, &st) != 0) {
+            return { errno, std::system_category() };
+        }
+        _size = static_cast<std::size_t>(st.st_size);
+        return {};
+    }
+
+    inline bool positional_file::is_open() const noexcept {
+        return _fd >= 0;
+    }
+
+    inline void positional_file::close() noexcept {
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+        _fd = -1;
+        _size = 0;
+    }
+
+}
@@ -1,40 +1,195 @@
 /**
  * \file median.hpp
- * \brief Инкрементальный расчёт медианы на основе min-max heap
+ * \brief Инкрементальный расчёт медианы
+ *
+ * Калькулятор параметризован типом цены: double или fixed_price
+ * (int64 в единицах 10^-8). В фиксированной точке структуры сравнивают
+ * целые числа, а середина двух цен округляется так же, как в double,
+ * поэтому результат совпадает байт в байт.
+ *
+ * Хранение значений вынесено в движок (policy):
+ *  - two_heap — две кучи, только вставка, медиана за O(1) (по умолчанию);
+ *  - indexable_skiplist — вставка, удаление и любой квантиль за O(log n);
+ *  - tdigest — приближённая медиана в фиксированной памяти;
+ *  - tick_histogram — счётчики на сетке шага цены, add() за O(1).
  */
 
 #pragma once
 
+#include <algorithm>
+#include <concepts>
 #include <cstdint>
 #include <functional>
-#include <queue>
+#include <new>
+#include <span>
 #include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "histogram.hpp"
+#include "pages.hpp"
+#include "price.hpp"
+#include "sketch.hpp"
+#include "skiplist.hpp"
+#include "state.hpp"
 
 namespace csv_median {
 
+    /**
+     * \brief Движок медианы: хранит значения и отдаёт центральные
+     *
+     * middle() возвращает элементы с рангами (n-1)/2 и n/2.
+     */
+    template<class E>
+    concept median_engine = requires(E e_, const E& ce_, typename E::value_type v_) {
+        e_.insert(v_);
+        { ce_.size() } -> std::convertible_to<std::size_t>;
+        { ce_.middle() } -> std::same_as<std::pair<typename E::value_type,
+            typename E::value_type>>;
+    };
+
+    /**
+     * \brief Движок с удалением и доступом по рангу
+     */
+    template<class E>
+    concept order_statistic_engine = median_engine<E>
+        && requires(E e_, const E& ce_, typename E::value_type v_, std::size_t k_) {
+        { e_.erase(v_) } -> std::same_as<bool>;
+        { ce_.select(k_) } -> std::same_as<typename E::value_type>;
+    };
+
+    /**
+     * \brief Движок, значения которого складываются с другим той же
+     *        конфигурации без исходных записей (shard.hpp)
+     */
+    template<class E>
+    concept mergeable_engine = median_engine<E> && requires(E e_, const E& ce_) {
+        e_.merge(ce_);
+    };
+
+    /**
+     * \brief Две кучи: нижняя половина (max-heap) и верхняя (min-heap)
+     *
+     * Только вставка; центральные элементы — вершины куч. Массивы куч —
+     * в page_allocator (pages.hpp).
+     *
+     * \tparam Alloc аллокатор массивов куч
+     */
+    template<class T, class Alloc = page_allocator<T>>
+    class two_heap {
+    public:
+        using value_type = T;
+
+        /**
+         * \brief Вставить значение
+         *
+         * Строгая гарантия: при std::bad_alloc кучи не меняются.
+         */
+        void insert(T value_);
+
+        /**
+         * \brief Место под n_ значений без перевыделений
+         */
+        void reserve(std::size_t n_);
+
+        [[nodiscard]] std::pair<T, T> middle() const noexcept;
+        [[nodiscard]] std::size_t size() const noexcept;
+
+        /**
+         * \brief Значения обеих куч
+         *
+         * Кучи сортируются на месте: отсортированный массив — тоже куча,
+         * а дельты соседних цен в снимке короткие.
+         */
+        void save(state_writer& out_);
+
+        /**
+         * \brief Восстановить кучи из save()
+         * \return false если снимок повреждён
+         */
+        [[nodiscard]] bool load(state_reader& in_);
+
+    private:
+        using heap_vector = std::vector<T, Alloc>;
+
+        /**
+         * \brief Место ещё под одно значение: ёмкость растёт вдвое
+         */
+        static void reserve_one(heap_vector& heap_);
+
+        /**
+         * \brief Балансировка куч: разница размеров не должна превышать 1.
+         * Инвариант: _lower.size() >= _upper.size()
+         *
+         * Не выделяет память: место зарезервировано в insert().
+         */
+        void balance() noexcept;
+
+        // Нижняя половина значений: max-heap, максимум в front()
+        heap_vector _lower;
+
+        // Верхняя половина значений: min-heap, минимум в front()
+        heap_vector _upper;
+    };
+
     /**
      * \brief Калькулятор инкрементальной медианы
      *
      * Поддерживает добавление значений по одному и
      * возвращает актуальную медиану после каждого добавления.
      * Фиксирует факт изменения медианы для оптимизации записи.
+     *
+     * \tparam T      тип цены: double или fixed_price
+     * \tparam Engine движок хранения значений
      */
-    class calculator {
+    template<class T, median_engine Engine = two_heap<T>>
+    class basic_calculator {
     public:
-        calculator() noexcept = default;
+        using value_type = T;
+        using engine_type = Engine;
+
+        basic_calculator() noexcept = default;
+
+        /**
+         * \brief Калькулятор с заранее настроенным движком
+         */
+        explicit basic_calculator(Engine engine_) noexcept;
 
         /**
          * \brief Добавить новое значение цены
          * \param price_ новое значение для учёта в медиане
+         * \return not_enough_memory — движку не хватило памяти, или ошибка
+         *         движка (value_too_large — у гистограммы кончились
+         *         страницы): значение не учтено, медиана и is_changed() прежние
+         */
+        std::error_code add(T price_) noexcept;
+
+        /**
+         * \brief Удалить одно вхождение значения
+         * \return false если значения нет
+         *
+         * is_changed() и median() относятся к последнему add(): удаления
+         * перед очередным add() учитываются в его сравнении медиан.
          */
-        void add(double price_) noexcept;
+        bool remove(T price_) noexcept
+            requires order_statistic_engine<Engine>;
+
+        /**
+         * \brief Квантиль по ближайшему рангу: элемент с рангом round(q * (n - 1))
+         * \param q_ в диапазоне [0, 1]
+         * \warning Вызов без значений — UB
+         */
+        [[nodiscard]] T quantile(double q_) const noexcept
+            requires order_statistic_engine<Engine>;
 
         /**
          * \brief Получить текущую медиану
          * \return медиана всех добавленных значений
          * \warning Вызов до добавления хотя бы одного значения — UB
          */
-        [[nodiscard]] double median() const noexcept;
+        [[nodiscard]] T median() const noexcept;
 
         /**
          * \brief Проверить, изменилась ли медиана после последнего вызова add()
@@ -42,94 +197,338 @@ namespace csv_median {
          */
         [[nodiscard]] bool is_changed() const noexcept;
 
+        /**
+         * \brief Ключ сравнения медиан после последнего add()
+         *
+         * is_changed() — это неравенство ключей соседних add(). По ключам
+         * сшиваются независимо посчитанные участки ряда (partition.hpp).
+         */
+        [[nodiscard]] T key() const noexcept;
+
         /**
          * \brief Количество добавленных значений
          */
         [[nodiscard]] std::size_t count() const noexcept;
 
+        /**
+         * \brief Подготовить хранение под n_ значений, если движок хранит
+         *        их все (кучи, skip list); иначе ничего не делает
+         * \throws std::bad_alloc
+         */
+        void reserve(std::size_t n_);
+
         /**
          * \brief Есть ли хотя бы одно значение
          */
         [[nodiscard]] bool has_values() const noexcept;
 
-    private:
-        // Нижняя половина значений (максимум наверху)
-        std::priority_queue<double> _lower;
+        /**
+         * \brief Движок хранения значений
+         */
+        [[nodiscard]] const Engine& engine() const noexcept;
 
-        // Верхняя половина значений (минимум наверху)
-        std::priority_queue<double, std::vector<double>, std::greater<double>>
-            _upper;
+        /**
+         * \brief Снимок движка и последней медианы (checkpoint.hpp)
+         */
+        void save(state_writer& out_);
 
-        double      _last_median{ 0.0 };
+        /**
+         * \brief Продолжить с состояния save() калькулятора той же конфигурации
+         * \return false если снимок повреждён
+         */
+        [[nodiscard]] bool load(state_reader& in_);
+
+        /**
+         * \brief Добавить значения калькулятора той же конфигурации
+         *
+         * Медиана и ключ — как после последней записи обоих наборов,
+         * поэтому следующий add() сравнивает с ними.
+         * \return ошибка движка (value_too_large у гистограммы): калькулятор
+         *         не изменён
+         * \throws std::bad_alloc
+         */
+        std::error_code merge(const basic_calculator& other_)
+            requires mergeable_engine<Engine>;
+
+    private:
+        Engine      _engine;
+
+        // Точное значение медианы для сравнения: в фиксированной
+        // точке это удвоенная медиана, чтобы не терять половину единицы
+        T           _last_key{};
+        T           _last_median{};
         bool        _changed{ false };
 
         /**
-         * \brief Балансировка куч: разница размеров не должна превышать 1.
-         * Инвариант: _lower.size() >= _upper.size()
+         * \brief Ключ сравнения по центральным элементам
          */
-        void balance() noexcept;
+        [[nodiscard]] static T compute_key(
+            const std::pair<T, T>& middle_, bool even_) noexcept;
 
         /**
-         * \brief Вычислить медиану из текущего состояния куч
+         * \brief Медиана по центральным элементам
          */
-        [[nodiscard]] double compute_median() const noexcept;
+        [[nodiscard]] static T compute_median(
+            const std::pair<T, T>& middle_, bool even_) noexcept;
     };
 
+    using calculator = basic_calculator<double>;
+    using fixed_calculator = basic_calculator<fixed_price>;
+
+    template<class T>
+    using skiplist_calculator = basic_calculator<T, indexable_skiplist<T>>;
+
+    template<class T>
+    using sketch_calculator = basic_calculator<T, tdigest<T>>;
+
+    template<class T>
+    using histogram_calculator = basic_calculator<T, tick_histogram<T>>;
+
     // ──────────────────────────────────────────────
     // Реализация (inline, т.к. header-only)
     // ──────────────────────────────────────────────
 
-    inline void calculator::add(double price_) noexcept {
+    template<class T, class Alloc>
+    inline void two_heap<T, Alloc>::insert(T value_) {
+        // Вставка и балансировка добавляют не больше одного значения в каждую
+        // кучу: память выделяется до изменения куч, bad_alloc их не ломает
+        reserve_one(_lower);
+        reserve_one(_upper);
+
         // Направляем значение в нужную кучу
-        if (_lower.empty() || price_ <= _lower.top()) {
-            _lower.push(price_);
+        if (_lower.empty() || value_ <= _lower.front()) {
+            _lower.push_back(value_);
+            std::ranges::push_heap(_lower);
         }
         else {
-            _upper.push(price_);
+            _upper.push_back(value_);
+            std::ranges::push_heap(_upper, std::greater<T>{});
         }
 
         balance();
-
-        const double new_median = compute_median();
-        _changed = (new_median != _last_median);
-        _last_median = new_median;
     }
 
-    inline double calculator::median() const noexcept {
-        return _last_median;
+    template<class T, class Alloc>
+    inline void two_heap<T, Alloc>::reserve(std::size_t n_) {
+        // Нижняя куча больше верхней не более чем на одно значение
+        _lower.reserve(n_ / 2 + 1);
+        _upper.reserve(n_ / 2 + 1);
     }
 
-    inline bool calculator::is_changed() const noexcept {
-        return _changed;
+    template<class T, class Alloc>
+    inline void two_heap<T, Alloc>::reserve_one(heap_vector& heap_) {
+        if (heap_.size() == heap_.capacity()) {
+            heap_.reserve(std::max<std::size_t>(16, 2 * heap_.capacity()));
+        }
     }
 
-    inline std::size_t calculator::count() const noexcept {
-        return _lower.size() + _upper.size();
+    template<class T, class Alloc>
+    inline std::pair<T, T> two_heap<T, Alloc>::middle() const noexcept {
+        if (_lower.size() == _upper.size()) {
+            return { _lower.front(), _upper.front() };
+        }
+        return { _lower.front(), _lower.front() };
     }
 
-    inline bool calculator::has_values() const noexcept {
-        return !_lower.empty();
+    template<class T, class Alloc>
+    inline std::size_t two_heap<T, Alloc>::size() const noexcept {
+        return _lower.size() + _upper.size();
     }
 
-    inline void calculator::balance() noexcept {
+    template<class T, class Alloc>
+    inline void two_heap<T, Alloc>::balance() noexcept {
         // Инвариант: _lower.size() == _upper.size() или _lower.size() == _upper.size() + 1
         if (_lower.size() > _upper.size() + 1) {
-            _upper.push(_lower.top());
-            _lower.pop();
+            std::ranges::pop_heap(_lower);
+            _upper.push_back(_lower.back());
+            _lower.pop_back();
+            std::ranges::push_heap(_upper, std::greater<T>{});
         }
         else if (_upper.size() > _lower.size()) {
-            _lower.push(_upper.top());
-            _upper.pop();
+            std::ranges::pop_heap(_upper, std::greater<T>{});
+            _lower.push_back(_upper.back());
+            _upper.pop_back();
+            std::ranges::push_heap(_lower);
         }
     }
 
-    inline double calculator::compute_median() const noexcept {
-        if (_lower.size() == _upper.size()) {
+    template<class T, class Alloc>
+    inline void two_heap<T, Alloc>::save(state_writer& out_) {
+        std::ranges::sort(_lower, std::greater<T>{});
+        std::ranges::sort(_upper);
+        out_.put_values(std::span<const T>{ _lower });
+        out_.put_values(std::span<const T>{ _upper });
+    }
+
+    template<class T, class Alloc>
+    inline bool two_heap<T, Alloc>::load(state_reader& in_) {
+        if (!in_.get_values(_lower) || !in_.get_values(_upper)) {
+            return false;
+        }
+        if (_lower.size() < _upper.size() || _lower.size() > _upper.size() + 1) {
+            return false;
+        }
+        std::ranges::make_heap(_lower);
+        std::ranges::make_heap(_upper, std::greater<T>{});
+        return _upper.empty() || !(_upper.front() < _lower.front());
+    }
+
+    template<class T, median_engine Engine>
+    inline basic_calculator<T, Engine>::basic_calculator(Engine engine_) noexcept
+        : _engine{ std::move(engine_) }
+    {
+    }
+
+    template<class T, median_engine Engine>
+    inline std::error_code basic_calculator<T, Engine>::add(T price_) noexcept {
+        try {
+            if constexpr (std::same_as<decltype(_engine.insert(price_)), std::error_code>) {
+                if (const auto err = _engine.insert(price_)) {
+                    return err;
+                }
+            }
+            else {
+                _engine.insert(price_);
+            }
+        }
+        catch (const std::bad_alloc&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+
+        const auto middle = _engine.middle();
+        const bool even = (_engine.size() % 2 == 0);
+
+        const T new_key = compute_key(middle, even);
+        _changed = (new_key != _last_key);
+        _last_key = new_key;
+        if (_changed) {
+            if constexpr (std::is_floating_point_v<T>) {
+                _last_median = new_key;
+            }
+            else {
+                _last_median = compute_median(middle, even);
+            }
+        }
+        return {};
+    }
+
+    template<class T, median_engine Engine>
+    inline bool basic_calculator<T, Engine>::remove(T price_) noexcept
+        requires order_statistic_engine<Engine>
+    {
+        return _engine.erase(price_);
+    }
+
+    template<class T, median_engine Engine>
+    inline T basic_calculator<T, Engine>::quantile(double q_) const noexcept
+        requires order_statistic_engine<Engine>
+    {
+        const auto last = static_cast<double>(_engine.size() - 1);
+        const auto rank = static_cast<std::size_t>(q_ * last + 0.5);
+        return _engine.select(rank);
+    }
+
+    template<class T, median_engine Engine>
+    inline T basic_calculator<T, Engine>::median() const noexcept {
+        return _last_median;
+    }
+
+    template<class T, median_engine Engine>
+    inline bool basic_calculator<T, Engine>::is_changed() const noexcept {
+        return _changed;
+    }
+
+    template<class T, median_engine Engine>
+    inline T basic_calculator<T, Engine>::key() const noexcept {
+        return _last_key;
+    }
+
+    template<class T, median_engine Engine>
+    inline std::size_t basic_calculator<T, Engine>::count() const noexcept {
+        return _engine.size();
+    }
+
+    template<class T, median_engine Engine>
+    inline void basic_calculator<T, Engine>::reserve(std::size_t n_) {
+        if constexpr (requires { _engine.reserve(n_); }) {
+            _engine.reserve(n_);
+        }
+    }
+
+    template<class T, median_engine Engine>
+    inline bool basic_calculator<T, Engine>::has_values() const noexcept {
+        return _engine.size() > 0;
+    }
+
+    template<class T, median_engine Engine>
+    inline const Engine& basic_calculator<T, Engine>::engine() const noexcept {
+        return _engine;
+    }
+
+    template<class T, median_engine Engine>
+    inline void basic_calculator<T, Engine>::save(state_writer& out_) {
+        _engine.save(out_);
+        out_.put(_last_key);
+        out_.put(_last_median);
+        out_.put(_changed);
+    }
+
+    template<class T, median_engine Engine>
+    inline bool basic_calculator<T, Engine>::load(state_reader& in_) {
+        return _engine.load(in_) && in_.get(_last_key) && in_.get(_last_median)
+            && in_.get(_changed);
+    }
+
+    template<class T, median_engine Engine>
+    inline std::error_code basic_calculator<T, Engine>::merge(const basic_calculator& other_)
+        requires mergeable_engine<Engine>
+    {
+        if constexpr (std::same_as<decltype(_engine.merge(other_._engine)), std::error_code>) {
+            if (const auto err = _engine.merge(other_._engine)) {
+                return err;
+            }
+        }
+        else {
+            _engine.merge(other_._engine);
+        }
+        if (_engine.size() == 0) {
+            return {};
+        }
+        const auto middle = _engine.middle();
+        const bool even = (_engine.size() % 2 == 0);
+        _last_key = compute_key(middle, even);
+        _last_median = compute_median(middle, even);
+        return {};
+    }
+
+    template<class T, median_engine Engine>
+    inline T basic_calculator<T, Engine>::compute_key(
+        const std::pair<T, T>& middle_, bool even_) noexcept
+    {
+        if constexpr (std::is_floating_point_v<T>) {
+            return compute_median(middle_, even_);
+        }
+        else {
+            // Удвоенная медиана: сумма центральных или 2 * центральный
+            return even_ ? middle_.first + middle_.second : middle_.first * 2;
+        }
+    }
+
+    template<class T, median_engine Engine>
+    inline T basic_calculator<T, Engine>::compute_median(
+        const std::pair<T, T>& middle_, bool even_) noexcept
+    {
+        if (even_) {
             // Чётное количество — среднее двух центральных
-            return (_lower.top() + _upper.top()) / 2.0;
+            if constexpr (std::is_floating_point_v<T>) {
+                return (middle_.first + middle_.second) / 2.0;
+            }
+            else {
+                return fixed_midpoint(middle_.first, middle_.second);
+            }
         }
-        // Нечётное — верхний элемент нижней кучи
-        return _lower.top();
+        // Нечётное — нижний из центральных
+        return middle_.first;
     }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,185 @@
+/**
+ * \file merge.hpp
+ * \brief Дерево проигравших (tournament tree) для k-way merge
+ *
+ * Во внутренних узлах хранятся проигравшие сравнения, в корне —
+ * победитель. После того как победитель сменил ключ, перепроигрывается
+ * только путь от его листа к корню: log2(k) сравнений без перестановок
+ * кучи. Ключи (receive_ts источников) лежат в непрерывном массиве рядом
+ * с деревом, поэтому сравнения не обращаются к самим курсорам.
+ *
+ * Порядок — по (ts, индекс источника): при равных ts первым идёт
+ * источник с меньшим индексом, как в min-heap по паре (ts, idx).
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace csv_median {
+
+    /**
+     * \brief Дерево проигравших над k источниками с ключами receive_ts
+     */
+    class loser_tree {
+    public:
+        static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+        /**
+         * \param keys_ начальные ключи источников; все источники активны
+         */
+        explicit loser_tree(std::vector<std::uint64_t> keys_);
+
+        /**
+         * \brief Все источники исчерпаны
+         */
+        [[nodiscard]] bool empty() const noexcept;
+
+        /**
+         * \brief Источник с наименьшим ключом
+         * \warning empty() — UB
+         */
+        [[nodiscard]] std::size_t winner() const noexcept;
+
+        /**
+         * \brief Лучший активный источник кроме победителя
+         *
+         * Ищется среди проигравших на пути победителя — O(log k).
+         * \return индекс или npos, если других активных источников нет
+         */
+        [[nodiscard]] std::size_t runner_up() const noexcept;
+
+        /**
+         * \brief Текущий ключ источника
+         */
+        [[nodiscard]] std::uint64_t key(std::size_t source_) const noexcept;
+
+        /**
+         * \brief Новый ключ победителя и перепроигрывание его пути
+         */
+        void replace(std::uint64_t key_) noexcept;
+
+        /**
+         * \brief Исключить победителя (источник исчерпан)
+         */
+        void pop() noexcept;
+
+        /**
+         * \brief Число активных источников
+         */
+        [[nodiscard]] std::size_t size() const noexcept;
+
+    private:
+        /**
+         * \brief Порядок источников: исчерпанные — после всех активных
+         */
+        [[nodiscard]] bool less(std::size_t a_, std::size_t b_) const noexcept;
+
+        void replay(std::size_t source_) noexcept;
+
+        std::vector<std::uint64_t> _keys;
+        std::vector<std::uint8_t>  _done;
+        std::vector<std::size_t>   _tree;   ///< [0] победитель, [1, k) проигравшие
+        std::size_t                _live;
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline loser_tree::loser_tree(std::vector<std::uint64_t> keys_)
+        : _keys{ std::move(keys_) }
+        , _done(_keys.size(), 0)
+        , _tree(_keys.size(), 0)
+        , _live{ _keys.size() }
+    {
+        const std::size_t k = _keys.size();
+        if (k <= 1) {
+            return;
+        }
+
+        // Узлы 1..k-1 внутренние, листья k..2k-1; победители поднимаются
+        // снизу вверх, в узле остаётся проигравший
+        std::vector<std::size_t> winners(2 * k);
+        for (std::size_t i = 0; i < k; ++i) {
+            winners[k + i] = i;
+        }
+        for (std::size_t node = k - 1; node >= 1; --node) {
+            const std::size_t a = winners[2 * node];
+            const std::size_t b = winners[2 * node + 1];
+            const bool a_wins = less(a, b);
+            winners[node] = a_wins ? a : b;
+            _tree[node] = a_wins ? b : a;
+        }
+        _tree[0] = winners[1];
+    }
+
+    inline bool loser_tree::less(std::size_t a_, std::size_t b_) const noexcept {
+        if (_done[a_] != _done[b_]) {
+            return _done[b_] != 0;
+        }
+        if (_keys[a_] != _keys[b_]) {
+            return _keys[a_] < _keys[b_];
+        }
+        return a_ < b_;
+    }
+
+    inline void loser_tree::replay(std::size_t source_) noexcept {
+        const std::size_t k = _keys.size();
+        std::size_t winner = source_;
+        for (std::size_t node = (k + source_) / 2; node >= 1; node /= 2) {
+            if (less(_tree[node], winner)) {
+                std::swap(_tree[node], winner);
+            }
+        }
+        _tree[0] = winner;
+    }
+
+    inline bool loser_tree::empty() const noexcept {
+        return _live == 0;
+    }
+
+    inline std::size_t loser_tree::winner() const noexcept {
+        return _tree[0];
+    }
+
+    inline std::size_t loser_tree::runner_up() const noexcept {
+        const std::size_t k = _keys.size();
+        const std::size_t winner = _tree[0];
+
+        // Второй по порядку проиграл победителю в одном из узлов его пути
+        std::size_t best = npos;
+        for (std::size_t node = (k + winner) / 2; node >= 1; node /= 2) {
+            const std::size_t loser = _tree[node];
+            if (_done[loser] == 0 && (best == npos || less(loser, best))) {
+                best = loser;
+            }
+        }
+        return best;
+    }
+
+    inline std::uint64_t loser_tree::key(std::size_t source_) const noexcept {
+        return _keys[source_];
+    }
+
+    inline void loser_tree::replace(std::uint64_t key_) noexcept {
+        const std::size_t winner = _tree[0];
+        _keys[winner] = key_;
+        replay(winner);
+    }
+
+    inline void loser_tree::pop() noexcept {
+        const std::size_t winner = _tree[0];
+        _done[winner] = 1;
+        --_live;
+        replay(winner);
+    }
+
+    inline std::size_t loser_tree::size() const noexcept {
+        return _live;
+    }
+
+}
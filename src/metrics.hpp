@@ -0,0 +1,1010 @@
+/**
+ * \file metrics.hpp
+ * \brief Счётчики и задержки стадий расчёта: чтение, разбор, слияние,
+ *        калькулятор, запись
+ *
+ * Горячие пути пишут в блок своего потока (thread_local, relaxed
+ * load + store без lock-префикса); снимок суммирует блоки всех потоков.
+ * Блоки не освобождаются: потоков немного, а снимок учитывает и
+ * завершившиеся (задачи пула, поток записи).
+ *
+ * Замеры времени включает set_metrics_enabled(): без [main].metrics на
+ * горячих путях остаются только сложения счётчиков. Время операции
+ * калькулятора меряется выборочно — каждая k_calc_sample_every-я
+ * запись, — иначе два чтения часов стоили бы дороже самой вставки.
+ * Задержки — гистограммы по степеням двойки наносекунд.
+ *
+ * metrics_reporter пишет строку метрик в лог раз в interval_ms и в
+ * режиме follow отдаёт /metrics в текстовом формате Prometheus;
+ * итог расчёта — JSON (write_metrics_json).
+ *
+ * Строки с ошибкой разбора считаются в file_metrics; в лог по одной
+ * выводятся только первые parse_error_limit() строк файла, иначе
+ * повреждённый файл тратил бы время на форматирование предупреждений.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+#include "options.hpp"
+
+namespace csv_median {
+
+    namespace fs = std::filesystem;
+
+    inline constexpr std::string_view k_metrics_filename = "median_result.metrics.json";
+
+    // Каждая k-я запись калькулятора с замером времени
+    inline constexpr std::uint32_t k_calc_sample_every = 1024;
+
+    // Корзины задержек: [2^(i-1), 2^i) нс, последняя — всё дольше 2^38 нс
+    inline constexpr std::size_t k_latency_buckets = 40;
+
+    /**
+     * \brief Счётчик стадии
+     */
+    enum class counter : std::uint8_t {
+        bytes_read,      ///< байт CSV разобрано
+        records_parsed,  ///< записей разобрано (и прочитано из кэша)
+        records_skipped, ///< строк с ошибкой разбора
+        records_merged,  ///< записей выдано слиянием
+        merge_batches,   ///< пакетов слияния
+        merge_stalls,    ///< ожиданий фрагмента, ещё не разобранного пулом
+        calc_ops,        ///< записей через калькулятор
+        writer_flushes,  ///< буферов результата отдано на запись
+        writer_bytes,    ///< байт в них
+        count_
+    };
+
+    /**
+     * \brief Задержка стадии
+     */
+    enum class latency : std::uint8_t {
+        merge_stall,  ///< ожидание фрагмента слиянием
+        calc_op,      ///< одна вставка в калькулятор (выборочно)
+        writer_flush, ///< запись буфера: write(2) или от постановки до завершения в io_uring
+        count_
+    };
+
+    /**
+     * \brief Глубина очереди: последнее и наибольшее значение
+     */
+    enum class gauge : std::uint8_t {
+        parse_queue, ///< фрагментов курсора в задачах пула
+        write_queue, ///< буферов результата в записи
+        count_
+    };
+
+    inline constexpr std::size_t k_counter_count = static_cast<std::size_t>(counter::count_);
+    inline constexpr std::size_t k_latency_count = static_cast<std::size_t>(latency::count_);
+    inline constexpr std::size_t k_gauge_count = static_cast<std::size_t>(gauge::count_);
+
+    [[nodiscard]] std::string_view metric_name(counter counter_) noexcept;
+    [[nodiscard]] std::string_view metric_name(latency latency_) noexcept;
+    [[nodiscard]] std::string_view metric_name(gauge gauge_) noexcept;
+
+    /**
+     * \brief Замеры времени на горячих путях; счётчики считаются всегда
+     */
+    void set_metrics_enabled(bool enabled_) noexcept;
+
+    [[nodiscard]] bool metrics_enabled() noexcept;
+
+    /**
+     * \brief Строк с ошибкой одного файла, выводимых в лог ([main].parse_error_limit)
+     */
+    void set_parse_error_limit(std::uint64_t limit_) noexcept;
+
+    [[nodiscard]] std::uint64_t parse_error_limit() noexcept;
+
+    /**
+     * \brief Прибавить n_ к счётчику потока
+     */
+    void add_metric(counter counter_, std::uint64_t n_ = 1) noexcept;
+
+    /**
+     * \brief Учесть задержку в гистограмме потока
+     */
+    void record_latency(latency latency_, std::uint64_t ns_) noexcept;
+
+    /**
+     * \brief Текущая глубина очереди
+     */
+    void set_gauge(gauge gauge_, std::uint64_t value_) noexcept;
+
+    /**
+     * \brief Время от создания
+     */
+    class stopwatch {
+    public:
+        stopwatch() noexcept;
+
+        [[nodiscard]] std::uint64_t elapsed_ns() const noexcept;
+
+    private:
+        std::chrono::steady_clock::time_point _start;
+    };
+
+    /**
+     * \brief Выбор записей калькулятора для замера времени
+     */
+    class op_sampler {
+    public:
+        op_sampler() noexcept;
+
+        /**
+         * \brief Мерить ли эту запись
+         */
+        [[nodiscard]] bool due() noexcept;
+
+    private:
+        bool          _enabled;
+        std::uint32_t _n{ 0 };
+    };
+
+    /**
+     * \brief Итоги чтения одного входного файла
+     *
+     * Курсоров файла может быть несколько сразу (участки partitions),
+     * поэтому сложения атомарные; они — раз на пакет, не на запись.
+     */
+    struct file_metrics {
+        fs::path                   path;
+        std::atomic<std::uint64_t> bytes{ 0 };
+        std::atomic<std::uint64_t> records{ 0 };
+        std::atomic<std::uint64_t> skipped{ 0 };
+        std::atomic<std::uint64_t> logged{ 0 };    ///< строк с ошибкой, отданных в лог
+        std::atomic<bool>          muted{ false }; ///< предупреждение о лимите выведено
+
+        void add(std::uint64_t bytes_, std::uint64_t records_, std::uint64_t skipped_) noexcept;
+
+        /**
+         * \brief Сколько из issues_ новых строк с ошибкой вывести в лог
+         * \return первые из них, пока не выведено parse_error_limit() строк файла
+         */
+        [[nodiscard]] std::size_t log_slots(std::size_t issues_) noexcept;
+
+        /**
+         * \brief Один раз на файл предупредить, что остальные строки только считаются
+         */
+        void mute() noexcept;
+    };
+
+    /**
+     * \brief Итоги файла path_; один объект на путь на весь процесс
+     */
+    [[nodiscard]] file_metrics& file_metrics_for(const fs::path& path_) noexcept;
+
+    /**
+     * \brief Гистограмма задержек в снимке
+     */
+    struct latency_summary {
+        std::array<std::uint64_t, k_latency_buckets> buckets{};
+        std::uint64_t                                count{ 0 };
+        std::uint64_t                                sum_ns{ 0 };
+        std::uint64_t                                max_ns{ 0 };
+
+        /**
+         * \brief Верхняя граница корзины квантиля q_ (0..1); 0 — замеров нет
+         */
+        [[nodiscard]] std::uint64_t percentile(double q_) const noexcept;
+
+        /**
+         * \brief Средняя задержка, нс
+         */
+        [[nodiscard]] std::uint64_t mean() const noexcept;
+
+        /**
+         * \brief Замеры после prev_ (max — за всё время)
+         */
+        [[nodiscard]] latency_summary since(const latency_summary& prev_) const noexcept;
+    };
+
+    struct gauge_value {
+        std::uint64_t last{ 0 };
+        std::uint64_t max{ 0 };
+    };
+
+    struct file_summary {
+        std::string   path;
+        std::uint64_t bytes{ 0 };
+        std::uint64_t records{ 0 };
+        std::uint64_t skipped{ 0 };
+    };
+
+    /**
+     * \brief Сумма метрик всех потоков на момент снимка
+     */
+    struct metrics_snapshot {
+        double                                       elapsed_s{ 0 }; ///< от set_metrics_enabled(true)
+        std::array<std::uint64_t, k_counter_count>   counters{};
+        std::array<latency_summary, k_latency_count> latencies{};
+        std::array<gauge_value, k_gauge_count>       gauges{};
+        std::vector<file_summary>                    files;  ///< по имени
+
+        [[nodiscard]] std::uint64_t operator[](counter counter_) const noexcept;
+        [[nodiscard]] const latency_summary& operator[](latency latency_) const noexcept;
+        [[nodiscard]] const gauge_value& operator[](gauge gauge_) const noexcept;
+    };
+
+    /**
+     * \brief Снимок метрик
+     * \throws std::bad_alloc
+     */
+    [[nodiscard]] metrics_snapshot take_metrics_snapshot();
+
+    /**
+     * \brief Строка лога за интервал от prev_ до now_
+     */
+    [[nodiscard]] std::string format_metrics_line(const metrics_snapshot& now_,
+        const metrics_snapshot& prev_);
+
+    /**
+     * \brief Снимок в JSON
+     */
+    [[nodiscard]] std::string metrics_json(const metrics_snapshot& snapshot_);
+
+    /**
+     * \brief Снимок в текстовом формате Prometheus
+     *
+     * Счётчики — csv_median_<имя>_total, файлы — с меткой file,
+     * задержки — гистограммы в секундах.
+     */
+    [[nodiscard]] std::string metrics_prometheus(const metrics_snapshot& snapshot_);
+
+    /**
+     * \brief Записать JSON снимка в path_
+     */
+    [[nodiscard]] std::error_code write_metrics_json(const fs::path& path_,
+        const metrics_snapshot& snapshot_) noexcept;
+
+    /**
+     * \brief Разобрать адрес вида "127.0.0.1:9464" (только IPv4)
+     */
+    [[nodiscard]] bool parse_listen_address(std::string_view value_, sockaddr_in& address_) noexcept;
+
+    /**
+     * \brief Поток периодического лога и HTTP /metrics
+     */
+    class metrics_reporter {
+    public:
+        metrics_reporter() noexcept = default;
+        ~metrics_reporter() noexcept;
+
+        metrics_reporter(const metrics_reporter&) = delete;
+        metrics_reporter& operator=(const metrics_reporter&) = delete;
+
+        /**
+         * \brief Запустить поток; с listen — открыть порт
+         * \return ошибка bind / listen
+         */
+        [[nodiscard]] std::error_code start(const metrics_options& options_) noexcept;
+
+        /**
+         * \brief Остановить поток и закрыть порт
+         */
+        void stop() noexcept;
+
+        /**
+         * \brief Порт /metrics (с портом 0 в listen — выбранный системой)
+         */
+        [[nodiscard]] std::uint16_t port() const noexcept;
+
+    private:
+        void loop() noexcept;
+
+        /**
+         * \brief Ответить на один запрос HTTP
+         */
+        void serve(int fd_) noexcept;
+
+        std::thread   _thread;
+        int           _listen_fd{ -1 };
+        int           _wake[2]{ -1, -1 };
+        std::uint32_t _interval_ms{ 0 };
+        std::uint16_t _port{ 0 };
+    };
+
+    namespace detail {
+
+        /**
+         * \brief Метрики одного потока
+         */
+        struct metric_block {
+            std::array<std::atomic<std::uint64_t>, k_counter_count> counters{};
+            std::array<std::array<std::atomic<std::uint64_t>, k_latency_buckets>,
+                k_latency_count>                                     buckets{};
+            std::array<std::atomic<std::uint64_t>, k_latency_count> sums{};
+            std::array<std::atomic<std::uint64_t>, k_latency_count> maxes{};
+        };
+
+        struct metric_registry {
+            std::mutex                                        mutex;
+            std::deque<metric_block>                          blocks;
+            std::deque<file_metrics>                          files;
+            std::map<fs::path, file_metrics*>                 by_path;
+            std::atomic<bool>                                 enabled{ false };
+            std::atomic<std::uint64_t>                        error_limit{ k_parse_error_limit };
+            std::atomic<std::chrono::steady_clock::rep>       start{
+                std::chrono::steady_clock::now().time_since_epoch().count() };
+            std::array<std::atomic<std::uint64_t>, k_gauge_count> gauge_last{};
+            std::array<std::atomic<std::uint64_t>, k_gauge_count> gauge_max{};
+            metric_block                                      fallback; ///< если блок потока не выделился
+            file_metrics                                      fallback_file;
+        };
+
+        [[nodiscard]] inline metric_registry& registry() noexcept {
+            static metric_registry instance;
+            return instance;
+        }
+
+        [[nodiscard]] metric_block& local_block() noexcept;
+
+        // Один писатель: без атомарного сложения
+        inline void bump(std::atomic<std::uint64_t>& value_, std::uint64_t n_) noexcept {
+            value_.store(value_.load(std::memory_order_relaxed) + n_, std::memory_order_relaxed);
+        }
+
+        inline void raise(std::atomic<std::uint64_t>& max_, std::uint64_t value_) noexcept {
+            std::uint64_t current = max_.load(std::memory_order_relaxed);
+            while (value_ > current
+                && !max_.compare_exchange_weak(current, value_, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        // Верхняя граница корзины i, нс
+        [[nodiscard]] constexpr std::uint64_t bucket_bound(std::size_t i_) noexcept {
+            return std::uint64_t{ 1 } << i_;
+        }
+
+        void append_json_string(std::string& out_, std::string_view value_);
+
+        void append_label_value(std::string& out_, std::string_view value_);
+
+    }
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline std::string_view metric_name(counter counter_) noexcept {
+        constexpr std::array<std::string_view, k_counter_count> names{
+            "bytes_read", "records_parsed", "records_skipped", "records_merged",
+            "merge_batches", "merge_stalls", "calc_ops", "writer_flushes", "writer_bytes" };
+        return names[static_cast<std::size_t>(counter_)];
+    }
+
+    inline std::string_view metric_name(latency latency_) noexcept {
+        constexpr std::array<std::string_view, k_latency_count> names{
+            "merge_stall", "calc_op", "writer_flush" };
+        return names[static_cast<std::size_t>(latency_)];
+    }
+
+    inline std::string_view metric_name(gauge gauge_) noexcept {
+        constexpr std::array<std::string_view, k_gauge_count> names{
+            "parse_queue", "write_queue" };
+        return names[static_cast<std::size_t>(gauge_)];
+    }
+
+    inline void set_metrics_enabled(bool enabled_) noexcept {
+        auto& reg = detail::registry();
+        if (enabled_ && !reg.enabled.load(std::memory_order_relaxed)) {
+            reg.start.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                std::memory_order_relaxed);
+        }
+        reg.enabled.store(enabled_, std::memory_order_relaxed);
+    }
+
+    inline bool metrics_enabled() noexcept {
+        return detail::registry().enabled.load(std::memory_order_relaxed);
+    }
+
+    inline detail::metric_block& detail::local_block() noexcept {
+        thread_local metric_block* const block = [] {
+            auto& reg = registry();
+            try {
+                const std::lock_guard lock{ reg.mutex };
+                return &reg.blocks.emplace_back();
+            }
+            catch (const std::exception&) {
+                return &reg.fallback;
+            }
+        }();
+        return *block;
+    }
+
+    inline void add_metric(counter counter_, std::uint64_t n_) noexcept {
+        detail::bump(detail::local_block().counters[static_cast<std::size_t>(counter_)], n_);
+    }
+
+    inline void record_latency(latency latency_, std::uint64_t ns_) noexcept {
+        auto& block = detail::local_block();
+        const auto index = static_cast<std::size_t>(latency_);
+        const auto bucket = std::min<std::size_t>(
+            static_cast<std::size_t>(std::bit_width(ns_)), k_latency_buckets - 1);
+        detail::bump(block.buckets[index][bucket], 1);
+        detail::bump(block.sums[index], ns_);
+        if (ns_ > block.maxes[index].load(std::memory_order_relaxed)) {
+            block.maxes[index].store(ns_, std::memory_order_relaxed);
+        }
+    }
+
+    inline void set_gauge(gauge gauge_, std::uint64_t value_) noexcept {
+        auto& reg = detail::registry();
+        const auto index = static_cast<std::size_t>(gauge_);
+        reg.gauge_last[index].store(value_, std::memory_order_relaxed);
+        detail::raise(reg.gauge_max[index], value_);
+    }
+
+    inline stopwatch::stopwatch() noexcept
+        : _start{ std::chrono::steady_clock::now() }
+    {
+    }
+
+    inline std::uint64_t stopwatch::elapsed_ns() const noexcept {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - _start).count());
+    }
+
+    inline op_sampler::op_sampler() noexcept
+        : _enabled{ metrics_enabled() }
+    {
+    }
+
+    inline bool op_sampler::due() noexcept {
+        return _enabled && ++_n % k_calc_sample_every == 0;
+    }
+
+    inline void set_parse_error_limit(std::uint64_t limit_) noexcept {
+        detail::registry().error_limit.store(limit_, std::memory_order_relaxed);
+    }
+
+    inline std::uint64_t parse_error_limit() noexcept {
+        return detail::registry().error_limit.load(std::memory_order_relaxed);
+    }
+
+    inline void file_metrics::add(std::uint64_t bytes_, std::uint64_t records_,
+        std::uint64_t skipped_) noexcept
+    {
+        bytes.fetch_add(bytes_, std::memory_order_relaxed);
+        records.fetch_add(records_, std::memory_order_relaxed);
+        if (skipped_ != 0) {
+            skipped.fetch_add(skipped_, std::memory_order_relaxed);
+        }
+    }
+
+    inline std::size_t file_metrics::log_slots(std::size_t issues_) noexcept {
+        const std::uint64_t limit = parse_error_limit();
+        // После лимита — без записи в общую строку кэша
+        if (issues_ == 0 || logged.load(std::memory_order_relaxed) >= limit) {
+            return 0;
+        }
+        const std::uint64_t before = logged.fetch_add(issues_, std::memory_order_relaxed);
+        return before >= limit ? 0
+            : static_cast<std::size_t>(std::min<std::uint64_t>(issues_, limit - before));
+    }
+
+    inline void file_metrics::mute() noexcept {
+        if (!muted.exchange(true, std::memory_order_relaxed)) {
+            spdlog::warn("{}: more than {} invalid lines, the rest are only counted",
+                path.filename().string(), parse_error_limit());
+        }
+    }
+
+    inline file_metrics& file_metrics_for(const fs::path& path_) noexcept {
+        auto& reg = detail::registry();
+        try {
+            const std::lock_guard lock{ reg.mutex };
+            if (const auto it = reg.by_path.find(path_); it != reg.by_path.end()) {
+                return *it->second;
+            }
+            auto& entry = reg.files.emplace_back();
+            entry.path = path_;
+            reg.by_path.emplace(path_, &entry);
+            return entry;
+        }
+        catch (const std::exception&) {
+            return reg.fallback_file;
+        }
+    }
+
+    inline std::uint64_t latency_summary::percentile(double q_) const noexcept {
+        if (count == 0) {
+            return 0;
+        }
+        const auto rank = static_cast<std::uint64_t>(q_ * static_cast<double>(count - 1));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < k_latency_buckets; ++i) {
+            seen += buckets[i];
+            if (seen > rank) {
+                return std::min(detail::bucket_bound(i), max_ns);
+            }
+        }
+        return max_ns;
+    }
+
+    inline std::uint64_t latency_summary::mean() const noexcept {
+        return count == 0 ? 0 : sum_ns / count;
+    }
+
+    inline latency_summary latency_summary::since(const latency_summary& prev_) const noexcept {
+        latency_summary result;
+        for (std::size_t i = 0; i < k_latency_buckets; ++i) {
+            result.buckets[i] = buckets[i] - prev_.buckets[i];
+        }
+        result.count = count - prev_.count;
+        result.sum_ns = sum_ns - prev_.sum_ns;
+        result.max_ns = max_ns;
+        return result;
+    }
+
+    inline std::uint64_t metrics_snapshot::operator[](counter counter_) const noexcept {
+        return counters[static_cast<std::size_t>(counter_)];
+    }
+
+    inline const latency_summary& metrics_snapshot::operator[](latency latency_) const noexcept {
+        return latencies[static_cast<std::size_t>(latency_)];
+    }
+
+    inline const gauge_value& metrics_snapshot::operator[](gauge gauge_) const noexcept {
+        return gauges[static_cast<std::size_t>(gauge_)];
+    }
+
+    inline metrics_snapshot take_metrics_snapshot() {
+        auto& reg = detail::registry();
+        metrics_snapshot result;
+        const std::chrono::steady_clock::duration since_start{
+            std::chrono::steady_clock::now().time_since_epoch().count()
+            - reg.start.load(std::memory_order_relaxed) };
+        result.elapsed_s = std::chrono::duration<double>(since_start).count();
+
+        const std::lock_guard lock{ reg.mutex };
+        const auto sum_block = [&result](const detail::metric_block& block_) {
+            for (std::size_t i = 0; i < k_counter_count; ++i) {
+                result.counters[i] += block_.counters[i].load(std::memory_order_relaxed);
+            }
+            for (std::size_t l = 0; l < k_latency_count; ++l) {
+                auto& summary = result.latencies[l];
+                for (std::size_t b = 0; b < k_latency_buckets; ++b) {
+                    const auto n = block_.buckets[l][b].load(std::memory_order_relaxed);
+                    summary.buckets[b] += n;
+                    summary.count += n;
+                }
+                summary.sum_ns += block_.sums[l].load(std::memory_order_relaxed);
+                summary.max_ns = std::max(summary.max_ns,
+                    block_.maxes[l].load(std::memory_order_relaxed));
+            }
+            };
+        for (const auto& block : reg.blocks) {
+            sum_block(block);
+        }
+        sum_block(reg.fallback);
+
+        for (std::size_t i = 0; i < k_gauge_count; ++i) {
+            result.gauges[i] = { reg.gauge_last[i].load(std::memory_order_relaxed),
+                reg.gauge_max[i].load(std::memory_order_relaxed) };
+        }
+
+        result.files.reserve(reg.by_path.size());
+        for (const auto& [path, entry] : reg.by_path) {
+            result.files.push_back({ path.string(), entry->bytes.load(std::memory_order_relaxed),
+                entry->records.load(std::memory_order_relaxed),
+                entry->skipped.load(std::memory_order_relaxed) });
+        }
+        return result;
+    }
+
+    inline std::string format_metrics_line(const metrics_snapshot& now_,
+        const metrics_snapshot& prev_)
+    {
+        const double interval = std::max(now_.elapsed_s - prev_.elapsed_s, 1e-9);
+        const auto delta = [&](counter counter_) {
+            return now_[counter_] - prev_[counter_];
+        };
+        const auto stalls = now_[latency::merge_stall].since(prev_[latency::merge_stall]);
+        const auto calc = now_[latency::calc_op].since(prev_[latency::calc_op]);
+        const auto flush = now_[latency::writer_flush].since(prev_[latency::writer_flush]);
+        const auto& parse_queue = now_[gauge::parse_queue];
+        const auto& write_queue = now_[gauge::write_queue];
+
+        return std::format("metrics: read {:.1f} MB ({:.1f} MB/s), parsed {} ({:.0f}/s), "
+            "skipped {}, merged {} in {} batches, stalls {} ({:.1f} ms), "
+            "calc {} ns/op, flush {} x p50 {} us p99 {} us, "
+            "queues parse {}/{} write {}/{}",
+            static_cast<double>(now_[counter::bytes_read]) / (1 << 20),
+            static_cast<double>(delta(counter::bytes_read)) / (1 << 20) / interval,
+            now_[counter::records_parsed],
+            static_cast<double>(delta(counter::records_parsed)) / interval,
+            now_[counter::records_skipped],
+            now_[counter::records_merged], now_[counter::merge_batches],
+            delta(counter::merge_stalls), static_cast<double>(stalls.sum_ns) / 1e6,
+            calc.mean(),
+            delta(counter::writer_flushes), flush.percentile(0.5) / 1000, flush.percentile(0.99) / 1000,
+            parse_queue.last, parse_queue.max, write_queue.last, write_queue.max);
+    }
+
+    inline void detail::append_json_string(std::string& out_, std::string_view value_) {
+        out_ += '"';
+        for (const char c : value_) {
+            switch (c) {
+            case '"': out_ += "\\\""; break;
+            case '\\': out_ += "\\\\"; break;
+            case '\n': out_ += "\\n"; break;
+            case '\t': out_ += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out_ += std::format("\\u{:04x}", static_cast<unsigned>(c));
+                }
+                else {
+                    out_ += c;
+                }
+            }
+        }
+        out_ += '"';
+    }
+
+    inline void detail::append_label_value(std::string& out_, std::string_view value_) {
+        out_ += '"';
+        for (const char c : value_) {
+            switch (c) {
+            case '"': out_ += "\\\""; break;
+            case '\\': out_ += "\\\\"; break;
+            case '\n': out_ += "\\n"; break;
+            default: out_ += c;
+            }
+        }
+        out_ += '"';
+    }
+
+    inline std::string metrics_json(const metrics_snapshot& snapshot_) {
+        std::string out = std::format("{{\n  \"elapsed_seconds\": {:.3f},\n  \"counters\": {{",
+            snapshot_.elapsed_s);
+        for (std::size_t i = 0; i < k_counter_count; ++i) {
+            out += std::format("{}\n    \"{}\": {}", i == 0 ? "" : ",",
+                metric_name(static_cast<counter>(i)), snapshot_.counters[i]);
+        }
+
+        out += "\n  },\n  \"gauges\": {";
+        for (std::size_t i = 0; i < k_gauge_count; ++i) {
+            out += std::format("{}\n    \"{}\": {{ \"last\": {}, \"max\": {} }}", i == 0 ? "" : ",",
+                metric_name(static_cast<gauge>(i)), snapshot_.gauges[i].last, snapshot_.gauges[i].max);
+        }
+
+        out += "\n  },\n  \"latency_ns\": {";
+        for (std::size_t i = 0; i < k_latency_count; ++i) {
+            const auto& summary = snapshot_.latencies[i];
+            out += std::format("{}\n    \"{}\": {{ \"count\": {}, \"mean\": {}, \"p50\": {}, "
+                "\"p90\": {}, \"p99\": {}, \"max\": {}, \"buckets\": [",
+                i == 0 ? "" : ",", metric_name(static_cast<latency>(i)), summary.count,
+                summary.mean(), summary.percentile(0.5), summary.percentile(0.9),
+                summary.percentile(0.99), summary.max_ns);
+            // Корзины до последней непустой: [граница, число]
+            std::size_t used = k_latency_buckets;
+            while (used > 0 && summary.buckets[used - 1] == 0) {
+                --used;
+            }
+            for (std::size_t b = 0; b < used; ++b) {
+                out += std::format("{}[{}, {}]", b == 0 ? "" : ", ",
+                    detail::bucket_bound(b), summary.buckets[b]);
+            }
+            out += "] }";
+        }
+
+        out += "\n  },\n  \"files\": [";
+        for (std::size_t i = 0; i < snapshot_.files.size(); ++i) {
+            const auto& file = snapshot_.files[i];
+            out += i == 0 ? "\n    { \"path\": " : ",\n    { \"path\": ";
+            detail::append_json_string(out, file.path);
+            out += std::format(", \"bytes\": {}, \"records\": {}, \"skipped\": {} }}",
+                file.bytes, file.records, file.skipped);
+        }
+        out += snapshot_.files.empty() ? "]\n}\n" : "\n  ]\n}\n";
+        return out;
+    }
+
+    inline std::string metrics_prometheus(const metrics_snapshot& snapshot_) {
+        std::string out;
+        for (std::size_t i = 0; i < k_counter_count; ++i) {
+            const auto name = metric_name(static_cast<counter>(i));
+            out += std::format("# TYPE csv_median_{}_total counter\ncsv_median_{}_total {}\n",
+                name, name, snapshot_.counters[i]);
+        }
+
+        for (std::size_t i = 0; i < k_gauge_count; ++i) {
+            const auto name = metric_name(static_cast<gauge>(i));
+            out += std::format("# TYPE csv_median_{}_depth gauge\ncsv_median_{}_depth {}\n"
+                "# TYPE csv_median_{}_depth_max gauge\ncsv_median_{}_depth_max {}\n",
+                name, name, snapshot_.gauges[i].last, name, name, snapshot_.gauges[i].max);
+        }
+
+        for (std::size_t i = 0; i < k_latency_count; ++i) {
+            const auto name = metric_name(static_cast<latency>(i));
+            const auto& summary = snapshot_.latencies[i];
+            out += std::format("# TYPE csv_median_{}_seconds histogram\n", name);
+            std::uint64_t cumulative = 0;
+            for (std::size_t b = 0; b + 1 < k_latency_buckets; ++b) {
+                cumulative += summary.buckets[b];
+                out += std::format("csv_median_{}_seconds_bucket{{le=\"{:g}\"}} {}\n",
+                    name, static_cast<double>(detail::bucket_bound(b)) / 1e9, cumulative);
+            }
+            out += std::format("csv_median_{}_seconds_bucket{{le=\"+Inf\"}} {}\n"
+                "csv_median_{}_seconds_sum {:g}\ncsv_median_{}_seconds_count {}\n",
+                name, summary.count, name, static_cast<double>(summary.sum_ns) / 1e9,
+                name, summary.count);
+        }
+
+        const struct {
+            std::string_view name;
+            std::uint64_t file_summary::* field;
+        } file_fields[] = {
+            { "file_bytes", &file_summary::bytes },
+            { "file_records", &file_summary::records },
+            { "file_skipped", &file_summary::skipped },
+        };
+        for (const auto& field : file_fields) {
+            out += std::format("# TYPE csv_median_{}_total counter\n", field.name);
+            for (const auto& file : snapshot_.files) {
+                out += std::format("csv_median_{}_total{{file=", field.name);
+                detail::append_label_value(out, file.path);
+                out += std::format("}} {}\n", file.*field.field);
+            }
+        }
+        return out;
+    }
+
+    inline std::error_code write_metrics_json(const fs::path& path_,
+        const metrics_snapshot& snapshot_) noexcept
+    {
+        std::string json;
+        try {
+            json = metrics_json(snapshot_);
+        }
+        catch (const std::exception&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+
+        const int fd = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return { errno, std::system_category() };
+        }
+        std::error_code err;
+        for (std::size_t done = 0; done < json.size(); ) {
+            const auto n = ::write(fd, json.data() + done, json.size() - done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                err = { errno, std::system_category() };
+                break;
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        if (::close(fd) != 0 && !err) {
+            err = { errno, std::system_category() };
+        }
+        return err;
+    }
+
+    inline bool parse_listen_address(std::string_view value_, sockaddr_in& address_) noexcept {
+        const auto colon = value_.rfind(':');
+        if (colon == std::string_view::npos || colon == 0 || colon + 1 == value_.size()
+            || colon >= INET_ADDRSTRLEN)
+        {
+            return false;
+        }
+
+        char host[INET_ADDRSTRLEN]{};
+        std::memcpy(host, value_.data(), colon);
+        std::uint32_t port = 0;
+        for (const char c : value_.substr(colon + 1)) {
+            if (c < '0' || c > '9' || (port = port * 10 + static_cast<std::uint32_t>(c - '0')) > 65535) {
+                return false;
+            }
+        }
+
+        address_ = {};
+        address_.sin_family = AF_INET;
+        address_.sin_port = htons(static_cast<std::uint16_t>(port));
+        return ::inet_pton(AF_INET, host, &address_.sin_addr) == 1;
+    }
+
+    inline metrics_reporter::~metrics_reporter() noexcept {
+        stop();
+    }
+
+    inline std::error_code metrics_reporter::start(const metrics_options& options_) noexcept {
+        _interval_ms = options_.interval_ms;
+
+        if (!options_.listen.empty()) {
+            sockaddr_in address{};
+            if (!parse_listen_address(options_.listen, address)) {
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+            _listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (_listen_fd < 0) {
+                return { errno, std::system_category() };
+            }
+            const int reuse = 1;
+            static_cast<void>(::setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)));
+            socklen_t size = sizeof(address);
+            if (::bind(_listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+                || ::listen(_listen_fd, 16) != 0
+                || ::getsockname(_listen_fd, reinterpret_cast<sockaddr*>(&address), &size) != 0)
+            {
+                const std::error_code err{ errno, std::system_category() };
+                ::close(_listen_fd);
+                _listen_fd = -1;
+                return err;
+            }
+            _port = ntohs(address.sin_port);
+        }
+
+        if (_interval_ms == 0 && _listen_fd < 0) {
+            return {};
+        }
+        if (::pipe2(_wake, O_CLOEXEC) != 0) {
+            const std::error_code err{ errno, std::system_category() };
+            stop();
+            return err;
+        }
+        try {
+            _thread = std::thread{ [this] { loop(); } };
+        }
+        catch (const std::system_error& e) {
+            stop();
+            return e.code();
+        }
+        return {};
+    }
+
+    inline void metrics_reporter::stop() noexcept {
+        if (_thread.joinable()) {
+            const char byte = 0;
+            static_cast<void>(::write(_wake[1], &byte, 1));
+            _thread.join();
+        }
+        for (int& fd : _wake) {
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        if (_listen_fd >= 0) {
+            ::close(_listen_fd);
+            _listen_fd = -1;
+        }
+    }
+
+    inline std::uint16_t metrics_reporter::port() const noexcept {
+        return _port;
+    }
+
+    inline void metrics_reporter::loop() noexcept {
+        using clock = std::chrono::steady_clock;
+        const std::chrono::milliseconds interval{ _interval_ms };
+        auto next_log = clock::now() + interval;
+        metrics_snapshot prev;
+        try {
+            prev = take_metrics_snapshot();
+        }
+        catch (const std::exception&) {
+        }
+
+        pollfd fds[2] = { { _wake[0], POLLIN, 0 }, { _listen_fd, POLLIN, 0 } };
+        const nfds_t count = _listen_fd >= 0 ? 2 : 1;
+        while (true) {
+            int timeout = -1;
+            if (_interval_ms != 0) {
+                const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    next_log - clock::now()).count();
+                timeout = static_cast<int>(std::max<std::int64_t>(left, 0));
+            }
+            if (::poll(fds, count, timeout) < 0 && errno != EINTR) {
+                spdlog::warn("metrics: poll failed: {}", std::strerror(errno));
+                return;
+            }
+            if (fds[0].revents != 0) {
+                return;
+            }
+            if (count == 2 && (fds[1].revents & POLLIN) != 0) {
+                if (const int client = ::accept4(_listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+                    client >= 0)
+                {
+                    serve(client);
+                    ::close(client);
+                }
+            }
+            if (_interval_ms != 0 && clock::now() >= next_log) {
+                try {
+                    auto now = take_metrics_snapshot();
+                    spdlog::info("{}", format_metrics_line(now, prev));
+                    prev = std::move(now);
+                }
+                catch (const std::exception&) {
+                }
+                next_log += interval;
+            }
+        }
+    }
+
+    inline void metrics_reporter::serve(int fd_) noexcept {
+        // Медленный клиент не должен задерживать строку лога
+        const timeval timeout{ 1, 0 };
+        static_cast<void>(::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)));
+        static_cast<void>(::setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)));
+
+        char request[4096];
+        std::size_t size = 0;
+        while (size < sizeof(request)) {
+            const auto n = ::recv(fd_, request + size, sizeof(request) - size, 0);
+            if (n <= 0) {
+                break;
+            }
+            size += static_cast<std::size_t>(n);
+            if (std::string_view{ request, size }.find("\r\n\r\n") != std::string_view::npos) {
+                break;
+            }
+        }
+
+        const std::string_view line{ request, size };
+        std::string response;
+        try {
+            if (line.starts_with("GET /metrics ") || line.starts_with("GET /metrics?")) {
+                const auto body = metrics_prometheus(take_metrics_snapshot());
+                response = std::format("HTTP/1.0 200 OK\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Content-Length: {}\r\nConnection: close\r\n\r\n{}", body.size(), body);
+            }
+            else {
+                response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            }
+        }
+        catch (const std::exception&) {
+            response = "HTTP/1.0 500 Internal Server Error\r\nContent-Length: 0\r\n"
+                "Connection: close\r\n\r\n";
+        }
+
+        // MSG_NOSIGNAL: закрытый клиентом сокет не должен завершать процесс
+        std::size_t sent = 0;
+        while (sent < response.size()) {
+            const auto n = ::send(fd_, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            sent += static_cast<std::size_t>(n);
+        }
+    }
+
+}
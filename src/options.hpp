@@ -0,0 +1,382 @@
+/**
+ * \file options.hpp
+ * \brief Режимы работы, общие для конфигурации и компонентов
+ *
+ * Вынесены отдельно, чтобы parser.hpp не зависел от reader/writer,
+ * а компоненты — от toml++ и Boost.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace csv_median {
+
+    /**
+     * \brief Способ чтения входных файлов
+     */
+    enum class read_mode {
+        stream, ///< std::ifstream построчно (работает для любых файлов)
+        mmap,   ///< отображение файла в память, без копирования строк
+        uring   ///< io_uring: несколько больших чтений в полёте (Linux)
+    };
+
+    /**
+     * \brief Разобрать значение [main].read_mode
+     * \return режим или nullopt для неизвестного значения
+     */
+    [[nodiscard]] inline std::optional<read_mode>
+        to_read_mode(std::string_view value_) noexcept
+    {
+        if (value_ == "stream") { return read_mode::stream; }
+        if (value_ == "mmap") { return read_mode::mmap; }
+        if (value_ == "uring") { return read_mode::uring; }
+        return std::nullopt;
+    }
+
+    /**
+     * \brief Представление цен в расчёте
+     */
+    enum class price_mode {
+        floating, ///< double, как в исходных данных
+        fixed     ///< int64 в единицах 10^-8 от разбора до записи
+    };
+
+    /**
+     * \brief Разобрать значение [main].price_mode ('double' или 'fixed')
+     * \return режим или nullopt для неизвестного значения
+     */
+    [[nodiscard]] inline std::optional<price_mode>
+        to_price_mode(std::string_view value_) noexcept
+    {
+        if (value_ == "double") { return price_mode::floating; }
+        if (value_ == "fixed") { return price_mode::fixed; }
+        return std::nullopt;
+    }
+
+    /**
+     * \brief Движок хранения значений калькулятора медианы
+     */
+    enum class median_backend {
+        heap,     ///< две кучи, только вставка
+        skiplist, ///< индексируемый skip list: удаление и квантили за O(log n)
+        tdigest,  ///< t-digest: приближённая медиана в фиксированной памяти
+        histogram ///< счётчики на сетке шага цены: add() за O(1), удаление
+    };
+
+    // Ошибка ранга медианы tdigest по умолчанию (доля от числа значений)
+    inline constexpr double k_default_sketch_error = 0.01;
+
+    /**
+     * \brief Разобрать значение [main].median_backend
+     * \return движок или nullopt для неизвестного значения
+     */
+    [[nodiscard]] inline std::optional<median_backend>
+        to_median_backend(std::string_view value_) noexcept
+    {
+        if (value_ == "heap") { return median_backend::heap; }
+        if (value_ == "skiplist") { return median_backend::skiplist; }
+        if (value_ == "tdigest") { return median_backend::tdigest; }
+        if (value_ == "histogram") { return median_backend::histogram; }
+        return std::nullopt;
+    }
+
+    /**
+     * \brief Способ записи результата
+     */
+    enum class write_mode {
+        sync,  ///< write(2) в потоке расчёта
+        async, ///< отдельный поток записи, буферы через SPSC очередь
+        uring  ///< io_uring: несколько записей в полёте без потока (Linux)
+    };
+
+    /**
+     * \brief Разобрать значение [main].write_mode
+     * \return режим или nullopt для неизвестного значения
+     */
+    [[nodiscard]] inline std::optional<write_mode>
+        to_write_mode(std::string_view value_) noexcept
+    {
+        if (value_ == "sync") { return write_mode::sync; }
+        if (value_ == "async") { return write_mode::async; }
+        if (value_ == "uring") { return write_mode::uring; }
+        return std::nullopt;
+    }
+
+    // Число буферов асинхронной записи результатов по умолчанию
+    inline constexpr std::size_t k_default_write_buffers = 4;
+
+    // Верхняя граница [main].write_buffers (буфер — 1 МБ)
+    inline constexpr std::size_t k_max_write_buffers = 1024;
+
+    /**
+     * \brief Страницы больших массивов калькулятора (pages.hpp)
+     */
+    enum class huge_pages {
+        off,    ///< обычные страницы 4 КБ
+        thp,    ///< madvise(MADV_HUGEPAGE): transparent huge pages
+        hugetlb ///< MAP_HUGETLB из пула vm.nr_hugepages, иначе thp
+    };
+
+    /**
+     * \brief Разобрать значение [main].huge_pages
+     * \return режим или nullopt для неизвестного значения
+     */
+    [[nodiscard]] inline std::optional<huge_pages>
+        to_huge_pages(std::string_view value_) noexcept
+    {
+        if (value_ == "off") { return huge_pages::off; }
+        if (value_ == "thp") { return huge_pages::thp; }
+        if (value_ == "hugetlb") { return huge_pages::hugetlb; }
+        return std::nullopt;
+    }
+
+    /**
+     * \brief Формат файла результата
+     */
+    enum class output_format {
+        csv,      ///< median_result.csv: строки "receive_ts;price_median"
+        columnar  ///< median_result.col: колонки дельтами (columnar.hpp)
+    };
+
+    /**
+     * \brief Разобрать значение [main].output_format
+     * \return формат или nullopt для неизвестного значения
+     */
+    [[nodiscard]] inline std::optional<output_format>
+        to_output_format(std::string_view value_) noexcept
+    {
+        if (value_ == "csv") { return output_format::csv; }
+        if (value_ == "columnar") { return output_format::columnar; }
+        return std::nullopt;
+    }
+
+    /**
+     * \brief Разбиение записей на группы со своей медианой и своим файлом
+     */
+    enum class group_mode {
+        none,   ///< все записи — одна медиана
+        mask,   ///< по маске filename_mask, под которую попал файл
+        column  ///< по значению колонки group_column (например, side)
+    };
+
+    /**
+     * \brief Разобрать значение [main].group_by ('none', 'mask' или 'column')
+     * \return режим или nullopt для неизвестного значения
+     */
+    [[nodiscard]] inline std::optional<group_mode>
+        to_group_mode(std::string_view value_) noexcept
+    {
+        if (value_ == "none") { return group_mode::none; }
+        if (value_ == "mask") { return group_mode::mask; }
+        if (value_ == "column") { return group_mode::column; }
+        return std::nullopt;
+    }
+
+    /**
+     * \brief Роль процесса в расчёте несколькими узлами (shard.hpp)
+     */
+    enum class shard_mode {
+        none,    ///< обычный расчёт
+        partial, ///< посчитать свою часть входа и сохранить состояние median_result.part
+        merge    ///< слить состояния частей shard_inputs без исходных CSV
+    };
+
+    /**
+     * \brief Разобрать значение [main].shard_mode ('none', 'partial' или 'merge')
+     * \return режим или nullopt для неизвестного значения
+     */
+    [[nodiscard]] inline std::optional<shard_mode>
+        to_shard_mode(std::string_view value_) noexcept
+    {
+        if (value_ == "none") { return shard_mode::none; }
+        if (value_ == "partial") { return shard_mode::partial; }
+        if (value_ == "merge") { return shard_mode::merge; }
+        return std::nullopt;
+    }
+
+    /**
+     * \brief Статистика, которая выводится колонкой после медианы
+     */
+    enum class statistic_kind : std::uint8_t {
+        quantile, ///< pNN: квантиль по ближайшему рангу
+        vwap,     ///< средняя цена, взвешенная по quantity
+        mean,     ///< среднее цен
+        stddev    ///< стандартное отклонение цен (по всем значениям, не выборочное)
+    };
+
+    /**
+     * \brief Одна колонка [main].statistics
+     */
+    struct statistic {
+        statistic_kind kind{ statistic_kind::quantile };
+        std::uint8_t   percent{ 0 }; ///< для quantile: 1..99
+
+        [[nodiscard]] bool operator==(const statistic&) const noexcept = default;
+    };
+
+    /**
+     * \brief Разобрать элемент [main].statistics: 'p01'..'p99', 'vwap',
+     * 'mean' или 'stddev'
+     * \return статистика или nullopt для неизвестного значения
+     */
+    [[nodiscard]] inline std::optional<statistic>
+        to_statistic(std::string_view value_) noexcept
+    {
+        if (value_ == "vwap") { return statistic{ statistic_kind::vwap }; }
+        if (value_ == "mean") { return statistic{ statistic_kind::mean }; }
+        if (value_ == "stddev") { return statistic{ statistic_kind::stddev }; }
+        if (value_.size() == 3 && value_[0] == 'p'
+            && value_[1] >= '0' && value_[1] <= '9' && value_[2] >= '0' && value_[2] <= '9')
+        {
+            const auto percent = static_cast<std::uint8_t>((value_[1] - '0') * 10 + (value_[2] - '0'));
+            if (percent != 0) {
+                return statistic{ statistic_kind::quantile, percent };
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * \brief Имя колонки статистики в заголовке результата
+     */
+    [[nodiscard]] inline std::string statistic_name(const statistic& stat_) {
+        switch (stat_.kind) {
+        case statistic_kind::vwap:   return "vwap";
+        case statistic_kind::mean:   return "mean";
+        case statistic_kind::stddev: return "stddev";
+        case statistic_kind::quantile:
+            break;
+        }
+        return { 'p', static_cast<char>('0' + stat_.percent / 10),
+            static_cast<char>('0' + stat_.percent % 10) };
+    }
+
+    /**
+     * \brief Формат сжатия: входных файлов и блоков колоночного вывода
+     */
+    enum class compression : std::uint8_t {
+        none,
+        gzip,   ///< .gz
+        zstd,   ///< .zst
+        lz4     ///< .lz4 (LZ4 frame)
+    };
+
+    /**
+     * \brief Кодек собран в программу (CSV_MEDIAN_HAS_ZLIB / _ZSTD / _LZ4)
+     */
+    [[nodiscard]] bool compression_supported(compression codec_) noexcept;
+
+    [[nodiscard]] std::string_view compression_name(compression codec_) noexcept;
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline bool compression_supported(compression codec_) noexcept {
+        switch (codec_) {
+        case compression::none:
+            return true;
+        case compression::gzip:
+#if defined(CSV_MEDIAN_HAS_ZLIB)
+            return true;
+#else
+            return false;
+#endif
+        case compression::zstd:
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+            return true;
+#else
+            return false;
+#endif
+        case compression::lz4:
+#if defined(CSV_MEDIAN_HAS_LZ4)
+            return true;
+#else
+            return false;
+#endif
+        }
+        return false;
+    }
+
+    inline std::string_view compression_name(compression codec_) noexcept {
+        switch (codec_) {
+        case compression::none: return "none";
+        case compression::gzip: return "gzip";
+        case compression::zstd: return "zstd";
+        case compression::lz4:  return "lz4";
+        }
+        return "unknown";
+    }
+
+    // Записей между точками сохраняемого индекса по умолчанию
+    inline constexpr std::size_t k_index_every_records = 64 * 1024;
+
+    /**
+     * \brief Шаг точек сохраняемого индекса
+     *
+     * Точка ставится, как только с прошлой набралось every_records
+     * записей или receive_ts ушёл вперёд на every_us (0 — только по
+     * записям).
+     */
+    struct index_options {
+        std::size_t   every_records{ k_index_every_records };
+        std::uint64_t every_us{ 0 };
+    };
+
+    // Ожидание изменений в follow без inotify и между проверками остановки
+    inline constexpr std::uint32_t k_follow_poll_ms = 100;
+
+    // Допустимое отставание файла в follow по умолчанию: с 0 дочитанный
+    // файл, запись в который чуть запоздала, теряет её как опоздавшую
+    inline constexpr std::uint64_t k_follow_lateness_us = 5000;
+
+    /**
+     * \brief Чтение дописываемых файлов ([main].follow)
+     *
+     * Запись выдаётся, когда её receive_ts не позже самого свежего
+     * receive_ts всех файлов минус lateness_us — на столько один файл
+     * может отставать от другого. Более поздние записи старше уже
+     * выданных отбрасываются.
+     */
+    struct follow_options {
+        std::uint64_t lateness_us{ k_follow_lateness_us };
+        std::uint32_t poll_ms{ k_follow_poll_ms };
+    };
+
+    // Период строки метрик в логе по умолчанию
+    inline constexpr std::uint32_t k_metrics_interval_ms = 10'000;
+
+    // Строк с ошибкой разбора одного файла, выводимых в лог по одной
+    inline constexpr std::uint64_t k_parse_error_limit = 100;
+
+    /**
+     * \brief Метрики стадий расчёта ([main].metrics, metrics.hpp)
+     */
+    struct metrics_options {
+        bool          enabled{ false };
+        std::uint32_t interval_ms{ k_metrics_interval_ms }; ///< 0 — без строки в логе
+        std::string   listen;  ///< адрес:порт Prometheus в follow; пусто — без него
+    };
+
+    /**
+     * \brief Полуинтервал receive_ts [from, to)
+     */
+    struct ts_range {
+        std::uint64_t from{ 0 };
+        std::uint64_t to{ std::numeric_limits<std::uint64_t>::max() };
+
+        /**
+         * \brief Диапазон без ограничений
+         */
+        [[nodiscard]] bool whole() const noexcept {
+            return from == 0 && to == std::numeric_limits<std::uint64_t>::max();
+        }
+    };
+
+}
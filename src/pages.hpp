@@ -0,0 +1,169 @@
+/**
+ * \file pages.hpp
+ * \brief Аллокатор больших массивов калькулятора страницами, в том числе huge pages
+ *
+ * Кучи и пул узлов skip list держат все цены расчёта — сотни МБ,
+ * и обращения к ним случайны: на страницах 4 КБ почти каждое промахивается
+ * мимо TLB. Блоки от k_huge_page_size отображаются mmap отдельно,
+ * с выравниванием на 2 МБ:
+ *  - huge_pages::thp — madvise(MADV_HUGEPAGE), ядро собирает
+ *    transparent huge pages (режим THP "madvise" или "always");
+ *  - huge_pages::hugetlb — MAP_HUGETLB из зарезервированного пула
+ *    (vm.nr_hugepages); если он пуст — как thp;
+ *  - huge_pages::off — обычные страницы, но всё так же отдельным mmap.
+ *
+ * Не тронутые страницы отображения не занимают RSS, поэтому резерв
+ * под оценку числа записей (csv_reader::estimate_records) с запасом
+ * стоит только адресного пространства, а вектор не перевыделяется
+ * с копированием посреди расчёта. Меньшие блоки — обычный operator new.
+ *
+ * Аллокатор без состояния; режим общий для процесса (set_huge_pages)
+ * и не влияет на освобождение: оно зависит только от размера блока.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <sys/mman.h>
+
+#include <spdlog/spdlog.h>
+
+#include "options.hpp"
+
+namespace csv_median {
+
+    // Размер huge page на x86-64 и aarch64 с 4 КБ страницами
+    inline constexpr std::size_t k_huge_page_size = 2 * 1024 * 1024;
+
+    /**
+     * \brief Режим страниц для последующих больших блоков page_allocator
+     */
+    void set_huge_pages(huge_pages mode_) noexcept;
+
+    [[nodiscard]] huge_pages current_huge_pages() noexcept;
+
+    /**
+     * \brief Аллокатор: блоки от k_huge_page_size — отдельным mmap по 2 МБ
+     */
+    template<class T>
+    class page_allocator {
+    public:
+        using value_type = T;
+        using is_always_equal = std::true_type;
+
+        page_allocator() noexcept = default;
+
+        template<class U>
+        page_allocator(const page_allocator<U>&) noexcept {}
+
+        [[nodiscard]] T* allocate(std::size_t n_);
+        void deallocate(T* p_, std::size_t n_) noexcept;
+
+        template<class U>
+        friend bool operator==(const page_allocator&, const page_allocator<U>&) noexcept {
+            return true;
+        }
+    };
+
+    template<class T>
+    using page_vector = std::vector<T, page_allocator<T>>;
+
+    namespace detail {
+
+        inline std::atomic<huge_pages> g_huge_pages{ huge_pages::off };
+
+        /**
+         * \brief Отобразить size_ байт (кратно k_huge_page_size) с выравниванием 2 МБ
+         * \throws std::bad_alloc
+         */
+        [[nodiscard]] void* map_pages(std::size_t size_);
+
+        [[nodiscard]] constexpr std::size_t round_to_huge(std::size_t size_) noexcept {
+            return (size_ + k_huge_page_size - 1) / k_huge_page_size * k_huge_page_size;
+        }
+
+    }
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline void set_huge_pages(huge_pages mode_) noexcept {
+        detail::g_huge_pages.store(mode_, std::memory_order_relaxed);
+    }
+
+    inline huge_pages current_huge_pages() noexcept {
+        return detail::g_huge_pages.load(std::memory_order_relaxed);
+    }
+
+    inline void* detail::map_pages(std::size_t size_) {
+        const auto mode = current_huge_pages();
+#ifdef MAP_HUGETLB
+        if (mode == huge_pages::hugetlb) {
+            void* const p = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                return p;
+            }
+            static std::atomic<bool> warned{ false };
+            if (!warned.exchange(true, std::memory_order_relaxed)) {
+                spdlog::warn("MAP_HUGETLB failed (vm.nr_hugepages?), "
+                    "using transparent huge pages");
+            }
+        }
+#endif
+
+        // С запасом на выравнивание: лишнее по краям сразу возвращается
+        const std::size_t mapped = size_ + k_huge_page_size;
+        void* const raw = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (raw == MAP_FAILED) {
+            throw std::bad_alloc{};
+        }
+        const auto begin = reinterpret_cast<std::uintptr_t>(raw);
+        const auto aligned = (begin + k_huge_page_size - 1) / k_huge_page_size * k_huge_page_size;
+        if (aligned != begin) {
+            ::munmap(raw, aligned - begin);
+        }
+        if (const auto tail = begin + mapped - (aligned + size_); tail != 0) {
+            ::munmap(reinterpret_cast<void*>(aligned + size_), tail);
+        }
+
+        void* const p = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+        if (mode != huge_pages::off) {
+            static_cast<void>(::madvise(p, size_, MADV_HUGEPAGE));
+        }
+#endif
+        return p;
+    }
+
+    template<class T>
+    inline T* page_allocator<T>::allocate(std::size_t n_) {
+        if (n_ > (static_cast<std::size_t>(-1) - k_huge_page_size) / sizeof(T)) {
+            throw std::bad_array_new_length{};
+        }
+        const std::size_t size = n_ * sizeof(T);
+        if (size < k_huge_page_size) {
+            return static_cast<T*>(::operator new(size, std::align_val_t{ alignof(T) }));
+        }
+        return static_cast<T*>(detail::map_pages(detail::round_to_huge(size)));
+    }
+
+    template<class T>
+    inline void page_allocator<T>::deallocate(T* p_, std::size_t n_) noexcept {
+        const std::size_t size = n_ * sizeof(T);
+        if (size < k_huge_page_size) {
+            ::operator delete(p_, std::align_val_t{ alignof(T) });
+            return;
+        }
+        ::munmap(p_, detail::round_to_huge(size));
+    }
+
+}
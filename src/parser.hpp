@@ -5,6 +5,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
 #include <filesystem>
 #include <optional>
 #include <string>
@@ -15,6 +18,9 @@
 #include <spdlog/spdlog.h>
 #include <toml++/toml.hpp>
 
+#include "metrics.hpp"
+#include "options.hpp"
+
 namespace csv_median {
 
     namespace fs = std::filesystem;
@@ -27,6 +33,38 @@ namespace csv_median {
         fs::path                 input_dir;
         fs::path                 output_dir;
         std::vector<std::string> filename_masks;
+        read_mode                input_mode{ read_mode::stream };
+        bool                     parallel_parse{ true };
+        write_mode               output_mode{ write_mode::sync };
+        std::size_t              write_buffers{ k_default_write_buffers }; ///< буферов для async / uring
+        bool                     direct_io{ false }; ///< O_DIRECT для read_mode / write_mode = uring
+        bool                     cache{ false }; ///< колоночный кэш входных файлов
+        bool                     pin_threads{ false }; ///< закрепить потоки пула за CPU
+        huge_pages               pages{ huge_pages::off }; ///< страницы массивов калькулятора
+        output_format            format{ output_format::csv };
+        compression              output_compression{ compression::none }; ///< блоков output_format = columnar
+        price_mode               prices{ price_mode::floating };
+        median_backend           backend{ median_backend::heap };
+        std::uint64_t            window_us{ 0 }; ///< 0 — медиана за всё время
+        std::size_t              partitions{ 1 }; ///< участков receive_ts для окна
+        ts_range                 range;           ///< [from_ts, to_ts) входных записей
+        index_options            index;           ///< шаг индекса <имя>.idx для range
+        group_mode               groups{ group_mode::none }; ///< своя медиана и файл на группу
+        std::string              group_column{ "side" };     ///< для group_mode::column
+        std::vector<statistic>   statistics;      ///< колонки строки после медианы
+        std::uint64_t            bucket_us{ 0 };  ///< 0 — строка на каждое изменение медианы
+        bool                     bucket_ohlc{ false }; ///< open, high, low корзины после медианы
+        bool                     follow{ false }; ///< ждать дописывания файлов до сигнала
+        follow_options           follow_settings; ///< водяной знак и опрос для follow
+        std::uint64_t            checkpoint_records{ 0 }; ///< 0 — без контрольных точек
+        bool                     resume{ false }; ///< --resume: продолжить с контрольной точки
+        double                   sketch_error{ k_default_sketch_error }; ///< ошибка ранга для tdigest
+        std::int64_t             tick_units{ 1 }; ///< шаг цены для histogram, в единицах 10^-8
+        metrics_options          metrics;         ///< замеры стадий, лог и /metrics
+        std::uint64_t            parse_error_limit{ k_parse_error_limit }; ///< строк с ошибкой файла в логе
+        shard_mode               shard{ shard_mode::none }; ///< роль в расчёте несколькими узлами
+        std::vector<fs::path>    shard_inputs;    ///< файлы частей для shard_mode = 'merge'
+        fs::path                 shard_prefix;    ///< слияние предыдущих частей; пусто — с нуля
     };
 
     /**
@@ -51,9 +89,9 @@ namespace csv_median {
     private:
         /**
          * \brief Найти путь к конфиг-файлу из аргументов CLI
-         * \return путь к файлу или ошибку
+         * \return путь к файлу, флаг --resume или ошибку
          */
-        [[nodiscard]] std::tuple<fs::path, std::error_code>
+        [[nodiscard]] std::tuple<fs::path, bool, std::error_code>
             resolve_config_path(int argc_, const char* const* argv_) noexcept;
 
         /**
@@ -69,7 +107,7 @@ namespace csv_median {
     // Реализация
     // ──────────────────────────────────────────────
 
-    inline std::tuple<fs::path, std::error_code>
+    inline std::tuple<fs::path, bool, std::error_code>
         config_parser::resolve_config_path(
             int argc_,
             const char* const* argv_) noexcept
@@ -78,7 +116,8 @@ namespace csv_median {
             po::options_description desc{ "csv_report_calc options" };
             desc.add_options()
                 ("config", po::value<std::string>(), "path to config file")
-                ("cfg",    po::value<std::string>(), "path to config file");
+                ("cfg",    po::value<std::string>(), "path to config file")
+                ("resume", po::bool_switch(), "continue from the last checkpoint");
 
             po::variables_map vm;
             po::store(
@@ -87,11 +126,12 @@ namespace csv_median {
             );
             po::notify(vm);
 
+            const bool resume = vm["resume"].as<bool>();
             if (vm.count("config")) {
-                return { fs::path{vm["config"].as<std::string>()}, {} };
+                return { fs::path{vm["config"].as<std::string>()}, resume, {} };
             }
             if (vm.count("cfg")) {
-                return { fs::path{vm["cfg"].as<std::string>()}, {} };
+                return { fs::path{vm["cfg"].as<std::string>()}, resume, {} };
             }
 
             // По умолчанию ищем config.toml рядом с исполняемым файлом
@@ -101,12 +141,12 @@ namespace csv_median {
             spdlog::info("--config not specified, using default: {}",
                 default_config.string());
 
-            return { default_config, {} };
+            return { default_config, resume, {} };
 
         }
         catch (const std::exception& e) {
             spdlog::error("Failed to parse arguments: {}", e.what());
-            return { {}, std::make_error_code(std::errc::invalid_argument) };
+            return { {}, false, std::make_error_code(std::errc::invalid_argument) };
         }
     }
 
@@ -123,13 +163,13 @@ namespace csv_median {
             const auto table = toml::parse_file(config_path_.string());
             const auto main = table["main"];
 
-            // input — обязательный параметр
+            // input — обязательный параметр, кроме слияния частей без исходных CSV
             const auto input = main["input"].value<std::string>();
-            if (!input) {
+            if (!input && main["shard_mode"].value<std::string>() != "merge") {
                 spdlog::error("Missing required parameter [main].input");
                 return { {}, std::make_error_code(std::errc::invalid_argument) };
             }
-            config.input_dir = fs::path{ *input };
+            config.input_dir = fs::path{ input.value_or(std::string{}) };
 
             // output — опциональный, дефолт: ./output
             const auto output = main["output"].value<std::string>();
@@ -146,6 +186,437 @@ namespace csv_median {
                 }
             }
 
+            // read_mode — опциональный, дефолт: stream
+            if (const auto mode = main["read_mode"].value<std::string>()) {
+                const auto parsed = to_read_mode(*mode);
+                if (!parsed) {
+                    spdlog::error("Invalid [main].read_mode '{}', "
+                        "expected 'stream', 'mmap' or 'uring'", *mode);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.input_mode = *parsed;
+            }
+
+            // parallel_parse — опциональный, дефолт: true
+            if (const auto parallel = main["parallel_parse"].value<bool>()) {
+                config.parallel_parse = *parallel;
+            }
+
+            // write_mode — опциональный, дефолт: sync
+            if (const auto mode = main["write_mode"].value<std::string>()) {
+                const auto parsed = to_write_mode(*mode);
+                if (!parsed) {
+                    spdlog::error("Invalid [main].write_mode '{}', "
+                        "expected 'sync', 'async' or 'uring'", *mode);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.output_mode = *parsed;
+            }
+
+            // write_buffers — опциональный, дефолт: 4; ограничивает
+            // память и отставание потока записи
+            if (const auto buffers = main["write_buffers"].value<std::int64_t>()) {
+                if (*buffers < 2 || *buffers > static_cast<std::int64_t>(k_max_write_buffers)) {
+                    spdlog::error("Invalid [main].write_buffers {}, expected 2..{}",
+                        *buffers, k_max_write_buffers);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.write_buffers = static_cast<std::size_t>(*buffers);
+            }
+
+            // direct_io — опциональный, дефолт: false
+            if (const auto direct = main["direct_io"].value<bool>()) {
+                config.direct_io = *direct;
+            }
+
+            // cache — опциональный, дефолт: false
+            if (const auto cache = main["cache"].value<bool>()) {
+                config.cache = *cache;
+            }
+
+            // pin_threads — опциональный, дефолт: false
+            if (const auto pin = main["pin_threads"].value<bool>()) {
+                config.pin_threads = *pin;
+            }
+
+            // huge_pages — опциональный, дефолт: обычные страницы
+            if (const auto pages = main["huge_pages"].value<std::string>()) {
+                const auto parsed = to_huge_pages(*pages);
+                if (!parsed) {
+                    spdlog::error("Invalid [main].huge_pages '{}', "
+                        "expected 'off', 'thp' or 'hugetlb'", *pages);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.pages = *parsed;
+            }
+
+            // output_format — опциональный, дефолт: csv
+            if (const auto format = main["output_format"].value<std::string>()) {
+                const auto parsed = to_output_format(*format);
+                if (!parsed) {
+                    spdlog::error("Invalid [main].output_format '{}', "
+                        "expected 'csv' or 'columnar'", *format);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.format = *parsed;
+            }
+
+            // output_compression — опциональный, дефолт: none
+            if (const auto codec = main["output_compression"].value<std::string>()) {
+                if (*codec == "zstd") {
+                    config.output_compression = compression::zstd;
+                }
+                else if (*codec != "none") {
+                    spdlog::error("Invalid [main].output_compression '{}', "
+                        "expected 'none' or 'zstd'", *codec);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                if (!compression_supported(config.output_compression)) {
+                    spdlog::error("[main].output_compression = 'zstd' requires "
+                        "a build with zstd (CSV_MEDIAN_ZSTD)");
+                    return { {}, std::make_error_code(std::errc::not_supported) };
+                }
+                if (config.output_compression != compression::none
+                    && config.format != output_format::columnar)
+                {
+                    spdlog::error("[main].output_compression requires output_format = 'columnar'");
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+            }
+
+            // price_mode — опциональный, дефолт: double
+            if (const auto mode = main["price_mode"].value<std::string>()) {
+                const auto parsed = to_price_mode(*mode);
+                if (!parsed) {
+                    spdlog::error("Invalid [main].price_mode '{}', "
+                        "expected 'double' or 'fixed'", *mode);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.prices = *parsed;
+            }
+
+            // window_us — опциональный, дефолт: без окна
+            if (const auto window = main["window_us"].value<std::int64_t>()) {
+                if (*window <= 0) {
+                    spdlog::error("Invalid [main].window_us {}, expected > 0", *window);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.window_us = static_cast<std::uint64_t>(*window);
+            }
+
+            // partitions — опциональный, дефолт: 1 (без разбиения);
+            // независимы только участки окна, медиана за всё время — нет
+            if (const auto parts = main["partitions"].value<std::int64_t>()) {
+                if (*parts < 1) {
+                    spdlog::error("Invalid [main].partitions {}, expected >= 1", *parts);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                if (*parts > 1 && config.window_us == 0) {
+                    spdlog::error("[main].partitions requires window_us");
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.partitions = static_cast<std::size_t>(*parts);
+            }
+
+            // from_ts / to_ts — опциональные, дефолт: все записи
+            if (const auto from = main["from_ts"].value<std::int64_t>()) {
+                if (*from < 0) {
+                    spdlog::error("Invalid [main].from_ts {}, expected >= 0", *from);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.range.from = static_cast<std::uint64_t>(*from);
+            }
+            if (const auto to = main["to_ts"].value<std::int64_t>()) {
+                if (*to < 0 || static_cast<std::uint64_t>(*to) <= config.range.from) {
+                    spdlog::error("Invalid [main].to_ts {}, expected > from_ts", *to);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.range.to = static_cast<std::uint64_t>(*to);
+            }
+
+            // index_records / index_interval_us — опциональные, шаг <имя>.idx
+            if (const auto every = main["index_records"].value<std::int64_t>()) {
+                if (*every < 1) {
+                    spdlog::error("Invalid [main].index_records {}, expected >= 1", *every);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.index.every_records = static_cast<std::size_t>(*every);
+            }
+            if (const auto every = main["index_interval_us"].value<std::int64_t>()) {
+                if (*every < 0) {
+                    spdlog::error("Invalid [main].index_interval_us {}, expected >= 0", *every);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.index.every_us = static_cast<std::uint64_t>(*every);
+            }
+
+            // group_by / group_column — опциональные, дефолт: без групп
+            if (const auto mode = main["group_by"].value<std::string>()) {
+                const auto parsed = to_group_mode(*mode);
+                if (!parsed) {
+                    spdlog::error("Invalid [main].group_by '{}', "
+                        "expected 'none', 'mask' or 'column'", *mode);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.groups = *parsed;
+            }
+            if (const auto column = main["group_column"].value<std::string>()) {
+                if (column->empty()) {
+                    spdlog::error("[main].group_column can't be empty");
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.group_column = *column;
+            }
+            if (config.groups == group_mode::mask && config.filename_masks.empty()) {
+                spdlog::error("[main].group_by = 'mask' requires filename_mask");
+                return { {}, std::make_error_code(std::errc::invalid_argument) };
+            }
+            if (config.groups != group_mode::none && config.partitions > 1) {
+                spdlog::error("[main].group_by can't be combined with partitions");
+                return { {}, std::make_error_code(std::errc::invalid_argument) };
+            }
+
+            // statistics — опциональный список колонок после медианы
+            if (const auto stats = main["statistics"].as_array()) {
+                for (const auto& item : *stats) {
+                    const auto name = item.value<std::string>();
+                    const auto parsed = name ? to_statistic(*name) : std::nullopt;
+                    if (!parsed) {
+                        spdlog::error("Invalid [main].statistics item '{}', "
+                            "expected 'p01'..'p99', 'vwap', 'mean' or 'stddev'", name.value_or(""));
+                        return { {}, std::make_error_code(std::errc::invalid_argument) };
+                    }
+                    if (std::ranges::find(config.statistics, *parsed) != config.statistics.end()) {
+                        spdlog::error("Duplicate [main].statistics item '{}'", *name);
+                        return { {}, std::make_error_code(std::errc::invalid_argument) };
+                    }
+                    config.statistics.push_back(*parsed);
+                }
+            }
+            if (!config.statistics.empty()) {
+                if (config.format != output_format::csv) {
+                    spdlog::error("[main].statistics requires output_format = 'csv'");
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                if (config.partitions > 1 || config.groups != group_mode::none) {
+                    spdlog::error("[main].statistics can't be combined with partitions or group_by");
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+            }
+
+            // bucket_us — опциональный, дефолт: без прореживания
+            if (const auto bucket = main["bucket_us"].value<std::int64_t>()) {
+                if (*bucket <= 0) {
+                    spdlog::error("Invalid [main].bucket_us {}, expected > 0", *bucket);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.bucket_us = static_cast<std::uint64_t>(*bucket);
+            }
+            if (const auto ohlc = main["bucket_ohlc"].value<bool>()) {
+                config.bucket_ohlc = *ohlc;
+            }
+            if (config.bucket_ohlc) {
+                if (config.bucket_us == 0) {
+                    spdlog::error("[main].bucket_ohlc requires bucket_us");
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                if (config.format != output_format::csv) {
+                    spdlog::error("[main].bucket_ohlc requires output_format = 'csv'");
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+            }
+
+            // follow — опциональный, дефолт: файлы читаются один раз
+            if (const auto follow = main["follow"].value<bool>()) {
+                config.follow = *follow;
+            }
+            if (const auto lateness = main["follow_lateness_us"].value<std::int64_t>()) {
+                if (*lateness < 0) {
+                    spdlog::error("Invalid [main].follow_lateness_us {}, expected >= 0", *lateness);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.follow_settings.lateness_us = static_cast<std::uint64_t>(*lateness);
+            }
+            if (const auto poll = main["follow_poll_ms"].value<std::int64_t>()) {
+                if (*poll <= 0 || *poll > 60'000) {
+                    spdlog::error("Invalid [main].follow_poll_ms {}, expected 1..60000", *poll);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.follow_settings.poll_ms = static_cast<std::uint32_t>(*poll);
+            }
+            if (config.follow && (config.partitions > 1 || !config.range.whole())) {
+                spdlog::error("[main].follow can't be combined with partitions or from_ts / to_ts");
+                return { {}, std::make_error_code(std::errc::invalid_argument) };
+            }
+
+            // checkpoint_records — опциональный, дефолт: без контрольных точек
+            if (const auto every = main["checkpoint_records"].value<std::int64_t>()) {
+                if (*every <= 0) {
+                    spdlog::error("Invalid [main].checkpoint_records {}, expected > 0", *every);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.checkpoint_records = static_cast<std::uint64_t>(*every);
+            }
+            if (config.checkpoint_records != 0
+                && (config.format != output_format::csv || config.groups != group_mode::none
+                    || config.partitions > 1 || !config.statistics.empty()
+                    || config.bucket_us != 0 || config.follow || !config.range.whole()))
+            {
+                spdlog::error("[main].checkpoint_records requires output_format = 'csv' "
+                    "and can't be combined with group_by, partitions, statistics, "
+                    "bucket_us, follow or from_ts / to_ts");
+                return { {}, std::make_error_code(std::errc::invalid_argument) };
+            }
+
+            // parse_error_limit — опциональный: остальные строки с ошибкой только считаются
+            if (const auto limit = main["parse_error_limit"].value<std::int64_t>()) {
+                if (*limit < 0) {
+                    spdlog::error("Invalid [main].parse_error_limit {}, expected >= 0", *limit);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.parse_error_limit = static_cast<std::uint64_t>(*limit);
+            }
+
+            // metrics — опциональный, дефолт: только счётчики, без замеров и отчёта
+            if (const auto metrics = main["metrics"].value<bool>()) {
+                config.metrics.enabled = *metrics;
+            }
+            const auto interval = main["metrics_interval_ms"].value<std::int64_t>();
+            if (interval) {
+                if (*interval < 0 || *interval > 3'600'000) {
+                    spdlog::error("Invalid [main].metrics_interval_ms {}, expected 0..3600000", *interval);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.metrics.interval_ms = static_cast<std::uint32_t>(*interval);
+            }
+            const auto listen = main["metrics_listen"].value<std::string>();
+            if (listen) {
+                sockaddr_in address{};
+                if (!parse_listen_address(*listen, address)) {
+                    spdlog::error("Invalid [main].metrics_listen '{}', expected 'ipv4:port'", *listen);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                if (!config.follow) {
+                    spdlog::error("[main].metrics_listen requires follow = true");
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.metrics.listen = *listen;
+            }
+            if ((interval || listen) && !config.metrics.enabled) {
+                spdlog::error("[main].metrics_interval_ms and metrics_listen require metrics = true");
+                return { {}, std::make_error_code(std::errc::invalid_argument) };
+            }
+
+            // median_backend — опциональный, дефолт: heap,
+            // в режиме окна и со статистиками — skiplist (удаление и ранги)
+            if (config.window_us != 0 || !config.statistics.empty()) {
+                config.backend = median_backend::skiplist;
+            }
+            if (const auto name = main["median_backend"].value<std::string>()) {
+                const auto parsed = to_median_backend(*name);
+                if (!parsed) {
+                    spdlog::error("Invalid [main].median_backend '{}', "
+                        "expected 'heap', 'skiplist', 'tdigest' or 'histogram'", *name);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                if (config.window_us != 0 && *parsed != median_backend::skiplist
+                    && *parsed != median_backend::histogram)
+                {
+                    spdlog::error("[main].window_us requires median_backend "
+                        "with removal, '{}' can't remove values", *name);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                if (!config.statistics.empty() && *parsed != median_backend::skiplist
+                    && *parsed != median_backend::histogram)
+                {
+                    spdlog::error("[main].statistics requires median_backend "
+                        "'skiplist' or 'histogram', '{}' has no rank access", *name);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.backend = *parsed;
+            }
+
+            // sketch_error — опциональный, дефолт: 0.01
+            if (const auto error = main["sketch_error"].value<double>()) {
+                if (!(*error > 0.0 && *error < 0.5)) {
+                    spdlog::error("Invalid [main].sketch_error {}, "
+                        "expected value in (0, 0.5)", *error);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.sketch_error = *error;
+            }
+
+            // tick_size — обязателен для histogram: плотные счётчики
+            // на сетке 1e-8 не помещаются в память при широком диапазоне цен
+            if (const auto tick = main["tick_size"].value<double>()) {
+                const double units = *tick * 1e8;
+                const double rounded = std::round(units);
+                if (!(rounded >= 1.0) || std::abs(units - rounded) > 1e-6 * rounded) {
+                    spdlog::error("Invalid [main].tick_size {}, expected a positive "
+                        "multiple of 1e-8", *tick);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.tick_units = static_cast<std::int64_t>(rounded);
+            }
+            else if (config.backend == median_backend::histogram) {
+                spdlog::error("median_backend = 'histogram' requires [main].tick_size");
+                return { {}, std::make_error_code(std::errc::invalid_argument) };
+            }
+
+            // shard_mode — опциональный, дефолт: обычный расчёт
+            if (const auto mode = main["shard_mode"].value<std::string>()) {
+                const auto parsed = to_shard_mode(*mode);
+                if (!parsed) {
+                    spdlog::error("Invalid [main].shard_mode '{}', "
+                        "expected 'none', 'partial' or 'merge'", *mode);
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                config.shard = *parsed;
+            }
+            if (const auto inputs = main["shard_inputs"].as_array()) {
+                for (const auto& part : *inputs) {
+                    if (const auto str = part.value<std::string>()) {
+                        config.shard_inputs.emplace_back(*str);
+                    }
+                }
+            }
+            if (const auto prefix = main["shard_prefix"].value<std::string>()) {
+                config.shard_prefix = fs::path{ *prefix };
+            }
+            if ((config.shard == shard_mode::merge) != !config.shard_inputs.empty()) {
+                spdlog::error("[main].shard_inputs is required with shard_mode = 'merge' "
+                    "and only with it");
+                return { {}, std::make_error_code(std::errc::invalid_argument) };
+            }
+            if (config.shard != shard_mode::none && !config.shard_prefix.empty()) {
+                spdlog::error("[main].shard_prefix can't be combined with shard_mode");
+                return { {}, std::make_error_code(std::errc::invalid_argument) };
+            }
+            if (config.shard != shard_mode::none || !config.shard_prefix.empty()) {
+                // Сливаются только счётчики гистограммы и центроиды t-digest
+                if ((config.backend != median_backend::histogram
+                    && config.backend != median_backend::tdigest) || config.window_us != 0)
+                {
+                    spdlog::error("[main].shard_mode and shard_prefix require median_backend "
+                        "'histogram' or 'tdigest' without window_us");
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+                if (config.groups != group_mode::none || config.partitions > 1
+                    || !config.statistics.empty())
+                {
+                    spdlog::error("[main].shard_mode and shard_prefix can't be combined "
+                        "with group_by, partitions or statistics");
+                    return { {}, std::make_error_code(std::errc::invalid_argument) };
+                }
+            }
+            if (config.shard != shard_mode::none
+                && (config.follow || config.checkpoint_records != 0))
+            {
+                spdlog::error("[main].shard_mode can't be combined with follow "
+                    "or checkpoint_records");
+                return { {}, std::make_error_code(std::errc::invalid_argument) };
+            }
+
             return { config, {} };
 
         }
@@ -162,13 +633,21 @@ namespace csv_median {
 
     inline std::tuple<app_config, std::error_code>
         config_parser::parse(int argc_, const char* const* argv_) noexcept {
-        auto [config_path, path_err] = resolve_config_path(argc_, argv_);
+        auto [config_path, resume, path_err] = resolve_config_path(argc_, argv_);
         if (path_err) {
             return { {}, path_err };
         }
 
         spdlog::info("Loading config: {}", config_path.string());
-        return load_toml(config_path);
+        auto [config, err] = load_toml(config_path);
+        if (!err && resume) {
+            if (config.checkpoint_records == 0) {
+                spdlog::error("--resume requires [main].checkpoint_records");
+                return { {}, std::make_error_code(std::errc::invalid_argument) };
+            }
+            config.resume = true;
+        }
+        return { std::move(config), err };
     }
 
 }
\ No newline at end of file
@@ -0,0 +1,347 @@
+/**
+ * \file partition.hpp
+ * \brief Скользящая медиана по независимым диапазонам receive_ts
+ *
+ * Медиана окна (ts - w, ts] зависит только от записей последних w
+ * микросекунд, поэтому ось времени режется на участки [begin, end),
+ * и каждый считается своей задачей пула: своё слияние, свой
+ * калькулятор. Участок читает записи с begin - w (прогрев окна, без
+ * вывода) — к первой записи участка окно то же, что при сквозном
+ * расчёте. Файлы открываются сразу на нужном месте по ts_index.
+ *
+ * Строка выводится, когда ключ медианы отличается от предыдущего.
+ * Для первой записи участка предыдущий ключ — последний ключ прошлого
+ * участка, он известен только при сшивке. Поэтому первая запись
+ * хранится отдельно вместе с ключом, и решение о ней принимает
+ * сшивка. Итог совпадает со сквозным расчётом байт в байт.
+ *
+ * Границы участков берутся из опорных точек индексов: каждая точка —
+ * около k_index_probe_stride байт данных, так что участки примерно
+ * равны по объёму, а не по времени.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <limits>
+#include <span>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "index.hpp"
+#include "pool.hpp"
+#include "reader.hpp"
+#include "sink.hpp"
+#include "window.hpp"
+
+namespace csv_median {
+
+    /**
+     * \brief Участок оси времени: выводятся строки записей с ts в [begin, end)
+     */
+    struct time_partition {
+        std::uint64_t begin{ 0 };
+        std::uint64_t end{ std::numeric_limits<std::uint64_t>::max() };
+    };
+
+    /**
+     * \brief Строки одного участка
+     */
+    template<class Price>
+    struct partition_result {
+        bool                       has_first{ false };
+        std::uint64_t              first_ts{ 0 };
+        Price                      first_median{};
+        Price                      first_key{};  ///< ключ после первой записи участка
+        Price                      last_key{};   ///< ключ после последней
+        std::vector<std::uint64_t> ts;           ///< строки после первой записи
+        std::vector<Price>         price;
+        std::error_code            error;
+    };
+
+    /**
+     * \brief Построить индексы файлов и разбить ось времени на участки
+     * \param count_ желаемое число участков; меньше, если данных мало
+     * \param range_ участки покрывают только его ([main].from_ts / to_ts)
+     * \param index_ сюда кладутся индексы; файлы без индекса (сжатые)
+     *        участки читают с начала
+     * \return участки по возрастанию времени и код ошибки
+     */
+    [[nodiscard]] std::tuple<std::vector<time_partition>, std::error_code>
+        plan_partitions(thread_pool& pool_, csv_reader& reader_,
+            const fs::path& input_dir_, const std::vector<std::string>& masks_,
+            std::size_t count_, const ts_range& range_, index_table& index_) noexcept;
+
+    /**
+     * \brief Границы участков по опорным точкам индексов
+     */
+    [[nodiscard]] std::vector<time_partition>
+        split_time_range(const index_table& index_, std::size_t count_);
+
+    /**
+     * \brief Оставить от участков только пересечение с range_
+     */
+    void clip_partitions(std::vector<time_partition>& parts_, const ts_range& range_) noexcept;
+
+    /**
+     * \brief Посчитать участок
+     *
+     * Читает записи [begin - warmup_us_, end): до begin только наполняет
+     * окно калькулятора.
+     *
+     * \param floor_ts_ раньше него записи не читаются даже для прогрева
+     *        ([main].from_ts: сквозной расчёт их тоже не видит)
+     * \param calc_ новый калькулятор (sliding_window)
+     * \param stop_ вызывается на каждом пакете; true — прервать
+     */
+    template<class Calc, class Stop>
+    [[nodiscard]] partition_result<typename Calc::value_type>
+        compute_partition(csv_reader& reader_, const fs::path& input_dir_,
+            const std::vector<std::string>& masks_, const index_table& index_,
+            const time_partition& part_, std::uint64_t warmup_us_,
+            std::uint64_t floor_ts_, Calc& calc_, Stop&& stop_) noexcept;
+
+    /**
+     * \brief Посчитать участки задачами пула и записать строки по порядку
+     *
+     * Одновременно считается не больше thread_count() + 1 участков —
+     * память ограничена их строками.
+     *
+     * \param compute_ (const time_partition&) -> partition_result<Price>,
+     *        вызывается в потоках пула
+     * \param written_ число записанных строк
+     * \return первая ошибка расчёта или записи
+     */
+    template<class Price, result_sink Sink, class Compute>
+    [[nodiscard]] std::error_code
+        run_partitions(thread_pool& pool_, std::span<const time_partition> parts_,
+            Sink& sink_, std::size_t& written_, Compute&& compute_) noexcept;
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline std::tuple<std::vector<time_partition>, std::error_code>
+        plan_partitions(thread_pool& pool_, csv_reader& reader_,
+            const fs::path& input_dir_, const std::vector<std::string>& masks_,
+            std::size_t count_, const ts_range& range_, index_table& index_) noexcept
+    {
+        auto [paths, scan_err] = reader_.scan_directory(input_dir_, masks_);
+        if (scan_err) {
+            return { {}, scan_err };
+        }
+
+        try {
+            std::vector<ts_index> indexes(paths.size());
+            std::vector<std::error_code> errors(paths.size());
+            pool_.parallel_for(paths.size(), [&](std::size_t i_) {
+                errors[i_] = indexes[i_].probe(paths[i_]);
+                }, 1);
+
+            index_.clear();
+            for (std::size_t i = 0; i < paths.size(); ++i) {
+                if (errors[i]) {
+                    spdlog::warn("No time index for {} ({}), partitions read it from the start",
+                        paths[i].filename().string(), errors[i].message());
+                    continue;
+                }
+                index_.emplace(paths[i], std::move(indexes[i]));
+            }
+            auto parts = split_time_range(index_, count_);
+            clip_partitions(parts, range_);
+            return { std::move(parts), {} };
+        }
+        catch (const std::exception& e) {
+            spdlog::error("Can't plan partitions: {}", e.what());
+            return { {}, std::make_error_code(std::errc::not_enough_memory) };
+        }
+    }
+
+    inline std::vector<time_partition>
+        split_time_range(const index_table& index_, std::size_t count_)
+    {
+        // Опорная точка «весит» байты до следующей точки своего файла
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> weighted;
+        std::uint64_t total = 0;
+        for (const auto& [path, index] : index_) {
+            const auto& entries = index.entries();
+            for (std::size_t i = 0; i < entries.size(); ++i) {
+                const std::uint64_t next = (i + 1 < entries.size())
+                    ? entries[i + 1].offset : index.file_size();
+                const std::uint64_t bytes = next - entries[i].offset;
+                weighted.emplace_back(entries[i].ts, bytes);
+                total += bytes;
+            }
+        }
+        std::ranges::sort(weighted);
+
+        std::vector<time_partition> parts(1);
+        if (count_ < 2 || total == 0) {
+            return parts;
+        }
+
+        std::uint64_t seen = 0;
+        std::size_t next_part = 1;
+        for (const auto& [ts, bytes] : weighted) {
+            const std::uint64_t threshold = total / count_ * next_part;
+            if (seen >= threshold && next_part < count_) {
+                // Граница только между разными ts: равные — в одном участке;
+                // до самой ранней точки данных нет
+                if (ts > weighted.front().first && ts > parts.back().begin) {
+                    parts.back().end = ts;
+                    parts.push_back({ ts, std::numeric_limits<std::uint64_t>::max() });
+                }
+                ++next_part;
+            }
+            seen += bytes;
+        }
+        return parts;
+    }
+
+    inline void clip_partitions(std::vector<time_partition>& parts_,
+        const ts_range& range_) noexcept
+    {
+        std::erase_if(parts_, [&range_](const time_partition& part_) {
+            return part_.end <= range_.from || part_.begin >= range_.to;
+            });
+        if (!parts_.empty()) {
+            parts_.front().begin = std::max(parts_.front().begin, range_.from);
+            parts_.back().end = std::min(parts_.back().end, range_.to);
+        }
+    }
+
+    template<class Calc, class Stop>
+    inline partition_result<typename Calc::value_type>
+        compute_partition(csv_reader& reader_, const fs::path& input_dir_,
+            const std::vector<std::string>& masks_, const index_table& index_,
+            const time_partition& part_, std::uint64_t warmup_us_,
+            std::uint64_t floor_ts_, Calc& calc_, Stop&& stop_) noexcept
+    {
+        using Price = typename Calc::value_type;
+        partition_result<Price> result;
+
+        const std::uint64_t from = std::max(floor_ts_,
+            (part_.begin > warmup_us_) ? part_.begin - warmup_us_ : 0);
+        reader_.set_range({ from, part_.end }, &index_);
+
+        const auto on_batch = [&](std::span<const std::uint64_t> ts_,
+            std::span<const Price> price_)
+        {
+            if (result.error || stop_()) [[unlikely]] {
+                return;
+            }
+
+            try {
+                for (std::size_t i = 0; i < ts_.size(); ++i) {
+                    std::error_code err;
+                    if constexpr (timed_calculator<Calc>) {
+                        err = calc_.add(ts_[i], price_[i]);
+                    }
+                    else {
+                        err = calc_.add(price_[i]);
+                    }
+                    if (err) [[unlikely]] {
+                        result.error = err;
+                        return;
+                    }
+
+                    if (ts_[i] < part_.begin) {
+                        continue;
+                    }
+                    if (!result.has_first) {
+                        // Сравнить с прошлым участком сможет только сшивка
+                        result.has_first = true;
+                        result.first_ts = ts_[i];
+                        result.first_median = calc_.median();
+                        result.first_key = calc_.key();
+                    }
+                    else if (calc_.is_changed()) {
+                        result.ts.push_back(ts_[i]);
+                        result.price.push_back(calc_.median());
+                    }
+                }
+            }
+            catch (const std::bad_alloc&) {
+                result.error = std::make_error_code(std::errc::not_enough_memory);
+            }
+            };
+
+        if (const auto err = reader_.template process_batches<Price>(input_dir_, masks_, on_batch)) {
+            result.error = err;
+        }
+        if (result.has_first) {
+            result.last_key = calc_.key();
+        }
+        return result;
+    }
+
+    template<class Price, result_sink Sink, class Compute>
+    inline std::error_code
+        run_partitions(thread_pool& pool_, std::span<const time_partition> parts_,
+            Sink& sink_, std::size_t& written_, Compute&& compute_) noexcept
+    {
+        const std::size_t depth = pool_.thread_count() + 1;
+        std::deque<std::future<partition_result<Price>>> inflight;
+        std::size_t next = 0;
+        std::error_code error;
+
+        // До начала сквозного расчёта ключ — значение по умолчанию
+        Price prev_key{};
+
+        try {
+            while (true) {
+                while (!error && inflight.size() < depth && next < parts_.size()) {
+                    inflight.push_back(pool_.submit(
+                        [&compute_, part = parts_[next]] { return compute_(part); }));
+                    ++next;
+                }
+                if (inflight.empty()) {
+                    break;
+                }
+
+                auto result = inflight.front().get();
+                inflight.pop_front();
+                if (error) {
+                    // Дожидаемся уже запущенных: они ссылаются на compute_
+                    continue;
+                }
+                if (result.error) {
+                    error = result.error;
+                    continue;
+                }
+                if (!result.has_first) {
+                    continue;
+                }
+
+                if (result.first_key != prev_key) {
+                    error = sink_.write(result.first_ts, result.first_median);
+                    written_ += error ? 0 : 1;
+                }
+                for (std::size_t i = 0; i < result.ts.size() && !error; ++i) {
+                    error = sink_.write(result.ts[i], result.price[i]);
+                    written_ += error ? 0 : 1;
+                }
+                prev_key = result.last_key;
+            }
+        }
+        catch (const std::exception& e) {
+            spdlog::error("Partition failed: {}", e.what());
+            for (auto& f : inflight) {
+                f.wait();
+            }
+            return std::make_error_code(std::errc::io_error);
+        }
+        return error;
+    }
+
+}
@@ -1,25 +1,182 @@
 /**
  * \file pool.hpp
- * \brief Пул потоков с очередью задач
+ * \brief Пул потоков с раздельными очередями и перехватом задач
+ *
+ * У каждого рабочего потока своя деку Chase-Lev: владелец кладёт и
+ * берёт задачи с нижнего конца без блокировок, свободные потоки
+ * забирают (steal) с верхнего одним CAS. Задачи из внешних потоков
+ * (поток слияния, main) попадают в общую очередь под мьютексом — её
+ * трогают только при отправке и когда своей работы нет.
+ *
+ * Задача — один узел: функтор и promise лежат в нём же, без
+ * std::function, packaged_task и shared_ptr. parallel_for не создаёт
+ * узлов на итерацию: потоки разбирают отрезки индексов атомарным
+ * счётчиком, вызывающий поток работает вместе с пулом.
  */
 
 #pragma once
 
-#include <condition_variable>
-#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
 #include <future>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <stdexcept>
+#include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
+#include <pthread.h>
+#include <sched.h>
+
 namespace csv_median {
 
+    class thread_pool;
+
+    namespace detail {
+
+        // Начальная ёмкость деки рабочего потока (растёт вдвое)
+        inline constexpr std::size_t k_deque_capacity = 256;
+
+        // Проходов поиска с yield() перед сном на futex
+        inline constexpr unsigned k_idle_spins = 64;
+
+        /**
+         * \brief Узел задачи: выполняет себя и освобождает память
+         */
+        struct task_base {
+            virtual void run() noexcept = 0;
+
+        protected:
+            ~task_base() = default;
+        };
+
+        /**
+         * \brief Задача submit(): результат или исключение — в promise
+         */
+        template<class F, class R>
+        class future_task final : public task_base {
+        public:
+            template<class G>
+            explicit future_task(G&& fn_) : _fn{ std::forward<G>(fn_) } {}
+
+            [[nodiscard]] std::future<R> get_future() { return _promise.get_future(); }
+
+            void run() noexcept override {
+                try {
+                    if constexpr (std::is_void_v<R>) {
+                        _fn();
+                        _promise.set_value();
+                    }
+                    else {
+                        _promise.set_value(_fn());
+                    }
+                }
+                catch (...) {
+                    _promise.set_exception(std::current_exception());
+                }
+                delete this;
+            }
+
+        private:
+            F               _fn;
+            std::promise<R> _promise;
+        };
+
+        /**
+         * \brief Задача без результата (помощники parallel_for)
+         */
+        template<class F>
+        class plain_task final : public task_base {
+        public:
+            explicit plain_task(F fn_) : _fn{ std::move(fn_) } {}
+
+            void run() noexcept override {
+                _fn();
+                delete this;
+            }
+
+        private:
+            F _fn;
+        };
+
+        /**
+         * \brief Деку Chase-Lev (Lê, Pop, Cohen, Zappa Nardelli, 2013)
+         *
+         * push() и take() — только поток-владелец, steal() — любой.
+         * Старые кольца при росте не освобождаются до разрушения: вор
+         * может ещё читать из них.
+         */
+        class work_deque {
+        public:
+            work_deque();
+
+            work_deque(const work_deque&) = delete;
+            work_deque& operator=(const work_deque&) = delete;
+
+            void push(task_base* task_);
+
+            [[nodiscard]] task_base* take() noexcept;
+
+            [[nodiscard]] task_base* steal() noexcept;
+
+            [[nodiscard]] bool empty() const noexcept;
+
+        private:
+            struct ring {
+                explicit ring(std::size_t capacity_)
+                    : mask{ capacity_ - 1 }
+                    , slots{ std::make_unique<std::atomic<task_base*>[]>(capacity_) }
+                {
+                }
+
+                [[nodiscard]] std::size_t capacity() const noexcept { return mask + 1; }
+
+                std::atomic<task_base*>& at(std::int64_t i_) noexcept {
+                    return slots[static_cast<std::size_t>(i_) & mask];
+                }
+
+                std::size_t                                mask;
+                std::unique_ptr<std::atomic<task_base*>[]> slots;
+            };
+
+            alignas(64) std::atomic<std::int64_t> _top{ 0 };
+            alignas(64) std::atomic<std::int64_t> _bottom{ 0 };
+            std::atomic<ring*>                    _ring;
+            std::vector<std::unique_ptr<ring>>    _rings;
+        };
+
+        /**
+         * \brief Рабочий поток, в котором выполняется код (для submit изнутри задач)
+         */
+        struct worker_slot {
+            const thread_pool* pool{ nullptr };
+            std::size_t        index{ 0 };
+        };
+
+        inline thread_local worker_slot t_worker{};
+
+        /**
+         * \brief Доступные процессу CPU, сгруппированные по узлам NUMA
+         *
+         * Соседние рабочие потоки попадают на один узел. Узлы — из
+         * /sys/devices/system/node; без него — порядок sched_getaffinity.
+         */
+        [[nodiscard]] std::vector<int> numa_ordered_cpus() noexcept;
+
+    }
+
     /**
-     * \brief Пул потоков с очередью задач фиксированного размера
+     * \brief Пул потоков фиксированного размера с перехватом задач
      *
-     * Потоки создаются один раз при конструировании
+     * Потоки создаются один раз при конструировании. Разрушение пула
+     * дожидается выполнения всех отправленных задач.
      */
     class thread_pool {
     public:
@@ -27,10 +184,12 @@ namespace csv_median {
          * \brief Создать пул с заданным числом потоков
          * \param thread_count_ число рабочих потоков.
          *        По умолчанию — hardware_concurrency().
+         * \param pin_threads_ закрепить потоки за CPU (по узлам NUMA)
          */
         explicit thread_pool(
             std::size_t thread_count_ =
-            std::thread::hardware_concurrency()) noexcept;
+            std::thread::hardware_concurrency(),
+            bool pin_threads_ = false) noexcept;
 
         ~thread_pool() noexcept;
         thread_pool(const thread_pool&) = delete;
@@ -38,89 +197,445 @@ namespace csv_median {
         thread_pool(thread_pool&&) = delete;
         thread_pool& operator=(thread_pool&&) = delete;
 
+        /**
+         * \brief Отправить задачу
+         *
+         * Из рабочего потока задача кладётся в его деку, иначе — в
+         * общую очередь.
+         */
         template<class F>
         [[nodiscard]] auto submit(F&& task_)
             -> std::future<std::invoke_result_t<F>>;
 
+        /**
+         * \brief Вызвать body_(i) для всех i из [0, count_) и дождаться
+         * \param grain_ индексов в отрезке; 0 — около 4 отрезков на поток
+         *
+         * Вызывающий поток разбирает отрезки вместе с пулом, а пока
+         * ждёт остальных — выполняет чужие задачи, поэтому вызов из
+         * задачи пула не блокирует его. Первое исключение body_
+         * останавливает раздачу и пробрасывается отсюда.
+         */
+        template<class F>
+        void parallel_for(std::size_t count_, F&& body_, std::size_t grain_ = 0);
+
         [[nodiscard]] std::size_t thread_count() const noexcept;
 
+        /**
+         * \brief Сколько потоков удалось закрепить за CPU
+         */
+        [[nodiscard]] std::size_t pinned_count() const noexcept;
+
     private:
-        void worker_loop() noexcept;
+        void worker_loop(std::size_t index_) noexcept;
+
+        void enqueue(detail::task_base* task_);
 
-        std::vector<std::thread>          _workers;
-        std::queue<std::function<void()>> _tasks;
-        std::mutex                        _mutex;
-        std::condition_variable           _cv;
-        bool                              _stop{ false };
+        void wake(bool all_) noexcept;
+
+        /**
+         * \brief Взять задачу: своя дека, общая очередь, чужие деки
+         */
+        [[nodiscard]] detail::task_base* find_task() noexcept;
+
+        /**
+         * \brief Выполнить одну найденную задачу
+         * \return false, если задач нет
+         */
+        bool run_one() noexcept;
+
+        std::vector<std::thread>                        _workers;
+        std::vector<std::unique_ptr<detail::work_deque>> _deques;
+        std::deque<detail::task_base*>                  _injected;
+        std::mutex                                      _mutex;
+        std::atomic<std::size_t>                        _injected_count{ 0 };
+        std::atomic<std::uint32_t>                      _epoch{ 0 };
+        std::atomic<bool>                               _stop{ false };
+        std::size_t                                     _pinned{ 0 };
     };
 
-    inline thread_pool::thread_pool(std::size_t thread_count_) noexcept {
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    namespace detail {
+
+        inline work_deque::work_deque() {
+            _rings.push_back(std::make_unique<ring>(k_deque_capacity));
+            _ring.store(_rings.back().get(), std::memory_order_relaxed);
+        }
+
+        inline void work_deque::push(task_base* task_) {
+            const std::int64_t b = _bottom.load(std::memory_order_relaxed);
+            const std::int64_t t = _top.load(std::memory_order_acquire);
+            ring* r = _ring.load(std::memory_order_relaxed);
+
+            if (b - t >= static_cast<std::int64_t>(r->capacity())) {
+                auto grown = std::make_unique<ring>(r->capacity() * 2);
+                for (std::int64_t i = t; i < b; ++i) {
+                    grown->at(i).store(r->at(i).load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+                }
+                r = grown.get();
+                _rings.push_back(std::move(grown));
+                _ring.store(r, std::memory_order_release);
+            }
+
+            r->at(b).store(task_, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            _bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        inline task_base* work_deque::take() noexcept {
+            const std::int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+            ring* const r = _ring.load(std::memory_order_relaxed);
+            _bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t t = _top.load(std::memory_order_relaxed);
+
+            if (t > b) {
+                _bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            task_base* task = r->at(b).load(std::memory_order_relaxed);
+            if (t == b) {
+                // Последний элемент: соревнуемся с ворами за top
+                if (!_top.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    task = nullptr;
+                }
+                _bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return task;
+        }
+
+        inline task_base* work_deque::steal() noexcept {
+            std::int64_t t = _top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const std::int64_t b = _bottom.load(std::memory_order_acquire);
+
+            if (t >= b) {
+                return nullptr;
+            }
+
+            ring* const r = _ring.load(std::memory_order_acquire);
+            task_base* const task = r->at(t).load(std::memory_order_relaxed);
+            if (!_top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return nullptr;
+            }
+            return task;
+        }
+
+        inline bool work_deque::empty() const noexcept {
+            return _top.load(std::memory_order_acquire) >= _bottom.load(std::memory_order_acquire);
+        }
+
+        /**
+         * \brief Разобрать список CPU вида "0-3,8,10-11"
+         */
+        inline std::vector<int> parse_cpu_list(const std::string& text_) {
+            std::vector<int> cpus;
+            std::size_t pos = 0;
+            while (pos < text_.size()) {
+                std::size_t end = text_.find(',', pos);
+                if (end == std::string::npos) {
+                    end = text_.size();
+                }
+                const auto item = text_.substr(pos, end - pos);
+                const auto dash = item.find('-');
+                try {
+                    const int first = std::stoi(item.substr(0, dash));
+                    const int last = (dash == std::string::npos) ? first : std::stoi(item.substr(dash + 1));
+                    for (int cpu = first; cpu <= last; ++cpu) {
+                        cpus.push_back(cpu);
+                    }
+                }
+                catch (const std::logic_error&) {
+                    // Пустой или битый элемент пропускаем
+                }
+                pos = end + 1;
+            }
+            return cpus;
+        }
+
+        inline std::vector<int> numa_ordered_cpus() noexcept {
+            try {
+                cpu_set_t allowed;
+                CPU_ZERO(&allowed);
+                if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+                    return {};
+                }
+
+                std::vector<int> cpus;
+                std::vector<bool> seen(CPU_SETSIZE, false);
+                const auto add = [&](int cpu_) {
+                    if (cpu_ >= 0 && cpu_ < CPU_SETSIZE && !seen[static_cast<std::size_t>(cpu_)]
+                        && CPU_ISSET(static_cast<std::size_t>(cpu_), &allowed))
+                    {
+                        seen[static_cast<std::size_t>(cpu_)] = true;
+                        cpus.push_back(cpu_);
+                    }
+                };
+
+                // Узлы нумеруются подряд; первый отсутствующий — конец
+                for (int node = 0;; ++node) {
+                    std::ifstream list{ "/sys/devices/system/node/node"
+                        + std::to_string(node) + "/cpulist" };
+                    std::string text;
+                    if (!list || !std::getline(list, text)) {
+                        break;
+                    }
+                    for (const int cpu : parse_cpu_list(text)) {
+                        add(cpu);
+                    }
+                }
+                for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                    add(cpu);
+                }
+                return cpus;
+            }
+            catch (const std::exception&) {
+                return {};
+            }
+        }
+
+    }
+
+    inline thread_pool::thread_pool(std::size_t thread_count_, bool pin_threads_) noexcept {
         const std::size_t count = std::max(std::size_t{ 1 }, thread_count_);
-        _workers.reserve(count);
+        _deques.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            _deques.push_back(std::make_unique<detail::work_deque>());
+        }
 
+        const auto cpus = pin_threads_ ? detail::numa_ordered_cpus() : std::vector<int>{};
+
+        _workers.reserve(count);
         for (std::size_t i = 0; i < count; ++i) {
-            _workers.emplace_back([this] { worker_loop(); });
+            _workers.emplace_back([this, i] { worker_loop(i); });
+
+            if (!cpus.empty()) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(static_cast<std::size_t>(cpus[i % cpus.size()]), &set);
+                if (::pthread_setaffinity_np(_workers.back().native_handle(), sizeof(set), &set) == 0) {
+                    ++_pinned;
+                }
+            }
         }
     }
 
     inline thread_pool::~thread_pool() noexcept {
-        {
-            std::unique_lock lock{ _mutex };
-            _stop = true;
-        }
-        _cv.notify_all();
+        _stop.store(true, std::memory_order_seq_cst);
+        wake(true);
 
         for (auto& worker : _workers) {
             if (worker.joinable()) {
                 worker.join();
             }
         }
+
+        // Задачи, отправленные задачами в последний момент
+        while (run_one()) {
+        }
     }
 
-    inline void thread_pool::worker_loop() noexcept {
+    inline void thread_pool::worker_loop(std::size_t index_) noexcept {
+        detail::t_worker = { this, index_ };
+
+        unsigned idle = 0;
         while (true) {
-            std::function<void()> task;
-            {
-                std::unique_lock lock{ _mutex };
+            // Эпоха читается до поиска: задача, отправленная после,
+            // сменит её, и wait() не уснёт
+            const auto epoch = _epoch.load(std::memory_order_seq_cst);
+            if (run_one()) {
+                idle = 0;
+                continue;
+            }
+            if (_stop.load(std::memory_order_seq_cst)) {
+                return;
+            }
+            if (++idle < detail::k_idle_spins) {
+                std::this_thread::yield();
+                continue;
+            }
+            _epoch.wait(epoch, std::memory_order_seq_cst);
+            idle = 0;
+        }
+    }
 
-                _cv.wait(lock, [this] {
-                    return _stop || !_tasks.empty();
-                    });
+    inline void thread_pool::enqueue(detail::task_base* task_) {
+        const auto& slot = detail::t_worker;
+        if (slot.pool == this) {
+            _deques[slot.index]->push(task_);
+            return;
+        }
 
-                if (_stop && _tasks.empty()) {
-                    return;
-                }
+        std::unique_lock lock{ _mutex };
+        if (_stop.load(std::memory_order_relaxed)) {
+            throw std::runtime_error{ "thread_pool: submit after shutdown" };
+        }
+        _injected.push_back(task_);
+        _injected_count.fetch_add(1, std::memory_order_release);
+    }
+
+    inline void thread_pool::wake(bool all_) noexcept {
+        _epoch.fetch_add(1, std::memory_order_seq_cst);
+        if (all_) {
+            _epoch.notify_all();
+        }
+        else {
+            _epoch.notify_one();
+        }
+    }
+
+    inline detail::task_base* thread_pool::find_task() noexcept {
+        const auto& slot = detail::t_worker;
+        const bool own = slot.pool == this;
+        if (own) {
+            if (auto* task = _deques[slot.index]->take()) {
+                return task;
+            }
+        }
+
+        if (_injected_count.load(std::memory_order_acquire) != 0) {
+            std::unique_lock lock{ _mutex };
+            if (!_injected.empty()) {
+                auto* task = _injected.front();
+                _injected.pop_front();
+                _injected_count.fetch_sub(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
 
-                task = std::move(_tasks.front());
-                _tasks.pop();
+        // Обход жертв со следующего за собой потока
+        const std::size_t count = _deques.size();
+        const std::size_t first = own ? slot.index + 1 : 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::size_t victim = (first + i) % count;
+            if (own && victim == slot.index) {
+                continue;
+            }
+            if (auto* task = _deques[victim]->steal()) {
+                return task;
             }
-            task();
         }
+        return nullptr;
+    }
+
+    inline bool thread_pool::run_one() noexcept {
+        auto* const task = find_task();
+        if (task == nullptr) {
+            return false;
+        }
+        task->run();
+        return true;
     }
 
     template<class F>
     auto thread_pool::submit(F&& task_) -> std::future<std::invoke_result_t<F>> {
         using result_t = std::invoke_result_t<F>;
+        using node_t = detail::future_task<std::decay_t<F>, result_t>;
+
+        auto node = std::make_unique<node_t>(std::forward<F>(task_));
+        auto future = node->get_future();
+        enqueue(node.get());
+        static_cast<void>(node.release());
+        wake(false);
+        return future;
+    }
 
-        auto pkg = std::make_shared<std::packaged_task<result_t()>>(
-            std::forward<F>(task_)
-        );
-        auto future = pkg->get_future();
+    template<class F>
+    void thread_pool::parallel_for(std::size_t count_, F&& body_, std::size_t grain_) {
+        if (count_ == 0) {
+            return;
+        }
+
+        const std::size_t grain = (grain_ != 0)
+            ? grain_
+            : std::max<std::size_t>(1, count_ / (4 * thread_count()));
+        const std::size_t chunks = (count_ + grain - 1) / grain;
+        const std::size_t helpers = std::min(thread_count(), chunks - 1);
+
+        // Помощник держит свою ссылку: последний notify_all() может
+        // выполниться уже после того, как вызывающий увидел pending == 0
+        // и вернулся
+        struct shared_state {
+            std::atomic<std::size_t> next{ 0 };
+            std::atomic<std::size_t> pending{ 0 };
+            std::atomic<bool>        failed{ false };
+            std::exception_ptr       error;
+        };
+        const auto shared = std::make_shared<shared_state>();
+        shared_state& state = *shared;
+
+        const auto work = [&]() noexcept {
+            while (!state.failed.load(std::memory_order_relaxed)) {
+                const std::size_t begin = state.next.fetch_add(grain, std::memory_order_relaxed);
+                if (begin >= count_) {
+                    return;
+                }
+                const std::size_t end = std::min(count_, begin + grain);
+                try {
+                    for (std::size_t i = begin; i < end; ++i) {
+                        body_(i);
+                    }
+                }
+                catch (...) {
+                    if (!state.failed.exchange(true)) {
+                        state.error = std::current_exception();
+                    }
+                }
+            }
+        };
+        const auto helper = [shared, &work]() noexcept {
+            work();
+            if (shared->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                shared->pending.notify_all();
+            }
+        };
 
+        for (std::size_t i = 0; i < helpers; ++i) {
+            state.pending.fetch_add(1, std::memory_order_relaxed);
+            auto node = std::make_unique<detail::plain_task<std::remove_cvref_t<decltype(helper)>>>(helper);
+            try {
+                enqueue(node.get());
+            }
+            catch (...) {
+                // submit после остановки: без помощника
+                state.pending.fetch_sub(1, std::memory_order_relaxed);
+                break;
+            }
+            static_cast<void>(node.release());
+        }
+        wake(true);
+
+        work();
+
+        // Помощники ещё в очередях — выполняем их (или чужие задачи) сами
+        for (auto pending = state.pending.load(std::memory_order_acquire); pending != 0;
+            pending = state.pending.load(std::memory_order_acquire))
         {
-            std::unique_lock lock{ _mutex };
-            if (_stop) {
-                throw std::runtime_error{ "thread_pool: submit after shutdown" };
+            if (!run_one()) {
+                state.pending.wait(pending, std::memory_order_acquire);
             }
-            // для единообразного хранения
-            _tasks.emplace([pkg] { (*pkg)(); });
         }
-        _cv.notify_one();
-        return future;
+
+        if (state.error) {
+            std::rethrow_exception(state.error);
+        }
     }
 
     inline std::size_t thread_pool::thread_count() const noexcept {
         return _workers.size();
     }
 
-}
\ No newline at end of file
+    inline std::size_t thread_pool::pinned_count() const noexcept {
+        return _pinned;
+    }
+
+}
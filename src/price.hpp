@@ -0,0 +1,272 @@
+/**
+ * \file price.hpp
+ * \brief Разбор цен биржевого формата в фиксированную точку
+ *
+ * Цены во входных файлах всегда вида 67960.89108975: целая часть и
+ * не более k_price_digits знаков после точки. Разбор строгий — любое
+ * отклонение от формата (экспонента, пробелы, лишние знаки) считается
+ * ошибкой. Восемь знаков дробной части декодируются за одно SWAR
+ * умножение над 64-битным словом вместо цикла по символам.
+ *
+ * Для режима price_mode::fixed здесь же арифметика и вывод цен
+ * в фиксированной точке без перехода к double.
+ */
+
+#pragma once
+
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+namespace csv_median {
+
+    // Число знаков дробной части цены в формате биржи
+    inline constexpr unsigned k_price_digits = 8;
+
+    /**
+     * \brief Цена в фиксированной точке: целое число единиц 10^-Frac
+     */
+    using fixed_price = std::int64_t;
+
+    /**
+     * \brief Множитель фиксированной точки: 10^Frac
+     */
+    template<unsigned Frac = k_price_digits>
+    inline constexpr std::int64_t price_scale = [] {
+        std::int64_t scale = 1;
+        for (unsigned i = 0; i < Frac; ++i) { scale *= 10; }
+        return scale;
+    }();
+
+    namespace detail {
+
+        // Все 8 байт слова — ASCII цифры
+        [[nodiscard]] constexpr bool is_8_digits(std::uint64_t v_) noexcept {
+            return ((v_ & 0xF0F0F0F0F0F0F0F0ull)
+                | (((v_ + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4))
+                == 0x3333333333333333ull;
+        }
+
+        // Значение 8 ASCII цифр (первая цифра в младшем байте)
+        [[nodiscard]] constexpr std::uint32_t parse_8_digits(std::uint64_t v_) noexcept {
+            constexpr std::uint64_t mask = 0x000000FF000000FFull;
+            constexpr std::uint64_t mul1 = 100 + (1000000ull << 32);
+            constexpr std::uint64_t mul2 = 1 + (10000ull << 32);
+            v_ -= 0x3030303030303030ull;
+            v_ = (v_ * 10) + (v_ >> 8);
+            v_ = (((v_ & mask) * mul1) + (((v_ >> 16) & mask) * mul2)) >> 32;
+            return static_cast<std::uint32_t>(v_);
+        }
+
+        [[nodiscard]] inline std::uint64_t load_8(const char* p_) noexcept {
+            std::uint64_t v;
+            std::memcpy(&v, p_, sizeof(v));
+            if constexpr (std::endian::native == std::endian::big) {
+                v = std::byteswap(v);
+            }
+            return v;
+        }
+
+        // Максимальная длина целой части, при которой значение влезает в int64
+        template<unsigned Frac>
+        inline constexpr std::size_t k_max_int_digits = 18 - Frac;
+
+    }
+
+    /**
+     * \brief Строго разобрать цену в фиксированную точку
+     * \param value_  текст цены: [-]цифры[.цифры], дробных знаков 1..Frac
+     * \param out_    цена в единицах 10^-Frac
+     * \return false если текст не соответствует формату
+     */
+    template<unsigned Frac = k_price_digits>
+    [[nodiscard]] inline bool parse_fixed(std::string_view value_,
+        fixed_price& out_) noexcept
+    {
+        static_assert(Frac >= 1 && Frac <= 17, "unsupported price precision");
+
+        const char* p = value_.data();
+        const char* const end = p + value_.size();
+
+        const bool negative = (p != end && *p == '-');
+        if (negative) { ++p; }
+
+        const char* const int_begin = p;
+        std::int64_t int_part = 0;
+        while (p != end && static_cast<unsigned char>(*p - '0') <= 9) {
+            int_part = int_part * 10 + (*p - '0');
+            ++p;
+        }
+
+        const auto int_digits = static_cast<std::size_t>(p - int_begin);
+        if (int_digits == 0 || int_digits > detail::k_max_int_digits<Frac>) {
+            return false;
+        }
+
+        std::int64_t frac_part = 0;
+        if (p != end) {
+            if (*p != '.') { return false; }
+            ++p;
+
+            const auto frac_digits = static_cast<std::size_t>(end - p);
+            if (frac_digits == 0 || frac_digits > Frac) {
+                return false;
+            }
+
+            if constexpr (Frac == 8) {
+                if (frac_digits == 8) {
+                    const auto word = detail::load_8(p);
+                    if (!detail::is_8_digits(word)) { return false; }
+                    frac_part = detail::parse_8_digits(word);
+                    p = end;
+                }
+            }
+
+            if (p != end) {
+                for (const char* q = p; q != end; ++q) {
+                    if (static_cast<unsigned char>(*q - '0') > 9) { return false; }
+                    frac_part = frac_part * 10 + (*q - '0');
+                }
+                // Недостающие знаки — нули справа
+                for (auto i = frac_digits; i < Frac; ++i) {
+                    frac_part *= 10;
+                }
+            }
+        }
+
+        const std::int64_t value = int_part * price_scale<Frac> + frac_part;
+        out_ = negative ? -value : value;
+        return true;
+    }
+
+    /**
+     * \brief Строго разобрать цену в double
+     *
+     * Формат тот же, что у parse_fixed. Результат совпадает с
+     * std::from_chars: деление точного целого на 10^Frac в IEEE
+     * округляется корректно. Для значений за пределами 2^53 единиц
+     * используется from_chars.
+     */
+    template<unsigned Frac = k_price_digits>
+    [[nodiscard]] inline bool parse_price(std::string_view value_,
+        double& out_) noexcept
+    {
+        fixed_price fixed = 0;
+        if (!parse_fixed<Frac>(value_, fixed)) {
+            return false;
+        }
+
+        constexpr std::int64_t k_exact_limit = std::int64_t{ 1 } << 53;
+        if (fixed > -k_exact_limit && fixed < k_exact_limit) [[likely]] {
+            out_ = static_cast<double>(fixed) / static_cast<double>(price_scale<Frac>);
+            return true;
+        }
+
+        const auto [ptr, err] = std::from_chars(
+            value_.data(), value_.data() + value_.size(), out_);
+        return err == std::errc{};
+    }
+
+    /**
+     * \brief Строго разобрать цену в фиксированную точку (перегрузка для шаблонов)
+     */
+    template<unsigned Frac = k_price_digits>
+    [[nodiscard]] inline bool parse_price(std::string_view value_,
+        fixed_price& out_) noexcept
+    {
+        return parse_fixed<Frac>(value_, out_);
+    }
+
+    /**
+     * \brief Середина двух цен в единицах 10^-Frac, округлённая как в double
+     *
+     * Нечётная сумма даёт половину младшего знака. Чтобы вывод совпадал
+     * байт в байт с расчётом в double ((a + b) / 2.0 и {:.8f}), направление
+     * округления берётся из той же суммы в double: её двоичное значение
+     * точно сравнивается с серединой между соседними значениями.
+     */
+    template<unsigned Frac = k_price_digits>
+    [[nodiscard]] inline fixed_price fixed_midpoint(fixed_price a_,
+        fixed_price b_) noexcept
+    {
+        const fixed_price sum = a_ + b_;
+        if ((sum & 1) == 0) [[likely]] {
+            return sum / 2;
+        }
+        if (sum < 0) {
+            return -fixed_midpoint<Frac>(-a_, -b_);
+        }
+
+        constexpr double scale = static_cast<double>(price_scale<Frac>);
+        const double mid = (static_cast<double>(a_) / scale
+            + static_cast<double>(b_) / scale) / 2.0;
+        const fixed_price below = sum / 2;
+
+        // mid = mantissa * 2^exp; сравниваем mid * 2 * 10^Frac с 2 * below + 1
+        const auto bits = std::bit_cast<std::uint64_t>(mid);
+        const auto biased = static_cast<int>((bits >> 52) & 0x7FF);
+        if (biased == 0) {
+            return below; // денормализованные значения меньше половины единицы
+        }
+        const auto mantissa = (bits & ((std::uint64_t{ 1 } << 52) - 1))
+            | (std::uint64_t{ 1 } << 52);
+        const int exp = biased - 1075;
+
+        __extension__ using u128 = unsigned __int128;
+        u128 lhs = u128{ mantissa } * static_cast<std::uint64_t>(2 * price_scale<Frac>);
+        u128 rhs = static_cast<u128>(2 * below + 1);
+        if (exp >= 0) {
+            lhs <<= exp;
+        }
+        else {
+            rhs <<= -exp;
+        }
+        if (lhs == rhs) {
+            // Ровно половина единицы: {:.8f} округляет к чётному
+            return (below & 1) ? below + 1 : below;
+        }
+        return lhs > rhs ? below + 1 : below;
+    }
+
+    /**
+     * \brief Цена в double: fixed_price — из единиц 10^-Frac, double — как есть
+     */
+    template<class T, unsigned Frac = k_price_digits>
+    [[nodiscard]] constexpr double price_to_double(T price_) noexcept {
+        if constexpr (std::is_floating_point_v<T>) {
+            return static_cast<double>(price_);
+        }
+        else {
+            return static_cast<double>(price_) / static_cast<double>(price_scale<Frac>);
+        }
+    }
+
+    /**
+     * \brief Записать цену в виде [-]целое.дробь с Frac знаками
+     * \param out_ буфер не меньше 32 байт
+     * \return указатель за последним записанным символом
+     */
+    template<unsigned Frac = k_price_digits>
+    [[nodiscard]] inline char* format_fixed(char* out_, fixed_price value_) noexcept {
+        auto magnitude = static_cast<std::uint64_t>(value_);
+        if (value_ < 0) {
+            *out_++ = '-';
+            magnitude = ~magnitude + 1;
+        }
+
+        const auto scale = static_cast<std::uint64_t>(price_scale<Frac>);
+        out_ = std::to_chars(out_, out_ + 20, magnitude / scale).ptr;
+        *out_++ = '.';
+
+        auto frac = magnitude % scale;
+        for (unsigned i = Frac; i > 0; --i) {
+            out_[i - 1] = static_cast<char>('0' + frac % 10);
+            frac /= 10;
+        }
+        return out_ + Frac;
+    }
+
+}
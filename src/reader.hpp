@@ -3,60 +3,175 @@
  * \brief Потоковое чтение CSV файлов биржевых данных
  *
  * Архитектура: каждый файл читается построчно через file_cursor.
- * Записи не накапливаются в памяти — каждая передаётся в callback
- * сразу после парсинга. Это позволяет обрабатывать файлы любого размера.
+ * Записи не накапливаются в памяти — они передаются в callback
+ * пакетами по мере слияния: спаны receive_ts / price прямо из пакета
+ * разбора курсора. Это позволяет обрабатывать файлы любого размера.
  *
- * K-way merge реализован через min-heap курсоров по открытым файлам,
- * что даёт O(N log k) без хранения всех данных одновременно.
+ * Файл читается блоками, line_scanner находит ';' и '\n' векторными
+ * инструкциями и возвращает смещения receive_ts/price для всех строк блока.
+ *
+ * В режиме read_mode::mmap файл отображается в память и строки
+ * берутся как string_view прямо из отображения, без копирования.
+ * Если файл отобразить нельзя (pipe, fifo), курсор читает через ifstream.
+ *
+ * В режиме read_mode::uring блоки файла читаются через io_uring
+ * (uring.hpp): несколько чтений по 1 МБ в полёте, пока разбирается
+ * текущий. Без поддержки ядра курсор откатывается на ifstream.
+ *
+ * Файлы .csv.gz / .csv.zst / .csv.lz4 распаковываются потоково прямо
+ * в буфер разбора (compressed.hpp), read_mode для них не действует.
+ * Сжатый файл разбирается последовательно; при параллельном разборе
+ * пул вместо этого распаковывает независимые кадры zstd.
+ *
+ * С кэшем (cache.hpp) разобранные колонки файла сохраняются рядом
+ * с ним в <имя>.cache; пока источник не менялся, курсор читает блоки
+ * кэша из отображения и CSV не разбирает вовсе.
+ *
+ * При параллельном разборе курсор делит файл на фрагменты по
+ * k_parse_chunk_size байт и отдаёт их задачам пула (parse_chunk).
+ * Готовые пакеты колонок забираются строго по порядку из ограниченной
+ * очереди futures, так что поток слияния только сравнивает receive_ts.
+ *
+ * K-way merge реализован деревом проигравших (merge.hpp) над курсорами
+ * открытых файлов: O(N log k) без хранения всех данных одновременно.
+ * Каждый файл должен быть упорядочен по receive_ts: записи внутри
+ * файла выдаются в его порядке.
+ * Пока запись курсора-победителя меньше ключа второго источника,
+ * записи выдаются одним пакетом без обращения к дереву.
  * Память: O(k) где k — число файлов, не O(N) от числа записей.
+ *
+ * С контрольными точками (checkpoint.hpp) process_batches() между
+ * пакетами слияния отдаёт позиции всех курсоров; при продолжении
+ * курсоры открываются сразу на них.
+ *
+ * follow_batches() не заканчивается на конце файлов: хвосты файлов
+ * дочитываются по мере дописывания (follow.hpp), новые файлы под
+ * маски подхватываются, записи сливаются по водяному знаку.
  */
 
 #pragma once
 
 #include <algorithm>
 #include <charconv>
+#include <chrono>
+#include <concepts>
 #include <cstdint>
+#include <cstring>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <functional>
 #include <future>
+#include <memory>
 #include <optional>
-#include <queue>
 #include <ranges>
+#include <span>
 #include <string>
 #include <string_view>
 #include <thread>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 
 #include <spdlog/spdlog.h>
 
+#include "cache.hpp"
+#include "checkpoint.hpp"
+#include "columns.hpp"
+#include "compressed.hpp"
+#include "follow.hpp"
+#include "group.hpp"
+#include "index.hpp"
+#include "mapped.hpp"
+#include "merge.hpp"
+#include "metrics.hpp"
+#include "options.hpp"
 #include "pool.hpp"
+#include "price.hpp"
+#include "scanner.hpp"
+#include "uring.hpp"
 
 namespace csv_median {
 
     namespace fs = std::filesystem;
 
-    // Размер буфера чтения файла — 64 KB компромисс между памятью и I/O
-    inline constexpr std::size_t k_read_buffer_size = 64 * 1024;
+    // Размер блока чтения и разбора — 256 KB компромисс между памятью и I/O.
+    // Растёт, если строка не помещается в блок целиком
+    inline constexpr std::size_t k_read_buffer_size = 256 * 1024;
 
     /**
      * \brief Одна запись из CSV файла
+     * \tparam Price тип цены: double или fixed_price
      */
-    struct csv_record {
+    template<class Price>
+    struct basic_record {
         std::uint64_t receive_ts;
-        double        price;
+        Price         price;
     };
 
+    using csv_record = basic_record<double>;
+    using fixed_record = basic_record<fixed_price>;
+
     /**
      * \brief Курсор для построчного чтения одного CSV файла
      *
      * Держит открытый файл и читает записи по одной без загрузки в память.
      * Используется в k-way merge — одновременно в памяти только k записей.
+     *
+     * Файл читается блоками: line_scanner размечает все полные строки
+     * блока, затем записи блока разбираются подряд в небольшой пакет,
+     * из которого advance() выдаёт их по одной.
+     *
+     * \tparam Price тип цены записей: double или fixed_price
      */
-    class file_cursor {
+    template<class Price>
+    class basic_file_cursor {
     public:
-        explicit file_cursor(const fs::path& path_) noexcept;
+        using record_type = basic_record<Price>;
+
+        /**
+         * \param path_  путь к CSV файлу, возможно сжатому (.gz, .zst, .lz4)
+         * \param mode_  способ чтения; mmap при неудаче откатывается на stream
+         * \param pool_  пул для параллельного разбора фрагментов
+         *               (для сжатых — распаковки кадров zstd);
+         *               nullptr — разбор в потоке, вызывающем advance()
+         * \param direct_io_ O_DIRECT для read_mode::uring
+         * \param cache_ читать колонки из кэша <имя>.cache, если он
+         *               действителен, иначе построить его при разборе
+         * \param range_ выдавать только записи с receive_ts из диапазона;
+         *               кэш при этом не используется
+         * \param start_ с какой строки читать данные (смещение из
+         *               ts_index или позиция контрольной точки) и сколько
+         *               записей пропустить от неё. Сжатые файлы читаются
+         *               с начала; со смещением кэш не используется
+         * \param groups_ ключи групп записей для pending_group(); при
+         *               группах по колонке кэш не используется
+         * \param quantity_ разбирать колонку quantity для pending_quantity();
+         *               кэш при этом не используется
+         */
+        explicit basic_file_cursor(const fs::path& path_,
+            read_mode mode_ = read_mode::stream,
+            thread_pool* pool_ = nullptr,
+            bool direct_io_ = false,
+            bool cache_ = false,
+            const ts_range& range_ = {},
+            const cursor_position& start_ = {},
+            const record_groups& groups_ = {},
+            bool quantity_ = false) noexcept;
+
+        /**
+         * \brief Дождаться задач разбора, ещё читающих файл
+         */
+        ~basic_file_cursor() noexcept;
+
+        /**
+         * \brief Подготовить первую запись
+         *
+         * При параллельном разборе ждёт первый пакет, поэтому вызывается
+         * вне потоков пула. Без пула запись готова уже в конструкторе.
+         * \return true если в файле есть записи
+         */
+        [[nodiscard]] bool start() noexcept;
 
         /**
          * \brief Продвинуть курсор к следующей записи
@@ -72,7 +187,43 @@ namespace csv_median {
         /**
          * \brief Текущая запись курсора
          */
-        [[nodiscard]] const csv_record& current() const noexcept;
+        [[nodiscard]] const record_type& current() const noexcept;
+
+        /**
+         * \brief receive_ts записей пакета, начиная с текущей
+         */
+        [[nodiscard]] std::span<const std::uint64_t> pending_ts() const noexcept;
+
+        /**
+         * \brief Цены записей пакета, начиная с текущей
+         */
+        [[nodiscard]] std::span<const Price> pending_price() const noexcept;
+
+        /**
+         * \brief Ключи групп записей пакета, начиная с текущей; пусто без групп
+         */
+        [[nodiscard]] std::span<const std::uint64_t> pending_group() const noexcept;
+
+        /**
+         * \brief Объёмы записей пакета, начиная с текущей; пусто без quantity
+         */
+        [[nodiscard]] std::span<const double> pending_quantity() const noexcept;
+
+        /**
+         * \brief Пропустить n_ записей пакета, начиная с текущей
+         * \param n_ от 1 до pending_ts().size()
+         * \return true если есть следующая запись
+         */
+        [[nodiscard]] bool skip(std::size_t n_) noexcept;
+
+        /**
+         * \brief Позиция текущей записи для контрольной точки
+         *
+         * Начало строки текущего блока (фрагмента при параллельном
+         * разборе) и число выданных записей блока; без точного смещения
+         * (сжатый файл, кэш) — число выданных записей от начала файла.
+         */
+        [[nodiscard]] cursor_position position() const noexcept;
 
         /**
          * \brief Имя файла для логирования
@@ -80,22 +231,193 @@ namespace csv_median {
         [[nodiscard]] std::string filename() const noexcept;
 
     private:
-        [[nodiscard]] int find_column(
-            std::string_view header_,
-            std::string_view col_) const noexcept;
-
-        [[nodiscard]] bool parse_line(std::string_view line_) noexcept;
-
-        fs::path      _path;
-        std::ifstream _file;
-        std::string   _line;
-        csv_record    _current{};
-        int           _ts_col{ -1 };
-        int           _price_col{ -1 };
-        std::size_t   _line_num{ 0 };
-        bool          _valid{ false };
+        /**
+         * \brief Записать в лог пропущенные строки пакета (до лимита
+         * файла), сдвинуть номер строки на число строк пакета и учесть
+         * пакет в метриках
+         * \param bytes_ байт файла, из которых разобран пакет
+         */
+        void report(column_batch<Price>& batch_, std::size_t bytes_) noexcept;
+
+        /**
+         * \brief Добавить разобранный пакет в строящийся кэш
+         */
+        void store(const column_batch<Price>& batch_) noexcept;
+
+        /**
+         * \brief Источник прочитан: сохранить кэш, если не было ошибок чтения
+         */
+        void finish_cache() noexcept;
+
+        /**
+         * \brief Следующий блок из кэша
+         * \return false если записи кончились
+         */
+        [[nodiscard]] bool refill_cached();
+
+        /**
+         * \brief Прочитать заголовок и найти нужные колонки
+         */
+        [[nodiscard]] bool read_header() noexcept;
+
+        /**
+         * \brief Перейти к строке, начинающейся в offset_
+         * \return false при ошибке чтения
+         */
+        [[nodiscard]] bool seek(std::uint64_t offset_, bool direct_io_) noexcept;
+
+        /**
+         * \brief Отсечь записи пакета вне _range
+         *
+         * Файл упорядочен по receive_ts: после первой записи с ts >= to
+         * курсор заканчивается.
+         */
+        void clip(column_batch<Price>& batch_) noexcept;
+
+        /**
+         * \brief Ключ группы файла всем записям пакета (group_mode::mask)
+         * \return false, если не хватило памяти
+         */
+        [[nodiscard]] bool tag(column_batch<Price>& batch_) noexcept;
+
+        /**
+         * \brief Разобрать следующий блок файла в пакет записей
+         * \return false если файл закончился
+         */
+        [[nodiscard]] bool refill() noexcept;
+
+        /**
+         * \brief Следующий пакет из очереди задач пула
+         * \return false если файл закончился
+         */
+        [[nodiscard]] bool refill_parallel() noexcept;
+
+        /**
+         * \brief Поставить задачи разбора следующих фрагментов,
+         * пока очередь не заполнена
+         */
+        void submit_chunks();
+
+        /**
+         * \brief Непрочитанные данные: срез отображения или буфера
+         */
+        [[nodiscard]] std::string_view window() const noexcept;
+
+        /**
+         * \brief Дочитать данные так, чтобы окно было не меньше size_ байт
+         */
+        void fill(std::size_t size_) noexcept;
+
+        /**
+         * \brief Отметить первые n_ байт окна прочитанными
+         */
+        void consume(std::size_t n_) noexcept;
+
+        /**
+         * \brief Пропустить записи, выданные до контрольной точки
+         */
+        void discard() noexcept;
+
+        /**
+         * \brief Окно содержит хвост файла (дальше данных нет)
+         */
+        [[nodiscard]] bool at_eof() const noexcept;
+
+        fs::path                 _path;
+        file_metrics*            _metrics;
+        std::ifstream            _file;
+        std::vector<char>        _buffer;
+        std::size_t              _buf_begin{ 0 };
+        std::size_t              _buf_end{ 0 };
+        bool                     _file_eof{ false };
+        mapped_file              _map;
+        uring_file_reader        _uring;
+        compressed_reader        _compressed;
+        std::size_t              _map_pos{ 0 };
+        std::size_t              _prefetch_pos{ 0 };
+        std::size_t              _block_size{ k_read_buffer_size };
+        line_scanner             _scanner;
+        std::vector<line_fields> _fields;
+        column_batch<Price>      _batch;
+        std::size_t              _batch_pos{ 0 };
+        record_type              _current{};
+        int                      _ts_col{ -1 };
+        int                      _price_col{ -1 };
+        int                      _group_col{ -1 };
+        int                      _quantity_col{ -1 };
+        record_groups            _groups;
+        bool                     _quantity{ false };
+        std::size_t              _line_num{ 0 };
+        bool                     _valid{ false };
+        bool                     _read_failed{ false };
+        cache_reader             _cache_in;
+        cache_writer             _cache_out;
+        ts_range                 _range;
+        std::uint64_t            _offset{ 0 };     ///< смещение после seek()
+        std::uint64_t            _position{ 0 };   ///< смещение начала окна в файле
+        std::uint64_t            _batch_offset{ 0 }; ///< начало строки блока пакета
+        std::uint64_t            _batch_line{ 0 };   ///< строк данных до него
+        std::uint64_t            _batch_first{ 0 };  ///< записей в прошлых пакетах
+        std::uint64_t            _skip{ 0 };         ///< записей пропустить в start()
+        bool                     _range_begun{ false };
+        bool                     _range_done{ false };
+
+        using chunk_result = std::pair<column_batch<Price>, std::error_code>;
+
+        thread_pool*                          _pool{ nullptr };
+        positional_file                       _positional;
+        chunk_source                          _source;
+        std::size_t                           _data_begin{ 0 };
+        std::size_t                           _next_chunk{ 0 };
+        std::size_t                           _depth{ 0 };
+        std::deque<std::future<chunk_result>> _inflight;
+        bool                                  _started{ false };
     };
 
+    using file_cursor = basic_file_cursor<double>;
+
+    /**
+     * \brief Колонки пакета записей одного файла
+     */
+    template<class Price>
+    struct batch_view {
+        std::span<const std::uint64_t> ts;
+        std::span<const Price>         price;
+        std::span<const std::uint64_t> group;    ///< пусто, если групп нет
+        std::span<const double>        quantity; ///< пусто, если не запрошен
+    };
+
+    /**
+     * \brief Callback пакета записей: (receive_ts[], price[]) или (batch_view)
+     */
+    template<class F, class Price>
+    concept batch_callback = std::invocable<F&,
+        std::span<const std::uint64_t>, std::span<const Price>>
+        || std::invocable<F&, const batch_view<Price>&>;
+
+    /**
+     * \brief Callback одной записи
+     */
+    template<class F, class Price>
+    concept record_callback = std::invocable<F&, const basic_record<Price>&>;
+
+    // Нижняя граница длины строки входного файла: receive_ts и exchange_ts
+    // по 16 цифр, цена, объём, сторона и разделители
+    inline constexpr std::uint64_t k_min_record_bytes = 40;
+
+    /**
+     * \brief Оценка сверху числа записей файлов по их размерам
+     *
+     * Сжатые файлы не учитываются: степень сжатия заранее неизвестна.
+     */
+    [[nodiscard]] std::uint64_t estimate_records(std::span<const fs::path> paths_) noexcept;
+
+    /**
+     * \brief Приёмник контрольной точки: позиции всех файлов и число
+     *        выданных записей; false — прекратить чтение
+     */
+    using checkpoint_hook = std::function<bool(std::span<const file_checkpoint>, std::uint64_t)>;
+
     /**
      * \brief Потоковый читатель CSV файлов
      *
@@ -105,164 +427,870 @@ namespace csv_median {
     public:
         /**
          * \brief Создает читатель с внешним thread pool
-         * \param pool_ пул потоков для параллельного открытия файлов
+         * \param pool_            пул потоков для параллельного открытия файлов
+         * \param mode_            способ чтения входных файлов
+         * \param parallel_parse_  разбирать фрагменты файлов задачами пула
+         * \param direct_io_       O_DIRECT для read_mode::uring
+         * \param cache_           колоночный кэш входных файлов (cache.hpp)
          */
-        explicit csv_reader(thread_pool& pool_) noexcept;
+        explicit csv_reader(thread_pool& pool_,
+            read_mode mode_ = read_mode::stream,
+            bool parallel_parse_ = false,
+            bool direct_io_ = false,
+            bool cache_ = false) noexcept;
 
         /**
-         * \brief Записи в потоковом режиме
+         * \brief Записи в потоковом режиме, пакетами
+         *
+         * Пакет — подряд идущие в порядке слияния записи одного файла,
+         * колонки ts_[i] / price_[i]. Спаны действительны только
+         * во время вызова.
+         *
          * \param input_dir_  директория с входными файлами
          * \param masks_      маски имён файлов (пустой список — все файлы)
+         * \param on_batch_   callback для каждого пакета
+         * \tparam Price      тип цены записей: double или fixed_price
+         * \return код ошибки
+         */
+        template<class Price = double, class OnBatch>
+            requires batch_callback<OnBatch, Price>
+        [[nodiscard]] std::error_code
+            process_batches(const fs::path& input_dir_,
+                const std::vector<std::string>& masks_,
+                OnBatch&& on_batch_) noexcept;
+
+        /**
+         * \brief Записи в потоковом режиме, по одной
+         *
+         * Обёртка над process_batches: callback встраивается в цикл
+         * по пакету, если это не std::function.
+         *
          * \param on_record_  callback для каждой записи
          * \return код ошибки
          */
+        template<class Price = double, class OnRecord>
+            requires record_callback<OnRecord, Price>
         [[nodiscard]] std::error_code
             process(const fs::path& input_dir_,
                 const std::vector<std::string>& masks_,
-                std::function<void(const csv_record&)> on_record_) noexcept;
+                OnRecord&& on_record_) noexcept;
 
-    private:
+        /**
+         * \brief Записи дописываемых файлов, пакетами, до остановки
+         *
+         * Сначала дочитывает имеющееся, затем ждёт дописывания и новых
+         * файлов под маски. Сжатые файлы не читаются. Диапазон, индекс,
+         * кэш и параллельный разбор не действуют.
+         *
+         * \param on_batch_ как у process_batches
+         * \param on_idle_  () -> bool: всё прочитанное выдано; false —
+         *                  остановиться, выдав ждущие водяного знака записи
+         * \return код ошибки
+         */
+        template<class Price = double, class OnBatch, class OnIdle>
+            requires batch_callback<OnBatch, Price> && std::predicate<OnIdle&>
+        [[nodiscard]] std::error_code
+            follow_batches(const fs::path& input_dir_,
+                const std::vector<std::string>& masks_,
+                const follow_options& options_,
+                OnBatch&& on_batch_,
+                OnIdle&& on_idle_) noexcept;
+
+        /**
+         * \brief Выдавать только записи с receive_ts из range_
+         * \param index_ индексы файлов для перехода к range_.from;
+         *        файлы без индекса читаются с начала. Должен жить,
+         *        пока читатель используется
+         */
+        void set_range(const ts_range& range_, const index_table* index_ = nullptr) noexcept;
+
+        /**
+         * \brief Помечать записи ключом группы (batch_view::group)
+         * \param column_ имя колонки для group_mode::column
+         */
+        void set_groups(group_mode mode_, std::string column_ = {}) noexcept;
+
+        /**
+         * \brief Разбирать колонку quantity (batch_view::quantity)
+         */
+        void set_quantity(bool quantity_) noexcept;
+
+        /**
+         * \brief Отдавать контрольную точку process_batches каждые
+         *        every_records_ записей и по request_checkpoint()
+         */
+        void set_checkpoints(std::uint64_t every_records_, checkpoint_hook hook_) noexcept;
+
+        /**
+         * \brief Снять контрольную точку перед следующим пакетом
+         *
+         * Можно вызывать из callback пакета.
+         */
+        void request_checkpoint() noexcept;
+
+        /**
+         * \brief Продолжить с позиций контрольной точки
+         *
+         * Файлы директории должны совпадать с files_ по именам и
+         * отпечаткам, иначе process_batches вернёт bad_message.
+         */
+        void set_resume(std::vector<file_checkpoint> files_, std::uint64_t records_) noexcept;
+
+        /**
+         * \brief Входные файлы директории, подходящие под маски, по имени
+         */
         [[nodiscard]] std::tuple<std::vector<fs::path>, std::error_code>
             scan_directory(const fs::path& dir_,
                 const std::vector<std::string>& masks_) noexcept;
 
+    private:
+
         [[nodiscard]] bool matches_masks(
             const fs::path& path_,
             const std::vector<std::string>& masks_) const noexcept;
 
+        /**
+         * \brief Откуда записи файла берут ключ группы
+         */
+        [[nodiscard]] record_groups groups_of(
+            const fs::path& path_,
+            const std::vector<std::string>& masks_) const noexcept;
+
         thread_pool& _pool;
+        read_mode    _mode;
+        bool         _parallel;
+        bool         _direct_io;
+        bool         _cache;
+        ts_range     _range;
+        const index_table* _index{ nullptr };
+        group_mode   _group_mode{ group_mode::none };
+        std::string  _group_column;
+        bool         _quantity{ false };
+
+        std::uint64_t   _checkpoint_every{ 0 };
+        checkpoint_hook _checkpoint_hook;
+        bool            _checkpoint_requested{ false };
+        std::vector<file_checkpoint> _resume_files;
+        std::uint64_t   _resume_records{ 0 };
+        bool            _resume{ false };
     };
 
 
-    inline file_cursor::file_cursor(const fs::path& path_) noexcept
+    template<class Price>
+    inline basic_file_cursor<Price>::basic_file_cursor(const fs::path& path_,
+        read_mode mode_, thread_pool* pool_, bool direct_io_, bool cache_,
+        const ts_range& range_, const cursor_position& start_, const record_groups& groups_,
+        bool quantity_) noexcept
         : _path{ path_ }
+        , _metrics{ &file_metrics_for(path_) }
+        , _groups{ groups_ }
+        , _quantity{ quantity_ }
+        , _range{ range_ }
+        , _skip{ start_.skip }
+        , _range_begun{ range_.from == 0 }
     {
-        // меньше системных вызовов
-        _file.rdbuf()->pubsetbuf(nullptr, static_cast<std::streamsize>(
-            k_read_buffer_size));
-        _file.open(path_);
+        // Кэш хранит файл целиком: частичное чтение его испортит;
+        // колонки группы в нём нет
+        if (cache_ && range_.whole() && start_.offset == 0
+            && groups_.mode != group_mode::column && !quantity_)
+        {
+            cache_source_info source;
+            if (const auto err = fingerprint(path_, source)) {
+                spdlog::warn("Can't check cache of {}: {}", path_.string(), err.message());
+            }
+            else if (!_cache_in.open(cache_path(path_), source)) {
+                spdlog::info("Using cache of {}: {} records", path_.filename().string(),
+                    _cache_in.records());
+                if (_cache_in.skipped() > 0) {
+                    spdlog::warn("{}: {} invalid lines were skipped when the cache was built",
+                        path_.filename().string(), _cache_in.skipped());
+                }
+                _started = true;
+                _valid = advance();
+                discard();
+                return;
+            }
+            else if (const auto write_err = _cache_out.open(cache_path(path_), source)) {
+                spdlog::warn("Can't create cache for {}: {}", path_.string(),
+                    write_err.message());
+            }
+        }
 
-        if (!_file.is_open()) [[unlikely]] {
-            spdlog::error("Failed to open file: {}", path_.string());
-            return;
+        if (const auto codec = compression_of(path_); codec != compression::none) {
+            if (const auto err = _compressed.open(path_, codec, pool_)) {
+                spdlog::error("Can't decompress {} ({}): {}", path_.string(),
+                    compression_name(codec), err.message());
+                return;
+            }
+        }
+        else if (mode_ == read_mode::mmap) {
+            if (const auto err = _map.open(path_)) {
+                spdlog::warn("Can't mmap {} ({}), falling back to stream",
+                    path_.string(), err.message());
+            }
+        }
+        else if (mode_ == read_mode::uring) {
+            if (const auto err = _uring.open(path_, direct_io_)) {
+                spdlog::warn("Can't read {} with io_uring ({}), falling back to stream",
+                    path_.string(), err.message());
+            }
+            else if (direct_io_ && !_uring.direct()) {
+                spdlog::warn("O_DIRECT is not supported for {}, using page cache",
+                    path_.string());
+            }
         }
 
-        std::string header;
-        if (!std::getline(_file, header)) [[unlikely]] {
-            spdlog::warn("File is empty: {}", path_.string());
+        if (!_map.is_open() && !_uring.is_open() && !_compressed.is_open()) {
+            // Блоки читаются целиком в _buffer, буфер ifstream не нужен
+            _file.rdbuf()->pubsetbuf(nullptr, 0);
+            _file.open(path_, std::ios::in | std::ios::binary);
+
+            if (!_file.is_open()) [[unlikely]] {
+                spdlog::error("Failed to open file: {}", path_.string());
+                return;
+            }
+        }
+
+        if (!read_header()) [[unlikely]] {
             return;
         }
 
-        _ts_col = find_column(header, "receive_ts");
-        _price_col = find_column(header, "price");
+        // Смещение первой строки данных в файле
+        std::size_t data_begin = _map.is_open() ? _map_pos : _buf_begin;
+        const std::size_t header_end = data_begin;
+        if (start_.offset > data_begin && !_compressed.is_open()) {
+            if (!seek(start_.offset, direct_io_)) [[unlikely]] {
+                return;
+            }
+            data_begin = static_cast<std::size_t>(start_.offset);
+            if (start_.line != 0) {
+                // Номер строки известен из контрольной точки
+                _offset = 0;
+                _line_num = static_cast<std::size_t>(start_.line);
+            }
+        }
 
-        if (_ts_col < 0 || _price_col < 0) [[unlikely]] {
-            spdlog::error("File {} missing required columns receive_ts/price",
-                path_.string());
+        if (pool_ != nullptr && !_compressed.is_open()) {
+            // Фрагменты читаются по смещению; ifstream нужен был для заголовка
+            // Первый фрагмент — с data_begin: это начало строки (индекс) или
+            // начало фрагмента прошлого запуска (контрольная точка)
+            if (_map.is_open()) {
+                _source = chunk_source{ _map.view(), nullptr, _map.view().size() };
+                _data_begin = header_end;
+                _pool = pool_;
+            }
+            else if (!_positional.open(path_)) {
+                // Фрагменты читаются задачами пула одновременно (pread)
+                _source = chunk_source{ {}, &_positional, _positional.size() };
+                _data_begin = header_end;
+                _file.close();
+                _uring.close();
+                _pool = pool_;
+            }
+        }
+
+        if (_pool != nullptr) {
+            _next_chunk = data_begin;
+            _depth = std::max<std::size_t>(2, _pool->thread_count());
+            try {
+                submit_chunks();
+            }
+            catch (const std::exception& e) {
+                spdlog::error("Can't schedule parsing of {}: {}", _path.string(), e.what());
+                return;
+            }
+            _valid = true;
             return;
         }
+
+        _started = true;
         _valid = advance();
+        discard();
     }
 
-    inline bool file_cursor::is_valid() const noexcept {
+    template<class Price>
+    inline basic_file_cursor<Price>::~basic_file_cursor() noexcept {
+        for (auto& chunk : _inflight) {
+            if (chunk.valid()) {
+                chunk.wait();
+            }
+        }
+    }
+
+    template<class Price>
+    inline bool basic_file_cursor<Price>::start() noexcept {
+        if (!_started) {
+            _started = true;
+            _valid = _valid && advance();
+            discard();
+        }
         return _valid;
     }
 
-    inline const csv_record& file_cursor::current() const noexcept {
-        return _current;
+    template<class Price>
+    inline void basic_file_cursor<Price>::discard() noexcept {
+        while (_valid && _skip > 0) {
+            const auto n = static_cast<std::size_t>(std::min<std::uint64_t>(
+                _skip, _batch.size() - _batch_pos));
+            _skip -= n;
+            _valid = skip(n);
+        }
+        _skip = 0;
     }
 
-    inline std::string file_cursor::filename() const noexcept {
-        return _path.filename().string();
+    template<class Price>
+    inline bool basic_file_cursor<Price>::is_valid() const noexcept {
+        return _valid;
     }
 
-    inline int file_cursor::find_column(
-        std::string_view header_,
-        std::string_view col_) const noexcept
+    template<class Price>
+    inline auto basic_file_cursor<Price>::current() const noexcept
+        -> const record_type&
     {
-        std::size_t start = 0;
-        int idx = 0;
+        return _current;
+    }
 
-        while (start <= header_.size()) {
-            const auto pos = header_.find(';', start);
-            const auto end = (pos == std::string_view::npos)
-                ? header_.size() : pos;
+    template<class Price>
+    inline std::span<const std::uint64_t> basic_file_cursor<Price>::pending_ts() const noexcept {
+        return std::span{ _batch.ts }.subspan(_batch_pos);
+    }
 
-            if (header_.substr(start, end - start) == col_) {
-                return idx;
-            }
-            ++idx;
-            start = (pos == std::string_view::npos) ? header_.size() + 1 : pos + 1;
+    template<class Price>
+    inline std::span<const Price> basic_file_cursor<Price>::pending_price() const noexcept {
+        return std::span{ _batch.price }.subspan(_batch_pos);
+    }
+
+    template<class Price>
+    inline std::span<const std::uint64_t> basic_file_cursor<Price>::pending_group() const noexcept {
+        if (_batch.group.empty()) {
+            return {};
         }
-        return -1;
+        return std::span{ _batch.group }.subspan(_batch_pos);
     }
 
-    inline bool file_cursor::parse_line(std::string_view line_) noexcept {
-        const auto ts_idx = static_cast<std::size_t>(_ts_col);
-        const auto price_idx = static_cast<std::size_t>(_price_col);
-        const auto max_idx = std::max(ts_idx, price_idx);
+    template<class Price>
+    inline std::span<const double> basic_file_cursor<Price>::pending_quantity() const noexcept {
+        if (_batch.quantity.empty()) {
+            return {};
+        }
+        return std::span{ _batch.quantity }.subspan(_batch_pos);
+    }
 
-        std::size_t start = 0;
-        std::size_t col = 0;
-        std::string_view ts_sv, price_sv;
+    template<class Price>
+    inline bool basic_file_cursor<Price>::skip(std::size_t n_) noexcept {
+        _batch_pos += n_ - 1;
+        return advance();
+    }
 
-        while (col <= max_idx) {
-            const auto pos = line_.find(';', start);
-            const auto end = (pos == std::string_view::npos)
-                ? line_.size() : pos;
+    template<class Price>
+    inline cursor_position basic_file_cursor<Price>::position() const noexcept {
+        if (!_valid) {
+            return { 0, 0, 0, true };
+        }
+        if (!_cache_in.is_open() && !_compressed.is_open()) {
+            return { _batch_offset, _batch_line, _batch_pos, false };
+        }
+        return { 0, 0, _batch_first + _batch_pos, false };
+    }
 
-            if (col == ts_idx) { ts_sv = line_.substr(start, end - start); }
-            if (col == price_idx) { price_sv = line_.substr(start, end - start); }
+    template<class Price>
+    inline std::string basic_file_cursor<Price>::filename() const noexcept {
+        return _path.filename().string();
+    }
 
-            if (pos == std::string_view::npos) { break; }
-            ++col;
-            start = pos + 1;
+    template<class Price>
+    inline bool basic_file_cursor<Price>::read_header() noexcept {
+        fill(_block_size);
+        auto data = window();
+        auto pos = data.find('\n');
+
+        // Заголовок длиннее блока — расширяем окно
+        while (pos == std::string_view::npos && !at_eof()) {
+            _block_size *= 2;
+            fill(_block_size);
+            data = window();
+            pos = data.find('\n');
         }
 
-        if (ts_sv.empty() || price_sv.empty()) [[unlikely]] {
+        if (data.empty()) [[unlikely]] {
+            spdlog::warn("File is empty: {}", _path.string());
             return false;
         }
 
-        const auto [ts_end, ts_err] = std::from_chars(
-            ts_sv.data(), ts_sv.data() + ts_sv.size(), _current.receive_ts);
+        auto header = data.substr(0, pos);
+        if (!header.empty() && header.back() == '\r') {
+            header.remove_suffix(1);
+        }
 
-        if (ts_err != std::errc{}) [[unlikely]] {
-            spdlog::warn("{}:{} - invalid receive_ts, skipping",
-                _path.filename().string(), _line_num);
+        _ts_col = find_column(header, "receive_ts");
+        _price_col = find_column(header, "price");
+        consume(pos == std::string_view::npos ? data.size() : pos + 1);
+
+        if (_ts_col < 0 || _price_col < 0) [[unlikely]] {
+            spdlog::error("File {} missing required columns receive_ts/price",
+                _path.string());
             return false;
         }
+        if (_groups.mode == group_mode::column) {
+            _group_col = find_column(header, _groups.column);
+            if (_group_col < 0) [[unlikely]] {
+                spdlog::error("File {} missing group column {}", _path.string(), _groups.column);
+                return false;
+            }
+        }
 
-        const auto [p_end, p_err] = std::from_chars(
-            price_sv.data(), price_sv.data() + price_sv.size(), _current.price);
+        if (_quantity) {
+            _quantity_col = find_column(header, "quantity");
+            if (_quantity_col < 0) [[unlikely]] {
+                spdlog::error("File {} missing column quantity", _path.string());
+                return false;
+            }
+        }
 
-        if (p_err != std::errc{}) [[unlikely]] {
-            spdlog::warn("{}:{} - invalid price, skipping",
-                _path.filename().string(), _line_num);
-            return false;
+        // Порядок полей — k_ts_field, k_price_field, k_group_field, k_quantity_field
+        const int columns[] = { _ts_col, _price_col, _group_col, _quantity_col };
+        _scanner = line_scanner{ columns };
+        return true;
+    }
+
+    template<class Price>
+    inline bool basic_file_cursor<Price>::seek(std::uint64_t offset_, bool direct_io_) noexcept {
+        _offset = offset_;
+        if (_map.is_open()) {
+            _map_pos = static_cast<std::size_t>(std::min<std::uint64_t>(offset_, _map.view().size()));
+            _position = _map_pos;
+            return true;
         }
 
+        _buf_begin = 0;
+        _buf_end = 0;
+        _file_eof = false;
+
+        if (_uring.is_open()) {
+            // Чтение с выровненного смещения, лишнее начало отбрасываем
+            if (const auto err = _uring.open(_path, direct_io_, k_uring_read_depth,
+                static_cast<std::size_t>(offset_)))
+            {
+                spdlog::error("Can't seek in {}: {}", _path.string(), err.message());
+                return false;
+            }
+            const auto skip = static_cast<std::size_t>(offset_ % k_io_align);
+            fill(std::max(_block_size, skip));
+            consume(std::min(skip, _buf_end - _buf_begin));
+            _position = offset_;
+            return true;
+        }
+
+        _file.clear();
+        if (!_file.seekg(static_cast<std::streamoff>(offset_))) [[unlikely]] {
+            spdlog::error("Can't seek in {} to {}", _path.string(), offset_);
+            return false;
+        }
+        _position = offset_;
         return true;
     }
 
-    inline bool file_cursor::advance() noexcept {
-        while (std::getline(_file, _line)) {
-            ++_line_num;
+    template<class Price>
+    inline void basic_file_cursor<Price>::clip(column_batch<Price>& batch_) noexcept {
+        if (_range.whole()) {
+            return;
+        }
+        if (!_range_begun) {
+            const auto first = std::ranges::find_if(batch_.ts,
+                [from = _range.from](std::uint64_t ts_) { return ts_ >= from; });
+            const auto n = first - batch_.ts.begin();
+            batch_.ts.erase(batch_.ts.begin(), first);
+            batch_.price.erase(batch_.price.begin(), batch_.price.begin() + n);
+            if (!batch_.group.empty()) {
+                batch_.group.erase(batch_.group.begin(), batch_.group.begin() + n);
+            }
+            if (!batch_.quantity.empty()) {
+                batch_.quantity.erase(batch_.quantity.begin(), batch_.quantity.begin() + n);
+            }
+            _range_begun = !batch_.ts.empty();
+        }
+
+        const auto last = std::ranges::find_if(batch_.ts,
+            [to = _range.to](std::uint64_t ts_) { return ts_ >= to; });
+        if (last != batch_.ts.end()) {
+            const auto n = static_cast<std::size_t>(last - batch_.ts.begin());
+            batch_.ts.resize(n);
+            batch_.price.resize(n);
+            if (!batch_.group.empty()) {
+                batch_.group.resize(n);
+            }
+            if (!batch_.quantity.empty()) {
+                batch_.quantity.resize(n);
+            }
+            _range_done = true;
+        }
+    }
+
+    template<class Price>
+    inline bool basic_file_cursor<Price>::tag(column_batch<Price>& batch_) noexcept {
+        if (_groups.mode != group_mode::mask) {
+            return true;
+        }
+        try {
+            batch_.group.assign(batch_.size(), _groups.key);
+            return true;
+        }
+        catch (const std::bad_alloc&) {
+            spdlog::error("Out of memory reading {}", _path.string());
+            batch_.clear();
+            return false;
+        }
+    }
+
+    template<class Price>
+    inline std::string_view basic_file_cursor<Price>::window() const noexcept {
+        if (_map.is_open()) {
+            const auto data = _map.view();
+            return data.substr(_map_pos, _block_size);
+        }
+        return { _buffer.data() + _buf_begin, _buf_end - _buf_begin };
+    }
+
+    template<class Price>
+    inline bool basic_file_cursor<Price>::at_eof() const noexcept {
+        if (_map.is_open()) {
+            return _map_pos + _block_size >= _map.view().size();
+        }
+        return _file_eof;
+    }
+
+    template<class Price>
+    inline void basic_file_cursor<Price>::fill(std::size_t size_) noexcept {
+        if (_map.is_open()) {
+            // Заранее просим ядро подгрузить следующее окно
+            if (_map_pos >= _prefetch_pos) {
+                _prefetch_pos = _map_pos + k_readahead_size / 2;
+                _map.prefetch(_prefetch_pos);
+            }
+            return;
+        }
+
+        if (_file_eof || _buf_end - _buf_begin >= size_) {
+            return;
+        }
+
+        // Переносим непрочитанный хвост в начало буфера
+        const std::size_t tail = _buf_end - _buf_begin;
+        if (_buf_begin > 0) {
+            std::memmove(_buffer.data(), _buffer.data() + _buf_begin, tail);
+            _buf_begin = 0;
+            _buf_end = tail;
+        }
+        if (_buffer.size() < size_) {
+            _buffer.resize(size_);
+        }
+
+        while (_buf_end < size_ && !_file_eof && _uring.is_open()) {
+            std::error_code err;
+            const auto n = _uring.read(_buffer.data() + _buf_end, size_ - _buf_end, err);
+            _buf_end += n;
+            if (err) [[unlikely]] {
+                spdlog::error("Read error: {}: {}", _path.string(), err.message());
+                _read_failed = true;
+            }
+            if (n == 0) {
+                _file_eof = true;
+            }
+        }
+
+        while (_buf_end < size_ && !_file_eof && _compressed.is_open()) {
+            std::error_code err;
+            const auto n = _compressed.read(_buffer.data() + _buf_end, size_ - _buf_end, err);
+            _buf_end += n;
+            if (err) [[unlikely]] {
+                spdlog::error("Decompression error: {}: {}", _path.string(), err.message());
+                _read_failed = true;
+            }
+            if (n == 0) {
+                _file_eof = true;
+            }
+        }
+
+        while (_buf_end < size_ && !_file_eof) {
+            _file.read(_buffer.data() + _buf_end,
+                static_cast<std::streamsize>(size_ - _buf_end));
+            _buf_end += static_cast<std::size_t>(_file.gcount());
+            if (!_file) {
+                if (!_file.eof()) [[unlikely]] {
+                    spdlog::error("Read error: {}", _path.string());
+                    _read_failed = true;
+                }
+                _file_eof = true;
+            }
+        }
+    }
+
+    template<class Price>
+    inline void basic_file_cursor<Price>::consume(std::size_t n_) noexcept {
+        _position += n_;
+        if (_map.is_open()) {
+            _map_pos += n_;
+            return;
+        }
+        _buf_begin += n_;
+    }
+
+    template<class Price>
+    inline void basic_file_cursor<Price>::report(column_batch<Price>& batch_,
+        std::size_t bytes_) noexcept
+    {
+        add_metric(counter::bytes_read, bytes_);
+        add_metric(counter::records_parsed, batch_.size());
+        add_metric(counter::records_skipped, batch_.issues.size());
+        _metrics->add(bytes_, batch_.size(), batch_.issues.size());
+
+        // Остальные строки с ошибкой попадут в итог файла в конце расчёта
+        const std::size_t shown = _metrics->log_slots(batch_.issues.size());
+        if (shown != 0) {
+            const std::string name = _path.filename().string();
+            for (const auto& issue : std::span{ batch_.issues }.first(shown)) {
+                const auto* const what =
+                    issue.what == parse_issue::field::receive_ts ? "receive_ts"
+                    : issue.what == parse_issue::field::price ? "price" : "quantity";
+                if (_offset != 0) {
+                    // После seek() номер строки от начала файла неизвестен
+                    spdlog::warn("{}: line {} after byte {} - invalid {}, skipping",
+                        name, _line_num + issue.line + 1, _offset, what);
+                }
+                else {
+                    spdlog::warn("{}:{} - invalid {}, skipping",
+                        name, _line_num + issue.line + 1, what);
+                }
+            }
+        }
+        if (shown < batch_.issues.size()) {
+            _metrics->mute();
+        }
+        _line_num += batch_.lines;
+        batch_.issues.clear();
+        batch_.lines = 0;
+    }
+
+    template<class Price>
+    inline bool basic_file_cursor<Price>::refill() noexcept {
+        _batch_first += _batch.size();
+        _batch.clear();
+        _batch_pos = 0;
+
+        if (_range_done) {
+            return false;
+        }
+        if (_cache_in.is_open()) {
+            return refill_cached();
+        }
+        if (_pool != nullptr) {
+            return refill_parallel();
+        }
+
+        while (_batch.empty()) {
+            fill(_block_size);
+            const auto data = window();
+            const bool final = at_eof();
+
+            if (data.empty() && final) {
+                finish_cache();
+                return false;
+            }
 
-            if (_line.empty()) [[unlikely]] {
+            // Разбор всех строк блока подряд, без обращения к источнику
+            const auto consumed = parse_lines(_scanner, data, final, _fields, _batch);
+            if (consumed == 0) {
+                // Строка длиннее блока — расширяем окно
+                _block_size *= 2;
                 continue;
             }
 
-            if (parse_line(_line)) {
-                return true;
+            _batch_offset = _position;
+            _batch_line = _line_num;
+            store(_batch);
+            report(_batch, consumed);
+            consume(consumed);
+            clip(_batch);
+            if (_range_done && _batch.empty()) {
+                return false;
             }
         }
-        _valid = false;
+        return tag(_batch);
+    }
+
+    template<class Price>
+    inline void basic_file_cursor<Price>::store(const column_batch<Price>& batch_) noexcept {
+        if (_cache_out.is_open()) {
+            _cache_out.append(batch_);
+        }
+    }
+
+    template<class Price>
+    inline void basic_file_cursor<Price>::finish_cache() noexcept {
+        if (!_cache_out.is_open()) {
+            return;
+        }
+        if (_read_failed) {
+            _cache_out.abandon();
+            return;
+        }
+        if (const auto err = _cache_out.commit()) {
+            spdlog::warn("Can't save cache for {}: {}", _path.string(), err.message());
+        }
+    }
+
+    template<class Price>
+    inline bool basic_file_cursor<Price>::refill_cached() {
+        std::error_code err;
+        if (_cache_in.next(_batch, err)) {
+            add_metric(counter::records_parsed, _batch.size());
+            _metrics->add(0, _batch.size(), 0);
+            return tag(_batch);
+        }
+        if (err) [[unlikely]] {
+            spdlog::error("Cache of {} is corrupt: {}", _path.string(), err.message());
+        }
         return false;
     }
 
-    inline csv_reader::csv_reader(thread_pool& pool_) noexcept
+    template<class Price>
+    inline void basic_file_cursor<Price>::submit_chunks() {
+        while (_inflight.size() < _depth && _next_chunk < _source.size) {
+            const std::size_t begin = _next_chunk;
+            const std::size_t end = begin + k_parse_chunk_size;
+            _next_chunk = end;
+
+            if (_map.is_open()) {
+                _map.prefetch(begin);
+            }
+            _inflight.push_back(_pool->submit(
+                [source = _source, scanner = _scanner, data_begin = _data_begin, begin, end] {
+                    std::error_code err;
+                    auto batch = parse_chunk<Price>(source, scanner, data_begin, begin, end, err);
+                    return chunk_result{ std::move(batch), err };
+                }));
+        }
+        set_gauge(gauge::parse_queue, _inflight.size());
+    }
+
+    template<class Price>
+    inline bool basic_file_cursor<Price>::refill_parallel() noexcept {
+        try {
+            while (true) {
+                submit_chunks();
+                if (_inflight.empty()) {
+                    finish_cache();
+                    return false;
+                }
+
+                // Фрагменты идут подряд по k_parse_chunk_size от _next_chunk назад
+                _batch_offset = _next_chunk - _inflight.size() * k_parse_chunk_size;
+                _batch_line = 0;
+                auto& next = _inflight.front();
+                if (next.wait_for(std::chrono::seconds{ 0 }) != std::future_status::ready) {
+                    // Слияние обогнало разбор: пулу не хватает потоков или диска
+                    add_metric(counter::merge_stalls);
+                    if (metrics_enabled()) {
+                        const stopwatch wait;
+                        next.wait();
+                        record_latency(latency::merge_stall, wait.elapsed_ns());
+                    }
+                }
+                auto [batch, err] = next.get();
+                _inflight.pop_front();
+
+                if (err) [[unlikely]] {
+                    spdlog::error("Read error: {}: {}", _path.string(), err.message());
+                    _cache_out.abandon();
+                    return false;
+                }
+
+                _batch = std::move(batch);
+                store(_batch);
+                report(_batch, std::min<std::size_t>(k_parse_chunk_size,
+                    _source.size - std::min(_source.size, _batch_offset)));
+                clip(_batch);
+                if (!_batch.empty()) {
+                    return tag(_batch);
+                }
+                if (_range_done) {
+                    return false;
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            spdlog::error("Parsing of {} failed: {}", _path.string(), e.what());
+            return false;
+        }
+    }
+
+    template<class Price>
+    inline bool basic_file_cursor<Price>::advance() noexcept {
+        if (++_batch_pos >= _batch.size()) {
+            if (!refill()) {
+                _valid = false;
+                return false;
+            }
+        }
+        _current = record_type{ _batch.ts[_batch_pos], _batch.price[_batch_pos] };
+        return true;
+    }
+
+    inline std::uint64_t estimate_records(std::span<const fs::path> paths_) noexcept {
+        std::uint64_t bytes = 0;
+        for (const auto& path : paths_) {
+            if (compression_of(path) != compression::none) {
+                continue;
+            }
+            std::error_code err;
+            if (const auto size = fs::file_size(path, err); !err) {
+                bytes += size;
+            }
+        }
+        return bytes / k_min_record_bytes;
+    }
+
+    inline csv_reader::csv_reader(thread_pool& pool_, read_mode mode_,
+        bool parallel_parse_, bool direct_io_, bool cache_) noexcept
         : _pool{ pool_ }
+        , _mode{ mode_ }
+        , _parallel{ parallel_parse_ }
+        , _direct_io{ direct_io_ }
+        , _cache{ cache_ }
+    {
+    }
+
+    inline void csv_reader::set_range(const ts_range& range_, const index_table* index_) noexcept {
+        _range = range_;
+        _index = index_;
+    }
+
+    inline void csv_reader::set_groups(group_mode mode_, std::string column_) noexcept {
+        _group_mode = mode_;
+        _group_column = std::move(column_);
+    }
+
+    inline void csv_reader::set_quantity(bool quantity_) noexcept {
+        _quantity = quantity_;
+    }
+
+    inline void csv_reader::set_checkpoints(std::uint64_t every_records_,
+        checkpoint_hook hook_) noexcept
     {
+        _checkpoint_every = every_records_;
+        _checkpoint_hook = std::move(hook_);
+    }
+
+    inline void csv_reader::request_checkpoint() noexcept {
+        _checkpoint_requested = true;
+    }
+
+    inline void csv_reader::set_resume(std::vector<file_checkpoint> files_,
+        std::uint64_t records_) noexcept
+    {
+        _resume_files = std::move(files_);
+        _resume_records = records_;
+        _resume = true;
     }
 
     inline bool csv_reader::matches_masks(
@@ -272,12 +1300,28 @@ namespace csv_median {
         if (masks_.empty()) {
             return true;
         }
-        const auto stem = path_.stem().string();
+        // Маски сверяются с основой имени: "trades.csv.zst" -> "trades"
+        const auto stem = uncompressed_name(path_).stem().string();
         return std::ranges::any_of(masks_, [&stem](const auto& mask) {
             return stem.find(mask) != std::string::npos;
             });
     }
 
+    inline record_groups csv_reader::groups_of(
+        const fs::path& path_,
+        const std::vector<std::string>& masks_) const noexcept
+    {
+        record_groups groups{ _group_mode, 0, _group_column };
+        if (_group_mode == group_mode::mask) {
+            // Группа файла — первая маска, под которую он подходит
+            const auto stem = uncompressed_name(path_).stem().string();
+            const auto mask = std::ranges::find_if(masks_,
+                [&stem](const auto& mask_) { return stem.find(mask_) != std::string::npos; });
+            groups.key = (mask != masks_.end()) ? group_key(*mask) : group_key({});
+        }
+        return groups;
+    }
+
     inline std::tuple<std::vector<fs::path>, std::error_code>
         csv_reader::scan_directory(
             const fs::path& dir_,
@@ -296,7 +1340,7 @@ namespace csv_median {
         try {
             for (const auto& entry : fs::directory_iterator{ dir_ }) {
                 if (!entry.is_regular_file()) { continue; }
-                if (entry.path().extension() != ".csv") { continue; }
+                if (uncompressed_name(entry.path()).extension() != ".csv") { continue; }
                 if (matches_masks(entry.path(), masks_)) {
                     paths.push_back(entry.path());
                 }
@@ -311,11 +1355,29 @@ namespace csv_median {
         return { std::move(paths), {} };
     }
 
+    template<class Price, class OnRecord>
+        requires record_callback<OnRecord, Price>
     inline std::error_code
         csv_reader::process(
             const fs::path& input_dir_,
             const std::vector<std::string>& masks_,
-            std::function<void(const csv_record&)> on_record_) noexcept
+            OnRecord&& on_record_) noexcept
+    {
+        return process_batches<Price>(input_dir_, masks_,
+            [&on_record_](std::span<const std::uint64_t> ts_, std::span<const Price> price_) {
+                for (std::size_t i = 0; i < ts_.size(); ++i) {
+                    on_record_(basic_record<Price>{ ts_[i], price_[i] });
+                }
+            });
+    }
+
+    template<class Price, class OnBatch>
+        requires batch_callback<OnBatch, Price>
+    inline std::error_code
+        csv_reader::process_batches(
+            const fs::path& input_dir_,
+            const std::vector<std::string>& masks_,
+            OnBatch&& on_batch_) noexcept
     {
         auto [paths, scan_err] = scan_directory(input_dir_, masks_);
         if (scan_err) {
@@ -329,26 +1391,71 @@ namespace csv_median {
 
         spdlog::info("Files found: {}", paths.size());
 
-        using cursor_ptr = std::shared_ptr<file_cursor>;
-        std::vector<std::future<cursor_ptr>> futures;
-        futures.reserve(paths.size());
+        const bool checkpoints = _checkpoint_every != 0 && _checkpoint_hook;
+        std::vector<file_checkpoint> files;
+        try {
+            files.resize(paths.size());
+        }
+        catch (const std::bad_alloc&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+
+        // Открытие (и чтение первых блоков) — параллельно, по файлу на индекс
+        using cursor_ptr = std::shared_ptr<basic_file_cursor<Price>>;
+        std::vector<cursor_ptr> opened(paths.size());
+        std::vector<std::error_code> fingerprints(paths.size());
 
-        for (const auto& path : paths) {
-            futures.push_back(
-                _pool.submit([path]() -> cursor_ptr {
-                    return std::make_shared<file_cursor>(path);
-                    })
-            );
+        thread_pool* const parse_pool = _parallel ? &_pool : nullptr;
+        _pool.parallel_for(paths.size(), [&](std::size_t i_) {
+            files[i_].path = paths[i_];
+            if (checkpoints || _resume) {
+                fingerprints[i_] = fingerprint(paths[i_], files[i_].source);
+            }
+            cursor_position start;
+            if (_resume) {
+                if (i_ < _resume_files.size()) {
+                    start = _resume_files[i_].position;
+                }
+                if (start.done) {
+                    return;
+                }
+            }
+            else if (_index != nullptr && _range.from != 0) {
+                if (const auto it = _index->find(paths[i_]); it != _index->end()) {
+                    start.offset = it->second.seek_offset(_range.from);
+                }
+            }
+            opened[i_] = std::make_shared<basic_file_cursor<Price>>(
+                paths[i_], _mode, parse_pool, _direct_io, _cache, _range, start,
+                groups_of(paths[i_], masks_), _quantity);
+            }, 1);
+
+        for (std::size_t i = 0; i < paths.size(); ++i) {
+            if (fingerprints[i]) {
+                spdlog::error("Can't fingerprint {}: {}", paths[i].string(),
+                    fingerprints[i].message());
+                return fingerprints[i];
+            }
+            // Продолжение только по тем же файлам в том же состоянии
+            if (_resume && (i >= _resume_files.size() || paths[i] != _resume_files[i].path
+                || files[i].source != _resume_files[i].source))
+            {
+                spdlog::error("{} changed since the checkpoint", paths[i].string());
+                return std::make_error_code(std::errc::bad_message);
+            }
+        }
+        if (_resume && paths.size() != _resume_files.size()) {
+            spdlog::error("Input files changed since the checkpoint");
+            return std::make_error_code(std::errc::bad_message);
         }
 
         std::vector<cursor_ptr> cursors;
         cursors.reserve(paths.size());
 
-        for (auto& f : futures) {
-            auto cursor = f.get();
-            if (cursor->is_valid()) {
+        for (const auto& cursor : opened) {
+            if (cursor && cursor->start()) {
                 spdlog::info("  - {}", cursor->filename());
-                cursors.push_back(std::move(cursor));
+                cursors.push_back(cursor);
             }
         }
 
@@ -357,29 +1464,73 @@ namespace csv_median {
             return {};
         }
 
-        using heap_entry = std::pair<std::uint64_t, std::size_t>; // (ts, idx)
-
-        std::priority_queue<
-            heap_entry,
-            std::vector<heap_entry>,
-            std::greater<heap_entry>
-        > heap;
-
-        for (std::size_t i = 0; i < cursors.size(); ++i) {
-            heap.emplace(cursors[i]->current().receive_ts, i);
+        std::vector<basic_file_cursor<Price>*> sources;
+        std::vector<std::uint64_t> keys;
+        sources.reserve(cursors.size());
+        keys.reserve(cursors.size());
+        for (const auto& cursor : cursors) {
+            sources.push_back(cursor.get());
+            keys.push_back(cursor->current().receive_ts);
         }
 
-        std::size_t total = 0;
+        loser_tree tree{ std::move(keys) };
+        std::uint64_t total = _resume ? _resume_records : 0;
+        std::uint64_t next_checkpoint = total + _checkpoint_every;
+        _checkpoint_requested = false;
+
+        while (!tree.empty()) {
+            // Все записи до позиций курсоров уже отданы on_batch_
+            if (checkpoints && (total >= next_checkpoint || _checkpoint_requested)) {
+                for (std::size_t i = 0; i < opened.size(); ++i) {
+                    files[i].position = opened[i] ? opened[i]->position()
+                        : cursor_position{ 0, 0, 0, true };
+                }
+                next_checkpoint = total + _checkpoint_every;
+                _checkpoint_requested = false;
+                if (!_checkpoint_hook(files, total)) {
+                    spdlog::info("Records processed: {}", total);
+                    return {};
+                }
+            }
 
-        while (!heap.empty()) {
-            const auto [ts, idx] = heap.top();
-            heap.pop();
+            const std::size_t idx = tree.winner();
+            auto& cursor = *sources[idx];
+            const auto ts_run = cursor.pending_ts();
+
+            // Записи курсора идут подряд, пока его ключ (ts, idx) меньше
+            // ключа второго источника — как при выдаче по одной
+            std::size_t run = ts_run.size();
+            if (const auto next = tree.runner_up(); next != loser_tree::npos) {
+                const std::uint64_t next_ts = tree.key(next);
+                const bool wins_ties = idx < next;
+                run = 1;
+                while (run < ts_run.size()
+                    && (ts_run[run] < next_ts || (wins_ties && ts_run[run] == next_ts)))
+                {
+                    ++run;
+                }
+            }
 
-            on_record_(cursors[idx]->current());
-            ++total;
+            if constexpr (std::invocable<OnBatch&, const batch_view<Price>&>) {
+                const auto group = cursor.pending_group();
+                const auto quantity = cursor.pending_quantity();
+                on_batch_(batch_view<Price>{ ts_run.first(run),
+                    cursor.pending_price().first(run),
+                    group.empty() ? group : group.first(run),
+                    quantity.empty() ? quantity : quantity.first(run) });
+            }
+            else {
+                on_batch_(ts_run.first(run), cursor.pending_price().first(run));
+            }
+            total += run;
+            add_metric(counter::merge_batches);
+            add_metric(counter::records_merged, run);
 
-            if (cursors[idx]->advance()) {
-                heap.emplace(cursors[idx]->current().receive_ts, idx);
+            if (cursor.skip(run)) {
+                tree.replace(cursor.current().receive_ts);
+            }
+            else {
+                tree.pop();
             }
         }
 
@@ -387,4 +1538,131 @@ namespace csv_median {
         return {};
     }
 
-}
\ No newline at end of file
+
+    template<class Price, class OnBatch, class OnIdle>
+        requires batch_callback<OnBatch, Price> && std::predicate<OnIdle&>
+    inline std::error_code
+        csv_reader::follow_batches(
+            const fs::path& input_dir_,
+            const std::vector<std::string>& masks_,
+            const follow_options& options_,
+            OnBatch&& on_batch_,
+            OnIdle&& on_idle_) noexcept
+    {
+        auto [paths, scan_err] = scan_directory(input_dir_, masks_);
+        if (scan_err) {
+            return scan_err;
+        }
+
+        dir_watch watch;
+        if (const auto err = watch.open(input_dir_)) {
+            spdlog::warn("Can't watch {} ({}), polling every {} ms",
+                input_dir_.string(), err.message(), options_.poll_ms);
+        }
+
+        try {
+            watermark_merge<Price> merge{ options_.lateness_us };
+            std::vector<std::unique_ptr<file_tail<Price>>> tails;
+            std::vector<fs::path> known;
+
+            // Индекс источника — порядок появления: равные ts идут по нему
+            const auto add_files = [&](const std::vector<fs::path>& found_) {
+                for (const auto& path : found_) {
+                    if (std::ranges::find(known, path) != known.end()) {
+                        continue;
+                    }
+                    known.push_back(path);
+                    if (compression_of(path) != compression::none) {
+                        spdlog::warn("{}: compressed files can't be followed, skipping",
+                            path.filename().string());
+                        continue;
+                    }
+                    auto tail = std::make_unique<file_tail<Price>>(path,
+                        groups_of(path, masks_), _quantity);
+                    if (tail->is_open()) {
+                        spdlog::info("  + {}", tail->filename());
+                        static_cast<void>(merge.add_source());
+                        tails.push_back(std::move(tail));
+                    }
+                }
+            };
+            add_files(paths);
+
+            std::size_t total = 0;
+            const auto emit = [&](const column_batch<Price>& batch_, std::size_t pos_,
+                std::size_t n_)
+            {
+                const std::span<const std::uint64_t> ts{ batch_.ts };
+                const std::span<const Price> price{ batch_.price };
+                if constexpr (std::invocable<OnBatch&, const batch_view<Price>&>) {
+                    const std::span<const std::uint64_t> group{ batch_.group };
+                    const std::span<const double> quantity{ batch_.quantity };
+                    on_batch_(batch_view<Price>{ ts.subspan(pos_, n_), price.subspan(pos_, n_),
+                        group.empty() ? group : group.subspan(pos_, n_),
+                        quantity.empty() ? quantity : quantity.subspan(pos_, n_) });
+                }
+                else {
+                    on_batch_(ts.subspan(pos_, n_), price.subspan(pos_, n_));
+                }
+                total += n_;
+            };
+
+            column_batch<Price> batch;
+            while (true) {
+                // Дочитать всё дописанное; первым — файл, отставший по receive_ts
+                while (true) {
+                    std::size_t lagging = tails.size();
+                    for (std::size_t i = 0; i < tails.size(); ++i) {
+                        const bool caught_up = tails[i]->caught_up();
+                        merge.set_caught_up(i, caught_up);
+                        if (!caught_up
+                            && (lagging == tails.size() || merge.frontier(i) < merge.frontier(lagging)))
+                        {
+                            lagging = i;
+                        }
+                    }
+                    if (lagging == tails.size()) {
+                        break;
+                    }
+                    if (tails[lagging]->read(batch, k_read_buffer_size)) {
+                        merge.push(lagging, batch);
+                    }
+                    merge.set_caught_up(lagging, tails[lagging]->caught_up());
+                    merge.release(emit);
+                }
+                merge.release(emit);
+
+                if (!on_idle_()) {
+                    break;
+                }
+
+                bool created = false;
+                if (!watch.wait(options_.poll_ms, created)) {
+                    continue;
+                }
+                for (auto& tail : tails) {
+                    tail->refresh();
+                }
+                if (created) {
+                    auto [found, err] = scan_directory(input_dir_, masks_);
+                    if (!err) {
+                        add_files(found);
+                    }
+                }
+            }
+
+            merge.release(emit, true);
+            if (merge.late_count() != 0) {
+                spdlog::warn("{} late records were dropped: increase follow_lateness_us",
+                    merge.late_count());
+            }
+            spdlog::info("Records processed: {}", total);
+            return {};
+        }
+        catch (const std::bad_alloc&) {
+            spdlog::error("Out of memory following {}", input_dir_.string());
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+    }
+
+}
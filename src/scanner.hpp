@@ -0,0 +1,332 @@
+/**
+ * \file scanner.hpp
+ * \brief Векторный поиск разделителей ';' и '\n' в буфере CSV
+ *
+ * Буфер обрабатывается блоками по 64 байта: для каждого блока строятся
+ * битовые маски позиций ';' и '\n', затем биты перебираются через ctz.
+ * Так за один проход по буферу находятся смещения нужных колонок
+ * во всех полных строках, без посимвольного find(';').
+ *
+ * Реализация масок выбирается один раз при старте по возможностям CPU:
+ * AVX-512BW, AVX2, SSE4.2 (x86) или NEON (AArch64), иначе скалярная.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CSV_MEDIAN_SCANNER_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define CSV_MEDIAN_SCANNER_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace csv_median {
+
+    // Максимум колонок, которые сканер извлекает из строки
+    inline constexpr std::size_t k_max_fields = 4;
+
+    // Ширина блока, для которого строятся маски
+    inline constexpr std::size_t k_scan_block = 64;
+
+    /**
+     * \brief Положение поля внутри буфера
+     */
+    struct field_ref {
+        std::uint32_t offset{ 0 };
+        std::uint32_t size{ 0 };
+    };
+
+    /**
+     * \brief Нужные поля одной непустой строки
+     */
+    struct line_fields {
+        std::uint32_t                          line{ 0 }; ///< номер строки в буфере, с 0
+        std::array<field_ref, k_max_fields>    fields{};  ///< в порядке запроса колонок
+    };
+
+    namespace detail {
+
+        /**
+         * \brief Маски символов одного 64-байтного блока (бит i — байт i)
+         */
+        struct block_masks {
+            std::uint64_t delim;
+            std::uint64_t newline;
+        };
+
+        using masks_fn = block_masks(*)(const char*) noexcept;
+
+        inline block_masks masks_scalar(const char* p_) noexcept {
+            block_masks m{ 0, 0 };
+            for (std::size_t i = 0; i < k_scan_block; ++i) {
+                m.delim |= std::uint64_t{ p_[i] == ';' } << i;
+                m.newline |= std::uint64_t{ p_[i] == '\n' } << i;
+            }
+            return m;
+        }
+
+#if defined(CSV_MEDIAN_SCANNER_X86)
+        __attribute__((target("sse4.2")))
+        inline block_masks masks_sse42(const char* p_) noexcept {
+            const __m128i semi = _mm_set1_epi8(';');
+            const __m128i nl = _mm_set1_epi8('\n');
+            block_masks m{ 0, 0 };
+            for (int i = 0; i < 4; ++i) {
+                const __m128i v = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(p_ + i * 16));
+                const auto shift = static_cast<unsigned>(i * 16);
+                m.delim |= std::uint64_t{ static_cast<std::uint16_t>(
+                    _mm_movemask_epi8(_mm_cmpeq_epi8(v, semi))) } << shift;
+                m.newline |= std::uint64_t{ static_cast<std::uint16_t>(
+                    _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl))) } << shift;
+            }
+            return m;
+        }
+
+        __attribute__((target("avx2")))
+        inline block_masks masks_avx2(const char* p_) noexcept {
+            const __m256i semi = _mm256_set1_epi8(';');
+            const __m256i nl = _mm256_set1_epi8('\n');
+            const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p_));
+            const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p_ + 32));
+
+            const std::uint64_t semi_lo = static_cast<std::uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, semi)));
+            const std::uint64_t semi_hi = static_cast<std::uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, semi)));
+            const std::uint64_t nl_lo = static_cast<std::uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, nl)));
+            const std::uint64_t nl_hi = static_cast<std::uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, nl)));
+            return { semi_lo | (semi_hi << 32), nl_lo | (nl_hi << 32) };
+        }
+
+        __attribute__((target("avx512bw")))
+        inline block_masks masks_avx512(const char* p_) noexcept {
+            const __m512i v = _mm512_loadu_si512(p_);
+            return {
+                _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(';')),
+                _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\n'))
+            };
+        }
+#endif
+
+#if defined(CSV_MEDIAN_SCANNER_NEON)
+        inline std::uint64_t neon_movemask(const std::uint8_t* p_, uint8x16_t c_) noexcept {
+            const uint8x16_t bits = {
+                1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+            const uint8x16_t v0 = vandq_u8(vceqq_u8(vld1q_u8(p_), c_), bits);
+            const uint8x16_t v1 = vandq_u8(vceqq_u8(vld1q_u8(p_ + 16), c_), bits);
+            const uint8x16_t v2 = vandq_u8(vceqq_u8(vld1q_u8(p_ + 32), c_), bits);
+            const uint8x16_t v3 = vandq_u8(vceqq_u8(vld1q_u8(p_ + 48), c_), bits);
+            uint8x16_t sum = vpaddq_u8(vpaddq_u8(v0, v1), vpaddq_u8(v2, v3));
+            sum = vpaddq_u8(sum, sum);
+            return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+        }
+
+        inline block_masks masks_neon(const char* p_) noexcept {
+            const auto* p = reinterpret_cast<const std::uint8_t*>(p_);
+            return { neon_movemask(p, vdupq_n_u8(';')), neon_movemask(p, vdupq_n_u8('\n')) };
+        }
+#endif
+
+        /**
+         * \brief Реализация масок, выбранная по возможностям CPU
+         */
+        struct masks_kernel {
+            masks_fn         fn;
+            std::string_view name;
+        };
+
+        inline masks_kernel select_kernel() noexcept {
+#if defined(CSV_MEDIAN_SCANNER_X86)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512bw")) { return { &masks_avx512, "avx512bw" }; }
+            if (__builtin_cpu_supports("avx2")) { return { &masks_avx2, "avx2" }; }
+            if (__builtin_cpu_supports("sse4.2")) { return { &masks_sse42, "sse4.2" }; }
+#elif defined(CSV_MEDIAN_SCANNER_NEON)
+            return { &masks_neon, "neon" };
+#endif
+            return { &masks_scalar, "scalar" };
+        }
+
+        inline const masks_kernel g_kernel = select_kernel();
+
+        // Все биты выше позиции i_ (i_ < 64)
+        [[nodiscard]] constexpr std::uint64_t bits_above(unsigned i_) noexcept {
+            return i_ == 63 ? 0 : (~std::uint64_t{ 0 } << (i_ + 1));
+        }
+
+    }
+
+    /**
+     * \brief Имя выбранной реализации масок (для логирования)
+     */
+    [[nodiscard]] inline std::string_view scanner_kernel_name() noexcept {
+        return detail::g_kernel.name;
+    }
+
+    /**
+     * \brief Разметка строк буфера: смещения заданных колонок в каждой строке
+     *
+     * Колонки после последней запрошенной не разбираются — их ';'
+     * отбрасываются маской до конца строки. Завершающий '\r' строки
+     * в поле не входит. Пустые строки пропускаются.
+     */
+    class line_scanner {
+    public:
+        line_scanner() noexcept;
+
+        /**
+         * \param columns_     номера колонок (с 0), не больше k_max_fields;
+         *                     поле i результата соответствует columns_[i]
+         * \param masks_       реализация масок, по умолчанию выбранная для CPU
+         */
+        explicit line_scanner(std::span<const int> columns_,
+            detail::masks_fn masks_ = detail::g_kernel.fn) noexcept;
+
+        /**
+         * \brief Разметить все полные строки буфера
+         * \param data_   буфер
+         * \param final_  буфер — конец файла: хвост без '\n' тоже строка
+         * \param out_    сюда добавляются непустые строки
+         * \param lines_  число пройденных строк (включая пустые)
+         * \return число байт, занятых разобранными строками
+         */
+        std::size_t scan(std::string_view data_, bool final_,
+            std::vector<line_fields>& out_, std::size_t& lines_) const;
+
+        /**
+         * \brief Запрошена ли колонка для поля slot_ (columns_[slot_] >= 0)
+         */
+        [[nodiscard]] bool has_field(std::size_t slot_) const noexcept;
+
+    private:
+        std::array<std::int8_t, 64> _slot_of_col{};
+        std::uint32_t               _fields{ 0 }; ///< бит i — поле i запрошено
+        std::size_t                 _max_col{ 0 };
+        detail::masks_fn            _masks{ detail::g_kernel.fn };
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline line_scanner::line_scanner() noexcept
+        : line_scanner{ std::span<const int>{} }
+    {
+    }
+
+    inline line_scanner::line_scanner(std::span<const int> columns_,
+        detail::masks_fn masks_) noexcept
+        : _masks{ masks_ }
+    {
+        _slot_of_col.fill(-1);
+        for (std::size_t i = 0; i < columns_.size() && i < k_max_fields; ++i) {
+            const auto col = static_cast<std::size_t>(columns_[i]);
+            if (columns_[i] < 0 || col >= _slot_of_col.size()) {
+                continue;
+            }
+            _slot_of_col[col] = static_cast<std::int8_t>(i);
+            _max_col = std::max(_max_col, col);
+            _fields |= std::uint32_t{ 1 } << i;
+        }
+    }
+
+    inline bool line_scanner::has_field(std::size_t slot_) const noexcept {
+        return slot_ < k_max_fields && ((_fields >> slot_) & 1) != 0;
+    }
+
+    inline std::size_t line_scanner::scan(std::string_view data_, bool final_,
+        std::vector<line_fields>& out_, std::size_t& lines_) const
+    {
+        const char* const base = data_.data();
+        const std::size_t size = data_.size();
+
+        std::size_t line_start = 0;
+        std::size_t field_start = 0;
+        std::size_t col = 0;
+        std::size_t lines = 0;
+        line_fields cur{};
+
+        const auto finish_field = [&](std::size_t end_) {
+            if (col <= _max_col && _slot_of_col[col] >= 0) {
+                cur.fields[static_cast<std::size_t>(_slot_of_col[col])] = {
+                    static_cast<std::uint32_t>(field_start),
+                    static_cast<std::uint32_t>(end_ - field_start)
+                };
+            }
+        };
+
+        const auto finish_line = [&](std::size_t end_) {
+            if (end_ > line_start && base[end_ - 1] == '\r') {
+                --end_;
+            }
+            if (end_ > line_start) {
+                finish_field(end_);
+                out_.push_back(cur);
+            }
+            ++lines;
+            cur = line_fields{};
+            cur.line = static_cast<std::uint32_t>(lines);
+            col = 0;
+        };
+
+        alignas(64) char tail[k_scan_block];
+
+        for (std::size_t block = 0; block < size; block += k_scan_block) {
+            detail::block_masks m;
+            if (size - block >= k_scan_block) {
+                m = _masks(base + block);
+            }
+            else {
+                std::memset(tail, 0, sizeof(tail));
+                std::memcpy(tail, base + block, size - block);
+                m = _masks(tail);
+            }
+
+            std::uint64_t bits = (col > _max_col)
+                ? m.newline : (m.delim | m.newline);
+
+            while (bits != 0) {
+                const auto i = static_cast<unsigned>(std::countr_zero(bits));
+                const std::size_t pos = block + i;
+
+                if ((m.newline >> i) & 1) {
+                    finish_line(pos);
+                    line_start = field_start = pos + 1;
+                    bits = (m.delim | m.newline) & detail::bits_above(i);
+                    continue;
+                }
+
+                bits &= bits - 1;
+                finish_field(pos);
+                ++col;
+                field_start = pos + 1;
+                if (col > _max_col) {
+                    // Дальше до конца строки колонки не нужны
+                    bits &= m.newline;
+                }
+            }
+        }
+
+        if (final_ && line_start < size) {
+            finish_line(size);
+            line_start = size;
+        }
+
+        lines_ = lines;
+        return line_start;
+    }
+
+}
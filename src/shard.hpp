@@ -0,0 +1,271 @@
+/**
+ * \file shard.hpp
+ * \brief Частичные состояния для расчёта медианы несколькими узлами
+ *
+ * Узел считает свою часть входа — свои файлы или диапазон from_ts /
+ * to_ts — калькулятором histogram или tdigest и сохраняет его снимок
+ * (state.hpp) с границами части: число записей, первый и последний
+ * receive_ts и отпечатки прочитанных файлов (как у кэша). Снимок —
+ * килобайты у t-digest и мегабайты у гистограммы вместо исходных CSV.
+ *
+ * Координатор упорядочивает части по receive_ts и сливает калькуляторы
+ * (merge): после части k медиана та же, что у сквозного расчёта после
+ * последней записи части k — у гистограммы точно, у t-digest с ошибкой
+ * ранга того же порядка, что у одного дайджеста. Для части k >= 1
+ * координатор сохраняет слияние частей 0..k-1 (префикс): узел,
+ * начавший с него ([main].shard_prefix), выводит строки своей части
+ * так же, как сквозной расчёт.
+ *
+ * Файл: магия, версия, порядок байт, подпись конфигурации, границы,
+ * файлы, снимок калькулятора и FNV-1a всего содержимого в конце;
+ * пишется через временный файл (checkpoint.hpp).
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <new>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "cache.hpp"
+#include "checkpoint.hpp"
+#include "mapped.hpp"
+#include "state.hpp"
+
+namespace csv_median {
+
+    namespace fs = std::filesystem;
+
+    inline constexpr std::string_view k_shard_filename = "median_result.part";
+
+    /**
+     * \brief Калькулятор, снимки которого сливаются без исходных записей
+     */
+    template<class Calc>
+    concept mergeable = checkpointable<Calc> && requires(Calc& c_, const Calc& other_) {
+        c_.merge(other_);
+    };
+
+    /**
+     * \brief Входной файл части
+     */
+    struct shard_file {
+        fs::path          path;
+        cache_source_info source;   ///< отпечаток на момент чтения
+    };
+
+    /**
+     * \brief Содержимое файла части
+     */
+    struct shard_state {
+        std::uint64_t              signature{ 0 }; ///< подпись калькулятора: цены, движок, сетка
+        std::uint64_t              records{ 0 };   ///< записей в калькуляторе
+        std::uint64_t              first_ts{ 0 };  ///< receive_ts первой записи
+        std::uint64_t              last_ts{ 0 };   ///< receive_ts последней записи
+        std::vector<shard_file>    files;          ///< входные файлы части, по имени
+        std::vector<unsigned char> state;          ///< снимок калькулятора
+    };
+
+    /**
+     * \brief Путь файла части рядом с результатом
+     */
+    [[nodiscard]] fs::path shard_path(const fs::path& output_dir_);
+
+    /**
+     * \brief Путь префикса части index_: median_result.prefix_<index_>.part
+     */
+    [[nodiscard]] fs::path shard_prefix_path(const fs::path& output_dir_, std::size_t index_);
+
+    /**
+     * \brief Сохранить часть: временный файл, fdatasync, rename
+     */
+    [[nodiscard]] std::error_code save_shard(const fs::path& path_,
+        const shard_state& shard_) noexcept;
+
+    /**
+     * \brief Прочитать часть, сохранённую save_shard()
+     * \return bad_message — файл повреждён, другой версии или не часть
+     */
+    [[nodiscard]] std::error_code load_shard(const fs::path& path_,
+        shard_state& shard_) noexcept;
+
+    /**
+     * \brief Упорядочить части по receive_ts для слияния
+     *
+     * Пустые части отбрасываются. Части должны идти одна за другой:
+     * последняя запись части не позже первой записи следующей.
+     * \return invalid_argument — разные подписи или диапазоны пересекаются
+     */
+    [[nodiscard]] std::error_code order_shards(std::vector<shard_state>& shards_) noexcept;
+
+    /**
+     * \brief Слить снимки упорядоченных частей в один калькулятор
+     * \param make_      () -> Calc, новый калькулятор той же конфигурации
+     * \param on_merged_ (index, const shard_state&, Calc&) -> std::error_code —
+     *                   после слияния части index; калькулятор — все части
+     *                   до неё включительно. Ошибка прекращает слияние.
+     * \return bad_message — снимок части не подходит калькулятору;
+     *         ошибка merge() калькулятора
+     */
+    template<class Make, class OnMerged>
+        requires mergeable<std::invoke_result_t<Make&>>
+    [[nodiscard]] std::error_code merge_shards(std::span<const shard_state> shards_,
+        Make&& make_, OnMerged&& on_merged_) noexcept;
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    namespace detail {
+        inline constexpr std::array<char, 8> k_shard_magic{ 'C', 'S', 'V', 'M', 'P', 'R', 'T', '1' };
+        inline constexpr std::uint32_t k_shard_version = 1;
+    }
+
+    inline fs::path shard_path(const fs::path& output_dir_) {
+        return output_dir_ / k_shard_filename;
+    }
+
+    inline fs::path shard_prefix_path(const fs::path& output_dir_, std::size_t index_) {
+        return output_dir_ / ("median_result.prefix_" + std::to_string(index_) + ".part");
+    }
+
+    inline std::error_code save_shard(const fs::path& path_,
+        const shard_state& shard_) noexcept
+    {
+        state_writer out;
+        try {
+            out.put(detail::k_shard_magic);
+            out.put(detail::k_shard_version);
+            out.put(detail::k_cache_byte_order);
+            out.put(shard_.signature);
+            out.put(shard_.records);
+            out.put(shard_.first_ts);
+            out.put(shard_.last_ts);
+            out.put_varint(shard_.files.size());
+            for (const auto& file : shard_.files) {
+                const auto& name = file.path.native();
+                out.put_bytes({ reinterpret_cast<const unsigned char*>(name.data()), name.size() });
+                out.put(file.source.size);
+                out.put(file.source.mtime_ns);
+                out.put(file.source.hash);
+            }
+            out.put_bytes(shard_.state);
+        }
+        catch (const std::exception&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+        return replace_hashed_file(path_, out.data());
+    }
+
+    inline std::error_code load_shard(const fs::path& path_,
+        shard_state& shard_) noexcept
+    {
+        mapped_file map;
+        std::span<const unsigned char> body;
+        if (const auto err = map_hashed_file(path_, map, body)) {
+            return err;
+        }
+        const auto corrupt = std::make_error_code(std::errc::bad_message);
+
+        try {
+            state_reader in{ body };
+            std::array<char, 8> magic{};
+            std::uint32_t version = 0;
+            std::uint32_t byte_order = 0;
+            if (!in.get(magic) || magic != detail::k_shard_magic
+                || !in.get(version) || version != detail::k_shard_version
+                || !in.get(byte_order) || byte_order != detail::k_cache_byte_order)
+            {
+                return corrupt;
+            }
+
+            shard_state result;
+            std::uint64_t files = 0;
+            if (!in.get(result.signature) || !in.get(result.records)
+                || !in.get(result.first_ts) || !in.get(result.last_ts)
+                || !in.get_varint(files))
+            {
+                return corrupt;
+            }
+            std::vector<unsigned char> name;
+            for (std::uint64_t i = 0; i < files; ++i) {
+                shard_file file;
+                if (!in.get_bytes(name) || !in.get(file.source.size)
+                    || !in.get(file.source.mtime_ns) || !in.get(file.source.hash))
+                {
+                    return corrupt;
+                }
+                file.path = fs::path{ std::string{ name.begin(), name.end() } };
+                result.files.push_back(std::move(file));
+            }
+            if (!in.get_bytes(result.state) || !in.done()) {
+                return corrupt;
+            }
+            shard_ = std::move(result);
+        }
+        catch (const std::exception&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+        return {};
+    }
+
+    inline std::error_code order_shards(std::vector<shard_state>& shards_) noexcept {
+        std::erase_if(shards_, [](const shard_state& shard_) { return shard_.records == 0; });
+        std::ranges::sort(shards_, {}, &shard_state::first_ts);
+
+        for (std::size_t i = 1; i < shards_.size(); ++i) {
+            if (shards_[i].signature != shards_[0].signature) {
+                spdlog::error("Shards are computed with different prices, median_backend, "
+                    "tick_size or sketch_error");
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+            if (shards_[i - 1].last_ts > shards_[i].first_ts) {
+                spdlog::error("Shard receive_ts ranges overlap: [{}, {}] and [{}, {}]",
+                    shards_[i - 1].first_ts, shards_[i - 1].last_ts,
+                    shards_[i].first_ts, shards_[i].last_ts);
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+        }
+        return {};
+    }
+
+    template<class Make, class OnMerged>
+        requires mergeable<std::invoke_result_t<Make&>>
+    inline std::error_code merge_shards(std::span<const shard_state> shards_,
+        Make&& make_, OnMerged&& on_merged_) noexcept
+    {
+        try {
+            auto calc = make_();
+            for (std::size_t i = 0; i < shards_.size(); ++i) {
+                auto part = make_();
+                state_reader in{ shards_[i].state };
+                if (!part.load(in) || !in.done()) {
+                    return std::make_error_code(std::errc::bad_message);
+                }
+                if (const auto err = calc.merge(part)) {
+                    return err;
+                }
+                if (const auto err = on_merged_(i, shards_[i], calc)) {
+                    return err;
+                }
+            }
+        }
+        catch (const std::bad_alloc&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+        return {};
+    }
+
+}
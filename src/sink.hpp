@@ -0,0 +1,66 @@
+/**
+ * \file sink.hpp
+ * \brief Приёмник результатов: общий интерфейс форматов вывода
+ *
+ * Расчёт пишет строки результата через шаблонный параметр, формат
+ * выбирается один раз в main по [main].output_format — без
+ * виртуальных вызовов на каждой строке.
+ */
+
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <system_error>
+
+#include "columnar.hpp"
+#include "price.hpp"
+#include "writer.hpp"
+
+namespace csv_median {
+
+    /**
+     * \brief Приёмник строк "receive_ts; медиана"
+     *
+     * write() для double и fixed_price дают одинаковый результат для
+     * одного и того же значения; close() дописывает хвост и возвращает
+     * первую ошибку записи. open(dir_) пишет в файл по умолчанию,
+     * open(dir_, name_) — в name_ (файлы групп).
+     */
+    template<class S>
+    concept result_sink = requires(S s_, const S& cs_, const std::filesystem::path& dir_,
+        const std::string& name_, std::uint64_t ts_, double d_, fixed_price f_)
+    {
+        { s_.open(dir_) } -> std::same_as<std::error_code>;
+        { s_.open(dir_, name_) } -> std::same_as<std::error_code>;
+        { s_.write(ts_, d_) } -> std::same_as<std::error_code>;
+        { s_.write(ts_, f_) } -> std::same_as<std::error_code>;
+        { s_.close() } -> std::same_as<std::error_code>;
+        { cs_.written_count() } -> std::convertible_to<std::size_t>;
+        { cs_.path() } -> std::convertible_to<const std::filesystem::path&>;
+    };
+
+    /**
+     * \brief Приёмник строк с колонками статистик после медианы
+     *
+     * set_columns() задаёт имена колонок до open(); write() с values_
+     * пишет их значения в том же порядке.
+     */
+    template<class S>
+    concept statistics_sink = result_sink<S>
+        && requires(S s_, std::span<const std::string> names_, std::uint64_t ts_,
+            double d_, fixed_price f_, std::span<const double> values_)
+    {
+        s_.set_columns(names_);
+        { s_.write(ts_, d_, values_) } -> std::same_as<std::error_code>;
+        { s_.write(ts_, f_, values_) } -> std::same_as<std::error_code>;
+    };
+
+    static_assert(result_sink<result_writer>);
+    static_assert(result_sink<columnar_writer>);
+    static_assert(statistics_sink<result_writer>);
+
+}
@@ -0,0 +1,376 @@
+/**
+ * \file sketch.hpp
+ * \brief Приближённая медиана в фиксированной памяти (merging t-digest)
+ *
+ * Значения сжимаются в центроиды (среднее, вес). Размер центроида
+ * ограничен функцией масштаба k1(q) = delta / 2pi * asin(2q - 1): у
+ * краёв центроиды мелкие, у медианы — около pi / delta от общего веса.
+ * При delta = pi / error ошибка ранга медианы не превышает ~error.
+ *
+ * Новые значения копятся в небольшом буфере и вливаются в центроиды
+ * пачкой. Медиана пересчитывается только при слиянии, поэтому буфер
+ * ограничен и долей error * n / 4: устаревание добавляет к ошибке
+ * ранга не больше error / 8. Пока центроиды одиночные (малые n),
+ * результат точный.
+ *
+ * Дайджесты с одной ошибкой сливаются (merge): центроиды обоих
+ * укрупняются заново той же функцией масштаба, и ошибка ранга медианы
+ * остаётся того же порядка, что у одного дайджеста.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <numbers>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "options.hpp"
+#include "state.hpp"
+
+namespace csv_median {
+
+    // Максимум значений в буфере до слияния
+    inline constexpr std::size_t k_sketch_buffer = 256;
+
+    /**
+     * \brief Движок медианы на t-digest: только вставка, память O(1 / error)
+     * \tparam T тип цены: double или fixed_price
+     */
+    template<class T>
+    class tdigest {
+    public:
+        using value_type = T;
+
+        /**
+         * \param error_ допустимая ошибка ранга медианы, (0, 0.5)
+         */
+        explicit tdigest(double error_ = k_default_sketch_error);
+
+        void insert(T value_);
+
+        /**
+         * \brief Приближённая медиана дважды: центральные элементы
+         * не различаются, медиана — интерполяция на ранге n/2
+         */
+        [[nodiscard]] std::pair<T, T> middle() const noexcept;
+
+        /**
+         * \brief Число добавленных значений
+         */
+        [[nodiscard]] std::size_t size() const noexcept;
+
+        /**
+         * \brief Приближённый квантиль по текущему состоянию (с буфером)
+         * \param q_ в диапазоне [0, 1]
+         */
+        [[nodiscard]] double quantile(double q_);
+
+        /**
+         * \brief Число центроидов (для контроля памяти)
+         */
+        [[nodiscard]] std::size_t centroid_count() const noexcept;
+
+        [[nodiscard]] double compression() const noexcept;
+
+        /**
+         * \brief Добавить значения other_ с той же ошибкой ранга
+         */
+        void merge(const tdigest& other_);
+
+        /**
+         * \brief Центроиды, буфер и медиана: несколько КБ при любом n
+         */
+        void save(state_writer& out_) const;
+
+        /**
+         * \brief Восстановить из save() при той же ошибке ранга
+         * \return false если снимок повреждён или ошибка другая
+         */
+        [[nodiscard]] bool load(state_reader& in_);
+
+    private:
+        struct centroid {
+            double mean;
+            double weight;
+        };
+
+        /**
+         * \brief Влить буфер в центроиды и пересчитать медиану
+         */
+        void flush();
+
+        /**
+         * \brief Укрупнить _merged (по возрастанию средних) в центроиды
+         *        и пересчитать медиану
+         */
+        void compress();
+
+        /**
+         * \brief Интерполированный квантиль по центроидам
+         */
+        [[nodiscard]] double centroid_quantile(double q_) const noexcept;
+
+        [[nodiscard]] double scale(double q_) const noexcept;
+
+        std::vector<centroid> _centroids;
+        std::vector<centroid> _merged;
+        std::vector<double>   _buffer;
+
+        double                _compression;
+        double                _error;
+        double                _min{ 0.0 };
+        double                _max{ 0.0 };
+        std::size_t           _merged_count{ 0 };
+        std::size_t           _count{ 0 };
+        T                     _median{};
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    template<class T>
+    inline tdigest<T>::tdigest(double error_)
+        : _compression{ std::numbers::pi / error_ }
+        , _error{ error_ }
+    {
+        _buffer.reserve(k_sketch_buffer);
+        const auto expected = static_cast<std::size_t>(_compression) + 1;
+        _centroids.reserve(expected + k_sketch_buffer);
+        _merged.reserve(expected + k_sketch_buffer);
+    }
+
+    template<class T>
+    inline void tdigest<T>::insert(T value_) {
+        _buffer.push_back(static_cast<double>(value_));
+        ++_count;
+
+        // Буфер не больше error * n / 4, чтобы медиана не устаревала
+        const auto stale_limit = static_cast<std::size_t>(
+            _error * static_cast<double>(_count) / 4.0);
+        if (_buffer.size() >= std::clamp(stale_limit, std::size_t{ 1 }, k_sketch_buffer)) {
+            flush();
+        }
+    }
+
+    template<class T>
+    inline std::pair<T, T> tdigest<T>::middle() const noexcept {
+        return { _median, _median };
+    }
+
+    template<class T>
+    inline std::size_t tdigest<T>::size() const noexcept {
+        return _count;
+    }
+
+    template<class T>
+    inline double tdigest<T>::quantile(double q_) {
+        if (!_buffer.empty()) {
+            flush();
+        }
+        return centroid_quantile(q_);
+    }
+
+    template<class T>
+    inline std::size_t tdigest<T>::centroid_count() const noexcept {
+        return _centroids.size();
+    }
+
+    template<class T>
+    inline double tdigest<T>::compression() const noexcept {
+        return _compression;
+    }
+
+    template<class T>
+    inline double tdigest<T>::scale(double q_) const noexcept {
+        return _compression / (2.0 * std::numbers::pi) * std::asin(2.0 * q_ - 1.0);
+    }
+
+    template<class T>
+    inline void tdigest<T>::flush() {
+        std::sort(_buffer.begin(), _buffer.end());
+        if (_merged_count == 0) {
+            _min = _buffer.front();
+            _max = _buffer.back();
+        }
+        else {
+            _min = std::min(_min, _buffer.front());
+            _max = std::max(_max, _buffer.back());
+        }
+
+        // Слияние отсортированных буфера и центроидов в порядке средних
+        _merged.clear();
+        auto c = _centroids.begin();
+        for (const double v : _buffer) {
+            for (; c != _centroids.end() && c->mean <= v; ++c) {
+                _merged.push_back(*c);
+            }
+            _merged.push_back(centroid{ v, 1.0 });
+        }
+        _merged.insert(_merged.end(), c, _centroids.end());
+
+        _merged_count += _buffer.size();
+        _buffer.clear();
+        compress();
+    }
+
+    template<class T>
+    inline void tdigest<T>::merge(const tdigest& other_) {
+        if (other_._count == 0) {
+            return;
+        }
+        if (!_buffer.empty()) {
+            flush();
+        }
+
+        // Центроиды other_ и его буфер как центроиды единичного веса
+        std::vector<centroid> incoming{ other_._centroids };
+        for (const double v : other_._buffer) {
+            incoming.push_back(centroid{ v, 1.0 });
+        }
+        std::ranges::sort(incoming, {}, &centroid::mean);
+
+        // _min / _max other_ точнее средних крайних центроидов
+        double other_min = incoming.front().mean;
+        double other_max = incoming.back().mean;
+        if (other_._merged_count != 0) {
+            other_min = std::min(other_min, other_._min);
+            other_max = std::max(other_max, other_._max);
+        }
+        _min = _merged_count == 0 ? other_min : std::min(_min, other_min);
+        _max = _merged_count == 0 ? other_max : std::max(_max, other_max);
+
+        _merged.clear();
+        std::ranges::merge(_centroids, incoming, std::back_inserter(_merged), {},
+            &centroid::mean, &centroid::mean);
+        _merged_count += other_._count;
+        _count += other_._count;
+        compress();
+    }
+
+    template<class T>
+    inline void tdigest<T>::compress() {
+        // Жадное укрупнение: центроид растёт, пока его вес укладывается
+        // в единицу функции масштаба
+        const auto total = static_cast<double>(_merged_count);
+        _centroids.clear();
+        centroid cur = _merged.front();
+        double weight_before = 0.0;
+        double k_left = scale(0.0);
+        for (std::size_t i = 1; i < _merged.size(); ++i) {
+            const centroid& next = _merged[i];
+            const double proposed = cur.weight + next.weight;
+            if (scale((weight_before + proposed) / total) - k_left <= 1.0) {
+                cur.mean += (next.mean - cur.mean) * next.weight / proposed;
+                cur.weight = proposed;
+            }
+            else {
+                weight_before += cur.weight;
+                k_left = scale(weight_before / total);
+                _centroids.push_back(cur);
+                cur = next;
+            }
+        }
+        _centroids.push_back(cur);
+
+        const double median = centroid_quantile(0.5);
+        if constexpr (std::is_floating_point_v<T>) {
+            _median = median;
+        }
+        else {
+            _median = static_cast<T>(std::llround(median));
+        }
+    }
+
+    template<class T>
+    inline double tdigest<T>::centroid_quantile(double q_) const noexcept {
+        if (_centroids.empty()) {
+            return 0.0;
+        }
+        if (_centroids.size() == 1) {
+            return _centroids.front().mean;
+        }
+
+        // Центр центроида i — на ранге (вес до него) + weight / 2;
+        // между центрами соседей значение интерполируется линейно
+        const double rank = q_ * static_cast<double>(_merged_count);
+        const double first_center = _centroids.front().weight / 2.0;
+        if (rank <= first_center) {
+            const double t = (first_center > 0.5) ? (rank - 0.5) / (first_center - 0.5) : 1.0;
+            return _min + std::max(t, 0.0) * (_centroids.front().mean - _min);
+        }
+
+        double center = first_center;
+        double weight_before = 0.0;
+        for (std::size_t i = 0; i + 1 < _centroids.size(); ++i) {
+            const double next_center = weight_before + _centroids[i].weight
+                + _centroids[i + 1].weight / 2.0;
+            if (rank <= next_center) {
+                const double t = (rank - center) / (next_center - center);
+                return _centroids[i].mean + t * (_centroids[i + 1].mean - _centroids[i].mean);
+            }
+            weight_before += _centroids[i].weight;
+            center = next_center;
+        }
+
+        const double last_center = center;
+        const double last_rank = static_cast<double>(_merged_count) - 0.5;
+        const double t = (last_rank > last_center) ? (rank - last_center) / (last_rank - last_center) : 0.0;
+        return _centroids.back().mean + std::min(t, 1.0) * (_max - _centroids.back().mean);
+    }
+
+    template<class T>
+    inline void tdigest<T>::save(state_writer& out_) const {
+        out_.put(_error);
+        out_.put_varint(_centroids.size());
+        for (const centroid& c : _centroids) {
+            out_.put(c.mean);
+            out_.put(c.weight);
+        }
+        out_.put_values(std::span<const double>{ _buffer });
+        out_.put(_min);
+        out_.put(_max);
+        out_.put_varint(_merged_count);
+        out_.put_varint(_count);
+        out_.put(_median);
+    }
+
+    template<class T>
+    inline bool tdigest<T>::load(state_reader& in_) {
+        double error = 0.0;
+        std::uint64_t centroids = 0;
+        if (!in_.get(error) || error != _error || !in_.get_varint(centroids)) {
+            return false;
+        }
+
+        _centroids.clear();
+        for (std::uint64_t i = 0; i < centroids; ++i) {
+            centroid c{};
+            if (!in_.get(c.mean) || !in_.get(c.weight)) {
+                return false;
+            }
+            _centroids.push_back(c);
+        }
+
+        std::uint64_t merged = 0;
+        std::uint64_t count = 0;
+        if (!in_.get_values(_buffer) || _buffer.size() > k_sketch_buffer
+            || !in_.get(_min) || !in_.get(_max)
+            || !in_.get_varint(merged) || !in_.get_varint(count) || !in_.get(_median))
+        {
+            return false;
+        }
+        _buffer.reserve(k_sketch_buffer);
+        _merged_count = static_cast<std::size_t>(merged);
+        _count = static_cast<std::size_t>(count);
+        return _count == _merged_count + _buffer.size();
+    }
+
+}
@@ -0,0 +1,357 @@
+/**
+ * \file skiplist.hpp
+ * \brief Индексируемый skip list: вставка, удаление и k-я статистика за O(log n)
+ *
+ * Узлы хранятся в пуле — непрерывном page_vector (pages.hpp), ссылки между ними
+ * это 32-битные индексы, а связи всех уровней лежат в общем массиве.
+ * Освобождённые узлы возвращаются в список свободных по высоте и
+ * переиспользуются без обращения к аллокатору. Каждая связь хранит
+ * ширину — число элементов нижнего уровня, которые она перепрыгивает,
+ * поэтому поиск по рангу идёт тем же спуском, что и поиск по значению.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "pages.hpp"
+#include "state.hpp"
+
+namespace csv_median {
+
+    /**
+     * \brief Мультимножество с доступом к элементу по рангу
+     *
+     * Дубликаты разрешены; erase() удаляет одно вхождение.
+     * \tparam T тип значения с operator<
+     */
+    template<class T>
+    class indexable_skiplist {
+    public:
+        using value_type = T;
+
+        indexable_skiplist() noexcept;
+
+        /**
+         * \brief Зарезервировать место под n_ элементов
+         */
+        void reserve(std::size_t n_);
+
+        /**
+         * \brief Добавить значение
+         */
+        void insert(T value_);
+
+        /**
+         * \brief Удалить одно вхождение значения
+         * \return false если значения нет
+         */
+        bool erase(T value_) noexcept;
+
+        /**
+         * \brief Элемент с рангом rank_ (с 0) в порядке возрастания
+         * \warning rank_ >= size() — UB
+         */
+        [[nodiscard]] T select(std::size_t rank_) const noexcept;
+
+        /**
+         * \brief Центральные элементы: ранги (n-1)/2 и n/2
+         */
+        [[nodiscard]] std::pair<T, T> middle() const noexcept;
+
+        [[nodiscard]] std::size_t size() const noexcept;
+        [[nodiscard]] bool empty() const noexcept;
+
+        void clear() noexcept;
+
+        /**
+         * \brief Значения по возрастанию и состояние генератора высот
+         */
+        void save(state_writer& out_) const;
+
+        /**
+         * \brief Восстановить список из save()
+         * \return false если снимок повреждён
+         */
+        [[nodiscard]] bool load(state_reader& in_);
+
+    private:
+        static constexpr std::uint32_t k_nil = 0xFFFFFFFFu;
+        static constexpr std::uint32_t k_head = 0;
+        static constexpr std::size_t   k_max_level = 24;
+
+        struct link {
+            std::uint32_t next;
+            std::uint32_t width;
+        };
+
+        struct node {
+            T             value;
+            std::uint32_t links;  ///< смещение связей в _links
+            std::uint32_t height;
+        };
+
+        [[nodiscard]] link& at(std::uint32_t node_, std::size_t level_) noexcept;
+        [[nodiscard]] const link& at(std::uint32_t node_, std::size_t level_) const noexcept;
+
+        [[nodiscard]] std::uint32_t random_height() noexcept;
+        [[nodiscard]] std::uint32_t allocate(T value_, std::uint32_t height_);
+
+        page_vector<node>                        _nodes;
+        page_vector<link>                        _links;
+        std::array<std::uint32_t, k_max_level + 1> _free{};
+        std::size_t                              _size{ 0 };
+        std::size_t                              _level{ 1 };
+        std::uint64_t                            _rng{ 0x9E3779B97F4A7C15ull };
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    template<class T>
+    inline indexable_skiplist<T>::indexable_skiplist() noexcept {
+        clear();
+    }
+
+    template<class T>
+    inline void indexable_skiplist<T>::clear() noexcept {
+        _nodes.clear();
+        _links.clear();
+        _free.fill(k_nil);
+        _size = 0;
+        _level = 1;
+
+        // Голова: все уровни сразу, ширина до конца списка — 1
+        _nodes.push_back(node{ T{}, 0, static_cast<std::uint32_t>(k_max_level) });
+        _links.assign(k_max_level, link{ k_nil, 1 });
+    }
+
+    template<class T>
+    inline void indexable_skiplist<T>::reserve(std::size_t n_) {
+        _nodes.reserve(n_ + 1);
+        // Средняя высота при p = 1/4 — 4/3 связи на узел
+        _links.reserve(k_max_level + n_ + n_ / 3 + 1);
+    }
+
+    template<class T>
+    inline auto indexable_skiplist<T>::at(std::uint32_t node_, std::size_t level_) noexcept
+        -> link&
+    {
+        return _links[_nodes[node_].links + level_];
+    }
+
+    template<class T>
+    inline auto indexable_skiplist<T>::at(std::uint32_t node_, std::size_t level_) const noexcept
+        -> const link&
+    {
+        return _links[_nodes[node_].links + level_];
+    }
+
+    template<class T>
+    inline std::uint32_t indexable_skiplist<T>::random_height() noexcept {
+        // xorshift64; каждый уровень с вероятностью 1/4
+        _rng ^= _rng << 13;
+        _rng ^= _rng >> 7;
+        _rng ^= _rng << 17;
+
+        std::uint64_t bits = _rng;
+        std::uint32_t height = 1;
+        while ((bits & 3) == 0 && height < k_max_level) {
+            ++height;
+            bits >>= 2;
+        }
+        return height;
+    }
+
+    template<class T>
+    inline std::uint32_t indexable_skiplist<T>::allocate(T value_, std::uint32_t height_) {
+        if (const auto idx = _free[height_]; idx != k_nil) {
+            // Свободные узлы одной высоты связаны через next нижнего уровня
+            _free[height_] = at(idx, 0).next;
+            _nodes[idx].value = value_;
+            return idx;
+        }
+
+        const auto idx = static_cast<std::uint32_t>(_nodes.size());
+        _nodes.push_back(node{ value_, static_cast<std::uint32_t>(_links.size()), height_ });
+        _links.resize(_links.size() + height_);
+        return idx;
+    }
+
+    template<class T>
+    inline void indexable_skiplist<T>::insert(T value_) {
+        std::array<std::uint32_t, k_max_level> update;
+        std::array<std::size_t, k_max_level> rank;
+
+        const auto height = random_height();
+        if (height > _level) {
+            for (std::size_t i = _level; i < height; ++i) {
+                at(k_head, i) = link{ k_nil, static_cast<std::uint32_t>(_size + 1) };
+            }
+            _level = height;
+        }
+
+        // Спуск: на каждом уровне — последний узел со значением <= value_
+        std::uint32_t cur = k_head;
+        std::size_t pos = 0;
+        for (std::size_t i = _level; i-- > 0;) {
+            for (auto next = at(cur, i).next;
+                next != k_nil && !(value_ < _nodes[next].value);
+                next = at(cur, i).next)
+            {
+                pos += at(cur, i).width;
+                cur = next;
+            }
+            update[i] = cur;
+            rank[i] = pos;
+        }
+
+        const auto idx = allocate(value_, height);
+
+        for (std::size_t i = 0; i < _level; ++i) {
+            link& prev = at(update[i], i);
+            if (i < height) {
+                const auto skipped = static_cast<std::uint32_t>(rank[0] - rank[i]);
+                at(idx, i) = link{ prev.next, prev.width - skipped };
+                prev = link{ idx, skipped + 1 };
+            }
+            else {
+                ++prev.width;
+            }
+        }
+        ++_size;
+    }
+
+    template<class T>
+    inline bool indexable_skiplist<T>::erase(T value_) noexcept {
+        std::array<std::uint32_t, k_max_level> update;
+
+        // Спуск: на каждом уровне — последний узел со значением < value_
+        std::uint32_t cur = k_head;
+        for (std::size_t i = _level; i-- > 0;) {
+            for (auto next = at(cur, i).next;
+                next != k_nil && _nodes[next].value < value_;
+                next = at(cur, i).next)
+            {
+                cur = next;
+            }
+            update[i] = cur;
+        }
+
+        const auto target = at(cur, 0).next;
+        if (target == k_nil || value_ < _nodes[target].value) {
+            return false;
+        }
+
+        const auto height = _nodes[target].height;
+        for (std::size_t i = 0; i < _level; ++i) {
+            link& prev = at(update[i], i);
+            if (i < height) {
+                const link& gone = at(target, i);
+                prev = link{ gone.next, prev.width + gone.width - 1 };
+            }
+            else {
+                --prev.width;
+            }
+        }
+
+        at(target, 0).next = _free[height];
+        _free[height] = target;
+        --_size;
+
+        while (_level > 1 && at(k_head, _level - 1).next == k_nil) {
+            --_level;
+        }
+        return true;
+    }
+
+    template<class T>
+    inline T indexable_skiplist<T>::select(std::size_t rank_) const noexcept {
+        // Ранги от 1: голова на позиции 0, ищем позицию rank_ + 1
+        const std::size_t target = rank_ + 1;
+        std::uint32_t cur = k_head;
+        std::size_t pos = 0;
+        for (std::size_t i = _level; i-- > 0;) {
+            while (at(cur, i).next != k_nil && pos + at(cur, i).width <= target) {
+                pos += at(cur, i).width;
+                cur = at(cur, i).next;
+            }
+            if (pos == target) {
+                break;
+            }
+        }
+        return _nodes[cur].value;
+    }
+
+    template<class T>
+    inline std::pair<T, T> indexable_skiplist<T>::middle() const noexcept {
+        const T lower = select((_size - 1) / 2);
+        return { lower, (_size % 2 == 0) ? select(_size / 2) : lower };
+    }
+
+    template<class T>
+    inline std::size_t indexable_skiplist<T>::size() const noexcept {
+        return _size;
+    }
+
+    template<class T>
+    inline bool indexable_skiplist<T>::empty() const noexcept {
+        return _size == 0;
+    }
+
+    template<class T>
+    inline void indexable_skiplist<T>::save(state_writer& out_) const {
+        out_.put(_rng);
+        out_.put_varint(_size);
+        T prev{};
+        for (auto idx = at(k_head, 0).next; idx != k_nil; idx = at(idx, 0).next) {
+            out_.put_value(_nodes[idx].value, prev);
+        }
+    }
+
+    template<class T>
+    inline bool indexable_skiplist<T>::load(state_reader& in_) {
+        std::uint64_t rng = 0;
+        page_vector<T> values;
+        if (!in_.get(rng) || !in_.get_values(values)) {
+            return false;
+        }
+
+        if (!std::ranges::is_sorted(values) || values.size() >= k_nil) {
+            return false;
+        }
+
+        // Значения по возрастанию: узел дописывается в конец каждого своего
+        // уровня без спуска. Форма списка другая, порядок тот же
+        clear();
+        reserve(values.size());
+        std::array<std::uint32_t, k_max_level> last;
+        std::array<std::size_t, k_max_level> last_rank{};
+        last.fill(k_head);
+        std::size_t rank = 0;
+        for (const T value : values) {
+            const auto height = random_height();
+            const auto idx = allocate(value, height);
+            ++rank;
+            for (std::size_t i = 0; i < height; ++i) {
+                at(last[i], i) = link{ idx, static_cast<std::uint32_t>(rank - last_rank[i]) };
+                last[i] = idx;
+                last_rank[i] = rank;
+            }
+            _level = std::max<std::size_t>(_level, height);
+        }
+        _size = values.size();
+        for (std::size_t i = 0; i < _level; ++i) {
+            at(last[i], i) = link{ k_nil, static_cast<std::uint32_t>(_size + 1 - last_rank[i]) };
+        }
+        _rng = rng;
+        return true;
+    }
+
+}
@@ -0,0 +1,155 @@
+/**
+ * \file spsc.hpp
+ * \brief Ограниченная lock-free очередь: один производитель, один потребитель
+ *
+ * Кольцо ёмкостью степени двойки; голова и хвост — монотонные счётчики
+ * в разных кэш-линиях, каждый пишет только свой поток. Блокирующие
+ * push() / pop() ждут на самом счётчике (std::atomic::wait), поэтому
+ * ожидание не крутит процессор, а быстрый путь не берёт мьютекс.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+namespace csv_median {
+
+    // Размер кэш-линии для разнесения счётчиков очереди
+    inline constexpr std::size_t k_cache_line = 64;
+
+    /**
+     * \brief SPSC очередь фиксированной ёмкости
+     *
+     * push() / try_push() вызывает только поток-производитель,
+     * pop() / try_pop() — только поток-потребитель.
+     *
+     * \tparam T копируемый тип элемента
+     */
+    template<class T>
+    class spsc_ring {
+    public:
+        /**
+         * \param capacity_ минимальная ёмкость; округляется до степени двойки
+         */
+        explicit spsc_ring(std::size_t capacity_);
+
+        spsc_ring(const spsc_ring&) = delete;
+        spsc_ring& operator=(const spsc_ring&) = delete;
+
+        /**
+         * \return false если очередь заполнена
+         */
+        [[nodiscard]] bool try_push(const T& value_) noexcept;
+
+        /**
+         * \return false если очередь пуста
+         */
+        [[nodiscard]] bool try_pop(T& value_) noexcept;
+
+        /**
+         * \brief Добавить элемент, ожидая свободного места
+         */
+        void push(const T& value_) noexcept;
+
+        /**
+         * \brief Забрать элемент, ожидая его появления
+         */
+        [[nodiscard]] T pop() noexcept;
+
+        [[nodiscard]] std::size_t capacity() const noexcept;
+
+        /**
+         * \brief Число элементов; из третьего потока — приблизительно
+         */
+        [[nodiscard]] std::size_t size() const noexcept;
+
+    private:
+        std::vector<T> _slots;
+        std::size_t    _mask;
+
+        alignas(k_cache_line) std::atomic<std::size_t> _head{ 0 }; ///< пишет потребитель
+        alignas(k_cache_line) std::atomic<std::size_t> _tail{ 0 }; ///< пишет производитель
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    template<class T>
+    inline spsc_ring<T>::spsc_ring(std::size_t capacity_)
+        : _slots(std::bit_ceil(capacity_ < 1 ? std::size_t{ 1 } : capacity_))
+        , _mask{ _slots.size() - 1 }
+    {
+    }
+
+    template<class T>
+    inline bool spsc_ring<T>::try_push(const T& value_) noexcept {
+        const std::size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == _slots.size()) {
+            return false;
+        }
+        _slots[tail & _mask] = value_;
+        _tail.store(tail + 1, std::memory_order_release);
+        _tail.notify_one();
+        return true;
+    }
+
+    template<class T>
+    inline bool spsc_ring<T>::try_pop(T& value_) noexcept {
+        const std::size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value_ = _slots[head & _mask];
+        _head.store(head + 1, std::memory_order_release);
+        _head.notify_one();
+        return true;
+    }
+
+    template<class T>
+    inline void spsc_ring<T>::push(const T& value_) noexcept {
+        const std::size_t tail = _tail.load(std::memory_order_relaxed);
+        for (;;) {
+            const std::size_t head = _head.load(std::memory_order_acquire);
+            if (tail - head != _slots.size()) {
+                break;
+            }
+            _head.wait(head, std::memory_order_acquire);
+        }
+        _slots[tail & _mask] = value_;
+        _tail.store(tail + 1, std::memory_order_release);
+        _tail.notify_one();
+    }
+
+    template<class T>
+    inline T spsc_ring<T>::pop() noexcept {
+        const std::size_t head = _head.load(std::memory_order_relaxed);
+        for (;;) {
+            const std::size_t tail = _tail.load(std::memory_order_acquire);
+            if (tail != head) {
+                break;
+            }
+            _tail.wait(tail, std::memory_order_acquire);
+        }
+        T value = _slots[head & _mask];
+        _head.store(head + 1, std::memory_order_release);
+        _head.notify_one();
+        return value;
+    }
+
+    template<class T>
+    inline std::size_t spsc_ring<T>::capacity() const noexcept {
+        return _slots.size();
+    }
+
+    template<class T>
+    inline std::size_t spsc_ring<T>::size() const noexcept {
+        // _head не обгоняет _tail: сначала читается head
+        const std::size_t head = _head.load(std::memory_order_acquire);
+        return _tail.load(std::memory_order_acquire) - head;
+    }
+
+}
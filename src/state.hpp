@@ -0,0 +1,259 @@
+/**
+ * \file state.hpp
+ * \brief Двоичный снимок состояния калькуляторов для checkpoint.hpp
+ *
+ * Значения пишутся подряд в порядке байт машины. Целые цены и метки
+ * времени — дельтами с предыдущим значением (zigzag LEB128, varint.hpp):
+ * отсортированные цены кучи или skip list и receive_ts окна занимают
+ * 1-3 байта вместо 8. double пишется как есть.
+ *
+ * state_reader проверяет границы: после первой ошибки все чтения
+ * возвращают false, и снимок считается повреждённым.
+ */
+
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "varint.hpp"
+
+namespace csv_median {
+
+    /**
+     * \brief Запись снимка в растущий буфер
+     */
+    class state_writer {
+    public:
+        /**
+         * \brief Значение как есть (sizeof(T) байт)
+         */
+        template<class T>
+            requires std::is_trivially_copyable_v<T>
+        void put(const T& value_);
+
+        /**
+         * \brief Беззнаковое число в LEB128
+         */
+        void put_varint(std::uint64_t value_);
+
+        /**
+         * \brief Значение относительно prev_: целое — дельтой, double — как есть
+         * \param prev_ предыдущее значение ряда; обновляется
+         */
+        template<class T>
+        void put_value(T value_, T& prev_);
+
+        /**
+         * \brief Число значений и значения рядом через put_value
+         */
+        template<class T>
+        void put_values(std::span<const T> values_);
+
+        /**
+         * \brief Длина и байты
+         */
+        void put_bytes(std::span<const unsigned char> bytes_);
+
+        [[nodiscard]] std::span<const unsigned char> data() const noexcept;
+
+    private:
+        std::vector<unsigned char> _data;
+    };
+
+    /**
+     * \brief Чтение снимка, записанного state_writer
+     */
+    class state_reader {
+    public:
+        explicit state_reader(std::span<const unsigned char> data_) noexcept;
+
+        template<class T>
+            requires std::is_trivially_copyable_v<T>
+        [[nodiscard]] bool get(T& value_) noexcept;
+
+        [[nodiscard]] bool get_varint(std::uint64_t& value_) noexcept;
+
+        /**
+         * \brief Значение, записанное put_value с тем же prev_
+         */
+        template<class T>
+        [[nodiscard]] bool get_value(T& value_, T& prev_) noexcept;
+
+        /**
+         * \brief Значения, записанные put_values
+         */
+        template<class T, class Alloc>
+        [[nodiscard]] bool get_values(std::vector<T, Alloc>& values_);
+
+        /**
+         * \brief Байты, записанные put_bytes
+         */
+        [[nodiscard]] bool get_bytes(std::vector<unsigned char>& bytes_);
+
+        /**
+         * \brief Прочитано всё и без ошибок
+         */
+        [[nodiscard]] bool done() const noexcept;
+
+    private:
+        const unsigned char* _pos;
+        const unsigned char* _end;
+        bool                 _ok{ true };
+    };
+
+    /**
+     * \brief Калькулятор, состояние которого сохраняется в снимок
+     *
+     * save() может переупорядочить хранение (кучи сортируются на месте),
+     * но не меняет результат расчёта.
+     */
+    template<class Calc>
+    concept checkpointable = requires(Calc& c_, state_writer& out_, state_reader& in_) {
+        c_.save(out_);
+        { c_.load(in_) } -> std::same_as<bool>;
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    template<class T>
+        requires std::is_trivially_copyable_v<T>
+    inline void state_writer::put(const T& value_) {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &value_, sizeof(T));
+        _data.insert(_data.end(), bytes, bytes + sizeof(T));
+    }
+
+    inline void state_writer::put_varint(std::uint64_t value_) {
+        // Без дельты zigzag удвоил бы число; пишем LEB128 напрямую
+        while (value_ >= 0x80) {
+            _data.push_back(static_cast<unsigned char>(value_ | 0x80));
+            value_ >>= 7;
+        }
+        _data.push_back(static_cast<unsigned char>(value_));
+    }
+
+    template<class T>
+    inline void state_writer::put_value(T value_, T& prev_) {
+        if constexpr (std::is_integral_v<T>) {
+            unsigned char bytes[k_max_varint_size];
+            unsigned char* const end = put_delta(bytes, static_cast<std::uint64_t>(value_),
+                static_cast<std::uint64_t>(prev_));
+            _data.insert(_data.end(), bytes, end);
+        }
+        else {
+            put(value_);
+        }
+        prev_ = value_;
+    }
+
+    template<class T>
+    inline void state_writer::put_values(std::span<const T> values_) {
+        put_varint(values_.size());
+        T prev{};
+        for (const T value : values_) {
+            put_value(value, prev);
+        }
+    }
+
+    inline void state_writer::put_bytes(std::span<const unsigned char> bytes_) {
+        put_varint(bytes_.size());
+        _data.insert(_data.end(), bytes_.begin(), bytes_.end());
+    }
+
+    inline std::span<const unsigned char> state_writer::data() const noexcept {
+        return _data;
+    }
+
+    inline state_reader::state_reader(std::span<const unsigned char> data_) noexcept
+        : _pos{ data_.data() }
+        , _end{ data_.data() + data_.size() }
+    {
+    }
+
+    template<class T>
+        requires std::is_trivially_copyable_v<T>
+    inline bool state_reader::get(T& value_) noexcept {
+        if (!_ok || static_cast<std::size_t>(_end - _pos) < sizeof(T)) [[unlikely]] {
+            _ok = false;
+            return false;
+        }
+        std::memcpy(&value_, _pos, sizeof(T));
+        _pos += sizeof(T);
+        return true;
+    }
+
+    inline bool state_reader::get_varint(std::uint64_t& value_) noexcept {
+        value_ = 0;
+        for (unsigned shift = 0; _ok; shift += 7) {
+            if (_pos == _end || shift > 63) [[unlikely]] {
+                _ok = false;
+                break;
+            }
+            const unsigned char byte = *_pos++;
+            value_ |= std::uint64_t{ byte & 0x7fu } << shift;
+            if ((byte & 0x80u) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<class T>
+    inline bool state_reader::get_value(T& value_, T& prev_) noexcept {
+        if constexpr (std::is_integral_v<T>) {
+            auto value = static_cast<std::uint64_t>(prev_);
+            if (!_ok || !get_delta(_pos, _end, value)) [[unlikely]] {
+                _ok = false;
+                return false;
+            }
+            value_ = static_cast<T>(value);
+        }
+        else if (!get(value_)) {
+            return false;
+        }
+        prev_ = value_;
+        return true;
+    }
+
+    template<class T, class Alloc>
+    inline bool state_reader::get_values(std::vector<T, Alloc>& values_) {
+        std::uint64_t count = 0;
+        // Значение занимает хотя бы байт: длина больше остатка — повреждение
+        if (!get_varint(count) || count > static_cast<std::uint64_t>(_end - _pos)) {
+            _ok = false;
+            return false;
+        }
+        values_.resize(static_cast<std::size_t>(count));
+        T prev{};
+        for (T& value : values_) {
+            if (!get_value(value, prev)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline bool state_reader::get_bytes(std::vector<unsigned char>& bytes_) {
+        std::uint64_t size = 0;
+        if (!get_varint(size) || size > static_cast<std::uint64_t>(_end - _pos)) {
+            _ok = false;
+            return false;
+        }
+        bytes_.assign(_pos, _pos + size);
+        _pos += size;
+        return true;
+    }
+
+    inline bool state_reader::done() const noexcept {
+        return _ok && _pos == _end;
+    }
+
+}
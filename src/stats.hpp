@@ -0,0 +1,314 @@
+/**
+ * \file stats.hpp
+ * \brief Квантили, VWAP, среднее и отклонение рядом с медианой за один проход
+ *
+ * statistics_calculator держит калькулятор с движком порядковых
+ * статистик (skiplist или histogram) и суммы цен и объёмов. Квантили
+ * берутся из того же движка за O(log n) только при выводе строки,
+ * суммы обновляются на каждой записи. С окном записи вытесняются так
+ * же, как в sliding_window: из движка и из сумм.
+ *
+ * Строка выводится при изменении медианы — те же строки, что и без
+ * статистик, только шире. Среднее и дисперсия считаются по Уэлфорду
+ * с обратным шагом при вытеснении, суммы — в long double, чтобы
+ * вычитание вытесненных значений не копило заметную для 8 знаков
+ * вывода погрешность.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "median.hpp"
+#include "options.hpp"
+#include "price.hpp"
+#include "window.hpp"
+
+namespace csv_median {
+
+    /**
+     * \brief Нужна ли статистикам колонка quantity
+     */
+    [[nodiscard]] bool uses_quantity(std::span<const statistic> stats_) noexcept;
+
+    /**
+     * \brief Среднее, дисперсия и VWAP мультимножества с удалением
+     */
+    class running_moments {
+    public:
+        /**
+         * \brief Добавить цену с объёмом
+         */
+        void add(double price_, double quantity_) noexcept;
+
+        /**
+         * \brief Удалить ранее добавленную пару
+         */
+        void remove(double price_, double quantity_) noexcept;
+
+        [[nodiscard]] double mean() const noexcept;
+
+        /**
+         * \brief Стандартное отклонение по всем значениям (делитель n)
+         */
+        [[nodiscard]] double stddev() const noexcept;
+
+        /**
+         * \brief sum(price * quantity) / sum(quantity); NaN при нулевом объёме
+         */
+        [[nodiscard]] double vwap() const noexcept;
+
+        [[nodiscard]] std::size_t count() const noexcept;
+
+    private:
+        std::size_t _count{ 0 };
+        long double _mean{ 0 };
+        long double _m2{ 0 };       ///< сумма квадратов отклонений от среднего
+        long double _notional{ 0 }; ///< sum(price * quantity)
+        long double _volume{ 0 };   ///< sum(quantity)
+    };
+
+    /**
+     * \brief Медиана и статистики [main].statistics за всё время или в окне
+     *
+     * \tparam Calc basic_calculator с движком, поддерживающим удаление
+     *         и доступ по рангу
+     */
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    class statistics_calculator {
+    public:
+        using value_type = typename Calc::value_type;
+
+        /**
+         * \param width_us_ ширина окна в микросекундах; 0 — за всё время
+         * \param stats_ колонки строки после медианы, по порядку
+         * \param calc_ калькулятор с заранее настроенным движком
+         */
+        statistics_calculator(std::uint64_t width_us_, std::vector<statistic> stats_,
+            Calc calc_ = Calc{});
+
+        /**
+         * \brief Сдвинуть окно к ts_ и добавить запись
+         * \param quantity_ объём записи; 0, если VWAP не нужен
+         * \return not_enough_memory — запись не добавлена, окно уже сдвинуто
+         */
+        std::error_code add(std::uint64_t ts_, value_type price_, double quantity_) noexcept;
+
+        [[nodiscard]] value_type median() const noexcept;
+
+        /**
+         * \brief Изменилась ли медиана после последнего add()
+         */
+        [[nodiscard]] bool is_changed() const noexcept;
+
+        /**
+         * \brief Ключ сравнения медиан (basic_calculator::key)
+         */
+        [[nodiscard]] value_type key() const noexcept;
+
+        /**
+         * \brief Значения статистик в порядке stats_ после последнего add()
+         * \warning Вызов до add() — UB
+         */
+        [[nodiscard]] std::span<const double> values() noexcept;
+
+        /**
+         * \brief Число учтённых записей (в окне или всего)
+         */
+        [[nodiscard]] std::size_t count() const noexcept;
+
+        [[nodiscard]] const Calc& calculator() const noexcept;
+
+    private:
+        struct sample {
+            std::uint64_t ts;
+            value_type    price;
+            double        quantity;
+        };
+
+        /**
+         * \brief Вытеснить записи с ts <= now_ - width
+         */
+        void expire(std::uint64_t now_) noexcept;
+
+        Calc                   _calc;
+        running_moments        _moments;
+        ring_buffer<sample>    _fifo;   ///< только с окном
+        std::vector<statistic> _stats;
+        std::vector<double>    _values;
+        std::uint64_t          _width;
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline bool uses_quantity(std::span<const statistic> stats_) noexcept {
+        return std::ranges::any_of(stats_, [](const statistic& stat_) {
+            return stat_.kind == statistic_kind::vwap;
+            });
+    }
+
+    inline void running_moments::add(double price_, double quantity_) noexcept {
+        const long double x = price_;
+        ++_count;
+        const long double delta = x - _mean;
+        _mean += delta / static_cast<long double>(_count);
+        _m2 += delta * (x - _mean);
+        _notional += x * quantity_;
+        _volume += quantity_;
+    }
+
+    inline void running_moments::remove(double price_, double quantity_) noexcept {
+        if (_count <= 1) {
+            // Пустое окно: начинаем без накопленной погрешности
+            *this = running_moments{};
+            return;
+        }
+        const long double x = price_;
+        const long double before = _mean;
+        const auto n = static_cast<long double>(_count);
+        _mean = (n * _mean - x) / (n - 1);
+        --_count;
+        _m2 = std::max(0.0L, _m2 - (x - before) * (x - _mean));
+        _notional -= x * quantity_;
+        _volume -= quantity_;
+    }
+
+    inline double running_moments::mean() const noexcept {
+        return static_cast<double>(_mean);
+    }
+
+    inline double running_moments::stddev() const noexcept {
+        if (_count == 0) {
+            return 0.0;
+        }
+        return static_cast<double>(std::sqrt(_m2 / static_cast<long double>(_count)));
+    }
+
+    inline double running_moments::vwap() const noexcept {
+        if (_volume == 0) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        return static_cast<double>(_notional / _volume);
+    }
+
+    inline std::size_t running_moments::count() const noexcept {
+        return _count;
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline statistics_calculator<Calc>::statistics_calculator(std::uint64_t width_us_,
+        std::vector<statistic> stats_, Calc calc_)
+        : _calc{ std::move(calc_) }
+        , _stats{ std::move(stats_) }
+        , _values(_stats.size())
+        , _width{ width_us_ }
+    {
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline std::error_code statistics_calculator<Calc>::add(std::uint64_t ts_,
+        value_type price_, double quantity_) noexcept
+    {
+        if (_width != 0) {
+            // Удаления до add() учитываются в его сравнении медиан
+            expire(ts_);
+            try {
+                _fifo.push_back(sample{ ts_, price_, quantity_ });
+            }
+            catch (const std::bad_alloc&) {
+                return std::make_error_code(std::errc::not_enough_memory);
+            }
+        }
+        if (const auto err = _calc.add(price_)) {
+            if (_width != 0) {
+                _fifo.pop_back();
+            }
+            return err;
+        }
+        _moments.add(price_to_double(price_), quantity_);
+        return {};
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline void statistics_calculator<Calc>::expire(std::uint64_t now_) noexcept {
+        if (now_ < _width) {
+            return;
+        }
+        const std::uint64_t cutoff = now_ - _width;
+        while (!_fifo.empty() && _fifo.front().ts <= cutoff) {
+            const sample& old = _fifo.front();
+            _calc.remove(old.price);
+            _moments.remove(price_to_double(old.price), old.quantity);
+            _fifo.pop_front();
+        }
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline auto statistics_calculator<Calc>::median() const noexcept -> value_type {
+        return _calc.median();
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline bool statistics_calculator<Calc>::is_changed() const noexcept {
+        return _calc.is_changed();
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline auto statistics_calculator<Calc>::key() const noexcept -> value_type {
+        return _calc.key();
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline std::span<const double> statistics_calculator<Calc>::values() noexcept {
+        for (std::size_t i = 0; i < _stats.size(); ++i) {
+            switch (_stats[i].kind) {
+            case statistic_kind::quantile:
+                _values[i] = price_to_double(
+                    _calc.quantile(static_cast<double>(_stats[i].percent) / 100.0));
+                break;
+            case statistic_kind::vwap:
+                _values[i] = _moments.vwap();
+                break;
+            case statistic_kind::mean:
+                _values[i] = _moments.mean();
+                break;
+            case statistic_kind::stddev:
+                _values[i] = _moments.stddev();
+                break;
+            }
+        }
+        return _values;
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline std::size_t statistics_calculator<Calc>::count() const noexcept {
+        return _moments.count();
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline const Calc& statistics_calculator<Calc>::calculator() const noexcept {
+        return _calc;
+    }
+
+}
@@ -0,0 +1,636 @@
+/**
+ * \file uring.hpp
+ * \brief Минимальная обёртка io_uring (Linux) без liburing
+ *
+ * io_ring — кольца отправки и завершения, отображённые из ядра, и
+ * операции чтения / записи по смещению. Запросы копятся в кольце
+ * отправки и уходят в ядро одним io_uring_enter, поэтому несколько
+ * больших чтений или записей выполняются одновременно без отдельного
+ * системного вызова на каждый.
+ *
+ * uring_file_reader поверх него читает файл последовательно, держа
+ * в полёте несколько блоков вперёд; опционально с O_DIRECT в обход
+ * page cache.
+ *
+ * Сборка без io_uring: CMake-опция CSV_MEDIAN_IO_URING=OFF
+ * (макрос CSV_MEDIAN_NO_IO_URING) или система без <linux/io_uring.h>.
+ * Тогда open() возвращает not_supported, и вызывающий код
+ * откатывается на обычное чтение и запись.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if !defined(CSV_MEDIAN_NO_IO_URING) && defined(__linux__) \
+    && __has_include(<linux/io_uring.h>)
+#define CSV_MEDIAN_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace csv_median {
+
+    namespace fs = std::filesystem;
+
+    // Выравнивание буферов, смещений и длин для O_DIRECT
+    inline constexpr std::size_t k_io_align = 4096;
+
+    // Блок чтения uring_file_reader
+    inline constexpr std::size_t k_uring_block_size = 1024 * 1024;
+
+    // Число блоков чтения в полёте на файл
+    inline constexpr unsigned k_uring_read_depth = 4;
+
+    /**
+     * \brief Освобождение памяти std::aligned_alloc
+     */
+    struct free_deleter {
+        void operator()(char* ptr_) const noexcept {
+            std::free(ptr_);
+        }
+    };
+
+    using aligned_buffer = std::unique_ptr<char[], free_deleter>;
+
+    /**
+     * \brief Буфер size_ байт, выровненный на k_io_align
+     * \return nullptr при нехватке памяти
+     */
+    [[nodiscard]] inline aligned_buffer allocate_aligned(std::size_t size_) noexcept {
+        const std::size_t rounded = (size_ + k_io_align - 1) / k_io_align * k_io_align;
+        return aligned_buffer{ static_cast<char*>(std::aligned_alloc(k_io_align, rounded)) };
+    }
+
+    /**
+     * \brief Доступен ли io_uring в этой сборке и ядре
+     */
+    [[nodiscard]] bool io_uring_supported() noexcept;
+
+    /**
+     * \brief Кольца io_uring одного владельца (не потокобезопасно)
+     */
+    class io_ring {
+    public:
+        /**
+         * \brief Завершённый запрос
+         */
+        struct completion {
+            std::uint64_t tag;    ///< значение из queue_read / queue_write
+            int           result; ///< число байт или -errno
+        };
+
+        io_ring() noexcept = default;
+        ~io_ring() noexcept;
+
+        io_ring(const io_ring&) = delete;
+        io_ring& operator=(const io_ring&) = delete;
+
+        /**
+         * \brief Создать кольца на entries_ запросов
+         * \return код ошибки; not_supported — io_uring недоступен
+         */
+        [[nodiscard]] std::error_code open(unsigned entries_) noexcept;
+
+        [[nodiscard]] bool is_open() const noexcept;
+
+        /**
+         * \brief Поставить чтение len_ байт со смещения offset_
+         * \return false если кольцо отправки заполнено
+         */
+        [[nodiscard]] bool queue_read(int fd_, char* buf_, std::size_t len_,
+            std::uint64_t offset_, std::uint64_t tag_) noexcept;
+
+        /**
+         * \brief Поставить запись len_ байт по смещению offset_
+         * \return false если кольцо отправки заполнено
+         */
+        [[nodiscard]] bool queue_write(int fd_, const char* buf_, std::size_t len_,
+            std::uint64_t offset_, std::uint64_t tag_) noexcept;
+
+        /**
+         * \brief Отправить поставленные запросы в ядро
+         * \param wait_ дождаться хотя бы стольких завершений
+         * \return код ошибки io_uring_enter
+         */
+        [[nodiscard]] std::error_code submit(unsigned wait_ = 0) noexcept;
+
+        /**
+         * \brief Забрать готовое завершение
+         * \return false если готовых нет
+         */
+        [[nodiscard]] bool pop(completion& out_) noexcept;
+
+        void close() noexcept;
+
+    private:
+#if defined(CSV_MEDIAN_IO_URING)
+        [[nodiscard]] bool queue(std::uint8_t opcode_, int fd_, const char* buf_,
+            std::size_t len_, std::uint64_t offset_, std::uint64_t tag_) noexcept;
+
+        void*          _sq_ring{ nullptr };
+        std::size_t    _sq_ring_size{ 0 };
+        void*          _cq_ring{ nullptr };
+        std::size_t    _cq_ring_size{ 0 };
+        io_uring_sqe*  _sqes{ nullptr };
+        std::size_t    _sqes_size{ 0 };
+
+        unsigned*      _sq_head{ nullptr };
+        unsigned*      _sq_tail{ nullptr };
+        unsigned*      _sq_array{ nullptr };
+        unsigned       _sq_mask{ 0 };
+        unsigned       _sq_entries{ 0 };
+        unsigned*      _cq_head{ nullptr };
+        unsigned*      _cq_tail{ nullptr };
+        io_uring_cqe*  _cqes{ nullptr };
+        unsigned       _cq_mask{ 0 };
+#endif
+        int            _fd{ -1 };
+        unsigned       _queued{ 0 };  ///< поставлено, но не отправлено
+    };
+
+    /**
+     * \brief Последовательное чтение файла с упреждением через io_uring
+     *
+     * Файл делится на блоки k_uring_block_size; до depth блоков читаются
+     * одновременно, read() копирует данные готовых блоков по порядку
+     * и сразу ставит освободившийся блок на чтение следующего.
+     */
+    class uring_file_reader {
+    public:
+        uring_file_reader() noexcept = default;
+        ~uring_file_reader() noexcept;
+
+        uring_file_reader(const uring_file_reader&) = delete;
+        uring_file_reader& operator=(const uring_file_reader&) = delete;
+
+        /**
+         * \param direct_ открыть с O_DIRECT; если файловая система его
+         *        не поддерживает — без него
+         * \param offset_ начать чтение с этого смещения, округлённого вниз
+         *        до k_io_align (первым read() придут байты от округлённого)
+         * \return код ошибки; not_supported — io_uring недоступен
+         *         или файл не регулярный
+         */
+        [[nodiscard]] std::error_code open(const fs::path& path_, bool direct_,
+            unsigned depth_ = k_uring_read_depth, std::size_t offset_ = 0) noexcept;
+
+        /**
+         * \brief Прочитать следующие до size_ байт файла
+         * \return число байт; 0 — конец файла или ошибка (err_)
+         */
+        [[nodiscard]] std::size_t read(char* out_, std::size_t size_,
+            std::error_code& err_) noexcept;
+
+        [[nodiscard]] bool is_open() const noexcept;
+
+        /**
+         * \brief Файл открыт с O_DIRECT
+         */
+        [[nodiscard]] bool direct() const noexcept;
+
+        void close() noexcept;
+
+    private:
+        struct block {
+            aligned_buffer data;
+            std::size_t    offset{ 0 };
+            std::size_t    size{ 0 };   ///< прочитано байт
+            bool           ready{ false };
+        };
+
+        /**
+         * \brief Поставить блок на чтение следующего участка файла
+         * \return false если файл уже весь поставлен на чтение
+         */
+        [[nodiscard]] bool schedule(std::size_t index_) noexcept;
+
+        /**
+         * \brief Дождаться готовности блока index_
+         */
+        [[nodiscard]] std::error_code await(std::size_t index_) noexcept;
+
+        io_ring            _ring;
+        std::vector<block> _blocks;
+        int                _fd{ -1 };
+        bool               _direct{ false };
+        std::size_t        _file_size{ 0 };
+        std::size_t        _next_offset{ 0 };  ///< следующее смещение для чтения
+        std::size_t        _current{ 0 };      ///< блок, из которого читает read()
+        std::size_t        _current_pos{ 0 };
+        std::size_t        _pending{ 0 };      ///< блоков в полёте или готовых
+        std::size_t        _inflight{ 0 };     ///< чтений в ядре
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    inline bool io_uring_supported() noexcept {
+        io_ring ring;
+        return !ring.open(1);
+    }
+
+    inline io_ring::~io_ring() noexcept {
+        close();
+    }
+
+    inline bool io_ring::is_open() const noexcept {
+        return _fd >= 0;
+    }
+
+#if defined(CSV_MEDIAN_IO_URING)
+
+    inline std::error_code io_ring::open(unsigned entries_) noexcept {
+        close();
+
+        io_uring_params params{};
+        const long fd = ::syscall(__NR_io_uring_setup, std::max(1u, entries_), &params);
+        if (fd < 0) {
+            // ENOSYS / EPERM: ядро без io_uring или он запрещён
+            return std::make_error_code(std::errc::not_supported);
+        }
+        _fd = static_cast<int>(fd);
+
+        _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+        }
+
+        _sq_ring = ::mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+        if (_sq_ring == MAP_FAILED) {
+            const std::error_code err{ errno, std::system_category() };
+            _sq_ring = nullptr;
+            close();
+            return err;
+        }
+
+        if (single) {
+            _cq_ring = _sq_ring;
+        }
+        else {
+            _cq_ring = ::mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+            if (_cq_ring == MAP_FAILED) {
+                const std::error_code err{ errno, std::system_category() };
+                _cq_ring = nullptr;
+                close();
+                return err;
+            }
+        }
+
+        _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void* const sqes = ::mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            const std::error_code err{ errno, std::system_category() };
+            close();
+            return err;
+        }
+        _sqes = static_cast<io_uring_sqe*>(sqes);
+
+        auto* const sq = static_cast<char*>(_sq_ring);
+        auto* const cq = static_cast<char*>(_cq_ring);
+        _sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        _sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        _sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        _sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        _sq_entries = params.sq_entries;
+        _cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        _cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        _cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        return {};
+    }
+
+    inline bool io_ring::queue(std::uint8_t opcode_, int fd_, const char* buf_,
+        std::size_t len_, std::uint64_t offset_, std::uint64_t tag_) noexcept
+    {
+        // Хвост пишем только мы, голову двигает ядро
+        const unsigned tail = *_sq_tail;
+        const unsigned head = std::atomic_ref{ *_sq_head }.load(std::memory_order_acquire);
+        if (tail - head >= _sq_entries) {
+            return false;
+        }
+
+        const unsigned index = tail & _sq_mask;
+        io_uring_sqe& sqe = _sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode_;
+        sqe.fd = fd_;
+        sqe.addr = reinterpret_cast<std::uint64_t>(buf_);
+        sqe.len = static_cast<std::uint32_t>(len_);
+        sqe.off = offset_;
+        sqe.user_data = tag_;
+        _sq_array[index] = index;
+
+        std::atomic_ref{ *_sq_tail }.store(tail + 1, std::memory_order_release);
+        ++_queued;
+        return true;
+    }
+
+    inline bool io_ring::queue_read(int fd_, char* buf_, std::size_t len_,
+        std::uint64_t offset_, std::uint64_t tag_) noexcept
+    {
+        return queue(IORING_OP_READ, fd_, buf_, len_, offset_, tag_);
+    }
+
+    inline bool io_ring::queue_write(int fd_, const char* buf_, std::size_t len_,
+        std::uint64_t offset_, std::uint64_t tag_) noexcept
+    {
+        return queue(IORING_OP_WRITE, fd_, buf_, len_, offset_, tag_);
+    }
+
+    inline std::error_code io_ring::submit(unsigned wait_) noexcept {
+        while (_queued != 0 || wait_ != 0) {
+            const unsigned flags = (wait_ != 0) ? IORING_ENTER_GETEVENTS : 0u;
+            const long n = ::syscall(__NR_io_uring_enter, _fd, _queued, wait_,
+                flags, nullptr, 0);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return { errno, std::system_category() };
+            }
+            _queued -= static_cast<unsigned>(n);
+            if (wait_ != 0 || n == 0) {
+                break;
+            }
+        }
+        return {};
+    }
+
+    inline bool io_ring::pop(completion& out_) noexcept {
+        const unsigned head = *_cq_head;
+        const unsigned tail = std::atomic_ref{ *_cq_tail }.load(std::memory_order_acquire);
+        if (head == tail) {
+            return false;
+        }
+
+        const io_uring_cqe& cqe = _cqes[head & _cq_mask];
+        out_ = completion{ cqe.user_data, cqe.res };
+        std::atomic_ref{ *_cq_head }.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    inline void io_ring::close() noexcept {
+        if (_sqes != nullptr) {
+            ::munmap(_sqes, _sqes_size);
+            _sqes = nullptr;
+        }
+        if (_cq_ring != nullptr && _cq_ring != _sq_ring) {
+            ::munmap(_cq_ring, _cq_ring_size);
+        }
+        _cq_ring = nullptr;
+        if (_sq_ring != nullptr) {
+            ::munmap(_sq_ring, _sq_ring_size);
+            _sq_ring = nullptr;
+        }
+        if (_fd >= 0) {
+            ::close(_fd);
+            _fd = -1;
+        }
+        _queued = 0;
+    }
+
+#else
+
+    inline std::error_code io_ring::open(unsigned) noexcept {
+        return std::make_error_code(std::errc::not_supported);
+    }
+
+    inline bool io_ring::queue_read(int, char*, std::size_t, std::uint64_t,
+        std::uint64_t) noexcept
+    {
+        return false;
+    }
+
+    inline bool io_ring::queue_write(int, const char*, std::size_t, std::uint64_t,
+        std::uint64_t) noexcept
+    {
+        return false;
+    }
+
+    inline std::error_code io_ring::submit(unsigned) noexcept {
+        return std::make_error_code(std::errc::not_supported);
+    }
+
+    inline bool io_ring::pop(completion&) noexcept {
+        return false;
+    }
+
+    inline void io_ring::close() noexcept {
+    }
+
+#endif
+
+    inline uring_file_reader::~uring_file_reader() noexcept {
+        close();
+    }
+
+    inline std::error_code uring_file_reader::open(const fs::path& path_, bool direct_,
+        unsigned depth_, std::size_t offset_) noexcept
+    {
+        close();
+        depth_ = std::max(1u, depth_);
+
+        if (const auto err = _ring.open(depth_)) {
+            return err;
+        }
+
+        int fd = -1;
+#ifdef O_DIRECT
+        if (direct_) {
+            fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+            _direct = (fd >= 0);
+        }
+#endif
+        if (fd < 0) {
+            fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+        if (fd < 0) {
+            const std::error_code err{ errno, std::system_category() };
+            _ring.close();
+            return err;
+        }
+        _fd = fd;
+
+        struct stat st {};
+        if (::fstat(_fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            close();
+            return std::make_error_code(std::errc::not_supported);
+        }
+        _file_size = static_cast<std::size_t>(st.st_size);
+        _next_offset = offset_ / k_io_align * k_io_align;
+
+        try {
+            _blocks.resize(depth_);
+        }
+        catch (const std::exception&) {
+            close();
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+        for (auto& b : _blocks) {
+            b.data = allocate_aligned(k_uring_block_size);
+            if (!b.data) {
+                close();
+                return std::make_error_code(std::errc::not_enough_memory);
+            }
+        }
+
+        for (std::size_t i = 0; i < _blocks.size() && schedule(i); ++i) {
+        }
+        if (const auto err = _ring.submit()) {
+            close();
+            return err;
+        }
+        return {};
+    }
+
+    inline bool uring_file_reader::schedule(std::size_t index_) noexcept {
+        if (_next_offset >= _file_size) {
+            return false;
+        }
+
+        block& b = _blocks[index_];
+        b.offset = _next_offset;
+        b.size = 0;
+        b.ready = false;
+        if (!_ring.queue_read(_fd, b.data.get(), k_uring_block_size, b.offset, index_)) {
+            return false;
+        }
+        _next_offset += k_uring_block_size;
+        ++_pending;
+        ++_inflight;
+        return true;
+    }
+
+    inline std::error_code uring_file_reader::await(std::size_t index_) noexcept {
+        while (!_blocks[index_].ready) {
+            if (const auto err = _ring.submit(1)) {
+                return err;
+            }
+
+            io_ring::completion done{};
+            while (_ring.pop(done)) {
+                --_inflight;
+                block& b = _blocks[static_cast<std::size_t>(done.tag)];
+                if (done.result < 0) {
+                    return { -done.result, std::system_category() };
+                }
+                b.size = static_cast<std::size_t>(done.result);
+                b.ready = true;
+            }
+        }
+
+        // Короткое чтение не у конца файла дочитываем синхронно
+        block& b = _blocks[index_];
+        const std::size_t expected = std::min(k_uring_block_size, _file_size - b.offset);
+        while (b.size < expected) {
+            const ::ssize_t n = ::pread(_fd, b.data.get() + b.size, expected - b.size,
+                static_cast<off_t>(b.offset + b.size));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                return { errno, std::system_category() };
+            }
+            if (n == 0) {
+                break; // файл укоротился после open()
+            }
+            b.size += static_cast<std::size_t>(n);
+        }
+        return {};
+    }
+
+    inline std::size_t uring_file_reader::read(char* out_, std::size_t size_,
+        std::error_code& err_) noexcept
+    {
+        std::size_t copied = 0;
+        while (copied < size_ && _pending != 0) {
+            if (const auto err = await(_current)) {
+                err_ = err;
+                _pending = 0;
+                return copied;
+            }
+
+            block& b = _blocks[_current];
+            const std::size_t n = std::min(size_ - copied, b.size - _current_pos);
+            std::memcpy(out_ + copied, b.data.get() + _current_pos, n);
+            copied += n;
+            _current_pos += n;
+
+            if (_current_pos == b.size) {
+                // Блок прочитан: ставим его на следующий участок файла
+                --_pending;
+                if (schedule(_current)) {
+                    if (const auto err = _ring.submit()) {
+                        err_ = err;
+                        _pending = 0;
+                        return copied;
+                    }
+                }
+                _current = (_current + 1) % _blocks.size();
+                _current_pos = 0;
+            }
+        }
+        return copied;
+    }
+
+    inline bool uring_file_reader::is_open() const noexcept {
+        return _fd >= 0;
+    }
+
+    inline bool uring_file_reader::direct() const noexcept {
+        return _direct;
+    }
+
+    inline void uring_file_reader::close() noexcept {
+        // Буферы блоков освобождаются только после завершения их чтений
+        while (_inflight != 0) {
+            if (_ring.submit(1)) {
+                // Ядро ещё может писать в буферы: оставляем их
+                for (auto& b : _blocks) {
+                    static_cast<void>(b.data.release());
+                }
+                break;
+            }
+            io_ring::completion done{};
+            while (_inflight != 0 && _ring.pop(done)) {
+                --_inflight;
+            }
+        }
+        _inflight = 0;
+        _ring.close();
+        _blocks.clear();
+        if (_fd >= 0) {
+            ::close(_fd);
+            _fd = -1;
+        }
+        _direct = false;
+        _file_size = 0;
+        _next_offset = 0;
+        _current = 0;
+        _current_pos = 0;
+        _pending = 0;
+    }
+
+}
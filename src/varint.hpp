@@ -0,0 +1,60 @@
+/**
+ * \file varint.hpp
+ * \brief Дельты в zigzag + LEB128 для бинарных колоночных форматов
+ *
+ * Разность соседних значений берётся по модулю 2^64 и кодируется
+ * zigzag (малые по модулю отрицательные — тоже малые), затем LEB128:
+ * по 7 бит в байте, старший бит — «дальше есть ещё байт». Дельта
+ * до 63 занимает байт, до 8191 — два.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace csv_median {
+
+    // Наибольшая длина одного значения
+    inline constexpr std::size_t k_max_varint_size = 10;
+
+    /**
+     * \brief Записать дельту value_ - prev_ с позиции out_
+     * \return позиция за последним записанным байтом
+     */
+    [[nodiscard]] inline unsigned char* put_delta(unsigned char* out_,
+        std::uint64_t value_, std::uint64_t prev_) noexcept
+    {
+        const std::uint64_t delta = value_ - prev_;
+        std::uint64_t zigzag = (delta << 1) ^ (std::uint64_t{ 0 } - (delta >> 63));
+        while (zigzag >= 0x80) {
+            *out_++ = static_cast<unsigned char>(zigzag | 0x80);
+            zigzag >>= 7;
+        }
+        *out_++ = static_cast<unsigned char>(zigzag);
+        return out_;
+    }
+
+    /**
+     * \brief Прочитать дельту и прибавить её к value_
+     * \return false если значение обрезано концом end_ или длиннее 10 байт
+     */
+    [[nodiscard]] inline bool get_delta(const unsigned char*& in_,
+        const unsigned char* end_, std::uint64_t& value_) noexcept
+    {
+        std::uint64_t zigzag = 0;
+        for (unsigned shift = 0;; shift += 7) {
+            if (in_ == end_ || shift > 63) [[unlikely]] {
+                return false;
+            }
+            const unsigned char byte = *in_++;
+            zigzag |= std::uint64_t{ byte & 0x7fu } << shift;
+            if ((byte & 0x80u) == 0) {
+                break;
+            }
+        }
+        value_ += (zigzag >> 1) ^ (std::uint64_t{ 0 } - (zigzag & 1));
+        return true;
+    }
+
+}
@@ -0,0 +1,341 @@
+/**
+ * \file window.hpp
+ * \brief Медиана в скользящем окне по receive_ts
+ *
+ * Окно (now - width, now] хранится дважды: в FIFO кольцевом буфере
+ * в порядке поступления и в калькуляторе с удаляемым движком. Перед
+ * добавлением записи из головы буфера вытесняются все записи, вышедшие
+ * из окна, и удаляются из калькулятора — O(log w) на запись в среднем,
+ * память ограничена числом записей в окне.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "median.hpp"
+#include "pages.hpp"
+#include "state.hpp"
+
+namespace csv_median {
+
+    /**
+     * \brief FIFO кольцевой буфер с ёмкостью степени двойки
+     *
+     * Растёт удвоением, когда заполнен; не сжимается.
+     */
+    template<class T>
+    class ring_buffer {
+    public:
+        void push_back(const T& value_);
+        void pop_front() noexcept;
+        void pop_back() noexcept;
+
+        [[nodiscard]] const T& front() const noexcept;
+
+        /**
+         * \brief i_-й элемент от головы (i_ < size())
+         */
+        [[nodiscard]] const T& operator[](std::size_t i_) const noexcept;
+        [[nodiscard]] std::size_t size() const noexcept;
+        [[nodiscard]] bool empty() const noexcept;
+        [[nodiscard]] std::size_t capacity() const noexcept;
+
+        void clear() noexcept;
+
+    private:
+        void grow();
+
+        page_vector<T> _data;
+        std::size_t    _head{ 0 };
+        std::size_t    _size{ 0 };
+    };
+
+    /**
+     * \brief Калькулятор, которому нужно время записи (скользящее окно)
+     */
+    template<class Calc>
+    concept timed_calculator = requires(Calc c_, typename Calc::value_type v_) {
+        c_.add(std::uint64_t{}, v_);
+    };
+
+    /**
+     * \brief Калькулятор медианы за последние width микросекунд
+     *
+     * Записи вытесняются в порядке поступления: предполагается, что
+     * receive_ts не убывает (как после слияния в csv_reader::process).
+     * Запись с меньшим receive_ts, чем у предыдущих, уйдёт из окна
+     * не раньше них.
+     *
+     * \tparam Calc basic_calculator с движком, поддерживающим удаление
+     */
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    class sliding_window {
+    public:
+        using value_type = typename Calc::value_type;
+
+        /**
+         * \param width_us_ ширина окна в микросекундах (> 0)
+         */
+        explicit sliding_window(std::uint64_t width_us_) noexcept;
+
+        /**
+         * \param calc_ калькулятор с заранее настроенным движком
+         */
+        sliding_window(std::uint64_t width_us_, Calc calc_) noexcept;
+
+        /**
+         * \brief Сдвинуть окно к ts_ и добавить цену
+         * \return not_enough_memory — цена не добавлена, окно уже сдвинуто
+         */
+        std::error_code add(std::uint64_t ts_, value_type price_) noexcept;
+
+        /**
+         * \brief Медиана окна после последнего add()
+         */
+        [[nodiscard]] value_type median() const noexcept;
+
+        /**
+         * \brief Изменилась ли медиана после последнего add()
+         */
+        [[nodiscard]] bool is_changed() const noexcept;
+
+        /**
+         * \brief Ключ сравнения медиан (basic_calculator::key)
+         */
+        [[nodiscard]] value_type key() const noexcept;
+
+        /**
+         * \brief Число записей в окне
+         */
+        [[nodiscard]] std::size_t count() const noexcept;
+
+        [[nodiscard]] std::uint64_t width() const noexcept;
+
+        /**
+         * \brief Калькулятор значений окна
+         */
+        [[nodiscard]] const Calc& calculator() const noexcept;
+
+        /**
+         * \brief Записи окна и калькулятор (checkpoint.hpp)
+         */
+        void save(state_writer& out_);
+
+        /**
+         * \brief Продолжить с состояния save() окна той же ширины
+         * \return false если снимок повреждён или ширина другая
+         */
+        [[nodiscard]] bool load(state_reader& in_);
+
+    private:
+        struct entry {
+            std::uint64_t ts;
+            value_type    price;
+        };
+
+        /**
+         * \brief Вытеснить записи с ts <= now_ - width
+         */
+        void expire(std::uint64_t now_) noexcept;
+
+        Calc                _calc;
+        ring_buffer<entry>  _fifo;
+        std::uint64_t       _width;
+    };
+
+    // ──────────────────────────────────────────────
+    // Реализация
+    // ──────────────────────────────────────────────
+
+    template<class T>
+    inline void ring_buffer<T>::push_back(const T& value_) {
+        if (_size == _data.size()) {
+            grow();
+        }
+        _data[(_head + _size) & (_data.size() - 1)] = value_;
+        ++_size;
+    }
+
+    template<class T>
+    inline void ring_buffer<T>::pop_front() noexcept {
+        _head = (_head + 1) & (_data.size() - 1);
+        --_size;
+    }
+
+    template<class T>
+    inline void ring_buffer<T>::pop_back() noexcept {
+        --_size;
+    }
+
+    template<class T>
+    inline const T& ring_buffer<T>::front() const noexcept {
+        return _data[_head];
+    }
+
+    template<class T>
+    inline const T& ring_buffer<T>::operator[](std::size_t i_) const noexcept {
+        return _data[(_head + i_) & (_data.size() - 1)];
+    }
+
+    template<class T>
+    inline std::size_t ring_buffer<T>::size() const noexcept {
+        return _size;
+    }
+
+    template<class T>
+    inline bool ring_buffer<T>::empty() const noexcept {
+        return _size == 0;
+    }
+
+    template<class T>
+    inline std::size_t ring_buffer<T>::capacity() const noexcept {
+        return _data.size();
+    }
+
+    template<class T>
+    inline void ring_buffer<T>::clear() noexcept {
+        _head = 0;
+        _size = 0;
+    }
+
+    template<class T>
+    inline void ring_buffer<T>::grow() {
+        const std::size_t capacity = _data.empty() ? 64 : _data.size() * 2;
+        page_vector<T> data(capacity);
+
+        // Разворачиваем кольцо в начало нового буфера
+        for (std::size_t i = 0; i < _size; ++i) {
+            data[i] = _data[(_head + i) & (_data.size() - 1)];
+        }
+        _data = std::move(data);
+        _head = 0;
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline sliding_window<Calc>::sliding_window(std::uint64_t width_us_) noexcept
+        : _width{ width_us_ }
+    {
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline sliding_window<Calc>::sliding_window(std::uint64_t width_us_, Calc calc_) noexcept
+        : _calc{ std::move(calc_) }
+        , _width{ width_us_ }
+    {
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline std::error_code sliding_window<Calc>::add(std::uint64_t ts_,
+        value_type price_) noexcept
+    {
+        // Удаления до add() учитываются в его сравнении медиан
+        expire(ts_);
+        try {
+            _fifo.push_back(entry{ ts_, price_ });
+        }
+        catch (const std::bad_alloc&) {
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+        if (const auto err = _calc.add(price_)) {
+            _fifo.pop_back();
+            return err;
+        }
+        return {};
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline void sliding_window<Calc>::expire(std::uint64_t now_) noexcept {
+        if (now_ < _width) {
+            return;
+        }
+        const std::uint64_t cutoff = now_ - _width;
+        while (!_fifo.empty() && _fifo.front().ts <= cutoff) {
+            _calc.remove(_fifo.front().price);
+            _fifo.pop_front();
+        }
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline auto sliding_window<Calc>::median() const noexcept -> value_type {
+        return _calc.median();
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline bool sliding_window<Calc>::is_changed() const noexcept {
+        return _calc.is_changed();
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline auto sliding_window<Calc>::key() const noexcept -> value_type {
+        return _calc.key();
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline std::size_t sliding_window<Calc>::count() const noexcept {
+        return _fifo.size();
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline std::uint64_t sliding_window<Calc>::width() const noexcept {
+        return _width;
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline const Calc& sliding_window<Calc>::calculator() const noexcept {
+        return _calc;
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline void sliding_window<Calc>::save(state_writer& out_) {
+        out_.put(_width);
+        out_.put_varint(_fifo.size());
+        std::uint64_t prev_ts = 0;
+        value_type prev_price{};
+        for (std::size_t i = 0; i < _fifo.size(); ++i) {
+            out_.put_value(_fifo[i].ts, prev_ts);
+            out_.put_value(_fifo[i].price, prev_price);
+        }
+        _calc.save(out_);
+    }
+
+    template<class Calc>
+        requires order_statistic_engine<typename Calc::engine_type>
+    inline bool sliding_window<Calc>::load(state_reader& in_) {
+        std::uint64_t width = 0;
+        std::uint64_t size = 0;
+        if (!in_.get(width) || width != _width || !in_.get_varint(size)) {
+            return false;
+        }
+
+        _fifo.clear();
+        std::uint64_t prev_ts = 0;
+        value_type prev_price{};
+        for (std::uint64_t i = 0; i < size; ++i) {
+            entry e{};
+            if (!in_.get_value(e.ts, prev_ts) || !in_.get_value(e.price, prev_price)) {
+                return false;
+            }
+            _fifo.push_back(e);
+        }
+        return _calc.load(in_) && _calc.count() == _fifo.size();
+    }
+
+}
@@ -1,28 +1,101 @@
 /**
  * \file writer.hpp
  * \brief Запись результатов расчёта медианы в CSV файл
+ *
+ * Строки форматируются напрямую в большой выровненный буфер (to_chars
+ * и format_fixed, без временных строк) и сбрасываются в файл через
+ * write(2), когда в буфере не остаётся места под строку. Ошибка
+ * записи проверяется и логируется один раз на сброс; после неё все
+ * операции возвращают тот же код.
+ *
+ * В асинхронном режиме заполненный буфер передаётся отдельному потоку
+ * записи через SPSC очередь, а расчёт продолжает в свободном буфере из
+ * обратной очереди. Буферов фиксированное число, поэтому при медленном
+ * диске расчёт ждёт освобождения буфера, а память ограничена.
+ *
+ * В режиме io_uring буфер ставится на запись по своему смещению, и
+ * несколько записей идут одновременно без отдельного потока. С O_DIRECT
+ * пишутся только части, кратные k_io_align; остаток переносится
+ * в следующий буфер, а хвост файла дописывается без O_DIRECT.
  */
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
-#include <format>
-#include <fstream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
 #include <tuple>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <spdlog/spdlog.h>
 
+#include "metrics.hpp"
+#include "options.hpp"
+#include "price.hpp"
+#include "spsc.hpp"
+#include "uring.hpp"
+
 namespace csv_median {
 
     namespace fs = std::filesystem;
 
+    // Буфер вывода: сбрасывается одним write(2), когда заполнен
+    inline constexpr std::size_t k_write_buffer_size = 1024 * 1024;
+
+    // Место под строку: ts (20) + ';' + double в fixed 8 (до 319) + '\n'
+    inline constexpr std::size_t k_max_line_size = 512;
+
+    /**
+     * \brief Записать size_ байт целиком, повторяя при EINTR и частичной записи
+     * \return код ошибки write(2)
+     */
+    [[nodiscard]] std::error_code write_all(int fd_, const char* data_,
+        std::size_t size_) noexcept;
+
+    /**
+     * \brief Записать size_ байт целиком по смещению offset_ (pwrite)
+     * \return код ошибки pwrite(2)
+     */
+    [[nodiscard]] std::error_code write_all_at(int fd_, const char* data_,
+        std::size_t size_, std::uint64_t offset_) noexcept;
+
     /**
      * \brief Писатель результатов медианы в CSV формат
      */
     class result_writer {
     public:
-        result_writer() noexcept = default;
+        /**
+         * \param mode_       способ записи; uring без поддержки ядра — sync
+         * \param buffers_    число буферов для async и uring (>= 2)
+         * \param direct_io_  O_DIRECT для write_mode::uring
+         */
+        explicit result_writer(write_mode mode_ = write_mode::sync,
+            std::size_t buffers_ = k_default_write_buffers,
+            bool direct_io_ = false) noexcept;
+
+        result_writer(const result_writer&) = delete;
+        result_writer& operator=(const result_writer&) = delete;
+
+        /**
+         * \brief Колонки после price_median ([main].statistics); до open()
+         */
+        void set_columns(std::span<const std::string> names_);
 
         /**
          * \brief Открыть выходной файл для записи
@@ -38,35 +111,234 @@ namespace csv_median {
          * \brief Записать строку результата
          * \param receive_ts_    временная метка события
          * \param price_median_  значение медианы
-         * \return код ошибки
+         * \return код ошибки, если строка вызвала неудачный сброс буфера
          */
         [[nodiscard]] std::error_code
             write(std::uint64_t receive_ts_, double price_median_) noexcept;
 
+        /**
+         * \brief Записать строку результата в фиксированной точке
+         * \param receive_ts_    временная метка события
+         * \param price_median_  значение медианы в единицах 10^-8
+         * \return код ошибки, если строка вызвала неудачный сброс буфера
+         *
+         * Вывод совпадает с перегрузкой для double.
+         */
+        [[nodiscard]] std::error_code
+            write(std::uint64_t receive_ts_, fixed_price price_median_) noexcept;
+
+        /**
+         * \brief Записать строку с колонками set_columns() после медианы
+         * \param values_ значения колонок по порядку, в {:.8f}
+         * \return код ошибки, если строка вызвала неудачный сброс буфера
+         */
+        [[nodiscard]] std::error_code
+            write(std::uint64_t receive_ts_, double price_median_,
+                std::span<const double> values_) noexcept;
+
+        [[nodiscard]] std::error_code
+            write(std::uint64_t receive_ts_, fixed_price price_median_,
+                std::span<const double> values_) noexcept;
+
+        /**
+         * \brief Сбросить буфер в файл
+         *
+         * В режимах async и uring буфер только передаётся на запись;
+         * её ошибка вернётся из следующего flush() или close().
+         *
+         * \return код ошибки (первой, если запись уже не удалась)
+         */
+        [[nodiscard]] std::error_code flush() noexcept;
+
+        /**
+         * \brief Продолжить файл с контрольной точки (checkpoint.hpp)
+         *
+         * Файл открывается без усечения, хвост после size_ байт
+         * отбрасывается, заголовок не пишется. O_DIRECT не используется:
+         * смещение может быть не выровнено.
+         *
+         * \param size_ размер файла из sync() на момент снимка
+         * \param rows_ строк результата в этих size_ байтах
+         * \return invalid_argument — файл короче size_
+         */
+        [[nodiscard]] std::error_code
+            resume(const fs::path& output_dir_, std::uint64_t size_, std::size_t rows_,
+                const std::string& filename_ = "median_result.csv") noexcept;
+
+        /**
+         * \brief Записать всё выведенное на диск: сбросить буфер, дождаться
+         * записей в полёте и fdatasync
+         *
+         * После успеха файл содержит ровно written_count() строк.
+         * \return размер файла и код ошибки
+         */
+        [[nodiscard]] std::tuple<std::uint64_t, std::error_code> sync() noexcept;
+
         /**
          * \brief Количество записанных строк
          */
         [[nodiscard]] std::size_t written_count() const noexcept;
 
         /**
-         * \brief Закрыть файл и сбросить буферы
+         * \brief Путь выходного файла (после open)
          */
-        void close() noexcept;
+        [[nodiscard]] const fs::path& path() const noexcept;
+
+        /**
+         * \brief Способ записи открытого файла (после отката uring на sync)
+         */
+        [[nodiscard]] write_mode mode() const noexcept;
+
+        /**
+         * \brief Сбросить буфер, дождаться всех записей и закрыть файл
+         * \return код ошибки сброса или закрытия
+         */
+        std::error_code close() noexcept;
 
         ~result_writer() noexcept;
 
     private:
-        std::ofstream _file;
-        std::size_t   _written_count{ 0 };
-        fs::path      _output_path;
+        /**
+         * \brief Заполненная часть буфера; data == nullptr — стоп потоку записи
+         */
+        struct chunk {
+            char*       data;
+            std::size_t size;
+        };
+
+        /**
+         * \brief Запись io_uring в полёте, по индексу буфера
+         */
+        struct pending_write {
+            std::uint64_t offset;
+            std::size_t   size;
+            stopwatch     queued{}; ///< для latency::writer_flush
+        };
+
+        /**
+         * \brief Начало места под следующую строку; nullptr при ошибке
+         * \param columns_ колонок после receive_ts
+         */
+        [[nodiscard]] char* line_begin(std::error_code& err_,
+            std::size_t columns_ = 1) noexcept;
+
+        /**
+         * \brief Дописать ";значение" для каждого из values_
+         */
+        [[nodiscard]] static char* append_values(char* out_,
+            std::span<const double> values_) noexcept;
+
+        /**
+         * \brief Завершить строку, начатую в line_
+         */
+        void end_line(char* line_, char* out_) noexcept;
+
+        /**
+         * \brief Запомнить и залогировать первую ошибку записи
+         */
+        void fail(std::error_code err_) noexcept;
+
+        [[nodiscard]] std::error_code flush_async() noexcept;
+        [[nodiscard]] std::error_code flush_uring() noexcept;
+
+        /**
+         * \brief Цикл потока записи: буферы из _filled в файл и в _free
+         */
+        void drain() noexcept;
+
+        /**
+         * \brief Забрать завершения io_uring
+         * \param wait_ дождаться хотя бы одного
+         */
+        void reap(bool wait_) noexcept;
+
+        /**
+         * \brief Дождаться записей io_uring и дописать хвост буфера
+         */
+        void finish_uring() noexcept;
+
+        std::vector<aligned_buffer>       _buffers;
+        char*                             _current{ nullptr };
+        std::size_t                       _current_index{ 0 };
+        std::size_t                       _used{ 0 };
+        int                               _fd{ -1 };
+        std::error_code                   _error;
+        std::size_t                       _written_count{ 0 };
+        fs::path                          _output_path;
+
+        write_mode                        _requested;
+        write_mode                        _mode{ write_mode::sync };
+        std::size_t                       _buffer_count;
+        bool                              _direct_io;
+
+        // write_mode::async
+        std::unique_ptr<spsc_ring<chunk>> _filled;
+        std::unique_ptr<spsc_ring<chunk>> _free;
+        std::thread                       _thread;
+        std::atomic<int>                  _async_errno{ 0 }; ///< ошибка потока записи
+        std::vector<char*>                _spare;     ///< буферы, забранные sync() из _free
+
+        // write_mode::uring
+        io_ring                           _ring;
+        std::vector<std::size_t>          _idle;      ///< свободные буферы
+        std::vector<pending_write>        _writes;
+        std::size_t                       _inflight{ 0 };
+        std::uint64_t                     _offset{ 0 }; ///< смещение следующей записи
+        bool                              _direct{ false }; ///< файл открыт с O_DIRECT
+
+        std::optional<std::uint64_t>      _resume_size; ///< open() из resume()
 
         static constexpr std::string_view k_header = "receive_ts;price_median\n";
+        std::string                       _header{ k_header };
     };
 
     // ──────────────────────────────────────────────
     // Реализация
     // ──────────────────────────────────────────────
 
+    inline std::error_code write_all(int fd_, const char* data_,
+        std::size_t size_) noexcept
+    {
+        while (size_ > 0) {
+            const ::ssize_t n = ::write(fd_, data_, size_);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return { errno, std::system_category() };
+            }
+            data_ += n;
+            size_ -= static_cast<std::size_t>(n);
+        }
+        return {};
+    }
+
+    inline std::error_code write_all_at(int fd_, const char* data_,
+        std::size_t size_, std::uint64_t offset_) noexcept
+    {
+        while (size_ > 0) {
+            const ::ssize_t n = ::pwrite(fd_, data_, size_, static_cast<off_t>(offset_));
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return { errno, std::system_category() };
+            }
+            data_ += n;
+            size_ -= static_cast<std::size_t>(n);
+            offset_ += static_cast<std::uint64_t>(n);
+        }
+        return {};
+    }
+
+    inline result_writer::result_writer(write_mode mode_, std::size_t buffers_,
+        bool direct_io_) noexcept
+        : _requested{ mode_ }
+        , _buffer_count{ std::max<std::size_t>(2, buffers_) }
+        , _direct_io{ direct_io_ }
+    {
+    }
+
     inline std::error_code result_writer::open(
         const fs::path& output_dir_,
         const std::string& filename_) noexcept
@@ -79,54 +351,549 @@ namespace csv_median {
             }
 
             _output_path = output_dir_ / filename_;
-            _file.open(_output_path, std::ios::out | std::ios::trunc);
+        }
+        catch (const fs::filesystem_error& e) {
+            spdlog::error("can't create dir {}: {}",
+                output_dir_.string(), e.what());
+            return e.code();
+        }
+        catch (const std::exception& e) {
+            spdlog::error("can't build output path: {}", e.what());
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+
+        static_cast<void>(close());
+        _error.clear();
+        _async_errno.store(0, std::memory_order_relaxed);
+        _offset = 0;
+
+        _mode = _requested;
+        if (_mode == write_mode::uring) {
+            if (const auto err = _ring.open(static_cast<unsigned>(_buffer_count))) {
+                spdlog::warn("io_uring is not available ({}), using write(2)",
+                    err.message());
+                _mode = write_mode::sync;
+            }
+        }
+
+        const std::size_t count = (_mode == write_mode::sync) ? 1 : _buffer_count;
+        try {
+            while (_buffers.size() < count) {
+                auto buffer = allocate_aligned(k_write_buffer_size);
+                if (!buffer) {
+                    throw std::bad_alloc{};
+                }
+                _buffers.push_back(std::move(buffer));
+            }
+            if (_mode == write_mode::async) {
+                // Стоп-сигнал занимает место в _filled наравне с буфером
+                _filled = std::make_unique<spsc_ring<chunk>>(count);
+                _free = std::make_unique<spsc_ring<chunk>>(count);
+                _spare.clear();
+                _spare.reserve(count);
+            }
+            if (_mode == write_mode::uring) {
+                _idle.clear();
+                for (std::size_t i = count; i > 1; --i) {
+                    _idle.push_back(i - 1);
+                }
+                _writes.assign(count, pending_write{ 0, 0 });
+            }
+        }
+        catch (const std::exception&) {
+            spdlog::error("can't allocate output buffers");
+            return std::make_error_code(std::errc::not_enough_memory);
+        }
+        _current_index = 0;
+        _current = _buffers.front().get();
 
-            if (!_file.is_open()) {
-                spdlog::error("can't created output file: {}",
+        const int flags = _resume_size ? (O_WRONLY | O_CLOEXEC)
+            : (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC);
+        _direct = false;
+#ifdef O_DIRECT
+        if (_mode == write_mode::uring && _direct_io && !_resume_size) {
+            _fd = ::open(_output_path.c_str(), flags | O_DIRECT, 0644);
+            _direct = (_fd >= 0);
+            if (!_direct) {
+                spdlog::warn("O_DIRECT is not supported for {}, using page cache",
                     _output_path.string());
-                return std::make_error_code(std::errc::permission_denied);
             }
+        }
+#endif
+        if (_fd < 0) {
+            _fd = ::open(_output_path.c_str(), flags, 0644);
+        }
+        if (_fd < 0) {
+            const std::error_code err{ errno, std::system_category() };
+            spdlog::error("can't created output file: {}: {}",
+                _output_path.string(), err.message());
+            return err;
+        }
+
+        if (_resume_size) {
+            struct stat st {};
+            if (::fstat(_fd, &st) != 0 || static_cast<std::uint64_t>(st.st_size) < *_resume_size) {
+                spdlog::error("output file {} is shorter than the checkpoint",
+                    _output_path.string());
+                ::close(_fd);
+                _fd = -1;
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+            const auto size = static_cast<off_t>(*_resume_size);
+            if (::ftruncate(_fd, size) != 0 || ::lseek(_fd, size, SEEK_SET) != size) {
+                const std::error_code err{ errno, std::system_category() };
+                spdlog::error("can't resume output file: {}: {}",
+                    _output_path.string(), err.message());
+                ::close(_fd);
+                _fd = -1;
+                return err;
+            }
+            _offset = *_resume_size;
+            _used = 0;
+        }
+        else {
+            _header.copy(_current, _header.size());
+            _used = _header.size();
+        }
+
+        if (_mode == write_mode::async) {
+            for (std::size_t i = 1; i < _buffers.size(); ++i) {
+                _free->push(chunk{ _buffers[i].get(), 0 });
+            }
+            try {
+                _thread = std::thread{ [this] { drain(); } };
+            }
+            catch (const std::system_error& e) {
+                spdlog::error("can't start output thread: {}", e.what());
+                ::close(_fd);
+                _fd = -1;
+                return e.code();
+            }
+        }
+        return {};
+    }
 
-            _file << k_header;
-            return {};
+    inline std::error_code result_writer::resume(const fs::path& output_dir_,
+        std::uint64_t size_, std::size_t rows_, const std::string& filename_) noexcept
+    {
+        _resume_size = size_;
+        const auto err = open(output_dir_, filename_);
+        _resume_size.reset();
+        _written_count = err ? 0 : rows_;
+        return err;
+    }
 
+    inline void result_writer::fail(std::error_code err_) noexcept {
+        if (!_error) {
+            _error = err_;
+            spdlog::error("error during writing file: {}: {}",
+                _output_path.string(), err_.message());
         }
-        catch (const fs::filesystem_error& e) {
-            spdlog::error("can't create dir {}: {}",
-                output_dir_.string(), e.what());
-            return e.code();
+    }
+
+    inline void result_writer::drain() noexcept {
+        for (;;) {
+            const chunk filled = _filled->pop();
+            if (filled.data == nullptr) {
+                return;
+            }
+
+            // После ошибки буферы только возвращаются, чтобы расчёт не ждал
+            if (_async_errno.load(std::memory_order_relaxed) == 0) {
+                const stopwatch write;
+                if (const auto err = write_all(_fd, filled.data, filled.size)) {
+                    spdlog::error("error during writing file: {}: {}",
+                        _output_path.string(), err.message());
+                    _async_errno.store(err.value(), std::memory_order_release);
+                }
+                else {
+                    add_metric(counter::writer_flushes);
+                    add_metric(counter::writer_bytes, filled.size);
+                    if (metrics_enabled()) {
+                        record_latency(latency::writer_flush, write.elapsed_ns());
+                    }
+                }
+            }
+            _free->push(filled);
+        }
+    }
+
+    inline void result_writer::set_columns(std::span<const std::string> names_) {
+        _header = k_header;
+        _header.pop_back();
+        for (const auto& name : names_) {
+            _header += ';';
+            _header += name;
         }
+        _header += '\n';
+    }
+
+    inline char* result_writer::line_begin(std::error_code& err_,
+        std::size_t columns_) noexcept
+    {
+        if (k_write_buffer_size - _used < k_max_line_size * columns_) [[unlikely]] {
+            err_ = flush();
+            if (err_) {
+                return nullptr;
+            }
+        }
+        return _current + _used;
     }
 
     inline std::error_code result_writer::write(
         std::uint64_t receive_ts_,
         double        price_median_) noexcept
     {
-        // Форматируем с точностью 8 знаков, как в исходных данных
-        _file << std::format("{};{:.8f}\n", receive_ts_, price_median_);
+        std::error_code err;
+        char* const line = line_begin(err);
+        if (line == nullptr) [[unlikely]] {
+            return err;
+        }
+
+        // Точность 8 знаков, как в исходных данных; совпадает с {:.8f}
+        char* out = std::to_chars(line, line + 20, receive_ts_).ptr;
+        *out++ = ';';
+        out = std::to_chars(out, line + k_max_line_size - 1, price_median_,
+            std::chars_format::fixed, 8).ptr;
+        *out++ = '\n';
+
+        _used += static_cast<std::size_t>(out - line);
+        ++_written_count;
+        return {};
+    }
+
+    inline std::error_code result_writer::write(
+        std::uint64_t receive_ts_,
+        fixed_price   price_median_) noexcept
+    {
+        std::error_code err;
+        char* const line = line_begin(err);
+        if (line == nullptr) [[unlikely]] {
+            return err;
+        }
+
+        char* out = std::to_chars(line, line + 20, receive_ts_).ptr;
+        *out++ = ';';
+        out = format_fixed(out, price_median_);
+        *out++ = '\n';
 
-        if (_file.fail()) {
-            spdlog::error("error during reading file: {}", _output_path.string());
-            return std::make_error_code(std::errc::io_error);
+        _used += static_cast<std::size_t>(out - line);
+        ++_written_count;
+        return {};
+    }
+
+    inline char* result_writer::append_values(char* out_,
+        std::span<const double> values_) noexcept
+    {
+        for (const double value : values_) {
+            *out_++ = ';';
+            out_ = std::to_chars(out_, out_ + k_max_line_size - 2, value,
+                std::chars_format::fixed, 8).ptr;
         }
+        return out_;
+    }
 
+    inline void result_writer::end_line(char* line_, char* out_) noexcept {
+        *out_++ = '\n';
+        _used += static_cast<std::size_t>(out_ - line_);
         ++_written_count;
+    }
+
+    inline std::error_code result_writer::write(
+        std::uint64_t           receive_ts_,
+        double                  price_median_,
+        std::span<const double> values_) noexcept
+    {
+        std::error_code err;
+        char* const line = line_begin(err, 1 + values_.size());
+        if (line == nullptr) [[unlikely]] {
+            return err;
+        }
+
+        char* out = std::to_chars(line, line + 20, receive_ts_).ptr;
+        *out++ = ';';
+        out = std::to_chars(out, line + k_max_line_size - 1, price_median_,
+            std::chars_format::fixed, 8).ptr;
+        end_line(line, append_values(out, values_));
         return {};
     }
 
+    inline std::error_code result_writer::write(
+        std::uint64_t           receive_ts_,
+        fixed_price             price_median_,
+        std::span<const double> values_) noexcept
+    {
+        std::error_code err;
+        char* const line = line_begin(err, 1 + values_.size());
+        if (line == nullptr) [[unlikely]] {
+            return err;
+        }
+
+        char* out = std::to_chars(line, line + 20, receive_ts_).ptr;
+        *out++ = ';';
+        out = format_fixed(out, price_median_);
+        end_line(line, append_values(out, values_));
+        return {};
+    }
+
+    inline std::error_code result_writer::flush() noexcept {
+        if (_error || _fd < 0) {
+            return _error;
+        }
+
+        switch (_mode) {
+        case write_mode::async:
+            return flush_async();
+        case write_mode::uring:
+            return flush_uring();
+        case write_mode::sync:
+            break;
+        }
+
+        if (_used != 0) {
+            const stopwatch write;
+            const auto err = write_all(_fd, _current, _used);
+            if (err) {
+                fail(err);
+            }
+            else {
+                add_metric(counter::writer_flushes);
+                add_metric(counter::writer_bytes, _used);
+                if (metrics_enabled()) {
+                    record_latency(latency::writer_flush, write.elapsed_ns());
+                }
+            }
+            _used = 0;
+        }
+        return _error;
+    }
+
+    inline std::error_code result_writer::flush_async() noexcept {
+        if (_used != 0) {
+            _filled->push(chunk{ _current, _used });
+            set_gauge(gauge::write_queue, _filled->size());
+            if (_spare.empty()) {
+                _current = _free->pop().data;
+            }
+            else {
+                _current = _spare.back();
+                _spare.pop_back();
+            }
+            _used = 0;
+        }
+        if (const int err = _async_errno.load(std::memory_order_acquire)) {
+            _error.assign(err, std::system_category());
+        }
+        return _error;
+    }
+
+    inline std::error_code result_writer::flush_uring() noexcept {
+        // С O_DIRECT уходит только выровненная часть буфера
+        const std::size_t size = _direct ? _used - _used % k_io_align : _used;
+        if (size == 0) {
+            reap(false);
+            return _error;
+        }
+
+        while (_idle.empty() && !_error) {
+            reap(true);
+        }
+        if (_error) {
+            return _error;
+        }
+
+        const std::size_t next = _idle.back();
+        _idle.pop_back();
+        char* const next_buffer = _buffers[next].get();
+        const std::size_t tail = _used - size;
+        std::memcpy(next_buffer, _current + size, tail);
+
+        _writes[_current_index] = pending_write{ _offset, size };
+        if (!_ring.queue_write(_fd, _current, size, _offset, _current_index)) {
+            // Колец на число буферов: заполненным быть не может
+            fail(std::make_error_code(std::errc::resource_unavailable_try_again));
+            return _error;
+        }
+        ++_inflight;
+        set_gauge(gauge::write_queue, _inflight);
+        _offset += size;
+        if (const auto err = _ring.submit()) {
+            fail(err);
+        }
+
+        _current_index = next;
+        _current = next_buffer;
+        _used = tail;
+        reap(false);
+        return _error;
+    }
+
+    inline std::tuple<std::uint64_t, std::error_code> result_writer::sync() noexcept {
+        if (_error || _fd < 0) {
+            return { 0, _error };
+        }
+
+        std::uint64_t size = 0;
+        if (_mode == write_mode::uring) {
+            static_cast<void>(flush_uring());
+            while (_inflight != 0 && !_error) {
+                reap(true);
+            }
+            if (_used != 0 && !_error) {
+                // Невыровненный хвост O_DIRECT: пишется и без него, а
+                // смещение не сдвигается — следующий буфер запишет его снова
+#ifdef O_DIRECT
+                const int flags = _direct ? ::fcntl(_fd, F_GETFL) : -1;
+                if (flags >= 0) {
+                    ::fcntl(_fd, F_SETFL, flags & ~O_DIRECT);
+                }
+#endif
+                if (const auto err = write_all_at(_fd, _current, _used, _offset)) {
+                    fail(err);
+                }
+#ifdef O_DIRECT
+                if (flags >= 0) {
+                    ::fcntl(_fd, F_SETFL, flags);
+                }
+#endif
+            }
+            size = _offset + _used;
+        }
+        else {
+            static_cast<void>(flush());
+            if (_mode == write_mode::async) {
+                // Все буферы, кроме текущего, вернулись — записи завершены
+                while (_spare.size() + 1 < _buffers.size()) {
+                    _spare.push_back(_free->pop().data);
+                }
+                static_cast<void>(flush_async());
+            }
+            const off_t end = ::lseek(_fd, 0, SEEK_CUR);
+            if (end < 0) {
+                fail({ errno, std::system_category() });
+            }
+            size = static_cast<std::uint64_t>(end);
+        }
+
+        if (!_error && ::fdatasync(_fd) != 0) {
+            fail({ errno, std::system_category() });
+        }
+        return { size, _error };
+    }
+
+    inline void result_writer::reap(bool wait_) noexcept {
+        if (wait_ && _inflight != 0) {
+            if (const auto err = _ring.submit(1)) {
+                fail(err);
+                return;
+            }
+        }
+
+        io_ring::completion done{};
+        while (_ring.pop(done)) {
+            --_inflight;
+            const auto index = static_cast<std::size_t>(done.tag);
+            const pending_write& w = _writes[index];
+            if (done.result < 0) {
+                fail({ -done.result, std::system_category() });
+            }
+            else if (const auto written = static_cast<std::size_t>(done.result);
+                written < w.size && !_error)
+            {
+                // Короткая запись: остаток синхронно
+                if (const auto err = write_all_at(_fd, _buffers[index].get() + written,
+                    w.size - written, w.offset + written))
+                {
+                    fail(err);
+                }
+            }
+            if (done.result >= 0) {
+                add_metric(counter::writer_flushes);
+                add_metric(counter::writer_bytes, w.size);
+                if (metrics_enabled()) {
+                    record_latency(latency::writer_flush, w.queued.elapsed_ns());
+                }
+            }
+            _idle.push_back(index);
+        }
+    }
+
+    inline void result_writer::finish_uring() noexcept {
+        static_cast<void>(flush_uring());
+
+        while (_inflight != 0) {
+            const std::size_t before = _inflight;
+            reap(true);
+            if (_inflight == before && _error) {
+                // Кольцо не отвечает: буферы могут быть ещё в ядре
+                for (auto& buffer : _buffers) {
+                    static_cast<void>(buffer.release());
+                }
+                _buffers.clear();
+                _inflight = 0;
+            }
+        }
+
+        if (_used != 0 && !_error) {
+#ifdef O_DIRECT
+            // Невыровненный хвост O_DIRECT не запишет
+            if (_direct) {
+                const int flags = ::fcntl(_fd, F_GETFL);
+                if (flags >= 0) {
+                    ::fcntl(_fd, F_SETFL, flags & ~O_DIRECT);
+                }
+            }
+#endif
+            if (const auto err = write_all_at(_fd, _current, _used, _offset)) {
+                fail(err);
+            }
+            _offset += _used;
+        }
+        _used = 0;
+        _ring.close();
+    }
+
     inline std::size_t result_writer::written_count() const noexcept {
         return _written_count;
     }
 
-    inline void result_writer::close() noexcept {
-        if (_file.is_open()) {
-            _file.flush();
-            _file.close();
+    inline const fs::path& result_writer::path() const noexcept {
+        return _output_path;
+    }
+
+    inline write_mode result_writer::mode() const noexcept {
+        return _mode;
+    }
+
+    inline std::error_code result_writer::close() noexcept {
+        if (_fd < 0) {
+            return _error;
+        }
+
+        std::error_code err;
+        if (_mode == write_mode::uring) {
+            finish_uring();
+            err = _error;
+        }
+        else {
+            err = flush();
+            if (_thread.joinable()) {
+                _filled->push(chunk{ nullptr, 0 });
+                _thread.join();
+                err = flush();
+            }
+        }
+        if (::close(_fd) != 0 && !err) {
+            err.assign(errno, std::system_category());
+            spdlog::error("error closing file: {}: {}",
+                _output_path.string(), err.message());
         }
+        _fd = -1;
+        return err;
     }
 
     inline result_writer::~result_writer() noexcept {
-        close();
+        static_cast<void>(close());
     }
 
-}
\ No newline at end of file
+}
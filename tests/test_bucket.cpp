@@ -0,0 +1,155 @@
+/**
+ * \file test_bucket.cpp
+ * \brief Unit-тесты для bucket_sink
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "bucket.hpp"
+#include "writer.hpp"
+
+using csv_median::bucket_sink;
+using csv_median::fixed_price;
+using csv_median::result_writer;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    struct temp_dir {
+        fs::path path;
+
+        temp_dir() {
+            path = fs::temp_directory_path()
+                / ("csv_bucket_test_" + std::to_string(
+                    std::chrono::steady_clock::now().time_since_epoch().count()));
+            fs::create_directories(path);
+        }
+
+        ~temp_dir() {
+            fs::remove_all(path);
+        }
+    };
+
+    std::string read_file(const fs::path& path_) {
+        std::ifstream f{ path_, std::ios::binary };
+        return { std::istreambuf_iterator<char>{ f }, std::istreambuf_iterator<char>{} };
+    }
+
+    /**
+     * \brief Приёмник в память, различающий перегрузки write()
+     */
+    struct memory_sink {
+        std::vector<std::uint64_t> ts;
+        std::vector<double>        price;
+        std::vector<bool>          fixed;
+        bool                       closed{ false };
+        fs::path                   file;
+
+        std::error_code open(const fs::path&) { return {}; }
+        std::error_code open(const fs::path&, const std::string&) { return {}; }
+        std::error_code write(std::uint64_t ts_, double price_) {
+            ts.push_back(ts_);
+            price.push_back(price_);
+            fixed.push_back(false);
+            return {};
+        }
+        std::error_code write(std::uint64_t ts_, fixed_price price_) {
+            (void)write(ts_, static_cast<double>(price_) / 1e8);
+            fixed.back() = true;
+            return {};
+        }
+        std::error_code close() { closed = true; return {}; }
+        std::size_t written_count() const { return ts.size(); }
+        const fs::path& path() const { return file; }
+    };
+
+    static_assert(csv_median::result_sink<bucket_sink<memory_sink>>);
+    static_assert(!csv_median::statistics_sink<bucket_sink<memory_sink>>);
+    static_assert(csv_median::statistics_sink<bucket_sink<result_writer>>);
+
+}
+
+TEST_CASE("bucket_sink - last median per bucket", "[bucket]") {
+    auto owned = std::make_unique<memory_sink>();
+    memory_sink& inner = *owned;
+    bucket_sink<memory_sink> sink{ std::move(owned), 100, false };
+
+    CHECK_FALSE(sink.write(std::uint64_t{ 105 }, 1.0));
+    CHECK_FALSE(sink.write(std::uint64_t{ 150 }, 2.0));
+    CHECK_FALSE(sink.write(std::uint64_t{ 199 }, 3.0));
+    CHECK(inner.ts.empty());
+
+    // Пустые корзины 200..399 пропускаются
+    CHECK_FALSE(sink.write(std::uint64_t{ 420 }, 4.0));
+    CHECK_FALSE(sink.write(std::uint64_t{ 500 }, fixed_price{ 500'000'000 }));
+    CHECK(sink.written_count() == 2);
+
+    REQUIRE_FALSE(sink.close());
+    CHECK(inner.closed);
+    CHECK(inner.ts == std::vector<std::uint64_t>{ 100, 400, 500 });
+    CHECK(inner.price == std::vector<double>{ 3.0, 4.0, 5.0 });
+    CHECK(inner.fixed == std::vector<bool>{ false, false, true });
+}
+
+TEST_CASE("bucket_sink - close without rows", "[bucket]") {
+    auto owned = std::make_unique<memory_sink>();
+    memory_sink& inner = *owned;
+    bucket_sink<memory_sink> sink{ std::move(owned), 1000, false };
+
+    REQUIRE_FALSE(sink.close());
+    CHECK(inner.closed);
+    CHECK(inner.ts.empty());
+}
+
+TEST_CASE("bucket_sink - open, high and low columns", "[bucket]") {
+    temp_dir tmp;
+    bucket_sink<result_writer> sink{ std::make_unique<result_writer>(), 1000, true };
+    REQUIRE_FALSE(sink.open(tmp.path, "out.csv"));
+
+    // Первая корзина открывается своей первой медианой
+    CHECK_FALSE(sink.write(std::uint64_t{ 1000 }, 10.0));
+    CHECK_FALSE(sink.write(std::uint64_t{ 1500 }, 12.0));
+    CHECK_FALSE(sink.write(std::uint64_t{ 1999 }, 11.0));
+    // Следующие — последней медианой прошлой
+    CHECK_FALSE(sink.write(std::uint64_t{ 2100 }, 13.0));
+    CHECK_FALSE(sink.write(std::uint64_t{ 5000 }, fixed_price{ 900'000'000 }));
+    REQUIRE_FALSE(sink.close());
+    CHECK(sink.written_count() == 3);
+
+    CHECK(read_file(tmp.path / "out.csv") ==
+        "receive_ts;price_median;open;high;low\n"
+        "1000;11.00000000;10.00000000;12.00000000;10.00000000\n"
+        "2000;13.00000000;11.00000000;13.00000000;11.00000000\n"
+        "5000;9.00000000;13.00000000;13.00000000;9.00000000\n");
+}
+
+TEST_CASE("bucket_sink - statistics of the last row", "[bucket]") {
+    temp_dir tmp;
+    bucket_sink<result_writer> sink{ std::make_unique<result_writer>(), 10, false };
+    const std::vector<std::string> columns{ "mean" };
+    sink.set_columns(columns);
+    REQUIRE_FALSE(sink.open(tmp.path, "out.csv"));
+
+    const std::vector<double> first{ 1.5 };
+    const std::vector<double> second{ 2.5 };
+    CHECK_FALSE(sink.write(std::uint64_t{ 1 }, 1.0, first));
+    CHECK_FALSE(sink.write(std::uint64_t{ 9 }, 2.0, second));
+    CHECK_FALSE(sink.write(std::uint64_t{ 10 }, 3.0, first));
+    REQUIRE_FALSE(sink.close());
+
+    CHECK(read_file(tmp.path / "out.csv") ==
+        "receive_ts;price_median;mean\n"
+        "0;2.00000000;2.50000000\n"
+        "10;3.00000000;1.50000000\n");
+}
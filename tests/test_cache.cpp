@@ -0,0 +1,309 @@
+/**
+ * \file test_cache.cpp
+ * \brief Unit-тесты для колоночного кэша входных файлов
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "cache.hpp"
+#include "reader.hpp"
+
+using csv_median::cache_reader;
+using csv_median::cache_source_info;
+using csv_median::cache_writer;
+using csv_median::column_batch;
+using csv_median::csv_reader;
+using csv_median::csv_record;
+using csv_median::fixed_price;
+using csv_median::read_mode;
+using csv_median::thread_pool;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    struct temp_dir {
+        fs::path path;
+
+        temp_dir() {
+            path = fs::temp_directory_path()
+                / ("cache_test_" + std::to_string(
+                    std::chrono::steady_clock::now().time_since_epoch().count()));
+            fs::create_directories(path);
+        }
+
+        ~temp_dir() {
+            fs::remove_all(path);
+        }
+
+        fs::path make_file(const std::string& name_, const std::string& content_) const {
+            const auto file_path = path / name_;
+            std::ofstream f{ file_path, std::ios::binary };
+            f << content_;
+            return file_path;
+        }
+    };
+
+    std::string make_csv(std::size_t rows_, std::uint64_t first_, std::uint64_t step_) {
+        std::string content = "receive_ts;exchange_ts;price;quantity;side\n";
+        for (std::size_t i = 0; i < rows_; ++i) {
+            const auto ts = first_ + i * step_;
+            content += std::to_string(ts) + ";" + std::to_string(ts - 1) + ";"
+                + std::to_string(100 + i % 97) + "." + std::to_string(10000000 + i % 89999999)
+                + ";1.00000000;bid\n";
+        }
+        return content;
+    }
+
+    std::vector<csv_record> load(const fs::path& dir_, bool cache_, bool parallel_ = false) {
+        thread_pool pool{ 2 };
+        csv_reader reader{ pool, read_mode::stream, parallel_, false, cache_ };
+        std::vector<csv_record> records;
+        const auto err = reader.process(dir_, {},
+            [&records](const csv_record& rec_) { records.push_back(rec_); });
+        REQUIRE(!err);
+        return records;
+    }
+
+    bool same_records(const std::vector<csv_record>& a_, const std::vector<csv_record>& b_) {
+        if (a_.size() != b_.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < a_.size(); ++i) {
+            if (a_[i].receive_ts != b_[i].receive_ts || a_[i].price != b_[i].price) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * \brief Записать кэш из пакетов и вернуть отпечаток, с которым он записан
+     */
+    template<class Price>
+    cache_source_info write_cache(const fs::path& path_,
+        const std::vector<column_batch<Price>>& batches_)
+    {
+        const cache_source_info info{ 123, 456, 789 };
+        cache_writer writer;
+        REQUIRE(!writer.open(path_, info));
+        for (const auto& batch : batches_) {
+            writer.append(batch);
+        }
+        REQUIRE(!writer.commit());
+        return info;
+    }
+
+    template<class Price>
+    column_batch<Price> read_cache(const fs::path& path_, const cache_source_info& info_) {
+        cache_reader reader;
+        REQUIRE(!reader.open(path_, info_));
+
+        column_batch<Price> all;
+        column_batch<Price> batch;
+        std::error_code err;
+        while (reader.next(batch, err)) {
+            REQUIRE(batch.size() <= csv_median::k_cache_block_records);
+            all.ts.insert(all.ts.end(), batch.ts.begin(), batch.ts.end());
+            all.price.insert(all.price.end(), batch.price.begin(), batch.price.end());
+        }
+        REQUIRE(!err);
+        CHECK(all.size() == reader.records());
+        return all;
+    }
+
+}
+
+TEST_CASE("cache - sidecar path and fingerprint", "[cache]") {
+    temp_dir tmp;
+    const auto source = tmp.make_file("trade.csv", make_csv(100, 1000, 1));
+    CHECK(csv_median::cache_path(source) == tmp.path / "trade.csv.cache");
+
+    cache_source_info a;
+    REQUIRE(!csv_median::fingerprint(source, a));
+    CHECK(a.size == fs::file_size(source));
+
+    cache_source_info b;
+    REQUIRE(!csv_median::fingerprint(source, b));
+    CHECK(a == b);
+
+    // Та же длина и mtime, другое содержимое
+    const auto mtime = fs::last_write_time(source);
+    auto content = make_csv(100, 1000, 1);
+    content[content.size() / 2] = (content[content.size() / 2] == '1') ? '2' : '1';
+    tmp.make_file("trade.csv", content);
+    fs::last_write_time(source, mtime);
+
+    cache_source_info c;
+    REQUIRE(!csv_median::fingerprint(source, c));
+    CHECK(c.size == a.size);
+    CHECK(c.mtime_ns == a.mtime_ns);
+    CHECK(c.hash != a.hash);
+
+    CHECK(csv_median::fingerprint(tmp.path / "missing.csv", c));
+}
+
+TEST_CASE("cache - fixed prices round trip across blocks", "[cache]") {
+    temp_dir tmp;
+    const auto path = tmp.path / "a.cache";
+
+    // Больше одного блока; ts не монотонны и с большими скачками
+    std::vector<column_batch<fixed_price>> batches(3);
+    std::uint64_t ts = 1'700'000'000'000'000;
+    for (std::size_t b = 0; b < batches.size(); ++b) {
+        for (std::size_t i = 0; i < 50'000; ++i) {
+            ts = (i % 1000 == 999) ? ts - 12345 : ts + (i % 7) * 100;
+            if (i == 1234) {
+                ts += std::uint64_t{ 1 } << 40;
+            }
+            batches[b].ts.push_back(ts);
+            batches[b].price.push_back(static_cast<fixed_price>(i * 1'000'003) - 500'000'000);
+        }
+        batches[b].lines = 50'001;
+        batches[b].issues.push_back({ 7, csv_median::parse_issue::field::price });
+    }
+
+    const auto info = write_cache(path, batches);
+    CHECK_FALSE(fs::exists(path.string() + ".tmp"));
+
+    const auto all = read_cache<fixed_price>(path, info);
+    column_batch<fixed_price> expected;
+    for (const auto& batch : batches) {
+        expected.ts.insert(expected.ts.end(), batch.ts.begin(), batch.ts.end());
+        expected.price.insert(expected.price.end(), batch.price.begin(), batch.price.end());
+    }
+    CHECK(all.ts == expected.ts);
+    CHECK(all.price == expected.price);
+
+    cache_reader reader;
+    REQUIRE(!reader.open(path, info));
+    CHECK(reader.skipped() == 3);
+
+    // Компактнее 16 байт на запись: дельты ts в 1-3 байта
+    CHECK(fs::file_size(path) < expected.size() * 12);
+}
+
+TEST_CASE("cache - double prices read back identically", "[cache]") {
+    temp_dir tmp;
+    const auto path = tmp.path / "a.cache";
+
+    std::vector<column_batch<double>> batches(1);
+    for (const char* text : { "0.00000001", "100.12345678", "99999.99999999", "-5.5", "0" }) {
+        double price = 0.0;
+        REQUIRE(csv_median::parse_price(std::string_view{ text }, price));
+        batches[0].ts.push_back(batches[0].ts.size());
+        batches[0].price.push_back(price);
+    }
+
+    const auto info = write_cache(path, batches);
+    const auto all = read_cache<double>(path, info);
+    CHECK(all.price == batches[0].price);
+
+    // Тот же кэш в фиксированной точке — значения исходного текста
+    const auto fixed = read_cache<fixed_price>(path, info);
+    CHECK(fixed.price == std::vector<fixed_price>{ 1, 10012345678, 9999999999999, -550000000, 0 });
+}
+
+TEST_CASE("cache - price not representable in fixed point abandons cache", "[cache]") {
+    temp_dir tmp;
+    const auto path = tmp.path / "a.cache";
+
+    column_batch<double> batch;
+    batch.ts = { 1, 2 };
+    batch.price = { 1.5, 1e300 };
+
+    cache_writer writer;
+    REQUIRE(!writer.open(path, {}));
+    writer.append(batch);
+    CHECK_FALSE(writer.is_open());
+    CHECK(writer.commit());
+    CHECK_FALSE(fs::exists(path));
+    CHECK_FALSE(fs::exists(path.string() + ".tmp"));
+}
+
+TEST_CASE("cache - stale, corrupt and uncommitted caches", "[cache]") {
+    temp_dir tmp;
+    const auto path = tmp.path / "a.cache";
+
+    std::vector<column_batch<fixed_price>> batches(1);
+    for (std::size_t i = 0; i < 1000; ++i) {
+        batches[0].ts.push_back(i * 10);
+        batches[0].price.push_back(static_cast<fixed_price>(i));
+    }
+    auto info = write_cache(path, batches);
+
+    SECTION("source fingerprint changed") {
+        info.mtime_ns += 1;
+        cache_reader reader;
+        CHECK(reader.open(path, info) == std::errc::bad_message);
+        CHECK_FALSE(reader.is_open());
+    }
+
+    SECTION("truncated file") {
+        fs::resize_file(path, fs::file_size(path) - 100);
+        cache_reader reader;
+        REQUIRE(!reader.open(path, info));
+        column_batch<fixed_price> batch;
+        std::error_code err;
+        CHECK_FALSE(reader.next(batch, err));
+        CHECK(err == std::errc::bad_message);
+    }
+
+    SECTION("writer destroyed before commit") {
+        const auto other = tmp.path / "b.cache";
+        {
+            cache_writer writer;
+            REQUIRE(!writer.open(other, info));
+            writer.append(batches[0]);
+        }
+        CHECK_FALSE(fs::exists(other));
+        CHECK_FALSE(fs::exists(other.string() + ".tmp"));
+    }
+}
+
+TEST_CASE("cache - reader builds and then uses sidecar caches", "[cache][csv]") {
+    temp_dir tmp;
+    tmp.make_file("trade.csv", make_csv(100'000, 1000, 7));
+    const auto level = tmp.make_file("level.csv", make_csv(30'000, 1003, 5)
+        + "bad;1;1;1;bid\n" + "5;4;bad;1;bid\n");
+
+    const bool parallel = GENERATE(false, true);
+    const auto expected = load(tmp.path, false, parallel);
+    REQUIRE(expected.size() == 130'000);
+    CHECK_FALSE(fs::exists(tmp.path / "trade.csv.cache"));
+
+    // Первый запуск строит кэш, второй читает его
+    CHECK(same_records(load(tmp.path, true, parallel), expected));
+    REQUIRE(fs::exists(tmp.path / "trade.csv.cache"));
+    REQUIRE(fs::exists(tmp.path / "level.csv.cache"));
+    CHECK(same_records(load(tmp.path, true, parallel), expected));
+
+    SECTION("changed source rebuilds its cache") {
+        tmp.make_file("level.csv", make_csv(10, 5, 1));
+        const auto records = load(tmp.path, true, parallel);
+        CHECK(records.size() == 100'010);
+        CHECK(same_records(load(tmp.path, true, parallel), records));
+    }
+
+    SECTION("valid cache is used instead of parsing") {
+        // Правка вне хэшируемой выборки, размер и mtime прежние —
+        // запуск с кэшем её не видит, значит CSV не разбирался
+        const auto mtime = fs::last_write_time(level);
+        auto content = make_csv(30'000, 1003, 5) + "bad;1;1;1;bid\n" + "5;4;bad;1;bid\n";
+        const auto pos = content.find('\n', content.size() / 4) + 1;
+        content[pos] = (content[pos] == '9') ? '8' : '9';
+        tmp.make_file("level.csv", content);
+        fs::last_write_time(level, mtime);
+
+        CHECK(same_records(load(tmp.path, true, parallel), expected));
+        CHECK_FALSE(same_records(load(tmp.path, false, parallel), expected));
+    }
+}
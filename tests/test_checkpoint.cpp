@@ -0,0 +1,413 @@
+/**
+ * \file test_checkpoint.cpp
+ * \brief Unit-тесты для снимков калькуляторов, контрольных точек и --resume
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "median.hpp"
+#include "reader.hpp"
+#include "window.hpp"
+#include "writer.hpp"
+
+using csv_median::checkpoint;
+using csv_median::csv_reader;
+using csv_median::file_checkpoint;
+using csv_median::fixed_price;
+using csv_median::read_mode;
+using csv_median::result_writer;
+using csv_median::state_reader;
+using csv_median::state_writer;
+using csv_median::thread_pool;
+using csv_median::write_mode;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    struct temp_dir {
+        fs::path path;
+
+        temp_dir() {
+            path = fs::temp_directory_path()
+                / ("csv_checkpoint_test_" + std::to_string(
+                    std::chrono::steady_clock::now().time_since_epoch().count()));
+            fs::create_directories(path);
+        }
+
+        ~temp_dir() {
+            fs::remove_all(path);
+        }
+
+        void make_file(const std::string& name_, const std::string& content_) const {
+            std::ofstream f{ path / name_, std::ios::binary };
+            f << content_;
+        }
+    };
+
+    std::string read_file(const fs::path& path_) {
+        std::ifstream f{ path_, std::ios::binary };
+        return { std::istreambuf_iterator<char>{ f }, std::istreambuf_iterator<char>{} };
+    }
+
+    /**
+     * \brief Цена на сетке 0.01 около 68000 из псевдослучайного ряда
+     */
+    template<class Price>
+    Price price_at(std::uint64_t i_) {
+        const auto ticks = static_cast<std::int64_t>((i_ * 2654435761u) % 2000);
+        if constexpr (std::is_same_v<Price, fixed_price>) {
+            return fixed_price{ 6'800'000'000'000 + ticks * 1'000'000 };
+        }
+        else {
+            return 68000.0 + static_cast<double>(ticks) * 0.01;
+        }
+    }
+
+    template<class Calc>
+    void add(Calc& calc_, std::uint64_t i_) {
+        using Price = typename Calc::value_type;
+        if constexpr (csv_median::timed_calculator<Calc>) {
+            calc_.add(1'000'000 + i_ * 37, price_at<Price>(i_));
+        }
+        else {
+            calc_.add(price_at<Price>(i_));
+        }
+    }
+
+    /**
+     * \brief После save() / load() калькулятор считает так же, как исходный
+     */
+    template<class Make>
+    void check_continues(Make make_) {
+        auto original = make_();
+        for (std::uint64_t i = 0; i < 3000; ++i) {
+            add(original, i);
+        }
+
+        state_writer out;
+        original.save(out);
+        auto restored = make_();
+        state_reader in{ out.data() };
+        REQUIRE(restored.load(in));
+        CHECK(in.done());
+
+        for (std::uint64_t i = 3000; i < 6000; ++i) {
+            add(original, i);
+            add(restored, i);
+            REQUIRE(restored.is_changed() == original.is_changed());
+            REQUIRE(restored.median() == original.median());
+        }
+
+        // Обрезанный снимок не загружается
+        const auto data = out.data();
+        auto broken = make_();
+        state_reader truncated{ data.first(data.size() - 1) };
+        CHECK_FALSE((broken.load(truncated) && truncated.done()));
+    }
+
+    constexpr const char* k_header = "receive_ts;exchange_ts;price;quantity;side\n";
+
+    struct record {
+        std::uint64_t ts;
+        double        price;
+
+        friend bool operator==(const record&, const record&) = default;
+    };
+
+    /**
+     * \brief Прочитать до стоп-точки: контрольная точка через every_
+     * записей, чтение прекращается на stop_at_-й
+     * \return записи, последняя контрольная точка (нет — дочитано) и ошибка
+     */
+    std::tuple<std::vector<record>, std::optional<checkpoint>, std::error_code>
+        read_until(const fs::path& dir_, read_mode mode_, bool parallel_,
+            std::uint64_t every_, int stop_at_, const std::optional<checkpoint>& resume_)
+    {
+        thread_pool pool{ 2 };
+        csv_reader reader{ pool, mode_, parallel_ };
+        if (resume_) {
+            reader.set_resume(resume_->files, resume_->records);
+        }
+
+        std::optional<checkpoint> last;
+        int calls = 0;
+        reader.set_checkpoints(every_,
+            [&](std::span<const file_checkpoint> files_, std::uint64_t records_) {
+                checkpoint snapshot;
+                snapshot.records = records_;
+                snapshot.files.assign(files_.begin(), files_.end());
+                last = std::move(snapshot);
+                return ++calls < stop_at_;
+            });
+
+        std::vector<record> records;
+        const auto err = reader.process_batches<double>(dir_, {},
+            [&](std::span<const std::uint64_t> ts_, std::span<const double> price_) {
+                for (std::size_t i = 0; i < ts_.size(); ++i) {
+                    records.push_back({ ts_[i], price_[i] });
+                }
+            });
+        if (calls < stop_at_) {
+            last.reset();
+        }
+        return { std::move(records), std::move(last), err };
+    }
+
+}
+
+TEST_CASE("state - varints, deltas and bounds", "[checkpoint]") {
+    state_writer out;
+    out.put(std::uint32_t{ 7 });
+    out.put_varint(300);
+    const std::vector<std::int64_t> values{ 5, 3, 1'000'000'000'000, -2 };
+    out.put_values<std::int64_t>(values);
+    const std::vector<double> doubles{ 0.5, -1.25 };
+    out.put_values<double>(doubles);
+
+    // Дельты соседних цен — по байту, а не по 8
+    state_writer small;
+    const std::vector<std::int64_t> sorted{ 100, 101, 103, 103, 110 };
+    small.put_values<std::int64_t>(sorted);
+    CHECK(small.data().size() == 1 + 2 + 4);
+
+    state_reader in{ out.data() };
+    std::uint32_t head = 0;
+    std::uint64_t varint = 0;
+    std::vector<std::int64_t> read_values;
+    std::vector<double> read_doubles;
+    REQUIRE(in.get(head));
+    REQUIRE(in.get_varint(varint));
+    REQUIRE(in.get_values(read_values));
+    REQUIRE(in.get_values(read_doubles));
+    CHECK(in.done());
+    CHECK(head == 7);
+    CHECK(varint == 300);
+    CHECK(read_values == values);
+    CHECK(read_doubles == doubles);
+
+    // Лишний get после конца — ошибка, и она не сбрасывается
+    std::uint64_t extra = 0;
+    CHECK_FALSE(in.get(extra));
+    CHECK_FALSE(in.done());
+
+    const auto data = out.data();
+    state_reader truncated{ data.first(6) };
+    REQUIRE(truncated.get(head));
+    REQUIRE(truncated.get_varint(varint));
+    CHECK_FALSE(truncated.get_values(read_values));
+    CHECK_FALSE(truncated.get_varint(varint));
+}
+
+TEST_CASE("checkpoint - calculators continue identically after load", "[checkpoint]") {
+    SECTION("heap") {
+        check_continues([] { return csv_median::basic_calculator<double>{}; });
+        check_continues([] { return csv_median::basic_calculator<fixed_price>{}; });
+    }
+    SECTION("skiplist") {
+        check_continues([] { return csv_median::skiplist_calculator<double>{}; });
+        check_continues([] { return csv_median::skiplist_calculator<fixed_price>{}; });
+    }
+    SECTION("histogram") {
+        check_continues([] {
+            return csv_median::histogram_calculator<fixed_price>{
+                csv_median::tick_histogram<fixed_price>{ 1'000'000 } };
+            });
+        check_continues([] {
+            return csv_median::histogram_calculator<double>{
+                csv_median::tick_histogram<double>{ 1'000'000 } };
+            });
+    }
+    SECTION("tdigest") {
+        check_continues([] {
+            return csv_median::sketch_calculator<double>{ csv_median::tdigest<double>{ 0.01 } };
+            });
+    }
+    SECTION("sliding window") {
+        check_continues([] {
+            return csv_median::sliding_window<csv_median::skiplist_calculator<fixed_price>>{
+                10'000 };
+            });
+        check_continues([] {
+            return csv_median::sliding_window<csv_median::histogram_calculator<double>>{
+                10'000, csv_median::histogram_calculator<double>{
+                    csv_median::tick_histogram<double>{ 1'000'000 } } };
+            });
+    }
+}
+
+TEST_CASE("checkpoint - snapshot of another engine is rejected", "[checkpoint]") {
+    csv_median::histogram_calculator<fixed_price> coarse{
+        csv_median::tick_histogram<fixed_price>{ 1'000'000 } };
+    coarse.add(fixed_price{ 6'800'000'000'000 });
+    state_writer out;
+    coarse.save(out);
+
+    csv_median::histogram_calculator<fixed_price> fine{
+        csv_median::tick_histogram<fixed_price>{ 1 } };
+    state_reader in{ out.data() };
+    CHECK_FALSE(fine.load(in));
+
+    csv_median::sliding_window<csv_median::skiplist_calculator<double>> window{ 100 };
+    window.add(1, 1.0);
+    state_writer window_out;
+    window.save(window_out);
+    csv_median::sliding_window<csv_median::skiplist_calculator<double>> other{ 200 };
+    state_reader window_in{ window_out.data() };
+    CHECK_FALSE(other.load(window_in));
+}
+
+TEST_CASE("checkpoint - file round trip and corruption", "[checkpoint]") {
+    temp_dir tmp;
+    const auto path = csv_median::checkpoint_path(tmp.path);
+
+    checkpoint saved;
+    saved.signature = 0x1234;
+    saved.records = 1'000'000;
+    saved.output_size = 123'456;
+    saved.output_rows = 4'321;
+    saved.files.push_back({ tmp.path / "trade.csv", { 100, 200, 300 }, { 4096, 150, 7, false } });
+    saved.files.push_back({ tmp.path / "level.csv", { 1, 2, 3 }, { 0, 0, 0, true } });
+    saved.state = { 1, 2, 3, 250 };
+    REQUIRE_FALSE(csv_median::save_checkpoint(path, saved));
+    CHECK_FALSE(fs::exists(path.string() + ".tmp"));
+
+    checkpoint loaded;
+    REQUIRE_FALSE(csv_median::load_checkpoint(path, loaded));
+    CHECK(loaded.signature == saved.signature);
+    CHECK(loaded.records == saved.records);
+    CHECK(loaded.output_size == saved.output_size);
+    CHECK(loaded.output_rows == saved.output_rows);
+    REQUIRE(loaded.files.size() == 2);
+    CHECK(loaded.files[0].path == saved.files[0].path);
+    CHECK(loaded.files[0].source == saved.files[0].source);
+    CHECK(loaded.files[0].position == saved.files[0].position);
+    CHECK(loaded.files[1].position == saved.files[1].position);
+    CHECK(loaded.state == saved.state);
+
+    // Любой изменённый байт ловит хэш
+    auto bytes = read_file(path);
+    bytes[bytes.size() / 2] = static_cast<char>(bytes[bytes.size() / 2] ^ 1);
+    tmp.make_file(path.filename().string(), bytes);
+    CHECK(csv_median::load_checkpoint(path, loaded) == std::errc::bad_message);
+
+    tmp.make_file(path.filename().string(), "CSV");
+    CHECK(csv_median::load_checkpoint(path, loaded) == std::errc::bad_message);
+
+    CHECK(csv_median::load_checkpoint(tmp.path / "missing.ckpt", loaded));
+}
+
+TEST_CASE("writer - resume after sync matches uninterrupted output", "[checkpoint]") {
+    const auto mode = GENERATE(write_mode::sync, write_mode::async, write_mode::uring);
+    const bool direct = GENERATE(false, true);
+    temp_dir tmp;
+
+    const auto write_rows = [](result_writer& writer_, std::uint64_t from_, std::uint64_t to_) {
+        for (std::uint64_t i = from_; i < to_; ++i) {
+            REQUIRE_FALSE(writer_.write(1'716'810'808'000'000 + i,
+                price_at<fixed_price>(i)));
+        }
+    };
+
+    {
+        result_writer whole{ mode, 3, direct };
+        REQUIRE_FALSE(whole.open(tmp.path, "whole.csv"));
+        write_rows(whole, 0, 120'000);
+        REQUIRE_FALSE(whole.close());
+    }
+
+    std::uint64_t size = 0;
+    {
+        // Строки после sync() — как не дошедшие до снимка
+        result_writer first{ mode, 3, direct };
+        REQUIRE_FALSE(first.open(tmp.path, "resumed.csv"));
+        write_rows(first, 0, 70'001);
+        auto [synced, err] = first.sync();
+        REQUIRE_FALSE(err);
+        size = synced;
+        CHECK(fs::file_size(tmp.path / "resumed.csv") == size);
+        write_rows(first, 70'001, 90'000);
+        REQUIRE_FALSE(first.close());
+    }
+
+    result_writer resumed{ mode, 3, direct };
+    REQUIRE_FALSE(resumed.resume(tmp.path, size, 70'001, "resumed.csv"));
+    CHECK(resumed.written_count() == 70'001);
+    write_rows(resumed, 70'001, 120'000);
+    REQUIRE_FALSE(resumed.close());
+
+    CHECK(read_file(tmp.path / "resumed.csv") == read_file(tmp.path / "whole.csv"));
+
+    // Файл короче снимка — продолжать нечего
+    result_writer too_long{ mode, 3, direct };
+    CHECK(too_long.resume(tmp.path, size * 10, 1, "resumed.csv"));
+}
+
+TEST_CASE("reader - resume from checkpoints gives the same records", "[checkpoint]") {
+    temp_dir tmp;
+
+    // Несколько фрагментов k_parse_chunk_size и блоков чтения
+    std::string trade = k_header;
+    std::string level = k_header;
+    std::uint64_t ts = 1'000'000;
+    while (trade.size() < csv_median::k_parse_chunk_size * 2 + 4321) {
+        trade += std::to_string(ts) + ";900;" + std::to_string(100 + ts % 97) + ".25;1.0;bid\n";
+        if (ts % 5 == 0) {
+            level += std::to_string(ts) + ";900;" + std::to_string(200 + ts % 13) + ".5;1.0;ask\n";
+        }
+        ts += 3;
+    }
+    tmp.make_file("trade.csv", trade);
+    tmp.make_file("level.csv", level);
+    tmp.make_file("empty.csv", k_header);
+
+    auto [expected, full_checkpoint, full_err] =
+        read_until(tmp.path, read_mode::stream, false, 1'000'000, 1'000'000, std::nullopt);
+    REQUIRE_FALSE(full_err);
+    REQUIRE_FALSE(full_checkpoint);
+
+    const auto mode = GENERATE(read_mode::stream, read_mode::mmap, read_mode::uring);
+    const bool parallel = GENERATE(false, true);
+
+    // Каждый запуск останавливается на второй контрольной точке
+    std::vector<record> records;
+    std::optional<checkpoint> resume;
+    int runs = 0;
+    do {
+        auto [part, last, err] = read_until(tmp.path, mode, parallel, 40'001, 2, resume);
+        REQUIRE_FALSE(err);
+        records.insert(records.end(), part.begin(), part.end());
+        if (last) {
+            REQUIRE(last->records == records.size());
+        }
+        resume = std::move(last);
+        ++runs;
+    } while (resume && runs < 100);
+
+    CHECK(runs > 3);
+    REQUIRE(records.size() == expected.size());
+    CHECK(records == expected);
+
+    SECTION("changed input is rejected") {
+        auto [part, last, err] = read_until(tmp.path, mode, parallel, 90'001, 1, std::nullopt);
+        REQUIRE_FALSE(err);
+        REQUIRE(last);
+        tmp.make_file("level.csv", level + "99999999;900;1.0;1.0;ask\n");
+
+        auto [rest, none, resume_err] = read_until(tmp.path, mode, parallel, 90'001, 2, last);
+        CHECK(resume_err == std::errc::bad_message);
+        CHECK(rest.empty());
+    }
+}
@@ -0,0 +1,187 @@
+/**
+ * \file test_columnar.cpp
+ * \brief Unit-тесты для колоночного файла результатов
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "columnar.hpp"
+#include "price.hpp"
+#include "writer.hpp"
+
+using csv_median::columnar_reader;
+using csv_median::columnar_writer;
+using csv_median::compression;
+using csv_median::fixed_price;
+using csv_median::result_writer;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    struct temp_dir {
+        fs::path path;
+
+        temp_dir() {
+            path = fs::temp_directory_path()
+                / ("columnar_test_" + std::to_string(
+                    std::chrono::steady_clock::now().time_since_epoch().count()));
+            fs::create_directories(path);
+        }
+
+        ~temp_dir() {
+            fs::remove_all(path);
+        }
+    };
+
+    struct columns {
+        std::vector<std::uint64_t> ts;
+        std::vector<fixed_price>   price;
+        std::size_t                chunks{ 0 };
+    };
+
+    columns read_all(const fs::path& path_) {
+        columnar_reader reader;
+        REQUIRE(!reader.open(path_));
+
+        columns all;
+        std::vector<std::uint64_t> ts;
+        std::vector<fixed_price> price;
+        std::error_code err;
+        while (reader.next(ts, price, err)) {
+            all.ts.insert(all.ts.end(), ts.begin(), ts.end());
+            all.price.insert(all.price.end(), price.begin(), price.end());
+            ++all.chunks;
+        }
+        REQUIRE(!err);
+        return all;
+    }
+
+    std::string read_text(const fs::path& path_) {
+        std::ifstream f{ path_, std::ios::binary };
+        std::stringstream ss;
+        ss << f.rdbuf();
+        return ss.str();
+    }
+
+}
+
+TEST_CASE("columnar - fixed values round trip across chunks", "[columnar]") {
+    temp_dir tmp;
+    const auto codec = GENERATE(compression::none, compression::zstd);
+    if (!csv_median::compression_supported(codec)) {
+        return;
+    }
+
+    columns expected;
+    std::uint64_t ts = 1'716'810'808'593'627;
+    for (std::size_t i = 0; i < 10'000; ++i) {
+        ts += (i % 13) * 1000 + (i == 5000 ? std::uint64_t{ 1 } << 40 : 0);
+        expected.ts.push_back(ts);
+        expected.price.push_back(static_cast<fixed_price>(i % 311) * 50'000 - 7'000'000);
+    }
+
+    columnar_writer writer{ codec, 4096 };
+    REQUIRE(!writer.open(tmp.path));
+    CHECK(writer.path() == tmp.path / "median_result.col");
+    for (std::size_t i = 0; i < expected.ts.size(); ++i) {
+        REQUIRE(!writer.write(expected.ts[i], expected.price[i]));
+    }
+    REQUIRE(!writer.close());
+    CHECK(writer.written_count() == expected.ts.size());
+
+    const auto all = read_all(writer.path());
+    CHECK(all.chunks == 3);
+    CHECK(all.ts == expected.ts);
+    CHECK(all.price == expected.price);
+
+    // Малые дельты — байт-два на значение
+    CHECK(fs::file_size(writer.path()) < expected.ts.size() * 6);
+}
+
+TEST_CASE("columnar - double medians match CSV output", "[columnar]") {
+    temp_dir tmp;
+
+    // Половины шага цены — медианы чётного числа значений
+    std::vector<double> medians{ 0.0, 100.12345678, 100.123456785, 99999.99999999,
+        0.1 + 0.2, 1.0 / 3.0, -5.5, 12345678.000000005, 0.000000015, 1e-12 };
+
+    result_writer csv;
+    columnar_writer col;
+    REQUIRE(!csv.open(tmp.path));
+    REQUIRE(!col.open(tmp.path));
+    for (std::size_t i = 0; i < medians.size(); ++i) {
+        REQUIRE(!csv.write(i, medians[i]));
+        REQUIRE(!col.write(i, medians[i]));
+    }
+    REQUIRE(!csv.close());
+    REQUIRE(!col.close());
+
+    const auto all = read_all(col.path());
+    REQUIRE(all.ts.size() == medians.size());
+
+    std::string text = "receive_ts;price_median\n";
+    for (std::size_t i = 0; i < all.ts.size(); ++i) {
+        char buf[64];
+        char* out = std::to_chars(buf, buf + 20, all.ts[i]).ptr;
+        *out++ = ';';
+        out = csv_median::format_fixed(out, all.price[i]);
+        *out++ = '\n';
+        text.append(buf, out);
+    }
+    CHECK(text == read_text(csv.path()));
+}
+
+TEST_CASE("columnar - incomplete and foreign files", "[columnar]") {
+    temp_dir tmp;
+    const auto codec = GENERATE(compression::none, compression::zstd);
+    if (!csv_median::compression_supported(codec)) {
+        return;
+    }
+
+    columnar_writer writer{ codec, 100 };
+    REQUIRE(!writer.open(tmp.path));
+    for (std::uint64_t i = 0; i < 1000; ++i) {
+        REQUIRE(!writer.write(i * 10, static_cast<fixed_price>(i)));
+    }
+    REQUIRE(!writer.close());
+
+    SECTION("truncated file") {
+        fs::resize_file(writer.path(), fs::file_size(writer.path()) - 30);
+
+        columnar_reader reader;
+        REQUIRE(!reader.open(writer.path()));
+        std::vector<std::uint64_t> ts;
+        std::vector<fixed_price> price;
+        std::error_code err;
+        while (reader.next(ts, price, err)) {
+        }
+        CHECK(err == std::errc::bad_message);
+    }
+
+    SECTION("not a columnar file") {
+        std::ofstream{ tmp.path / "a.col" } << "receive_ts;price_median\n1;2.00000000\n";
+        columnar_reader reader;
+        CHECK(reader.open(tmp.path / "a.col") == std::errc::bad_message);
+        CHECK_FALSE(reader.is_open());
+    }
+
+    SECTION("empty result") {
+        columnar_writer empty{ codec };
+        REQUIRE(!empty.open(tmp.path, "empty.col"));
+        REQUIRE(!empty.close());
+        const auto all = read_all(tmp.path / "empty.col");
+        CHECK(all.ts.empty());
+        CHECK(all.chunks == 0);
+    }
+}
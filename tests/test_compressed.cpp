@@ -0,0 +1,366 @@
+/**
+ * \file test_compressed.cpp
+ * \brief Unit-тесты для compressed_reader и чтения сжатых CSV
+ *
+ * Сжатые файлы готовятся теми же библиотеками; тесты кодека, не
+ * собранного в программу, проверяют только not_supported.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "compressed.hpp"
+#include "reader.hpp"
+
+using csv_median::compressed_reader;
+using csv_median::compression;
+using csv_median::csv_reader;
+using csv_median::csv_record;
+using csv_median::read_mode;
+using csv_median::thread_pool;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    /**
+     * \brief Временная директория, удаляется вместе с содержимым
+     */
+    struct temp_dir {
+        fs::path path;
+
+        temp_dir() {
+            path = fs::temp_directory_path()
+                / ("compressed_test_" + std::to_string(
+                    std::chrono::steady_clock::now().time_since_epoch().count()));
+            fs::create_directories(path);
+        }
+
+        ~temp_dir() {
+            fs::remove_all(path);
+        }
+
+        fs::path make_file(const std::string& name_, const std::string& content_) const {
+            const auto file_path = path / name_;
+            std::ofstream f{ file_path, std::ios::binary };
+            f << content_;
+            return file_path;
+        }
+    };
+
+    /**
+     * \brief CSV со строками receive_ts = first_ + i * step_
+     */
+    std::string make_csv(std::size_t rows_, std::uint64_t first_, std::uint64_t step_) {
+        std::string content = "receive_ts;exchange_ts;price;quantity;side\n";
+        for (std::size_t i = 0; i < rows_; ++i) {
+            const auto ts = first_ + i * step_;
+            content += std::to_string(ts) + ";" + std::to_string(ts - 1) + ";"
+                + std::to_string(100 + i % 97) + ".12345678;1.00000000;bid\n";
+        }
+        return content;
+    }
+
+    /**
+     * \brief Прочитать всё содержимое блоками по block_ байт
+     */
+    std::string read_all(compressed_reader& reader_, std::error_code& err_,
+        std::size_t block_ = 4096)
+    {
+        std::string out;
+        std::vector<char> buf(block_);
+        for (;;) {
+            const auto n = reader_.read(buf.data(), buf.size(), err_);
+            if (n == 0) {
+                break;
+            }
+            out.append(buf.data(), n);
+        }
+        return out;
+    }
+
+#if defined(CSV_MEDIAN_HAS_ZLIB)
+    std::string gzip(const std::string& data_) {
+        z_stream zs{};
+        REQUIRE(deflateInit2(&zs, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+        std::string out(deflateBound(&zs, static_cast<uLong>(data_.size())) + 32, '\0');
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data_.data()));
+        zs.avail_in = static_cast<uInt>(data_.size());
+        zs.next_out = reinterpret_cast<Bytef*>(out.data());
+        zs.avail_out = static_cast<uInt>(out.size());
+        REQUIRE(deflate(&zs, Z_FINISH) == Z_STREAM_END);
+        out.resize(zs.total_out);
+        deflateEnd(&zs);
+        return out;
+    }
+#endif
+
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+    /**
+     * \param known_size_ записать размер содержимого в заголовок кадра
+     */
+    std::string zstd_frame(const std::string& data_, bool known_size_ = true) {
+        ZSTD_CCtx* ctx = ZSTD_createCCtx();
+        REQUIRE(ctx != nullptr);
+        ZSTD_CCtx_setParameter(ctx, ZSTD_c_contentSizeFlag, known_size_ ? 1 : 0);
+        std::string out(ZSTD_compressBound(data_.size()), '\0');
+        const auto n = ZSTD_compress2(ctx, out.data(), out.size(), data_.data(), data_.size());
+        ZSTD_freeCCtx(ctx);
+        REQUIRE(!ZSTD_isError(n));
+        out.resize(n);
+        return out;
+    }
+
+    /**
+     * \brief Независимые кадры по frame_ байт исходного текста
+     */
+    std::string zstd_frames(const std::string& data_, std::size_t frame_, bool known_size_ = true) {
+        std::string out;
+        for (std::size_t pos = 0; pos < data_.size(); pos += frame_) {
+            out += zstd_frame(data_.substr(pos, frame_), known_size_);
+        }
+        return out;
+    }
+#endif
+
+#if defined(CSV_MEDIAN_HAS_LZ4)
+    std::string lz4(const std::string& data_) {
+        std::string out(LZ4F_compressFrameBound(data_.size(), nullptr), '\0');
+        const auto n = LZ4F_compressFrame(out.data(), out.size(),
+            data_.data(), data_.size(), nullptr);
+        REQUIRE(!LZ4F_isError(n));
+        out.resize(n);
+        return out;
+    }
+#endif
+
+    std::vector<csv_record> load(thread_pool& pool_, const fs::path& dir_,
+        const std::vector<std::string>& masks_, bool parallel_)
+    {
+        csv_reader reader{ pool_, read_mode::stream, parallel_ };
+        std::vector<csv_record> records;
+        const auto err = reader.process(dir_, masks_,
+            [&records](const csv_record& rec_) { records.push_back(rec_); });
+        REQUIRE(!err);
+        return records;
+    }
+
+    bool same_records(const std::vector<csv_record>& a_, const std::vector<csv_record>& b_) {
+        if (a_.size() != b_.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < a_.size(); ++i) {
+            if (a_[i].receive_ts != b_[i].receive_ts || a_[i].price != b_[i].price) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+}
+
+TEST_CASE("compressed - codec from extension", "[compressed]") {
+    CHECK(csv_median::compression_of("a/trade.csv.gz") == compression::gzip);
+    CHECK(csv_median::compression_of("a/trade.csv.zst") == compression::zstd);
+    CHECK(csv_median::compression_of("a/trade.csv.lz4") == compression::lz4);
+    CHECK(csv_median::compression_of("a/trade.csv") == compression::none);
+    CHECK(csv_median::compression_of("a/trade.zip") == compression::none);
+
+    CHECK(csv_median::uncompressed_name("a/trade.csv.zst") == fs::path{ "a/trade.csv" });
+    CHECK(csv_median::uncompressed_name("a/trade.csv") == fs::path{ "a/trade.csv" });
+    CHECK(csv_median::compression_supported(compression::none));
+}
+
+TEST_CASE("compressed - open errors", "[compressed]") {
+    compressed_reader reader;
+    CHECK(reader.open("missing.csv.gz", compression::none) == std::errc::invalid_argument);
+    CHECK_FALSE(reader.is_open());
+
+    for (const auto codec : { compression::gzip, compression::zstd, compression::lz4 }) {
+        const auto err = reader.open("/nonexistent/file.csv", codec);
+        REQUIRE(err);
+        if (!csv_median::compression_supported(codec)) {
+            CHECK(err == std::errc::not_supported);
+        }
+        CHECK_FALSE(reader.is_open());
+    }
+}
+
+#if defined(CSV_MEDIAN_HAS_ZLIB)
+TEST_CASE("compressed - gzip round trip and concatenated members", "[compressed]") {
+    temp_dir tmp;
+    const auto text = make_csv(20000, 1000, 3);
+    const auto half = text.size() / 2;
+
+    SECTION("single member, small reads") {
+        const auto path = tmp.make_file("a.csv.gz", gzip(text));
+        compressed_reader reader;
+        REQUIRE(!reader.open(path, compression::gzip));
+        std::error_code err;
+        CHECK(read_all(reader, err, 1000) == text);
+        CHECK(!err);
+    }
+
+    SECTION("two members as after cat a.gz b.gz") {
+        const auto path = tmp.make_file("b.csv.gz",
+            gzip(text.substr(0, half)) + gzip(text.substr(half)));
+        compressed_reader reader;
+        REQUIRE(!reader.open(path, compression::gzip));
+        std::error_code err;
+        CHECK(read_all(reader, err) == text);
+        CHECK(!err);
+    }
+
+    SECTION("truncated stream is an error") {
+        auto packed = gzip(text);
+        packed.resize(packed.size() / 2);
+        const auto path = tmp.make_file("c.csv.gz", packed);
+        compressed_reader reader;
+        REQUIRE(!reader.open(path, compression::gzip));
+        std::error_code err;
+        const auto out = read_all(reader, err);
+        CHECK(err == std::errc::bad_message);
+        CHECK(out.size() < text.size());
+        CHECK(text.starts_with(out));
+    }
+}
+#endif
+
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+TEST_CASE("compressed - zstd single frame", "[compressed]") {
+    temp_dir tmp;
+    const auto text = make_csv(20000, 1000, 3);
+    const auto path = tmp.make_file("a.csv.zst", zstd_frame(text));
+
+    thread_pool pool{ 2 };
+    compressed_reader reader;
+    REQUIRE(!reader.open(path, compression::zstd, &pool));
+    CHECK_FALSE(reader.parallel());
+
+    std::error_code err;
+    CHECK(read_all(reader, err, 777) == text);
+    CHECK(!err);
+}
+
+TEST_CASE("compressed - zstd frames decoded in parallel", "[compressed]") {
+    temp_dir tmp;
+    const auto text = make_csv(300000, 1000, 3);
+    const bool known = GENERATE(true, false);
+    const auto path = tmp.make_file("a.csv.zst", zstd_frames(text, 1024 * 1024, known));
+
+    SECTION("with pool") {
+        thread_pool pool{ 3 };
+        compressed_reader reader;
+        REQUIRE(!reader.open(path, compression::zstd, &pool));
+        CHECK(reader.parallel());
+
+        std::error_code err;
+        CHECK(read_all(reader, err, 100000) == text);
+        CHECK(!err);
+    }
+
+    SECTION("without pool the same frames are streamed") {
+        compressed_reader reader;
+        REQUIRE(!reader.open(path, compression::zstd));
+        CHECK_FALSE(reader.parallel());
+
+        std::error_code err;
+        CHECK(read_all(reader, err) == text);
+        CHECK(!err);
+    }
+
+    SECTION("close with jobs in flight") {
+        thread_pool pool{ 2 };
+        compressed_reader reader;
+        REQUIRE(!reader.open(path, compression::zstd, &pool));
+        std::vector<char> buf(10);
+        std::error_code err;
+        CHECK(reader.read(buf.data(), buf.size(), err) == buf.size());
+        reader.close();
+        CHECK_FALSE(reader.is_open());
+    }
+}
+
+TEST_CASE("compressed - zstd corrupt frame is an error", "[compressed]") {
+    temp_dir tmp;
+    const auto text = make_csv(300000, 1000, 3);
+    auto packed = zstd_frames(text, 1024 * 1024);
+    packed.resize(packed.size() - 7);
+    const auto path = tmp.make_file("a.csv.zst", packed);
+
+    thread_pool pool{ 2 };
+    compressed_reader reader;
+    REQUIRE(!reader.open(path, compression::zstd, &pool));
+
+    std::error_code err;
+    const auto out = read_all(reader, err);
+    CHECK(err == std::errc::bad_message);
+    CHECK(text.starts_with(out));
+}
+#endif
+
+#if defined(CSV_MEDIAN_HAS_LZ4)
+TEST_CASE("compressed - lz4 round trip", "[compressed]") {
+    temp_dir tmp;
+    const auto text = make_csv(20000, 1000, 3);
+    const auto path = tmp.make_file("a.csv.lz4", lz4(text) + lz4(text));
+
+    compressed_reader reader;
+    REQUIRE(!reader.open(path, compression::lz4));
+    std::error_code err;
+    CHECK(read_all(reader, err, 5000) == text + text);
+    CHECK(!err);
+}
+#endif
+
+TEST_CASE("compressed - reader merges compressed and plain files", "[compressed][csv]") {
+    const auto trade = make_csv(30000, 1000, 7);
+    const auto level = make_csv(30000, 1003, 5);
+    const auto quote = make_csv(30000, 1001, 3);
+
+    temp_dir plain;
+    plain.make_file("trade.csv", trade);
+    plain.make_file("level.csv", level);
+    plain.make_file("quote.csv", quote);
+
+    temp_dir packed;
+    packed.make_file("quote.csv", quote);
+    packed.make_file("notes.txt.gz", "not a csv");
+#if defined(CSV_MEDIAN_HAS_ZLIB)
+    packed.make_file("trade.csv.gz", gzip(trade));
+#else
+    packed.make_file("trade.csv", trade);
+#endif
+#if defined(CSV_MEDIAN_HAS_ZSTD)
+    packed.make_file("level.csv.zst", zstd_frames(level, 256 * 1024));
+#else
+    packed.make_file("level.csv", level);
+#endif
+
+    thread_pool pool{ 2 };
+    const bool parallel = GENERATE(false, true);
+
+    SECTION("all files") {
+        const auto expected = load(pool, plain.path, {}, parallel);
+        const auto records = load(pool, packed.path, {}, parallel);
+        REQUIRE(expected.size() == 90000);
+        CHECK(same_records(records, expected));
+    }
+
+    SECTION("masks match the name without extensions") {
+        const auto expected = load(pool, plain.path, { "trade", "level" }, parallel);
+        const auto records = load(pool, packed.path, { "trade", "level" }, parallel);
+        REQUIRE(expected.size() == 60000);
+        CHECK(same_records(records, expected));
+
+        // "csv" есть только в расширении — не совпадает ни с одним файлом
+        CHECK(load(pool, packed.path, { "csv" }, parallel).empty());
+    }
+}
@@ -0,0 +1,237 @@
+/**
+ * \file test_follow.cpp
+ * \brief Unit-тесты для file_tail, watermark_merge и csv_reader::follow_batches
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "reader.hpp"
+
+using csv_median::column_batch;
+using csv_median::csv_reader;
+using csv_median::file_tail;
+using csv_median::thread_pool;
+using csv_median::watermark_merge;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    struct temp_dir {
+        fs::path path;
+
+        temp_dir() {
+            path = fs::temp_directory_path()
+                / ("csv_follow_test_" + std::to_string(
+                    std::chrono::steady_clock::now().time_since_epoch().count()));
+            fs::create_directories(path);
+        }
+
+        ~temp_dir() {
+            fs::remove_all(path);
+        }
+
+        void append(const std::string& name_, const std::string& content_) const {
+            std::ofstream f{ path / name_, std::ios::binary | std::ios::app };
+            f << content_;
+        }
+    };
+
+    constexpr const char* k_header = "receive_ts;exchange_ts;price;quantity;side\n";
+
+    std::string line(std::uint64_t ts_, const std::string& price_) {
+        return std::to_string(ts_) + ";" + std::to_string(ts_) + ";" + price_ + ";1.0;bid\n";
+    }
+
+    column_batch<double> make_batch(std::vector<std::uint64_t> ts_) {
+        column_batch<double> batch;
+        for (const auto ts : ts_) {
+            batch.ts.push_back(ts);
+            batch.price.push_back(static_cast<double>(ts));
+        }
+        return batch;
+    }
+
+    /**
+     * \brief Выдать всё, что отпускает водяной знак: пары (ts, источник)
+     */
+    std::vector<std::uint64_t> drain(watermark_merge<double>& merge_, bool all_ = false) {
+        std::vector<std::uint64_t> out;
+        merge_.release([&](const column_batch<double>& batch_, std::size_t pos_, std::size_t n_) {
+            out.insert(out.end(), batch_.ts.begin() + static_cast<std::ptrdiff_t>(pos_),
+                batch_.ts.begin() + static_cast<std::ptrdiff_t>(pos_ + n_));
+            }, all_);
+        return out;
+    }
+
+}
+
+TEST_CASE("file_tail - только полные строки", "[follow]") {
+    temp_dir dir;
+    dir.append("trade.csv", "receive_ts;exchange_ts;pr");
+
+    file_tail<double> tail{ dir.path / "trade.csv", {}, false };
+    REQUIRE(tail.is_open());
+
+    column_batch<double> batch;
+    CHECK(tail.read(batch, 1024));
+    CHECK(batch.empty());
+    CHECK(tail.caught_up());
+
+    // Заголовок и полторы строки
+    dir.append("trade.csv", "ice;quantity;side\n" + line(10, "1.5") + "20;20;2.");
+    tail.refresh();
+    CHECK_FALSE(tail.caught_up());
+    REQUIRE(tail.read(batch, 1024));
+    CHECK(batch.ts == std::vector<std::uint64_t>{ 10 });
+    CHECK(batch.price == std::vector<double>{ 1.5 });
+
+    dir.append("trade.csv", "5;1.0;bid\n" + line(30, "3.5"));
+    tail.refresh();
+    REQUIRE(tail.read(batch, 1024));
+    CHECK(batch.ts == std::vector<std::uint64_t>{ 20, 30 });
+    CHECK(batch.price == std::vector<double>{ 2.5, 3.5 });
+    CHECK(tail.caught_up());
+
+    SECTION("чтение частями") {
+        dir.append("trade.csv", line(40, "4.0") + line(50, "5.0"));
+        tail.refresh();
+        std::vector<std::uint64_t> ts;
+        while (!tail.caught_up()) {
+            REQUIRE(tail.read(batch, 7));
+            ts.insert(ts.end(), batch.ts.begin(), batch.ts.end());
+        }
+        CHECK(ts == std::vector<std::uint64_t>{ 40, 50 });
+    }
+
+    SECTION("усечённый файл") {
+        std::ofstream{ dir.path / "trade.csv", std::ios::binary | std::ios::trunc } << k_header;
+        tail.refresh();
+        CHECK_FALSE(tail.is_open());
+        CHECK_FALSE(tail.read(batch, 1024));
+    }
+}
+
+TEST_CASE("file_tail - группы и quantity", "[follow]") {
+    temp_dir dir;
+    dir.append("trade.csv", k_header + line(1, "1.0") + line(2, "2.0"));
+
+    SECTION("маска") {
+        const csv_median::record_groups groups{ csv_median::group_mode::mask, 42, {} };
+        file_tail<double> tail{ dir.path / "trade.csv", groups, false };
+        column_batch<double> batch;
+        REQUIRE(tail.read(batch, 1024));
+        CHECK(batch.group == std::vector<std::uint64_t>{ 42, 42 });
+        CHECK(batch.quantity.empty());
+    }
+
+    SECTION("колонка и quantity") {
+        const csv_median::record_groups groups{ csv_median::group_mode::column, 0, "side" };
+        file_tail<double> tail{ dir.path / "trade.csv", groups, true };
+        column_batch<double> batch;
+        REQUIRE(tail.read(batch, 1024));
+        CHECK(batch.group == std::vector<std::uint64_t>(2, csv_median::group_key("bid")));
+        CHECK(batch.quantity == std::vector<double>{ 1.0, 1.0 });
+    }
+
+    SECTION("нет колонки") {
+        const csv_median::record_groups groups{ csv_median::group_mode::column, 0, "venue" };
+        file_tail<double> tail{ dir.path / "trade.csv", groups, false };
+        column_batch<double> batch;
+        CHECK_FALSE(tail.read(batch, 1024));
+        CHECK_FALSE(tail.is_open());
+    }
+}
+
+TEST_CASE("watermark_merge - порядок и недочитанные источники", "[follow]") {
+    watermark_merge<double> merge{ 0 };
+    const auto a = merge.add_source();
+    const auto b = merge.add_source();
+
+    merge.push(a, make_batch({ 10, 20, 30 }));
+    // b ещё не читался: выдавать нечего
+    CHECK(drain(merge).empty());
+
+    merge.push(b, make_batch({ 15, 20, 25 }));
+    // Оба не дочитаны: строго раньше меньшего из последних (25)
+    CHECK(drain(merge) == std::vector<std::uint64_t>{ 10, 15, 20, 20 });
+
+    merge.set_caught_up(b, true);
+    CHECK(drain(merge) == std::vector<std::uint64_t>{ 25 });
+
+    merge.set_caught_up(a, true);
+    CHECK(drain(merge) == std::vector<std::uint64_t>{ 30 });
+    CHECK(merge.pending_count() == 0);
+    CHECK(merge.late_count() == 0);
+}
+
+TEST_CASE("watermark_merge - lateness и опоздавшие записи", "[follow]") {
+    watermark_merge<double> merge{ 100 };
+    const auto a = merge.add_source();
+    const auto b = merge.add_source();
+    merge.set_caught_up(a, true);
+    merge.set_caught_up(b, true);
+
+    merge.push(a, make_batch({ 1000, 1050, 1150 }));
+    // Свежайший 1150: выдаётся не позже 1050
+    CHECK(drain(merge) == std::vector<std::uint64_t>{ 1000, 1050 });
+
+    // b отстаёт меньше чем на lateness — успевает
+    merge.push(b, make_batch({ 1060, 1100 }));
+    CHECK(drain(merge).empty());
+    merge.push(a, make_batch({ 1300 }));
+    CHECK(drain(merge) == std::vector<std::uint64_t>{ 1060, 1100, 1150 });
+
+    // А теперь опоздал
+    merge.push(b, make_batch({ 1120, 1250 }));
+    CHECK(merge.late_count() == 1);
+    CHECK(drain(merge, true) == std::vector<std::uint64_t>{ 1250, 1300 });
+}
+
+TEST_CASE("reader - follow_batches дочитывает дописанное и новые файлы", "[follow]") {
+    temp_dir dir;
+    dir.append("a_trade.csv", k_header + line(100, "1.0") + line(300, "3.0"));
+    dir.append("b_trade.csv", k_header + line(200, "2.0"));
+    dir.append("skip_level.csv", k_header + line(150, "9.0"));
+
+    thread_pool pool{ 2 };
+    csv_reader reader{ pool };
+
+    std::vector<std::uint64_t> ts;
+    std::vector<double> price;
+    std::size_t idle = 0;
+    bool completed = false;
+    const auto err = reader.follow_batches<double>(dir.path, { "trade" },
+        csv_median::follow_options{ 0, 10 },
+        [&](std::span<const std::uint64_t> ts_, std::span<const double> price_) {
+            ts.insert(ts.end(), ts_.begin(), ts_.end());
+            price.insert(price.end(), price_.begin(), price_.end());
+        },
+        [&] {
+            ++idle;
+            if (idle == 1) {
+                // Имеющееся уже выдано; строка 500 пока недописана
+                CHECK(ts == std::vector<std::uint64_t>{ 100, 200, 300 });
+                dir.append("b_trade.csv", line(400, "4.0") + "500;500;5.");
+                dir.append("c_trade.csv", k_header + line(450, "4.5"));
+            }
+            else if (ts.size() == 5 && !completed) {
+                dir.append("b_trade.csv", "0;1.0;bid\n");
+                completed = true;
+            }
+            // Счётчик — чтобы ошибка не подвесила тест
+            return ts.size() < 6 && idle < 1000;
+        });
+
+    REQUIRE_FALSE(err);
+    CHECK(ts == std::vector<std::uint64_t>{ 100, 200, 300, 400, 450, 500 });
+    CHECK(price == std::vector<double>{ 1.0, 2.0, 3.0, 4.0, 4.5, 5.0 });
+}
@@ -0,0 +1,61 @@
+/**
+ * \file test_group.cpp
+ * \brief Unit-тесты для ключей групп и group_table
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "group.hpp"
+
+using csv_median::group_key;
+using csv_median::group_name;
+using csv_median::group_table;
+
+TEST_CASE("group_key - короткие значения упаковываются", "[group]") {
+    CHECK(group_key("bid") != group_key("ask"));
+    CHECK(group_key("bid") == group_key(std::string{ "bid" }));
+    CHECK((group_key("trade") & csv_median::k_group_hashed_bit) == 0);
+
+    CHECK(group_name(group_key("bid")) == "bid");
+    CHECK(group_name(group_key("level")) == "level");
+    CHECK(group_name(group_key("12345678")) == "12345678");
+}
+
+TEST_CASE("group_key - длинные и небезопасные значения", "[group]") {
+    const auto long_key = group_key("very_long_group_value");
+    CHECK((long_key & csv_median::k_group_hashed_bit) != 0);
+    CHECK(long_key != group_key("very_long_group_valuf"));
+    CHECK(group_name(long_key).size() == 16);
+
+    // Имя файла не берётся из значения с разделителями пути
+    CHECK(group_name(group_key("../x")).size() == 16);
+    CHECK(group_name(group_key("")).size() == 16);
+}
+
+TEST_CASE("group_table - вставка и поиск", "[group]") {
+    group_table<int> table;
+    CHECK(table.find(group_key("bid")) == nullptr);
+
+    std::vector<std::uint64_t> keys;
+    for (int i = 0; i < 100; ++i) {
+        keys.push_back(group_key("g" + std::to_string(i)));
+        table.insert(keys.back(), std::make_unique<int>(i));
+    }
+    REQUIRE(table.size() == 100);
+
+    for (int i = 0; i < 100; ++i) {
+        const int* const value = table.find(keys[static_cast<std::size_t>(i)]);
+        REQUIRE(value != nullptr);
+        CHECK(*value == i);
+    }
+    CHECK(table.find(group_key("missing")) == nullptr);
+
+    // values() — в порядке появления
+    CHECK(*table.values().front() == 0);
+    CHECK(*table.values().back() == 99);
+}
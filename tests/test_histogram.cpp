@@ -0,0 +1,320 @@
+/**
+ * \file test_histogram.cpp
+ * \brief Unit-тесты для tick_histogram и histogram_calculator
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <limits>
+#include <random>
+#include <set>
+#include <system_error>
+
+#include "median.hpp"
+#include "histogram.hpp"
+#include "state.hpp"
+#include "window.hpp"
+
+using csv_median::tick_histogram;
+using csv_median::histogram_calculator;
+using csv_median::fixed_price;
+using Catch::Approx;
+
+TEST_CASE("histogram - middle and select", "[histogram]") {
+    tick_histogram<fixed_price> hist{ 100 };
+    for (const fixed_price v : { 500, 100, 400, 200, 300 }) {
+        REQUIRE_FALSE(hist.insert(v));
+    }
+
+    REQUIRE(hist.size() == 5);
+    CHECK(hist.middle() == std::pair<fixed_price, fixed_price>{ 300, 300 });
+    for (std::size_t i = 0; i < 5; ++i) {
+        CHECK(hist.select(i) == static_cast<fixed_price>(i + 1) * 100);
+    }
+
+    REQUIRE_FALSE(hist.insert(600));
+    CHECK(hist.middle() == std::pair<fixed_price, fixed_price>{ 300, 400 });
+    CHECK(hist.off_grid() == 0);
+}
+
+TEST_CASE("histogram - random operations match multiset", "[histogram]") {
+    // Шаг 1, цены в широком диапазоне — много страниц, в т.ч. отрицательных
+    tick_histogram<fixed_price> hist;
+    std::multiset<fixed_price> reference;
+
+    std::mt19937 rng{ 29 };
+    std::uniform_int_distribution<fixed_price> value{ -20000, 20000 };
+    std::uniform_int_distribution<int> op{ 0, 2 };
+
+    for (int step = 0; step < 20000; ++step) {
+        const fixed_price v = value(rng);
+        if (op(rng) == 0 && !reference.empty()) {
+            const bool expected = reference.count(v) > 0;
+            if (expected) {
+                reference.erase(reference.find(v));
+            }
+            CHECK(hist.erase(v) == expected);
+        }
+        else {
+            REQUIRE_FALSE(hist.insert(v));
+            reference.insert(v);
+        }
+
+        REQUIRE(hist.size() == reference.size());
+        if (reference.empty()) {
+            continue;
+        }
+
+        const auto n = reference.size();
+        const auto lower = *std::next(reference.begin(), static_cast<long>((n - 1) / 2));
+        const auto upper = *std::next(reference.begin(), static_cast<long>(n / 2));
+        REQUIRE(hist.middle() == std::pair{ lower, upper });
+
+        if (step % 997 == 0) {
+            std::size_t rank = 0;
+            for (const auto expected : reference) {
+                REQUIRE(hist.select(rank++) == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("histogram - calculator matches heap backend", "[histogram]") {
+    csv_median::calculator heap_calc;
+    histogram_calculator<double> hist_calc{ tick_histogram<double>{ 1'000'000 } };
+
+    std::mt19937 rng{ 31 };
+    std::uniform_int_distribution<int> cents{ 6'000'000, 6'010'000 };
+
+    for (int i = 0; i < 20000; ++i) {
+        // Цены на сетке 0.01, разобранные как во входных файлах
+        double price = 0.0;
+        const auto text = std::to_string(cents(rng) / 100) + "."
+            + std::to_string(100 + cents(rng) % 100).substr(1);
+        REQUIRE(csv_median::parse_price(text, price));
+
+        heap_calc.add(price);
+        hist_calc.add(price);
+
+        REQUIRE(hist_calc.median() == heap_calc.median());
+        REQUIRE(hist_calc.is_changed() == heap_calc.is_changed());
+    }
+    CHECK(hist_calc.engine().off_grid() == 0);
+}
+
+TEST_CASE("histogram - merge matches one histogram", "[histogram]") {
+    std::mt19937 rng{ 37 };
+
+    SECTION("parts on different pages") {
+        tick_histogram<fixed_price> whole;
+        tick_histogram<fixed_price> merged;
+        std::multiset<fixed_price> reference;
+
+        // Части с разными диапазонами: указатель медианы уходит
+        // через чужие страницы
+        for (const auto& [lo, hi] : { std::pair{ 0, 5000 }, std::pair{ -30000, -20000 },
+            std::pair{ 40000, 90000 }, std::pair{ -100, 100 } })
+        {
+            std::uniform_int_distribution<fixed_price> value{ lo, hi };
+            tick_histogram<fixed_price> part;
+            for (int i = 0; i < 3000; ++i) {
+                const fixed_price v = value(rng);
+                REQUIRE_FALSE(part.insert(v));
+                REQUIRE_FALSE(whole.insert(v));
+                reference.insert(v);
+            }
+            REQUIRE_FALSE(merged.merge(part));
+
+            REQUIRE(merged.size() == whole.size());
+            REQUIRE(merged.middle() == whole.middle());
+            std::size_t rank = 0;
+            for (const auto expected : reference) {
+                REQUIRE(merged.select(rank++) == expected);
+            }
+        }
+    }
+
+    SECTION("into an emptied histogram") {
+        tick_histogram<fixed_price> hist;
+        REQUIRE_FALSE(hist.insert(7));
+        REQUIRE(hist.erase(7));
+
+        tick_histogram<fixed_price> part;
+        for (const fixed_price v : { 30, 10, 20 }) {
+            REQUIRE_FALSE(part.insert(v));
+        }
+        REQUIRE_FALSE(hist.merge(part));
+        REQUIRE_FALSE(hist.merge(tick_histogram<fixed_price>{}));
+        CHECK(hist.size() == 3);
+        CHECK(hist.middle() == std::pair<fixed_price, fixed_price>{ 20, 20 });
+
+        REQUIRE_FALSE(hist.insert(40));
+        CHECK(hist.middle() == std::pair<fixed_price, fixed_price>{ 20, 30 });
+    }
+
+    SECTION("calculator continues like one pass") {
+        histogram_calculator<fixed_price> sequential;
+        histogram_calculator<fixed_price> first;
+        histogram_calculator<fixed_price> second;
+        std::uniform_int_distribution<fixed_price> value{ 1000, 2000 };
+
+        for (int i = 0; i < 2000; ++i) {
+            const fixed_price v = value(rng);
+            sequential.add(v);
+            (i < 1000 ? first : second).add(v);
+        }
+        first.merge(second);
+        REQUIRE(first.median() == sequential.median());
+
+        for (int i = 0; i < 2000; ++i) {
+            const fixed_price v = value(rng);
+            sequential.add(v);
+            first.add(v);
+            REQUIRE(first.median() == sequential.median());
+            REQUIRE(first.is_changed() == sequential.is_changed());
+        }
+    }
+}
+
+TEST_CASE("histogram - pages far apart", "[histogram]") {
+    // Шаг 10^-8 и цены в разных концах: каталог хранит только свои страницы
+    tick_histogram<fixed_price> hist;
+    const fixed_price far = 1'000'000'000'000'000;
+    for (const fixed_price v : { far, -far, fixed_price{ 0 }, 5 * far, fixed_price{ 1 } }) {
+        REQUIRE_FALSE(hist.insert(v));
+    }
+
+    CHECK(hist.page_count() == 4);
+    CHECK(hist.middle() == std::pair<fixed_price, fixed_price>{ 1, 1 });
+    CHECK(hist.select(0) == -far);
+    CHECK(hist.select(4) == 5 * far);
+
+    REQUIRE(hist.erase(1));
+    CHECK(hist.middle() == std::pair<fixed_price, fixed_price>{ 0, far });
+    REQUIRE(hist.erase(0));
+    REQUIRE(hist.erase(-far));
+    CHECK(hist.middle() == std::pair<fixed_price, fixed_price>{ far, 5 * far });
+}
+
+TEST_CASE("histogram - page limit", "[histogram]") {
+    // Две страницы по 2048 шагов
+    tick_histogram<fixed_price> hist{ 1, 2 };
+    REQUIRE_FALSE(hist.insert(10));
+    REQUIRE_FALSE(hist.insert(5000));
+
+    CHECK(hist.insert(100'000) == std::errc::value_too_large);
+    CHECK(hist.size() == 2);
+    CHECK(hist.page_count() == 2);
+    CHECK(hist.middle() == std::pair<fixed_price, fixed_price>{ 10, 5000 });
+    // На выделенных страницах место есть
+    REQUIRE_FALSE(hist.insert(20));
+    CHECK(hist.middle() == std::pair<fixed_price, fixed_price>{ 20, 20 });
+
+    SECTION("merge does not exceed the limit") {
+        tick_histogram<fixed_price> part;
+        REQUIRE_FALSE(part.insert(30));
+        REQUIRE_FALSE(part.insert(100'000));
+        CHECK(hist.merge(part) == std::errc::value_too_large);
+        CHECK(hist.size() == 3);
+        CHECK(hist.select(2) == 5000);
+    }
+
+    SECTION("calculator keeps the last median") {
+        histogram_calculator<fixed_price> calc{ tick_histogram<fixed_price>{ 1, 1 } };
+        REQUIRE_FALSE(calc.add(10));
+        REQUIRE_FALSE(calc.add(30));
+        CHECK(calc.add(100'000) == std::errc::value_too_large);
+        CHECK(calc.count() == 2);
+        CHECK(calc.median() == 20);
+    }
+}
+
+namespace {
+    /**
+     * \brief Снимок гистограммы с шагом 1: count_ значений цены value_
+     */
+    csv_median::state_writer single_tick_state(fixed_price value_, std::uint64_t count_) {
+        csv_median::state_writer out;
+        fixed_price prev = 0;
+        out.put(fixed_price{ 1 });
+        out.put_varint(1);
+        out.put_value(value_, prev);
+        out.put_varint(count_);
+        out.put(value_);
+        out.put_varint(0);
+        out.put_varint(0);
+        return out;
+    }
+}
+
+TEST_CASE("histogram - counts above 32 bits", "[histogram]") {
+    const std::uint64_t count = 3'000'000'000;
+    const auto state = single_tick_state(42, count);
+    tick_histogram<fixed_price> part;
+    csv_median::state_reader in{ state.data() };
+    REQUIRE(part.load(in));
+    REQUIRE(part.size() == count);
+
+    tick_histogram<fixed_price> hist;
+    REQUIRE_FALSE(hist.insert(7));
+    REQUIRE_FALSE(hist.merge(part));
+    REQUIRE_FALSE(hist.merge(part));
+    CHECK(hist.size() == 2 * count + 1);
+    CHECK(hist.select(0) == 7);
+    CHECK(hist.select(2 * count) == 42);
+    CHECK(hist.middle() == std::pair<fixed_price, fixed_price>{ 42, 42 });
+
+    SECTION("merge beyond 2^64 values is refused") {
+        const auto half = single_tick_state(42, std::uint64_t{ 1 } << 63);
+        tick_histogram<fixed_price> big;
+        tick_histogram<fixed_price> other;
+        csv_median::state_reader big_in{ half.data() };
+        csv_median::state_reader other_in{ half.data() };
+        REQUIRE(big.load(big_in));
+        REQUIRE(other.load(other_in));
+
+        CHECK(big.merge(other) == std::errc::value_too_large);
+        CHECK(big.size() == std::uint64_t{ 1 } << 63);
+    }
+}
+
+TEST_CASE("histogram - off-grid prices round to nearest tick", "[histogram]") {
+    histogram_calculator<double> calc{ tick_histogram<double>{ 1'000'000 } };
+
+    calc.add(100.004);
+    CHECK(calc.median() == Approx(100.00));
+    calc.add(100.016);
+    calc.add(100.016);
+    CHECK(calc.median() == Approx(100.02));
+    CHECK(calc.engine().off_grid() == 3);
+}
+
+TEST_CASE("histogram - sliding window", "[histogram]") {
+    csv_median::sliding_window<histogram_calculator<fixed_price>> window{
+        100, histogram_calculator<fixed_price>{ tick_histogram<fixed_price>{ 10 } } };
+
+    window.add(1000, 1000);
+    window.add(1050, 3000);
+    CHECK(window.median() == 2000);
+
+    window.add(1100, 5000);
+    CHECK(window.count() == 2);
+    CHECK(window.median() == 4000);
+}
+
+TEST_CASE("histogram - window over drifting prices frees pages", "[histogram]") {
+    // Каждая цена на новой странице; в окне 100 мкс — 10 записей
+    csv_median::sliding_window<histogram_calculator<fixed_price>> window{
+        100, histogram_calculator<fixed_price>{ tick_histogram<fixed_price>{ 1, 16 } } };
+
+    std::size_t max_pages = 0;
+    for (std::uint64_t i = 0; i < 10000; ++i) {
+        const auto price = static_cast<fixed_price>(i) * 5000;
+        REQUIRE_FALSE(window.add(i * 10, price));
+        REQUIRE(window.median() == price - (i >= 9 ? 22500 : static_cast<fixed_price>(i) * 2500));
+        max_pages = std::max(max_pages, window.calculator().engine().page_count());
+    }
+    CHECK(window.count() == 10);
+    CHECK(max_pages <= 11);
+}
@@ -6,6 +6,12 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_approx.hpp>
 
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <system_error>
+#include <vector>
+
 #include "median.hpp"
 
 using csv_median::calculator;
@@ -116,4 +122,142 @@ TEST_CASE("median - is_changed correct", "[median]") {
     calc.add(10.0); // [5, 5, 5, 10, 10, 10] -> (5+10)/2 = 7.5, changed
     CHECK(calc.is_changed());
     CHECK(calc.median() == Approx(7.5));
-}
\ No newline at end of file
+}
+TEST_CASE("median - fixed point matches double", "[median]") {
+    using csv_median::fixed_calculator;
+
+    calculator calc;
+    fixed_calculator fixed_calc;
+
+    // 68480.10, 68480.00, 68480.10, 68480.10 в единицах 10^-8
+    const csv_median::fixed_price prices[] = {
+        6848010000000, 6848000000000, 6848010000000, 6848010000000 };
+
+    for (const auto price : prices) {
+        calc.add(static_cast<double>(price) / 1e8);
+        fixed_calc.add(price);
+
+        CHECK(fixed_calc.is_changed() == calc.is_changed());
+        CHECK(static_cast<double>(fixed_calc.median()) / 1e8
+            == Approx(calc.median()));
+    }
+    CHECK(fixed_calc.count() == 4);
+}
+
+TEST_CASE("median - fixed point half unit rounding", "[median]") {
+    using csv_median::fixed_calculator;
+
+    fixed_calculator calc;
+    calc.add(1);
+    calc.add(2);
+
+    // 1.5 единицы — медиана изменилась, хотя округлена до целого
+    CHECK(calc.is_changed());
+    calc.add(2);
+    CHECK(calc.median() == 2);
+    CHECK(calc.is_changed());
+}
+
+namespace {
+    /**
+     * \brief two_heap, которому после limit вставок не хватает памяти
+     */
+    struct exhausted_engine : csv_median::two_heap<double> {
+        std::size_t limit{ 0 };
+
+        void insert(double value_) {
+            if (size() == limit) {
+                throw std::bad_alloc{};
+            }
+            two_heap<double>::insert(value_);
+        }
+    };
+
+    // Сколько ещё выделений разрешено budget_allocator
+    std::size_t g_allocation_budget{ 0 };
+
+    /**
+     * \brief Аллокатор, бросающий std::bad_alloc после g_allocation_budget выделений
+     */
+    template<class T>
+    struct budget_allocator {
+        using value_type = T;
+
+        budget_allocator() noexcept = default;
+
+        template<class U>
+        budget_allocator(const budget_allocator<U>&) noexcept {}
+
+        T* allocate(std::size_t n_) {
+            if (g_allocation_budget == 0) {
+                throw std::bad_alloc{};
+            }
+            --g_allocation_budget;
+            return std::allocator<T>{}.allocate(n_);
+        }
+
+        void deallocate(T* p_, std::size_t n_) noexcept {
+            std::allocator<T>{}.deallocate(p_, n_);
+        }
+
+        template<class U>
+        friend bool operator==(const budget_allocator&, const budget_allocator<U>&) noexcept {
+            return true;
+        }
+    };
+}
+
+TEST_CASE("median - add reports out of memory", "[median]") {
+    exhausted_engine engine;
+    engine.limit = 2;
+    csv_median::basic_calculator<double, exhausted_engine> calc{ engine };
+
+    CHECK_FALSE(calc.add(1.0));
+    CHECK_FALSE(calc.add(3.0));
+    CHECK(calc.median() == Approx(2.0));
+
+    // Значение не учтено: медиана и is_changed() от прошлого add()
+    CHECK(calc.add(10.0) == std::errc::not_enough_memory);
+    CHECK(calc.count() == 2);
+    CHECK(calc.median() == Approx(2.0));
+    CHECK(calc.is_changed());
+}
+
+TEST_CASE("median - two_heap survives bad_alloc in rebalance", "[median]") {
+    // Убывающие значения попадают в нижнюю кучу, и каждая вторая вставка
+    // переносит вершину в верхнюю: выделение для верхней кучи падает уже
+    // после того, как нижняя выросла
+    for (std::size_t budget = 0; budget < 8; ++budget) {
+        CAPTURE(budget);
+        g_allocation_budget = budget;
+
+        csv_median::two_heap<double, budget_allocator<double>> heap;
+        std::vector<double> inserted;
+        for (int i = 0; i < 200; ++i) {
+            const double value = 1000.0 - i;
+            try {
+                heap.insert(value);
+                inserted.push_back(value);
+            }
+            catch (const std::bad_alloc&) {
+                // Значение не вставлено, кучи согласованы
+                REQUIRE(heap.size() == inserted.size());
+                break;
+            }
+        }
+
+        // После отказа вставки продолжаются и медиана верна
+        g_allocation_budget = 1000;
+        for (int i = 0; i < 50; ++i) {
+            const double value = (i % 2 == 0) ? 2000.0 + i : -i;
+            heap.insert(value);
+            inserted.push_back(value);
+        }
+        std::ranges::sort(inserted);
+        const auto n = inserted.size();
+        REQUIRE(heap.size() == n);
+        const auto [lo, hi] = heap.middle();
+        CHECK(lo == inserted[(n - 1) / 2]);
+        CHECK(hi == inserted[n / 2]);
+    }
+}
@@ -0,0 +1,115 @@
+/**
+ * \file test_merge.cpp
+ * \brief Unit-тесты для loser_tree
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "merge.hpp"
+
+using csv_median::loser_tree;
+
+namespace {
+
+    using sources = std::vector<std::vector<std::uint64_t>>;
+
+    /**
+     * \brief Слить источники деревом: пары (ts, индекс источника)
+     */
+    std::vector<std::pair<std::uint64_t, std::size_t>> merge_all(const sources& sources_) {
+        std::vector<std::uint64_t> keys;
+        for (const auto& s : sources_) {
+            keys.push_back(s.front());
+        }
+
+        std::vector<std::size_t> pos(sources_.size(), 0);
+        std::vector<std::pair<std::uint64_t, std::size_t>> out;
+        loser_tree tree{ std::move(keys) };
+        while (!tree.empty()) {
+            const std::size_t w = tree.winner();
+            out.emplace_back(sources_[w][pos[w]], w);
+            if (++pos[w] < sources_[w].size()) {
+                tree.replace(sources_[w][pos[w]]);
+            }
+            else {
+                tree.pop();
+            }
+        }
+        return out;
+    }
+
+}
+
+TEST_CASE("loser_tree - merge sorted sources", "[merge]") {
+    const sources input{ { 1, 4, 7 }, { 2, 5, 8 }, { 3, 6, 9 } };
+    const auto out = merge_all(input);
+
+    REQUIRE(out.size() == 9);
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        CHECK(out[i].first == i + 1);
+    }
+}
+
+TEST_CASE("loser_tree - equal keys go in source order", "[merge]") {
+    const sources input{ { 5, 5 }, { 1, 5 }, { 5 } };
+    const auto out = merge_all(input);
+
+    const std::vector<std::pair<std::uint64_t, std::size_t>> expected{
+        { 1, 1 }, { 5, 0 }, { 5, 0 }, { 5, 1 }, { 5, 2 } };
+    CHECK(out == expected);
+}
+
+TEST_CASE("loser_tree - single source", "[merge]") {
+    loser_tree tree{ { 42 } };
+
+    REQUIRE_FALSE(tree.empty());
+    CHECK(tree.winner() == 0);
+    CHECK(tree.runner_up() == loser_tree::npos);
+
+    tree.pop();
+    CHECK(tree.empty());
+}
+
+TEST_CASE("loser_tree - runner up", "[merge]") {
+    loser_tree tree{ { 30, 10, 20, 40, 10 } };
+
+    CHECK(tree.winner() == 1);
+    CHECK(tree.runner_up() == 4);
+
+    tree.replace(25);
+    CHECK(tree.winner() == 4);
+    CHECK(tree.runner_up() == 2);
+
+    tree.pop();
+    tree.pop();
+    CHECK(tree.winner() == 1);
+    CHECK(tree.runner_up() == 0);
+    CHECK(tree.size() == 3);
+}
+
+TEST_CASE("loser_tree - random sources match stable sort", "[merge]") {
+    std::mt19937_64 rng{ 11 };
+
+    for (const std::size_t k : { 2u, 3u, 7u, 64u, 300u }) {
+        sources input(k);
+        std::vector<std::pair<std::uint64_t, std::size_t>> expected;
+        for (std::size_t s = 0; s < k; ++s) {
+            std::uint64_t ts = rng() % 100;
+            const std::size_t n = 1 + rng() % 20;
+            for (std::size_t i = 0; i < n; ++i) {
+                ts += rng() % 3;
+                input[s].push_back(ts);
+                expected.emplace_back(ts, s);
+            }
+        }
+        std::ranges::sort(expected);
+
+        CHECK(merge_all(input) == expected);
+    }
+}
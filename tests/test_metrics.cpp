@@ -0,0 +1,232 @@
+/**
+ * \file test_metrics.cpp
+ * \brief Unit-тесты для счётчиков, задержек и экспорта метрик
+ *
+ * Метрики глобальные на процесс, и их пишут тесты других модулей:
+ * проверяются разности снимков.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "metrics.hpp"
+
+using csv_median::counter;
+using csv_median::latency;
+using csv_median::latency_summary;
+using csv_median::metrics_snapshot;
+using csv_median::take_metrics_snapshot;
+
+namespace {
+
+    /**
+     * \brief GET path_ на 127.0.0.1:port_, весь ответ
+     */
+    [[nodiscard]] std::string http_get(std::uint16_t port_, const std::string& path_) {
+        const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        REQUIRE(fd >= 0);
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port_);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        REQUIRE(::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0);
+
+        const std::string request = "GET " + path_ + " HTTP/1.0\r\n\r\n";
+        REQUIRE(::send(fd, request.data(), request.size(), MSG_NOSIGNAL)
+            == static_cast<ssize_t>(request.size()));
+
+        std::string response;
+        char buffer[4096];
+        for (;;) {
+            const auto n = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                break;
+            }
+            response.append(buffer, static_cast<std::size_t>(n));
+        }
+        ::close(fd);
+        return response;
+    }
+
+}
+
+TEST_CASE("metrics - counters", "[metrics]") {
+    SECTION("summed across threads") {
+        const metrics_snapshot before = take_metrics_snapshot();
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([] {
+                for (int i = 0; i < 1000; ++i) {
+                    csv_median::add_metric(counter::merge_batches);
+                    csv_median::add_metric(counter::records_merged, 3);
+                }
+                });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        // Блоки завершившихся потоков остаются в снимке
+        const metrics_snapshot after = take_metrics_snapshot();
+        CHECK(after[counter::merge_batches] - before[counter::merge_batches] == 4000);
+        CHECK(after[counter::records_merged] - before[counter::records_merged] == 12000);
+    }
+
+    SECTION("gauge keeps the maximum") {
+        csv_median::set_gauge(csv_median::gauge::parse_queue, 1'000'000);
+        csv_median::set_gauge(csv_median::gauge::parse_queue, 2);
+
+        const metrics_snapshot snapshot = take_metrics_snapshot();
+        CHECK(snapshot[csv_median::gauge::parse_queue].last == 2);
+        CHECK(snapshot[csv_median::gauge::parse_queue].max >= 1'000'000);
+    }
+
+    SECTION("one file_metrics per path") {
+        auto& a = csv_median::file_metrics_for("metrics_test/a.csv");
+        auto& b = csv_median::file_metrics_for("metrics_test/b.csv");
+        CHECK(&a == &csv_median::file_metrics_for("metrics_test/a.csv"));
+        CHECK(&a != &b);
+
+        a.add(100, 10, 1);
+        a.add(50, 5, 0);
+        const metrics_snapshot snapshot = take_metrics_snapshot();
+        bool found = false;
+        for (const auto& file : snapshot.files) {
+            if (file.path == "metrics_test/a.csv") {
+                found = true;
+                CHECK(file.bytes >= 150);
+                CHECK(file.records >= 15);
+                CHECK(file.skipped >= 1);
+            }
+        }
+        CHECK(found);
+    }
+
+    SECTION("parse error limit per file") {
+        const std::uint64_t limit = csv_median::parse_error_limit();
+        csv_median::set_parse_error_limit(5);
+        auto& file = csv_median::file_metrics_for("metrics_test/errors.csv");
+
+        CHECK(file.log_slots(0) == 0);
+        CHECK(file.log_slots(3) == 3);
+        CHECK(file.log_slots(4) == 2);
+        CHECK(file.log_slots(1) == 0);
+        CHECK_FALSE(file.muted.load());
+        file.mute();
+        CHECK(file.muted.load());
+
+        // Лимит общий для всех курсоров файла
+        CHECK(csv_median::file_metrics_for("metrics_test/errors.csv").log_slots(1) == 0);
+        CHECK(csv_median::file_metrics_for("metrics_test/other.csv").log_slots(10) == 5);
+
+        csv_median::set_parse_error_limit(limit);
+    }
+}
+
+TEST_CASE("metrics - latency", "[metrics]") {
+    SECTION("power-of-two buckets") {
+        const metrics_snapshot before = take_metrics_snapshot();
+        for (int i = 0; i < 99; ++i) {
+            csv_median::record_latency(latency::merge_stall, 100);
+        }
+        csv_median::record_latency(latency::merge_stall, 1'000'000);
+
+        const latency_summary delta = take_metrics_snapshot()[latency::merge_stall]
+            .since(before[latency::merge_stall]);
+        CHECK(delta.count == 100);
+        CHECK(delta.sum_ns == 99 * 100 + 1'000'000);
+        CHECK(delta.mean() == (99 * 100 + 1'000'000) / 100);
+        // 100 нс — в корзине [64, 128)
+        CHECK(delta.percentile(0.5) == 128);
+        CHECK(delta.percentile(0.99) == 128);
+        // Граница корзины не больше наибольшего замера
+        CHECK(delta.percentile(1.0) >= 1'000'000);
+        CHECK(delta.percentile(1.0) <= 1 << 20);
+    }
+
+    SECTION("empty summary") {
+        const latency_summary empty;
+        CHECK(empty.percentile(0.5) == 0);
+        CHECK(empty.mean() == 0);
+    }
+}
+
+TEST_CASE("metrics - export", "[metrics]") {
+    metrics_snapshot snapshot;
+    snapshot.elapsed_s = 2.0;
+    snapshot.counters[static_cast<std::size_t>(counter::bytes_read)] = 4 << 20;
+    snapshot.latencies[static_cast<std::size_t>(latency::writer_flush)].buckets[3] = 2;
+    snapshot.latencies[static_cast<std::size_t>(latency::writer_flush)].count = 2;
+    snapshot.latencies[static_cast<std::size_t>(latency::writer_flush)].sum_ns = 10;
+    snapshot.files.push_back({ "in \"q\"\\d.csv", 10, 2, 1 });
+
+    SECTION("json") {
+        const std::string json = csv_median::metrics_json(snapshot);
+        CHECK(json.find("\"bytes_read\": 4194304") != std::string::npos);
+        CHECK(json.find("\"writer_flush\": { \"count\": 2") != std::string::npos);
+        CHECK(json.find("\"buckets\": [[1, 0], [2, 0], [4, 0], [8, 2]]") != std::string::npos);
+        CHECK(json.find("\"path\": \"in \\\"q\\\"\\\\d.csv\"") != std::string::npos);
+    }
+
+    SECTION("prometheus") {
+        const std::string text = csv_median::metrics_prometheus(snapshot);
+        CHECK(text.find("# TYPE csv_median_bytes_read_total counter\n"
+            "csv_median_bytes_read_total 4194304\n") != std::string::npos);
+        CHECK(text.find("csv_median_writer_flush_seconds_bucket{le=\"8e-09\"} 2\n")
+            != std::string::npos);
+        CHECK(text.find("csv_median_writer_flush_seconds_bucket{le=\"+Inf\"} 2\n")
+            != std::string::npos);
+        CHECK(text.find("csv_median_writer_flush_seconds_count 2\n") != std::string::npos);
+        CHECK(text.find("csv_median_file_records_total{file=\"in \\\"q\\\"\\\\d.csv\"} 2\n")
+            != std::string::npos);
+    }
+
+    SECTION("log line") {
+        const std::string line = csv_median::format_metrics_line(snapshot, {});
+        CHECK(line.starts_with("metrics: read 4.0 MB (2.0 MB/s)"));
+    }
+}
+
+TEST_CASE("metrics - listen address", "[metrics]") {
+    sockaddr_in address{};
+    CHECK(csv_median::parse_listen_address("127.0.0.1:9464", address));
+    CHECK(ntohs(address.sin_port) == 9464);
+    CHECK(ntohl(address.sin_addr.s_addr) == INADDR_LOOPBACK);
+    CHECK(csv_median::parse_listen_address("0.0.0.0:0", address));
+
+    CHECK_FALSE(csv_median::parse_listen_address("127.0.0.1", address));
+    CHECK_FALSE(csv_median::parse_listen_address("localhost:9464", address));
+    CHECK_FALSE(csv_median::parse_listen_address("127.0.0.1:65536", address));
+    CHECK_FALSE(csv_median::parse_listen_address("127.0.0.1:", address));
+    CHECK_FALSE(csv_median::parse_listen_address("127.0.0.1:80x", address));
+}
+
+TEST_CASE("metrics - reporter serves /metrics", "[metrics]") {
+    csv_median::metrics_options options;
+    options.enabled = true;
+    options.interval_ms = 0;
+    options.listen = "127.0.0.1:0";
+
+    csv_median::metrics_reporter reporter;
+    REQUIRE_FALSE(reporter.start(options));
+    REQUIRE(reporter.port() != 0);
+
+    const std::string ok = http_get(reporter.port(), "/metrics");
+    CHECK(ok.starts_with("HTTP/1.0 200 OK\r\n"));
+    CHECK(ok.find("csv_median_records_parsed_total ") != std::string::npos);
+
+    const std::string missing = http_get(reporter.port(), "/");
+    CHECK(missing.starts_with("HTTP/1.0 404 Not Found\r\n"));
+
+    reporter.stop();
+}
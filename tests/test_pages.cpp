@@ -0,0 +1,158 @@
+/**
+ * \file test_pages.cpp
+ * \brief Unit-тесты для page_allocator и резерва хранения калькулятора
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "median.hpp"
+#include "pages.hpp"
+#include "reader.hpp"
+#include "skiplist.hpp"
+
+using csv_median::huge_pages;
+using csv_median::k_huge_page_size;
+using csv_median::page_allocator;
+using csv_median::page_vector;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    /**
+     * \brief Включить режим страниц на время теста и вернуть off
+     */
+    struct scoped_huge_pages {
+        explicit scoped_huge_pages(huge_pages mode_) noexcept {
+            csv_median::set_huge_pages(mode_);
+        }
+
+        ~scoped_huge_pages() {
+            csv_median::set_huge_pages(huge_pages::off);
+        }
+    };
+
+}
+
+TEST_CASE("pages - small and large blocks", "[pages]") {
+    const scoped_huge_pages mode{ GENERATE(huge_pages::off, huge_pages::thp, huge_pages::hugetlb) };
+    page_allocator<std::int64_t> alloc;
+
+    SECTION("small block from operator new") {
+        std::int64_t* const p = alloc.allocate(16);
+        for (std::int64_t i = 0; i < 16; ++i) {
+            p[i] = i;
+        }
+        CHECK(p[15] == 15);
+        alloc.deallocate(p, 16);
+    }
+
+    SECTION("large block aligned to huge page") {
+        const std::size_t n = k_huge_page_size / sizeof(std::int64_t) * 3 + 7;
+        std::int64_t* const p = alloc.allocate(n);
+        CHECK(reinterpret_cast<std::uintptr_t>(p) % k_huge_page_size == 0);
+        p[0] = 1;
+        p[n - 1] = 2;
+        CHECK(p[0] + p[n - 1] == 3);
+        alloc.deallocate(p, n);
+    }
+
+    SECTION("too large") {
+        CHECK_THROWS_AS(alloc.allocate(static_cast<std::size_t>(-1) / 4), std::bad_array_new_length);
+    }
+}
+
+TEST_CASE("pages - page_vector grows across the huge page threshold", "[pages]") {
+    const scoped_huge_pages mode{ GENERATE(huge_pages::off, huge_pages::thp, huge_pages::hugetlb) };
+
+    page_vector<std::int64_t> values;
+    const std::int64_t count = 1'000'000;
+    for (std::int64_t i = 0; i < count; ++i) {
+        values.push_back(i * 3);
+    }
+
+    REQUIRE(values.size() == static_cast<std::size_t>(count));
+    bool same = true;
+    for (std::int64_t i = 0; i < count; ++i) {
+        same = same && values[static_cast<std::size_t>(i)] == i * 3;
+    }
+    CHECK(same);
+
+    auto copy = values;
+    values.clear();
+    values.shrink_to_fit();
+    CHECK(copy.back() == (count - 1) * 3);
+}
+
+TEST_CASE("pages - reserve does not change medians", "[pages]") {
+    std::mt19937_64 rng{ 26 };
+    std::uniform_int_distribution<std::int64_t> dist{ 1, 1'000'000 };
+    std::vector<std::int64_t> input(50'000);
+    for (auto& v : input) {
+        v = dist(rng);
+    }
+
+    SECTION("two_heap") {
+        csv_median::two_heap<std::int64_t> plain;
+        csv_median::two_heap<std::int64_t> reserved;
+        reserved.reserve(input.size() * 4);
+
+        bool same = true;
+        for (const auto v : input) {
+            plain.insert(v);
+            reserved.insert(v);
+            same = same && plain.middle() == reserved.middle();
+        }
+        CHECK(same);
+    }
+
+    SECTION("skip list calculator") {
+        const scoped_huge_pages mode{ huge_pages::thp };
+        csv_median::skiplist_calculator<std::int64_t> plain;
+        csv_median::skiplist_calculator<std::int64_t> reserved;
+        reserved.reserve(input.size());
+
+        bool same = true;
+        for (const auto v : input) {
+            plain.add(v);
+            reserved.add(v);
+            same = same && plain.median() == reserved.median();
+        }
+        CHECK(same);
+    }
+}
+
+TEST_CASE("pages - estimate_records", "[pages]") {
+    const fs::path dir = fs::temp_directory_path()
+        / ("pages_test_" + std::to_string(
+            std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(dir);
+
+    const auto make_file = [&](const std::string& name_, std::size_t size_) {
+        std::ofstream f{ dir / name_ };
+        f << std::string(size_, 'x');
+        return dir / name_;
+    };
+
+    const std::vector<fs::path> paths{
+        make_file("a.csv", 4000),
+        make_file("b.csv", 400),
+        make_file("c.csv.gz", 4000),
+        dir / "missing.csv"
+    };
+
+    // Сжатые и недоступные файлы не оцениваются
+    CHECK(csv_median::estimate_records(paths) == 4400 / csv_median::k_min_record_bytes);
+    CHECK(csv_median::estimate_records({}) == 0);
+
+    fs::remove_all(dir);
+}
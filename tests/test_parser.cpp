@@ -4,11 +4,14 @@
  */
 
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
 
 #include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "parser.hpp"
 
@@ -151,4 +154,1244 @@ TEST_CASE("config - invalid toml syntax returns error", "[config]") {
     auto [config, err] = parser.parse(args.argc(), args.argv());
 
     CHECK(err);
-}
\ No newline at end of file
+}
+
+TEST_CASE("config - read_mode", "[config]") {
+    SECTION("default is stream") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.input_mode == csv_median::read_mode::stream);
+    }
+
+    SECTION("mmap") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "read_mode = 'mmap'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.input_mode == csv_median::read_mode::mmap);
+    }
+
+    SECTION("unknown value returns error") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "read_mode = 'pigeon'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - price_mode", "[config]") {
+    SECTION("fixed") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "price_mode = 'fixed'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.prices == csv_median::price_mode::fixed);
+    }
+
+    SECTION("unknown value returns error") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "price_mode = 'float'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - median_backend", "[config]") {
+    SECTION("default is heap") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.backend == csv_median::median_backend::heap);
+    }
+
+    SECTION("skiplist") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "median_backend = 'skiplist'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.backend == csv_median::median_backend::skiplist);
+    }
+
+    SECTION("unknown value returns error") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "median_backend = 'tree'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - window_us", "[config]") {
+    SECTION("window selects skiplist backend") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "window_us = 1000000\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.window_us == 1000000);
+        CHECK(config.backend == csv_median::median_backend::skiplist);
+    }
+
+    SECTION("non-positive width returns error") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "window_us = 0\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+
+    SECTION("heap backend can't serve a window") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "window_us = 1000\n"
+            "median_backend = 'heap'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - tdigest backend", "[config]") {
+    SECTION("sketch_error") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "median_backend = 'tdigest'\n"
+            "sketch_error = 0.005\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.backend == csv_median::median_backend::tdigest);
+        CHECK(config.sketch_error == 0.005);
+    }
+
+    SECTION("sketch_error out of range returns error") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "sketch_error = 0.7\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+
+    SECTION("tdigest can't serve a window") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "window_us = 1000\n"
+            "median_backend = 'tdigest'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - histogram backend", "[config]") {
+    SECTION("tick_size") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "median_backend = 'histogram'\n"
+            "tick_size = 0.01\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.backend == csv_median::median_backend::histogram);
+        CHECK(config.tick_units == 1'000'000);
+    }
+
+    SECTION("tick_size finer than 1e-8 returns error") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "tick_size = 0.000000001\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+
+    SECTION("histogram serves a window") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "window_us = 1000\n"
+            "median_backend = 'histogram'\n"
+            "tick_size = 0.1\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.backend == csv_median::median_backend::histogram);
+    }
+
+    SECTION("histogram without tick_size returns error") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "median_backend = 'histogram'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - parallel_parse", "[config]") {
+    temp_toml cfg{
+        "[main]\n"
+        "input = './data'\n"
+        "parallel_parse = false\n"
+    };
+
+    fake_argv args{ {"app", "--config", cfg.str()} };
+    config_parser parser;
+    auto [config, err] = parser.parse(args.argc(), args.argv());
+
+    REQUIRE_FALSE(err);
+    CHECK_FALSE(config.parallel_parse);
+}
+
+TEST_CASE("config - write_mode", "[config]") {
+    SECTION("defaults") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.output_mode == csv_median::write_mode::sync);
+        CHECK(config.write_buffers == csv_median::k_default_write_buffers);
+        CHECK_FALSE(config.direct_io);
+    }
+
+    SECTION("async with buffers") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "write_mode = 'async'\n"
+            "write_buffers = 8\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.output_mode == csv_median::write_mode::async);
+        CHECK(config.write_buffers == 8);
+    }
+
+    SECTION("uring with O_DIRECT") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "read_mode = 'uring'\n"
+            "write_mode = 'uring'\n"
+            "direct_io = true\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.input_mode == csv_median::read_mode::uring);
+        CHECK(config.output_mode == csv_median::write_mode::uring);
+        CHECK(config.direct_io);
+    }
+
+    SECTION("unknown mode returns error") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "write_mode = 'later'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+
+    SECTION("one buffer returns error") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "write_mode = 'async'\n"
+            "write_buffers = 1\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - cache", "[config]") {
+    SECTION("off by default") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK_FALSE(config.cache);
+    }
+
+    SECTION("enabled") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "cache = true\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.cache);
+    }
+}
+
+TEST_CASE("config - output_format", "[config]") {
+    SECTION("csv by default") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.format == csv_median::output_format::csv);
+        CHECK(config.output_compression == csv_median::compression::none);
+    }
+
+    SECTION("columnar") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "output_format = 'columnar'\n"
+            "output_compression = 'none'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.format == csv_median::output_format::columnar);
+        CHECK(config.output_compression == csv_median::compression::none);
+    }
+
+    SECTION("zstd chunks") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "output_format = 'columnar'\n"
+            "output_compression = 'zstd'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        if (csv_median::compression_supported(csv_median::compression::zstd)) {
+            REQUIRE_FALSE(err);
+            CHECK(config.output_compression == csv_median::compression::zstd);
+        }
+        else {
+            CHECK(err == std::errc::not_supported);
+        }
+    }
+
+    SECTION("invalid format") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "output_format = 'parquet'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+
+    SECTION("invalid compression") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "output_format = 'columnar'\n"
+            "output_compression = 'gzip'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+
+    SECTION("compression without columnar output") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "output_compression = 'zstd'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - pin_threads", "[config]") {
+    temp_toml cfg{
+        "[main]\n"
+        "input = './data'\n"
+        "pin_threads = true\n"
+    };
+
+    fake_argv args{ {"app", "--config", cfg.str()} };
+    config_parser parser;
+    auto [config, err] = parser.parse(args.argc(), args.argv());
+
+    REQUIRE_FALSE(err);
+    CHECK(config.pin_threads);
+}
+
+TEST_CASE("config - partitions", "[config]") {
+    SECTION("default") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.partitions == 1);
+    }
+
+    SECTION("with window") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "window_us = 1000\n"
+            "partitions = 8\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.partitions == 8);
+    }
+
+    SECTION("without window") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "partitions = 8\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+
+    SECTION("zero") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "window_us = 1000\n"
+            "partitions = 0\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - from_ts / to_ts", "[config]") {
+    SECTION("default") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.range.whole());
+        CHECK(config.index.every_records == csv_median::k_index_every_records);
+        CHECK(config.index.every_us == 0);
+    }
+
+    SECTION("range and index step") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "from_ts = 1716810808000000\n"
+            "to_ts = 1716814408000000\n"
+            "index_records = 1000\n"
+            "index_interval_us = 60000000\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.range.from == 1716810808000000);
+        CHECK(config.range.to == 1716814408000000);
+        CHECK(config.index.every_records == 1000);
+        CHECK(config.index.every_us == 60000000);
+    }
+
+    SECTION("to_ts not after from_ts") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "from_ts = 2000\n"
+            "to_ts = 2000\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+
+    SECTION("zero index_records") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "index_records = 0\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - group_by", "[config]") {
+    SECTION("default") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.groups == csv_median::group_mode::none);
+        CHECK(config.group_column == "side");
+    }
+
+    SECTION("by column") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "group_by = 'column'\n"
+            "group_column = 'venue'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.groups == csv_median::group_mode::column);
+        CHECK(config.group_column == "venue");
+    }
+
+    SECTION("by mask") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "filename_mask = ['level', 'trade']\n"
+            "group_by = 'mask'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.groups == csv_median::group_mode::mask);
+    }
+
+    SECTION("mask without filename_mask") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "group_by = 'mask'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+
+    SECTION("with partitions") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "window_us = 1000\n"
+            "partitions = 4\n"
+            "group_by = 'column'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+
+    SECTION("unknown mode") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "group_by = 'symbol'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - statistics", "[config]") {
+    SECTION("default") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.statistics.empty());
+        CHECK(config.backend == csv_median::median_backend::heap);
+    }
+
+    SECTION("list in order, skiplist by default") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "statistics = ['p95', 'vwap', 'p05', 'mean', 'stddev']\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        using csv_median::statistic;
+        using csv_median::statistic_kind;
+        CHECK(config.statistics == std::vector<statistic>{
+            { statistic_kind::quantile, 95 }, { statistic_kind::vwap },
+            { statistic_kind::quantile, 5 }, { statistic_kind::mean },
+            { statistic_kind::stddev } });
+        CHECK(config.backend == csv_median::median_backend::skiplist);
+        CHECK(csv_median::statistic_name(config.statistics[2]) == "p05");
+    }
+
+    SECTION("histogram backend") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "statistics = ['p25']\n"
+            "median_backend = 'histogram'\n"
+            "tick_size = 0.01\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.backend == csv_median::median_backend::histogram);
+    }
+
+    SECTION("invalid") {
+        const auto toml = GENERATE(as<std::string>{},
+            "statistics = ['p5']\n",
+            "statistics = ['p00']\n",
+            "statistics = ['variance']\n",
+            "statistics = ['mean', 'mean']\n",
+            "statistics = ['mean']\nmedian_backend = 'heap'\n",
+            "statistics = ['mean']\nmedian_backend = 'tdigest'\n",
+            "statistics = ['mean']\noutput_format = 'columnar'\n",
+            "statistics = ['mean']\nfilename_mask = ['trade']\ngroup_by = 'mask'\n",
+            "statistics = ['mean']\nwindow_us = 1000\npartitions = 2\n");
+
+        temp_toml cfg{ "[main]\ninput = './data'\n" + toml };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - bucket_us", "[config]") {
+    SECTION("default") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.bucket_us == 0);
+        CHECK_FALSE(config.bucket_ohlc);
+    }
+
+    SECTION("bucket with ohlc") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "bucket_us = 100000\n"
+            "bucket_ohlc = true\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.bucket_us == 100000);
+        CHECK(config.bucket_ohlc);
+    }
+
+    SECTION("invalid") {
+        const auto toml = GENERATE(as<std::string>{},
+            "bucket_us = 0\n",
+            "bucket_us = -5\n",
+            "bucket_ohlc = true\n",
+            "bucket_us = 1000\nbucket_ohlc = true\noutput_format = 'columnar'\n");
+
+        temp_toml cfg{ "[main]\ninput = './data'\n" + toml };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - follow", "[config]") {
+    SECTION("default") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK_FALSE(config.follow);
+        CHECK(config.follow_settings.lateness_us == csv_median::k_follow_lateness_us);
+        CHECK(config.follow_settings.poll_ms == csv_median::k_follow_poll_ms);
+    }
+
+    SECTION("lateness and poll interval") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "follow = true\n"
+            "follow_lateness_us = 0\n"
+            "follow_poll_ms = 20\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.follow);
+        CHECK(config.follow_settings.lateness_us == 0);
+        CHECK(config.follow_settings.poll_ms == 20);
+    }
+
+    SECTION("invalid") {
+        const auto toml = GENERATE(as<std::string>{},
+            "follow_lateness_us = -1\n",
+            "follow_poll_ms = 0\n",
+            "follow = true\nwindow_us = 1000\npartitions = 2\n",
+            "follow = true\nfrom_ts = 100\n");
+
+        temp_toml cfg{ "[main]\ninput = './data'\n" + toml };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - checkpoint_records and --resume", "[config]") {
+    SECTION("default") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.checkpoint_records == 0);
+        CHECK_FALSE(config.resume);
+    }
+
+    SECTION("resume") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "checkpoint_records = 1000000\n"
+            "window_us = 1000\n"
+        };
+
+        fake_argv args{ {"app", "--resume", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.checkpoint_records == 1'000'000);
+        CHECK(config.resume);
+    }
+
+    SECTION("--resume without checkpoint_records") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str(), "--resume"} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+
+    SECTION("invalid") {
+        const auto toml = GENERATE(as<std::string>{},
+            "checkpoint_records = 0\n",
+            "checkpoint_records = 10\noutput_format = 'columnar'\n",
+            "checkpoint_records = 10\ngroup_by = 'mask'\n",
+            "checkpoint_records = 10\nwindow_us = 1000\npartitions = 2\n",
+            "checkpoint_records = 10\nstatistics = ['p05']\n",
+            "checkpoint_records = 10\nbucket_us = 1000\n",
+            "checkpoint_records = 10\nfollow = true\n",
+            "checkpoint_records = 10\nfrom_ts = 100\n");
+
+        temp_toml cfg{ "[main]\ninput = './data'\n" + toml };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - metrics", "[config]") {
+    SECTION("default") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK_FALSE(config.metrics.enabled);
+        CHECK(config.metrics.interval_ms == csv_median::k_metrics_interval_ms);
+        CHECK(config.metrics.listen.empty());
+        CHECK(config.parse_error_limit == csv_median::k_parse_error_limit);
+    }
+
+    SECTION("parse_error_limit") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "parse_error_limit = 0\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.parse_error_limit == 0);
+    }
+
+    SECTION("interval and listen") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "follow = true\n"
+            "metrics = true\n"
+            "metrics_interval_ms = 0\n"
+            "metrics_listen = '127.0.0.1:9464'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.metrics.enabled);
+        CHECK(config.metrics.interval_ms == 0);
+        CHECK(config.metrics.listen == "127.0.0.1:9464");
+    }
+
+    SECTION("invalid") {
+        const auto toml = GENERATE(as<std::string>{},
+            "metrics = true\nmetrics_interval_ms = -1\n",
+            "metrics = true\nmetrics_interval_ms = 3600001\n",
+            "metrics_interval_ms = 1000\n",
+            "follow = true\nmetrics_listen = '127.0.0.1:9464'\n",
+            "metrics = true\nmetrics_listen = '127.0.0.1:9464'\n",
+            "metrics = true\nfollow = true\nmetrics_listen = 'localhost:9464'\n",
+            "metrics = true\nfollow = true\nmetrics_listen = '127.0.0.1'\n",
+            "metrics = true\nfollow = true\nmetrics_listen = '127.0.0.1:70000'\n",
+            "parse_error_limit = -1\n");
+
+        temp_toml cfg{ "[main]\ninput = './data'\n" + toml };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - huge_pages", "[config]") {
+    SECTION("off by default") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.pages == csv_median::huge_pages::off);
+    }
+
+    SECTION("values") {
+        const auto [name, mode] = GENERATE(
+            std::pair{ "off", csv_median::huge_pages::off },
+            std::pair{ "thp", csv_median::huge_pages::thp },
+            std::pair{ "hugetlb", csv_median::huge_pages::hugetlb });
+
+        temp_toml cfg{ std::string{ "[main]\ninput = './data'\nhuge_pages = '" } + name + "'\n" };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.pages == mode);
+    }
+
+    SECTION("invalid") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "huge_pages = 'yes'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
+
+TEST_CASE("config - shard_mode", "[config]") {
+    SECTION("off by default") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.shard == csv_median::shard_mode::none);
+        CHECK(config.shard_inputs.empty());
+        CHECK(config.shard_prefix.empty());
+    }
+
+    SECTION("partial") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "median_backend = 'tdigest'\n"
+            "shard_mode = 'partial'\n"
+            "from_ts = 100\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.shard == csv_median::shard_mode::partial);
+    }
+
+    SECTION("merge without input") {
+        temp_toml cfg{
+            "[main]\n"
+            "median_backend = 'histogram'\n"
+            "tick_size = 0.01\n"
+            "shard_mode = 'merge'\n"
+            "shard_inputs = ['a/median_result.part', 'b/median_result.part']\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.shard == csv_median::shard_mode::merge);
+        CHECK(config.shard_inputs == std::vector<std::filesystem::path>{
+            "a/median_result.part", "b/median_result.part" });
+    }
+
+    SECTION("prefix") {
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "median_backend = 'histogram'\n"
+            "tick_size = 0.01\n"
+            "shard_prefix = 'm/median_result.prefix_1.part'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        REQUIRE_FALSE(err);
+        CHECK(config.shard == csv_median::shard_mode::none);
+        CHECK(config.shard_prefix == "m/median_result.prefix_1.part");
+    }
+
+    SECTION("invalid") {
+        const auto toml = GENERATE(as<std::string>{},
+            "median_backend = 'tdigest'\nshard_mode = 'coordinator'\n",
+            "shard_mode = 'partial'\n",
+            "median_backend = 'skiplist'\nshard_prefix = 'p.part'\n",
+            "median_backend = 'histogram'\ntick_size = 0.01\nwindow_us = 1000\nshard_mode = 'partial'\n",
+            "median_backend = 'tdigest'\nshard_mode = 'merge'\n",
+            "median_backend = 'tdigest'\nshard_inputs = ['a.part']\n",
+            "median_backend = 'tdigest'\nshard_mode = 'partial'\ngroup_by = 'mask'\n",
+            "median_backend = 'tdigest'\nshard_mode = 'partial'\nfollow = true\n",
+            "median_backend = 'tdigest'\nshard_mode = 'partial'\ncheckpoint_records = 1000\n");
+
+        temp_toml cfg{ "[main]\ninput = './data'\n" + toml };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+
+    SECTION("shard_prefix with shard_mode") {
+        // Префикс — отдельный режим запуска, не дополнение к partial / merge
+        const auto toml = GENERATE(as<std::string>{},
+            "shard_mode = 'partial'\n",
+            "shard_mode = 'merge'\nshard_inputs = ['a.part']\n");
+
+        temp_toml cfg{
+            "[main]\n"
+            "input = './data'\n"
+            "median_backend = 'tdigest'\n"
+            "shard_prefix = 'p.part'\n" + toml
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err == std::errc::invalid_argument);
+    }
+
+    SECTION("input is required outside merge") {
+        temp_toml cfg{
+            "[main]\n"
+            "median_backend = 'tdigest'\n"
+            "shard_mode = 'partial'\n"
+        };
+
+        fake_argv args{ {"app", "--config", cfg.str()} };
+        config_parser parser;
+        auto [config, err] = parser.parse(args.argc(), args.argv());
+
+        CHECK(err);
+    }
+}
@@ -0,0 +1,333 @@
+/**
+ * \file test_partition.cpp
+ * \brief Unit-тесты для ts_index, диапазонов чтения и расчёта участками
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "partition.hpp"
+#include "skiplist.hpp"
+
+using csv_median::csv_reader;
+using csv_median::read_mode;
+using csv_median::thread_pool;
+using csv_median::time_partition;
+using csv_median::ts_index;
+using csv_median::ts_range;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    struct temp_dir {
+        fs::path path;
+
+        temp_dir() {
+            path = fs::temp_directory_path()
+                / ("csv_partition_test_" + std::to_string(
+                    std::chrono::steady_clock::now().time_since_epoch().count()
+                ));
+            fs::create_directories(path);
+        }
+
+        ~temp_dir() {
+            fs::remove_all(path);
+        }
+
+        fs::path make_file(const std::string& name_, const std::string& content_) const {
+            const auto file_path = path / name_;
+            std::ofstream f{ file_path, std::ios::binary };
+            f << content_;
+            return file_path;
+        }
+    };
+
+    // count_ записей с ts = first_ + i * step_ и пилообразной ценой
+    std::string make_csv(std::uint64_t first_, std::uint64_t step_, std::size_t count_,
+        std::size_t period_ = 7)
+    {
+        std::string out = "receive_ts;exchange_ts;price;quantity;side\n";
+        for (std::size_t i = 0; i < count_; ++i) {
+            const auto ts = first_ + i * step_;
+            out += std::to_string(ts) + ";" + std::to_string(ts - 1) + ";"
+                + std::to_string(100 + i % period_) + "." + std::to_string(i % 10)
+                + ";1.0;bid\n";
+        }
+        return out;
+    }
+
+    /**
+     * \brief Приёмник в память
+     */
+    struct memory_sink {
+        std::vector<std::uint64_t> ts;
+        std::vector<double>        price;
+        fs::path                   file;
+
+        std::error_code open(const fs::path&) { return {}; }
+        std::error_code open(const fs::path&, const std::string&) { return {}; }
+        std::error_code write(std::uint64_t ts_, double price_) {
+            ts.push_back(ts_);
+            price.push_back(price_);
+            return {};
+        }
+        std::error_code write(std::uint64_t ts_, csv_median::fixed_price price_) {
+            return write(ts_, static_cast<double>(price_) / 1e8);
+        }
+        std::error_code close() { return {}; }
+        std::size_t written_count() const { return ts.size(); }
+        const fs::path& path() const { return file; }
+    };
+
+    static_assert(csv_median::result_sink<memory_sink>);
+
+    std::vector<std::uint64_t> read_ts(csv_reader& reader_, const fs::path& dir_) {
+        std::vector<std::uint64_t> ts;
+        const auto err = reader_.process_batches<double>(dir_, { "trade" },
+            [&](std::span<const std::uint64_t> ts_, std::span<const double>) {
+                ts.insert(ts.end(), ts_.begin(), ts_.end());
+            });
+        REQUIRE_FALSE(err);
+        return ts;
+    }
+
+}
+
+TEST_CASE("ts_index - probe и seek_offset", "[partition]") {
+    temp_dir dir;
+    const auto content = make_csv(1000, 10, 500);
+    const auto path = dir.make_file("trade.csv", content);
+
+    ts_index index;
+    REQUIRE_FALSE(index.probe(path, 256));
+    REQUIRE(index.entries().size() > 10);
+    CHECK(index.file_size() == content.size());
+    CHECK(index.last_ts() == 1000 + 499 * 10);
+
+    // Каждая точка — начало строки со своим receive_ts
+    for (const auto& e : index.entries()) {
+        REQUIRE(e.offset > 0);
+        CHECK(content[e.offset - 1] == '\n');
+        CHECK(content.substr(e.offset, content.find(';', e.offset) - e.offset)
+            == std::to_string(e.ts));
+    }
+
+    CHECK(index.seek_offset(0) == 0);
+    CHECK(index.seek_offset(index.entries().front().ts) == 0);
+    const auto& third = index.entries()[2];
+    CHECK(index.seek_offset(third.ts) == index.entries()[1].offset);
+    CHECK(index.seek_offset(third.ts + 1) == third.offset);
+}
+
+TEST_CASE("ts_index - убывающий receive_ts", "[partition]") {
+    temp_dir dir;
+    const auto path = dir.make_file("trade.csv",
+        make_csv(100000, 10, 200) + make_csv(1000, 10, 200).substr(43));
+
+    ts_index index;
+    CHECK(index.probe(path, 256) == std::make_error_code(std::errc::bad_message));
+    CHECK(index.empty());
+}
+
+TEST_CASE("ts_index - build через N записей или M микросекунд", "[partition]") {
+    temp_dir dir;
+    const auto content = make_csv(1000, 10, 1000);
+    const auto path = dir.make_file("trade.csv", content);
+
+    SECTION("по записям") {
+        ts_index index;
+        REQUIRE_FALSE(index.build(path, { 100, 0 }));
+        REQUIRE(index.entries().size() == 10);
+        for (std::size_t i = 0; i < index.entries().size(); ++i) {
+            CHECK(index.entries()[i].ts == 1000 + i * 100 * 10);
+        }
+        CHECK(index.last_ts() == 1000 + 999 * 10);
+    }
+
+    SECTION("по времени") {
+        ts_index index;
+        REQUIRE_FALSE(index.build(path, { 1'000'000, 2500 }));
+        REQUIRE(index.entries().size() == 4);
+        CHECK(index.entries()[1].ts == 3500);
+        CHECK(index.seek_offset(6000) == index.entries()[1].offset);
+    }
+}
+
+TEST_CASE("ts_index - sidecar <имя>.idx", "[partition]") {
+    temp_dir dir;
+    const auto path = dir.make_file("trade.csv", make_csv(1000, 10, 1000));
+    const csv_median::index_options options{ 64, 0 };
+
+    csv_median::cache_source_info source;
+    REQUIRE_FALSE(csv_median::fingerprint(path, source));
+
+    ts_index built;
+    REQUIRE_FALSE(built.build(path, options));
+    const auto sidecar = csv_median::index_path(path);
+    CHECK(sidecar.filename() == "trade.csv.idx");
+    REQUIRE_FALSE(built.save(sidecar, source, options));
+
+    ts_index loaded;
+    REQUIRE_FALSE(loaded.load(sidecar, source, options));
+    REQUIRE(loaded.entries().size() == built.entries().size());
+    for (std::size_t i = 0; i < built.entries().size(); ++i) {
+        CHECK(loaded.entries()[i].offset == built.entries()[i].offset);
+        CHECK(loaded.entries()[i].ts == built.entries()[i].ts);
+    }
+    CHECK(loaded.last_ts() == built.last_ts());
+
+    SECTION("другой шаг") {
+        CHECK(loaded.load(sidecar, source, { 128, 0 })
+            == std::make_error_code(std::errc::bad_message));
+    }
+
+    SECTION("изменённый источник") {
+        auto changed = source;
+        ++changed.mtime_ns;
+        CHECK(loaded.load(sidecar, changed, options)
+            == std::make_error_code(std::errc::bad_message));
+    }
+
+    SECTION("load_indexes строит и сохраняет") {
+        fs::remove(sidecar);
+        thread_pool pool{ 2 };
+        csv_median::index_table table;
+        const std::vector<fs::path> paths{ path };
+        csv_median::load_indexes(pool, paths, options, table);
+        REQUIRE(table.contains(path));
+        CHECK(table[path].entries().size() == built.entries().size());
+        CHECK(fs::exists(sidecar));
+    }
+}
+
+TEST_CASE("reader - set_range со смещением из индекса", "[partition]") {
+    const auto mode = GENERATE(read_mode::stream, read_mode::mmap, read_mode::uring);
+    const bool parallel = GENERATE(false, true);
+
+    temp_dir dir;
+    const auto path = dir.make_file("trade.csv", make_csv(1000, 10, 2000));
+
+    csv_median::index_table table;
+    REQUIRE_FALSE(table[path].probe(path, 1024));
+
+    thread_pool pool{ 2 };
+    csv_reader reader{ pool, mode, parallel };
+
+    std::vector<std::uint64_t> expected;
+    for (std::uint64_t ts = 5005; ts < 12345; ++ts) {
+        if (ts % 10 == 0) {
+            expected.push_back(ts);
+        }
+    }
+
+    SECTION("с индексом") {
+        reader.set_range({ 5005, 12345 }, &table);
+        CHECK(read_ts(reader, dir.path) == expected);
+    }
+
+    SECTION("без индекса") {
+        reader.set_range({ 5005, 12345 });
+        CHECK(read_ts(reader, dir.path) == expected);
+    }
+
+    SECTION("диапазон вне файла") {
+        reader.set_range({ 100000, 200000 }, &table);
+        CHECK(read_ts(reader, dir.path).empty());
+    }
+}
+
+TEST_CASE("split_time_range - границы по объёму", "[partition]") {
+    temp_dir dir;
+    const auto a = dir.make_file("a_trade.csv", make_csv(1000, 10, 1000));
+    const auto b = dir.make_file("b_trade.csv", make_csv(3000, 10, 1000));
+
+    csv_median::index_table table;
+    REQUIRE_FALSE(table[a].probe(a, 512));
+    REQUIRE_FALSE(table[b].probe(b, 512));
+
+    SECTION("один участок") {
+        const auto parts = csv_median::split_time_range(table, 1);
+        REQUIRE(parts.size() == 1);
+        CHECK(parts[0].begin == 0);
+        CHECK(parts[0].end == std::numeric_limits<std::uint64_t>::max());
+    }
+
+    SECTION("несколько участков покрывают всю ось") {
+        const auto parts = csv_median::split_time_range(table, 4);
+        REQUIRE(parts.size() == 4);
+        CHECK(parts.front().begin == 0);
+        CHECK(parts.back().end == std::numeric_limits<std::uint64_t>::max());
+        for (std::size_t i = 1; i < parts.size(); ++i) {
+            CHECK(parts[i].begin == parts[i - 1].end);
+            CHECK(parts[i].begin > parts[i - 1].begin);
+        }
+    }
+
+    SECTION("равные ts не разрезаются") {
+        csv_median::index_table flat;
+        const auto c = dir.make_file("c_trade.csv", make_csv(5000, 0, 1000));
+        REQUIRE_FALSE(flat[c].probe(c, 512));
+        CHECK(csv_median::split_time_range(flat, 8).size() == 1);
+    }
+}
+
+TEST_CASE("run_partitions - совпадает со сквозным расчётом", "[partition]") {
+    const std::uint64_t window = GENERATE(25u, 500u, 100000u);
+    const std::size_t count = GENERATE(2u, 5u, 16u);
+
+    temp_dir dir;
+    const auto a = dir.make_file("a_trade.csv", make_csv(1000, 7, 3000, 5));
+    const auto b = dir.make_file("b_trade.csv", make_csv(1003, 11, 2000, 9));
+
+    thread_pool pool{ 3 };
+    using window_calc = csv_median::sliding_window<csv_median::skiplist_calculator<double>>;
+
+    // Сквозной расчёт
+    memory_sink expected;
+    {
+        csv_reader reader{ pool, read_mode::mmap, false };
+        window_calc calc{ window };
+        const auto err = reader.process_batches<double>(dir.path, { "trade" },
+            [&](std::span<const std::uint64_t> ts_, std::span<const double> price_) {
+                for (std::size_t i = 0; i < ts_.size(); ++i) {
+                    calc.add(ts_[i], price_[i]);
+                    if (calc.is_changed()) {
+                        (void)expected.write(ts_[i], calc.median());
+                    }
+                }
+            });
+        REQUIRE_FALSE(err);
+    }
+    REQUIRE(expected.ts.size() > 100);
+
+    csv_median::index_table table;
+    REQUIRE_FALSE(table[a].probe(a, 1024));
+    REQUIRE_FALSE(table[b].probe(b, 1024));
+    const auto parts = csv_median::split_time_range(table, count);
+    REQUIRE(parts.size() > 1);
+
+    memory_sink actual;
+    std::size_t written = 0;
+    const auto err = csv_median::run_partitions<double>(pool, parts, actual, written,
+        [&](const time_partition& part_) {
+            csv_reader reader{ pool, read_mode::mmap, false };
+            window_calc calc{ window };
+            return csv_median::compute_partition(reader, dir.path, { "trade" }, table,
+                part_, window, 0, calc, [] { return false; });
+        });
+    REQUIRE_FALSE(err);
+
+    CHECK(written == actual.ts.size());
+    CHECK(actual.ts == expected.ts);
+    CHECK(actual.price == expected.price);
+}
@@ -5,12 +5,17 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <future>
+#include <mutex>
 #include <numeric>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 
-#include "thread_pool.hpp"
+#include "pool.hpp"
 
 using csv_median::thread_pool;
 
@@ -82,4 +87,149 @@ TEST_CASE("pool - tasks with return values", "[pool]") {
 
     // 0+1+4+9+16+25+36+49+64+81 = 285
     CHECK(sum == 285);
-}
\ No newline at end of file
+}
+TEST_CASE("pool - exception reaches the future", "[pool]") {
+    thread_pool pool{ 2 };
+
+    auto future = pool.submit([]() -> int { throw std::runtime_error{ "boom" }; });
+
+    CHECK_THROWS_AS(future.get(), std::runtime_error);
+}
+
+TEST_CASE("pool - tasks submitted from tasks are stolen", "[pool]") {
+    thread_pool pool{ 4 };
+
+    // Задача раскладывает подзадачи в свою деку. Каждая подзадача ждёт,
+    // пока не начнётся вторая: владелец деки, занятый первой, сам её не
+    // возьмёт — дождаться можно, только если подзадачу перехватил другой поток
+    constexpr int k_children = 8;
+    std::atomic<int> started{ 0 };
+    std::mutex mtx;
+    std::vector<std::thread::id> threads;
+
+    auto outer = pool.submit([&] {
+        std::vector<std::future<void>> inner;
+        for (int i = 0; i < k_children; ++i) {
+            inner.push_back(pool.submit([&] {
+                {
+                    std::lock_guard lock{ mtx };
+                    if (std::find(threads.begin(), threads.end(), std::this_thread::get_id()) == threads.end()) {
+                        threads.push_back(std::this_thread::get_id());
+                    }
+                }
+                started.fetch_add(1, std::memory_order_acq_rel);
+                const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 5 };
+                while (started.load(std::memory_order_acquire) < 2
+                    && std::chrono::steady_clock::now() < deadline) {
+                    std::this_thread::yield();
+                }
+                }));
+        }
+        return inner;
+        });
+
+    for (auto& f : outer.get()) {
+        f.get();
+    }
+
+    CHECK(started.load() == k_children);
+    CHECK(threads.size() > 1);
+}
+
+TEST_CASE("pool - destructor completes queued tasks", "[pool]") {
+    std::atomic<int> counter{ 0 };
+    {
+        thread_pool pool{ 2 };
+        for (int i = 0; i < 500; ++i) {
+            static_cast<void>(pool.submit([&counter] {
+                counter.fetch_add(1, std::memory_order_relaxed);
+                }));
+        }
+    }
+    CHECK(counter.load() == 500);
+}
+
+TEST_CASE("pool - parallel_for visits every index once", "[pool]") {
+    thread_pool pool{ 4 };
+
+    for (const std::size_t count : { std::size_t{ 0 }, std::size_t{ 1 }, std::size_t{ 7 },
+        std::size_t{ 100'000 } })
+    {
+        std::vector<std::atomic<int>> visits(count);
+        pool.parallel_for(count, [&visits](std::size_t i_) {
+            visits[i_].fetch_add(1, std::memory_order_relaxed);
+            });
+
+        std::size_t once = 0;
+        for (const auto& v : visits) {
+            once += (v.load() == 1) ? 1 : 0;
+        }
+        CHECK(once == count);
+    }
+}
+
+TEST_CASE("pool - short parallel_for calls back to back", "[pool]") {
+    thread_pool pool{ 4 };
+
+    // Вызов возвращается, пока последний помощник ещё будит ждущих:
+    // под санитайзером ловит обращение к состоянию прошлого вызова
+    std::size_t total = 0;
+    for (int round = 0; round < 5000; ++round) {
+        std::atomic<std::size_t> sum{ 0 };
+        pool.parallel_for(8, [&sum](std::size_t i_) {
+            sum.fetch_add(i_ + 1, std::memory_order_relaxed);
+            }, 1);
+        total += sum.load();
+    }
+    CHECK(total == 5000 * 36);
+}
+
+TEST_CASE("pool - nested parallel_for inside tasks", "[pool]") {
+    thread_pool pool{ 2 };
+
+    // Все потоки пула заняты внешними задачами, каждая ждёт свой parallel_for
+    std::atomic<std::size_t> sum{ 0 };
+    std::vector<std::future<void>> futures;
+    for (int t = 0; t < 8; ++t) {
+        futures.push_back(pool.submit([&] {
+            pool.parallel_for(1000, [&sum](std::size_t i_) {
+                sum.fetch_add(i_, std::memory_order_relaxed);
+                }, 10);
+            }));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+
+    CHECK(sum.load() == 8 * (999 * 1000 / 2));
+}
+
+TEST_CASE("pool - parallel_for rethrows the first exception", "[pool]") {
+    thread_pool pool{ 3 };
+
+    std::atomic<int> calls{ 0 };
+    CHECK_THROWS_AS(pool.parallel_for(10'000, [&calls](std::size_t i_) {
+        calls.fetch_add(1, std::memory_order_relaxed);
+        if (i_ == 42) {
+            throw std::runtime_error{ "bad index" };
+        }
+        }, 1), std::runtime_error);
+
+    // Раздача остановлена; пул продолжает работать
+    CHECK(calls.load() < 10'000);
+    CHECK(pool.submit([] { return 7; }).get() == 7);
+}
+
+TEST_CASE("pool - pinned threads", "[pool]") {
+    thread_pool pool{ 2, true };
+
+    CHECK(pool.pinned_count() <= pool.thread_count());
+    CHECK(pool.submit([] { return 1; }).get() == 1);
+}
+
+TEST_CASE("pool - cpu list parsing", "[pool]") {
+    CHECK(csv_median::detail::parse_cpu_list("0-3,8,10-11\n")
+        == std::vector<int>{ 0, 1, 2, 3, 8, 10, 11 });
+    CHECK(csv_median::detail::parse_cpu_list("").empty());
+    CHECK_FALSE(csv_median::detail::numa_ordered_cpus().empty());
+}
@@ -0,0 +1,137 @@
+/**
+ * \file test_price.cpp
+ * \brief Unit-тесты для разбора цен в фиксированную точку
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <charconv>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "price.hpp"
+
+using csv_median::fixed_price;
+using csv_median::parse_fixed;
+using csv_median::parse_price;
+
+TEST_CASE("price - fixed point values", "[price]") {
+    fixed_price v = 0;
+
+    REQUIRE(parse_fixed("67960.89108975", v));
+    CHECK(v == 6796089108975);
+
+    REQUIRE(parse_fixed("100", v));
+    CHECK(v == 10000000000);
+
+    REQUIRE(parse_fixed("100.5", v));
+    CHECK(v == 10050000000);
+
+    REQUIRE(parse_fixed("0.00000001", v));
+    CHECK(v == 1);
+
+    REQUIRE(parse_fixed("-1.25", v));
+    CHECK(v == -125000000);
+}
+
+TEST_CASE("price - custom precision", "[price]") {
+    fixed_price v = 0;
+
+    REQUIRE(parse_fixed<2>("68480.10", v));
+    CHECK(v == 6848010);
+
+    CHECK_FALSE(parse_fixed<2>("68480.101", v));
+}
+
+TEST_CASE("price - strict format", "[price]") {
+    fixed_price v = 0;
+
+    CHECK_FALSE(parse_fixed("", v));
+    CHECK_FALSE(parse_fixed("-", v));
+    CHECK_FALSE(parse_fixed(".5", v));
+    CHECK_FALSE(parse_fixed("100.", v));
+    CHECK_FALSE(parse_fixed("not_a_price", v));
+    CHECK_FALSE(parse_fixed("1e5", v));
+    CHECK_FALSE(parse_fixed("100.0000000x", v));
+    CHECK_FALSE(parse_fixed("100.123456789", v));
+    CHECK_FALSE(parse_fixed(" 100.0", v));
+    CHECK_FALSE(parse_fixed("100.0 ", v));
+    CHECK_FALSE(parse_fixed("1234567890123.0", v));
+}
+
+TEST_CASE("price - double matches from_chars", "[price]") {
+    std::mt19937_64 rng{ 7 };
+    std::uniform_int_distribution<std::int64_t> dist{ 0, 10'000'000'000'000 };
+
+    char buf[32];
+    for (int i = 0; i < 100000; ++i) {
+        const auto raw = dist(rng);
+        std::snprintf(buf, sizeof(buf), "%lld.%08lld",
+            static_cast<long long>(raw / 100000000),
+            static_cast<long long>(raw % 100000000));
+
+        const std::string_view text{ buf };
+        double expected = 0.0;
+        std::from_chars(text.data(), text.data() + text.size(), expected);
+
+        double got = 0.0;
+        REQUIRE(parse_price(text, got));
+        CHECK(got == expected);
+
+        fixed_price fixed = 0;
+        REQUIRE(parse_price(text, fixed));
+        CHECK(fixed == raw);
+    }
+}
+
+TEST_CASE("price - format fixed", "[price]") {
+    char buf[32];
+
+    const auto text = [&buf](fixed_price v_) {
+        return std::string{ buf, csv_median::format_fixed(buf, v_) };
+    };
+
+    CHECK(text(6796089108975) == "67960.89108975");
+    CHECK(text(1) == "0.00000001");
+    CHECK(text(10000000000) == "100.00000000");
+    CHECK(text(-125000000) == "-1.25000000");
+}
+
+TEST_CASE("price - midpoint rounds like double", "[price]") {
+    std::mt19937_64 rng{ 11 };
+    std::uniform_int_distribution<std::int64_t> dist{ 6'700'000'000'000, 6'900'000'000'000 };
+
+    char expected[64];
+    char got[32];
+    for (int i = 0; i < 100000; ++i) {
+        const auto a = dist(rng);
+        const auto b = dist(rng);
+
+        const double mid = (static_cast<double>(a) / 1e8
+            + static_cast<double>(b) / 1e8) / 2.0;
+        std::snprintf(expected, sizeof(expected), "%.8f", mid);
+
+        const auto end = csv_median::format_fixed(got,
+            csv_median::fixed_midpoint(a, b));
+        CHECK(std::string_view{ got, static_cast<std::size_t>(end - got) }
+            == std::string_view{ expected });
+    }
+}
+
+TEST_CASE("price - midpoint tie rounds half to even", "[price]") {
+    // Сумма в double — ровно 68637.451171875: {:.8f} даёт чётную восьмую цифру
+    const std::int64_t a = 6863744742187;
+    const std::int64_t b = 6863745492188;
+    const double mid = (static_cast<double>(a) / 1e8 + static_cast<double>(b) / 1e8) / 2.0;
+    REQUIRE(mid == 68637.451171875);
+
+    char expected[64];
+    std::snprintf(expected, sizeof(expected), "%.8f", mid);
+    REQUIRE(std::string_view{ expected } == "68637.45117188");
+
+    char got[32];
+    const auto end = csv_median::format_fixed(got, csv_median::fixed_midpoint(a, b));
+    CHECK(std::string_view{ got, static_cast<std::size_t>(end - got) } == "68637.45117188");
+    CHECK(csv_median::fixed_midpoint(-a, -b) == -csv_median::fixed_midpoint(a, b));
+}
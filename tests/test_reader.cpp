@@ -5,16 +5,22 @@
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_approx.hpp>
+#include <catch2/generators/catch_generators.hpp>
 
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <span>
 #include <string>
+#include <vector>
 
 #include "reader.hpp"
 
 using csv_median::csv_reader;
 using csv_median::csv_record;
+using csv_median::read_mode;
+using csv_median::thread_pool;
 using Catch::Approx;
 
 namespace fs = std::filesystem;
@@ -49,6 +55,29 @@ struct temp_dir {
     }
 };
 
+/**
+ * \brief Читатель для тестов: собирает записи process() в вектор
+ */
+struct collecting_reader {
+    thread_pool pool{ 2 };
+    csv_reader  reader;
+
+    explicit collecting_reader(read_mode mode_ = read_mode::stream,
+        bool parallel_ = false)
+        : reader{ pool, mode_, parallel_ }
+    {
+    }
+
+    std::tuple<std::vector<csv_record>, std::error_code>
+        load(const fs::path& dir_, const std::vector<std::string>& masks_)
+    {
+        std::vector<csv_record> records;
+        const auto err = reader.process(dir_, masks_,
+            [&records](const csv_record& rec_) { records.push_back(rec_); });
+        return { std::move(records), err };
+    }
+};
+
 TEST_CASE("reader - read trade.csv", "[csv]") {
     temp_dir tmp;
     tmp.make_file("trade.csv",
@@ -58,7 +87,7 @@ TEST_CASE("reader - read trade.csv", "[csv]") {
         "3000;2900;102.00000000;3.00000000;bid\n"
     );
 
-    csv_reader reader;
+    collecting_reader reader;
     auto [records, err] = reader.load(tmp.path, {});
 
     REQUIRE_FALSE(err);
@@ -82,7 +111,7 @@ TEST_CASE("reader - read level.csv", "[csv]") {
         "1000;900;68479.90000000;0.50000000;bid;0\n"
     );
 
-    csv_reader reader;
+    collecting_reader reader;
     auto [records, err] = reader.load(tmp.path, {});
 
     REQUIRE_FALSE(err);
@@ -91,24 +120,31 @@ TEST_CASE("reader - read level.csv", "[csv]") {
     CHECK(records[1].price == Approx(68479.9));
 }
 
-TEST_CASE("reader - sort receive_ts", "[csv]") {
+TEST_CASE("reader - records keep file order", "[csv]") {
+    // Файл должен быть упорядочен по receive_ts: слияние не сортирует
+    // записи внутри файла, а чередует файлы по текущим записям
     temp_dir tmp;
     tmp.make_file("trade.csv",
         "receive_ts;exchange_ts;price;quantity;side\n"
         "3000;2900;103.00000000;1.00000000;bid\n"
         "1000;900;101.00000000;1.00000000;bid\n"
-        "2000;1900;102.00000000;1.00000000;ask\n"
+    );
+    tmp.make_file("level.csv",
+        "receive_ts;exchange_ts;price;quantity;side;rebuild\n"
+        "2000;1900;102.00000000;1.00000000;ask;1\n"
+        "4000;3900;104.00000000;1.00000000;ask;0\n"
     );
 
-    csv_reader reader;
+    collecting_reader reader;
     auto [records, err] = reader.load(tmp.path, {});
 
     REQUIRE_FALSE(err);
-    REQUIRE(records.size() == 3);
+    REQUIRE(records.size() == 4);
 
-    CHECK(records[0].receive_ts == 1000);
-    CHECK(records[1].receive_ts == 2000);
-    CHECK(records[2].receive_ts == 3000);
+    CHECK(records[0].receive_ts == 2000);
+    CHECK(records[1].receive_ts == 3000);
+    CHECK(records[2].receive_ts == 1000);
+    CHECK(records[3].receive_ts == 4000);
 }
 
 TEST_CASE("reader - merge multiple files", "[csv]") {
@@ -124,7 +160,7 @@ TEST_CASE("reader - merge multiple files", "[csv]") {
         "4000;3900;400.00000000;1.00000000;ask;0\n"
     );
 
-    csv_reader reader;
+    collecting_reader reader;
     auto [records, err] = reader.load(tmp.path, {});
 
     REQUIRE_FALSE(err);
@@ -151,7 +187,7 @@ TEST_CASE("csv_reader - filter by filename_mask", "[csv]") {
         "3000;2900;300.00000000;1.00000000;bid\n"
     );
 
-    csv_reader reader;
+    collecting_reader reader;
 
     SECTION("'trade'") {
         auto [records, err] = reader.load(tmp.path, { "trade" });
@@ -177,7 +213,7 @@ TEST_CASE("reader - empty file", "[csv]") {
     temp_dir tmp;
     tmp.make_file("trade.csv", "");
 
-    csv_reader reader;
+    collecting_reader reader;
     auto [records, err] = reader.load(tmp.path, {});
 
     CHECK_FALSE(err);
@@ -190,7 +226,7 @@ TEST_CASE("csv_reader - only header", "[csv]") {
         "receive_ts;exchange_ts;price;quantity;side\n"
     );
 
-    csv_reader reader;
+    collecting_reader reader;
     auto [records, err] = reader.load(tmp.path, {});
 
     CHECK_FALSE(err);
@@ -207,7 +243,7 @@ TEST_CASE("reader - wrong value rows are skipped", "[csv]") {
         "3000;2900;102.00000000;1.00000000;bid\n"
     );
 
-    csv_reader reader;
+    collecting_reader reader;
     auto [records, err] = reader.load(tmp.path, {});
 
     CHECK_FALSE(err);
@@ -217,7 +253,7 @@ TEST_CASE("reader - wrong value rows are skipped", "[csv]") {
 }
 
 TEST_CASE("reader - dir is not exist", "[csv]") {
-    csv_reader reader;
+    collecting_reader reader;
     auto [records, err] = reader.load("/nonexistent/path/to/dir", {});
 
     CHECK(err);
@@ -228,7 +264,7 @@ TEST_CASE("reader - dir without .csv", "[csv]") {
     temp_dir tmp;
     tmp.make_file("readme.txt", "some text");
 
-    csv_reader reader;
+    collecting_reader reader;
     auto [records, err] = reader.load(tmp.path, {});
 
     CHECK_FALSE(err);
@@ -246,7 +282,7 @@ TEST_CASE("reader - parallel reading correctness", "[csv]") {
         );
     }
 
-    csv_reader reader;
+    collecting_reader reader;
     auto [records, err] = reader.load(tmp.path, {});
 
     REQUIRE_FALSE(err);
@@ -272,7 +308,7 @@ TEST_CASE("reader - kway merge interleaved timestamps", "[csv]") {
         "6000;900;105.0;1.0;ask\n"
     );
 
-    csv_reader reader;
+    collecting_reader reader;
     auto [records, err] = reader.load(tmp.path, {});
 
     REQUIRE_FALSE(err);
@@ -284,4 +320,292 @@ TEST_CASE("reader - kway merge interleaved timestamps", "[csv]") {
     CHECK(records[3].receive_ts == 4000);
     CHECK(records[4].receive_ts == 5000);
     CHECK(records[5].receive_ts == 6000);
-}
\ No newline at end of file
+}
+
+TEST_CASE("reader - mmap mode matches stream", "[csv]") {
+    temp_dir tmp;
+    tmp.make_file("trade_a.csv",
+        "receive_ts;exchange_ts;price;quantity;side\n"
+        "1000;900;100.0;1.0;bid\n"
+        "\n"
+        "3000;900;102.0;1.0;bid\n"
+        "bad;900;102.0;1.0;bid\n"
+    );
+    tmp.make_file("level_b.csv",
+        "receive_ts;exchange_ts;price;quantity;side;rebuild\n"
+        "2000;900;101.0;1.0;ask;1\n"
+        "4000;900;103.0;1.0;ask;0"
+    );
+
+    collecting_reader stream_reader{ read_mode::stream };
+    collecting_reader mmap_reader{ read_mode::mmap };
+
+    auto [expected, stream_err] = stream_reader.load(tmp.path, {});
+    auto [records, mmap_err] = mmap_reader.load(tmp.path, {});
+
+    REQUIRE_FALSE(stream_err);
+    REQUIRE_FALSE(mmap_err);
+    REQUIRE(records.size() == 4);
+    REQUIRE(records.size() == expected.size());
+
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        CHECK(records[i].receive_ts == expected[i].receive_ts);
+        CHECK(records[i].price == expected[i].price);
+    }
+    // последняя строка без '\n' тоже читается
+    CHECK(records[3].receive_ts == 4000);
+}
+
+TEST_CASE("reader - mmap mode empty file", "[csv]") {
+    temp_dir tmp;
+    tmp.make_file("trade.csv", "");
+
+    collecting_reader reader{ read_mode::mmap };
+    auto [records, err] = reader.load(tmp.path, {});
+
+    CHECK_FALSE(err);
+    CHECK(records.empty());
+}
+
+TEST_CASE("reader - line longer than read block", "[csv]") {
+    temp_dir tmp;
+    const std::string long_side(csv_median::k_read_buffer_size * 2, 'x');
+    tmp.make_file("trade.csv",
+        "receive_ts;exchange_ts;price;quantity;side\n"
+        "1000;900;100.0;1.0;" + long_side + "\n"
+        "2000;900;101.0;1.0;bid\n"
+    );
+
+    for (const auto mode : { read_mode::stream, read_mode::mmap, read_mode::uring }) {
+        collecting_reader reader{ mode };
+        auto [records, err] = reader.load(tmp.path, {});
+
+        REQUIRE_FALSE(err);
+        REQUIRE(records.size() == 2);
+        CHECK(records[0].receive_ts == 1000);
+        CHECK(records[1].price == Approx(101.0));
+    }
+}
+
+TEST_CASE("reader - parallel parse matches sequential", "[csv]") {
+    temp_dir tmp;
+
+    // Несколько фрагментов k_parse_chunk_size: границы попадают внутрь строк
+    std::string trade = "receive_ts;exchange_ts;price;quantity;side\r\n";
+    std::string level = "receive_ts;exchange_ts;price;quantity;side;rebuild\n";
+    std::uint64_t ts = 1'000'000;
+    while (trade.size() < csv_median::k_parse_chunk_size * 2 + 12345) {
+        trade += std::to_string(ts) + ";900;" + std::to_string(100 + ts % 97)
+            + ".12345678;1.0;bid\r\n";
+        if (ts % 7 == 0) {
+            level += std::to_string(ts) + ";900;" + std::to_string(200 + ts % 13)
+                + ".5;1.0;ask;0\n";
+        }
+        if (ts % 50000 == 0) {
+            trade += "bad;900;1.0;1.0;bid\r\n\r\n";
+        }
+        ts += 3;
+    }
+    level += std::to_string(ts) + ";900;1.0;1.0;ask;0"; // без '\n' в конце
+    tmp.make_file("trade.csv", trade);
+    tmp.make_file("level.csv", level);
+
+    collecting_reader sequential;
+    auto [expected, seq_err] = sequential.load(tmp.path, {});
+    REQUIRE_FALSE(seq_err);
+
+    for (const auto mode : { read_mode::stream, read_mode::mmap, read_mode::uring }) {
+        collecting_reader parallel{ mode, true };
+        auto [records, err] = parallel.load(tmp.path, {});
+
+        REQUIRE_FALSE(err);
+        REQUIRE(records.size() == expected.size());
+        for (std::size_t i = 0; i < records.size(); ++i) {
+            REQUIRE(records[i].receive_ts == expected[i].receive_ts);
+            REQUIRE(records[i].price == expected[i].price);
+        }
+    }
+}
+
+TEST_CASE("reader - parallel parse small and long-line files", "[csv]") {
+    temp_dir tmp;
+    const std::string long_side(csv_median::k_parse_chunk_size + 100, 'x');
+    tmp.make_file("trade.csv",
+        "receive_ts;exchange_ts;price;quantity;side\n"
+        "1000;900;100.0;1.0;" + long_side + "\n"
+        "2000;900;101.0;1.0;bid\n"
+    );
+    tmp.make_file("level.csv",
+        "receive_ts;exchange_ts;price;quantity;side;rebuild\n"
+    );
+
+    for (const auto mode : { read_mode::stream, read_mode::mmap, read_mode::uring }) {
+        collecting_reader reader{ mode, true };
+        auto [records, err] = reader.load(tmp.path, {});
+
+        REQUIRE_FALSE(err);
+        REQUIRE(records.size() == 2);
+        CHECK(records[0].receive_ts == 1000);
+        CHECK(records[1].price == Approx(101.0));
+    }
+}
+
+TEST_CASE("reader - batches are runs of one file in merge order", "[csv]") {
+    temp_dir tmp;
+    tmp.make_file("trade_a.csv",
+        "receive_ts;exchange_ts;price;quantity;side\n"
+        "1000;900;100.0;1.0;bid\n"
+        "2000;900;101.0;1.0;bid\n"
+        "3000;900;102.0;1.0;bid\n"
+        "7000;900;106.0;1.0;bid\n"
+    );
+    tmp.make_file("trade_b.csv",
+        "receive_ts;exchange_ts;price;quantity;side\n"
+        "3000;900;103.0;1.0;ask\n"
+        "5000;900;104.0;1.0;ask\n"
+        "8000;900;107.0;1.0;ask\n"
+    );
+
+    thread_pool pool{ 2 };
+    csv_reader reader{ pool };
+    std::vector<std::vector<std::uint64_t>> batches;
+    std::vector<double> prices;
+    const auto err = reader.process_batches(tmp.path, {},
+        [&](std::span<const std::uint64_t> ts_, std::span<const double> price_) {
+            REQUIRE(ts_.size() == price_.size());
+            batches.emplace_back(ts_.begin(), ts_.end());
+            prices.insert(prices.end(), price_.begin(), price_.end());
+        });
+
+    REQUIRE_FALSE(err);
+    // При равных receive_ts первым идёт файл, раньше в порядке имён
+    const std::vector<std::vector<std::uint64_t>> expected{
+        { 1000, 2000, 3000 }, { 3000, 5000 }, { 7000 }, { 8000 } };
+    CHECK(batches == expected);
+    CHECK(prices == std::vector<double>{ 100.0, 101.0, 102.0, 103.0, 104.0, 106.0, 107.0 });
+}
+
+TEST_CASE("reader - per-record lambda with fixed prices", "[csv]") {
+    temp_dir tmp;
+    tmp.make_file("trade.csv",
+        "receive_ts;exchange_ts;price;quantity;side\n"
+        "1000;900;100.5;1.0;bid\n"
+        "2000;900;0.00000001;1.0;bid\n"
+    );
+
+    thread_pool pool{ 2 };
+    csv_reader reader{ pool };
+    std::vector<csv_median::fixed_record> records;
+    const auto err = reader.process<csv_median::fixed_price>(tmp.path, {},
+        [&records](const csv_median::fixed_record& rec_) { records.push_back(rec_); });
+
+    REQUIRE_FALSE(err);
+    REQUIRE(records.size() == 2);
+    CHECK(records[0].price == 10'050'000'000);
+    CHECK(records[1].price == 1);
+}
+
+TEST_CASE("reader - group keys in batch_view", "[csv]") {
+    temp_dir tmp;
+    tmp.make_file("level.csv",
+        "receive_ts;exchange_ts;price;quantity;side;rebuild\n"
+        "1000;900;100.0;1.0;bid;1\n"
+        "4000;900;101.0;1.0;ask;0\n"
+    );
+    tmp.make_file("trade.csv",
+        "receive_ts;exchange_ts;price;quantity;side\n"
+        "2000;900;102.0;1.0;ask\n"
+        "3000;900;103.0;1.0;bid\n"
+    );
+
+    const auto mode = GENERATE(read_mode::stream, read_mode::mmap);
+    const bool parallel = GENERATE(false, true);
+    thread_pool pool{ 2 };
+    csv_reader reader{ pool, mode, parallel };
+
+    std::vector<std::uint64_t> ts;
+    std::vector<std::uint64_t> groups;
+    const auto collect = [&](const csv_median::batch_view<double>& batch_) {
+        REQUIRE(batch_.group.size() == batch_.ts.size());
+        ts.insert(ts.end(), batch_.ts.begin(), batch_.ts.end());
+        groups.insert(groups.end(), batch_.group.begin(), batch_.group.end());
+    };
+
+    SECTION("by column") {
+        reader.set_groups(csv_median::group_mode::column, "side");
+        REQUIRE_FALSE(reader.process_batches(tmp.path, { "level", "trade" }, collect));
+
+        CHECK(ts == std::vector<std::uint64_t>{ 1000, 2000, 3000, 4000 });
+        const auto bid = csv_median::group_key("bid");
+        const auto ask = csv_median::group_key("ask");
+        CHECK(groups == std::vector<std::uint64_t>{ bid, ask, bid, ask });
+    }
+
+    SECTION("by filename mask") {
+        reader.set_groups(csv_median::group_mode::mask);
+        REQUIRE_FALSE(reader.process_batches(tmp.path, { "level", "trade" }, collect));
+
+        CHECK(ts == std::vector<std::uint64_t>{ 1000, 2000, 3000, 4000 });
+        const auto level = csv_median::group_key("level");
+        const auto trade = csv_median::group_key("trade");
+        CHECK(groups == std::vector<std::uint64_t>{ level, trade, trade, level });
+    }
+
+    SECTION("missing group column skips the file") {
+        reader.set_groups(csv_median::group_mode::column, "venue");
+        REQUIRE_FALSE(reader.process_batches(tmp.path, { "level", "trade" }, collect));
+        CHECK(ts.empty());
+    }
+
+    SECTION("without groups the view has no keys") {
+        std::size_t records = 0;
+        REQUIRE_FALSE(reader.process_batches(tmp.path, { "level", "trade" },
+            [&](const csv_median::batch_view<double>& batch_) {
+                CHECK(batch_.group.empty());
+                records += batch_.ts.size();
+            }));
+        CHECK(records == 4);
+    }
+}
+
+TEST_CASE("reader - quantity column in batch_view", "[csv]") {
+    temp_dir tmp;
+    tmp.make_file("level.csv",
+        "receive_ts;exchange_ts;price;quantity;side;rebuild\n"
+        "1000;900;100.0;1.5;bid;1\n"
+        "4000;900;101.0;x;ask;0\n"
+        "5000;900;101.0;0.25;ask;0\n"
+    );
+    tmp.make_file("trade.csv",
+        "receive_ts;exchange_ts;price;quantity;side\n"
+        "2000;900;102.0;2.0;ask\n"
+        "3000;900;103.0;3.00000001;bid\n"
+    );
+
+    const auto mode = GENERATE(read_mode::stream, read_mode::mmap);
+    const bool parallel = GENERATE(false, true);
+    thread_pool pool{ 2 };
+    csv_reader reader{ pool, mode, parallel };
+
+    std::vector<std::uint64_t> ts;
+    std::vector<double> quantity;
+    const auto collect = [&](const csv_median::batch_view<double>& batch_) {
+        quantity.insert(quantity.end(), batch_.quantity.begin(), batch_.quantity.end());
+        ts.insert(ts.end(), batch_.ts.begin(), batch_.ts.end());
+    };
+
+    SECTION("requested") {
+        reader.set_quantity(true);
+        REQUIRE_FALSE(reader.process_batches(tmp.path, {}, collect));
+
+        // Строка с неверным объёмом пропускается целиком
+        CHECK(ts == std::vector<std::uint64_t>{ 1000, 2000, 3000, 5000 });
+        CHECK(quantity == std::vector<double>{ 1.5, 2.0, 3.00000001, 0.25 });
+    }
+
+    SECTION("not requested") {
+        REQUIRE_FALSE(reader.process_batches(tmp.path, {}, collect));
+        CHECK(ts.size() == 5);
+        CHECK(quantity.empty());
+    }
+}
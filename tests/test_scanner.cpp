@@ -0,0 +1,158 @@
+/**
+ * \file test_scanner.cpp
+ * \brief Unit-тесты для line_scanner
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "scanner.hpp"
+
+using csv_median::line_fields;
+using csv_median::line_scanner;
+
+namespace {
+
+    std::string_view field(std::string_view data_, const line_fields& line_,
+        std::size_t idx_)
+    {
+        const auto& f = line_.fields[idx_];
+        return data_.substr(f.offset, f.size);
+    }
+
+    std::vector<line_fields> scan_all(std::string_view data_,
+        const line_scanner& scanner_, bool final_ = true)
+    {
+        std::vector<line_fields> out;
+        std::size_t lines = 0;
+        static_cast<void>(scanner_.scan(data_, final_, out, lines));
+        return out;
+    }
+
+}
+
+TEST_CASE("scanner - fields of requested columns", "[scanner]") {
+    const int columns[] = { 0, 2 };
+    line_scanner scanner{ columns };
+
+    const std::string data =
+        "1000;900;100.5;1.0;bid\n"
+        "2000;1900;101.25;2.0;ask\n";
+
+    const auto lines = scan_all(data, scanner);
+
+    REQUIRE(lines.size() == 2);
+    CHECK(field(data, lines[0], 0) == "1000");
+    CHECK(field(data, lines[0], 1) == "100.5");
+    CHECK(field(data, lines[1], 0) == "2000");
+    CHECK(field(data, lines[1], 1) == "101.25");
+    CHECK(lines[1].line == 1);
+}
+
+TEST_CASE("scanner - column order follows request", "[scanner]") {
+    const int columns[] = { 2, 0 };
+    line_scanner scanner{ columns };
+
+    const std::string data = "a;b;c;d\n";
+    const auto lines = scan_all(data, scanner);
+
+    REQUIRE(lines.size() == 1);
+    CHECK(field(data, lines[0], 0) == "c");
+    CHECK(field(data, lines[0], 1) == "a");
+}
+
+TEST_CASE("scanner - partial last line", "[scanner]") {
+    const int columns[] = { 0, 1 };
+    line_scanner scanner{ columns };
+
+    const std::string data = "1;2\n3;4\n5;6";
+    std::vector<line_fields> out;
+    std::size_t lines = 0;
+
+    SECTION("not final - tail is left") {
+        const auto consumed = scanner.scan(data, false, out, lines);
+        CHECK(consumed == 8);
+        CHECK(lines == 2);
+        CHECK(out.size() == 2);
+    }
+
+    SECTION("final - tail is a line") {
+        const auto consumed = scanner.scan(data, true, out, lines);
+        CHECK(consumed == data.size());
+        CHECK(lines == 3);
+        REQUIRE(out.size() == 3);
+        CHECK(field(data, out[2], 1) == "6");
+    }
+}
+
+TEST_CASE("scanner - empty lines, CRLF and missing columns", "[scanner]") {
+    const int columns[] = { 0, 2 };
+    line_scanner scanner{ columns };
+
+    const std::string data = "\n1;2;3\r\n\r\n4;5\n";
+    std::vector<line_fields> out;
+    std::size_t lines = 0;
+    static_cast<void>(scanner.scan(data, true, out, lines));
+
+    CHECK(lines == 4);
+    REQUIRE(out.size() == 2);
+    CHECK(out[0].line == 1);
+    CHECK(field(data, out[0], 1) == "3");
+    CHECK(out[1].line == 3);
+    CHECK(field(data, out[1], 0) == "4");
+    CHECK(out[1].fields[1].size == 0);
+}
+
+TEST_CASE("scanner - lines across 64-byte blocks", "[scanner]") {
+    const int columns[] = { 0, 3 };
+    line_scanner scanner{ columns };
+
+    std::string data;
+    for (int i = 0; i < 50; ++i) {
+        data += std::to_string(i) + ";" + std::string(static_cast<std::size_t>(i * 7), 'x')
+            + ";z;" + std::to_string(i * 3) + ";tail;more\n";
+    }
+
+    const auto lines = scan_all(data, scanner);
+
+    REQUIRE(lines.size() == 50);
+    for (int i = 0; i < 50; ++i) {
+        const auto& line = lines[static_cast<std::size_t>(i)];
+        CHECK(field(data, line, 0) == std::to_string(i));
+        CHECK(field(data, line, 1) == std::to_string(i * 3));
+    }
+}
+
+TEST_CASE("scanner - all kernels agree with scalar", "[scanner]") {
+    using namespace csv_median::detail;
+
+    std::vector<masks_fn> kernels;
+#if defined(CSV_MEDIAN_SCANNER_X86)
+    if (__builtin_cpu_supports("sse4.2")) { kernels.push_back(&masks_sse42); }
+    if (__builtin_cpu_supports("avx2")) { kernels.push_back(&masks_avx2); }
+    if (__builtin_cpu_supports("avx512bw")) { kernels.push_back(&masks_avx512); }
+#elif defined(CSV_MEDIAN_SCANNER_NEON)
+    kernels.push_back(&masks_neon);
+#endif
+
+    std::mt19937 rng{ 42 };
+    std::uniform_int_distribution<int> pick{ 0, 9 };
+    std::string block(64, ' ');
+
+    for (int round = 0; round < 1000; ++round) {
+        for (auto& c : block) {
+            const int v = pick(rng);
+            c = v == 0 ? ';' : v == 1 ? '\n' : static_cast<char>('0' + v);
+        }
+        const auto expected = masks_scalar(block.data());
+        for (const auto kernel : kernels) {
+            const auto got = kernel(block.data());
+            CHECK(got.delim == expected.delim);
+            CHECK(got.newline == expected.newline);
+        }
+    }
+}
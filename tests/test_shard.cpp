@@ -0,0 +1,182 @@
+/**
+ * \file test_shard.cpp
+ * \brief Unit-тесты для файлов частей и их слияния
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "histogram.hpp"
+#include "median.hpp"
+#include "shard.hpp"
+
+using csv_median::fixed_price;
+using csv_median::histogram_calculator;
+using csv_median::shard_state;
+using csv_median::state_reader;
+using csv_median::state_writer;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    struct temp_dir {
+        fs::path path;
+
+        temp_dir() {
+            path = fs::temp_directory_path()
+                / ("csv_shard_test_" + std::to_string(
+                    std::chrono::steady_clock::now().time_since_epoch().count()));
+            fs::create_directories(path);
+        }
+
+        ~temp_dir() {
+            fs::remove_all(path);
+        }
+    };
+
+    std::string read_file(const fs::path& path_) {
+        std::ifstream f{ path_, std::ios::binary };
+        return { std::istreambuf_iterator<char>{ f }, std::istreambuf_iterator<char>{} };
+    }
+
+    void write_file(const fs::path& path_, const std::string& content_) {
+        std::ofstream f{ path_, std::ios::binary };
+        f << content_;
+    }
+
+    /**
+     * \brief Часть с диапазоном [first_ts_, last_ts_] и снимком calc_
+     */
+    shard_state make_shard(histogram_calculator<fixed_price>& calc_,
+        std::uint64_t first_ts_, std::uint64_t last_ts_)
+    {
+        state_writer out;
+        calc_.save(out);
+        const auto bytes = out.data();
+        return { 7, calc_.engine().size(), first_ts_, last_ts_, {}, { bytes.begin(), bytes.end() } };
+    }
+
+}
+
+TEST_CASE("shard - file round trip and corruption", "[shard]") {
+    temp_dir tmp;
+    const auto path = csv_median::shard_path(tmp.path);
+    CHECK(path.filename() == "median_result.part");
+    CHECK(csv_median::shard_prefix_path(tmp.path, 3).filename() == "median_result.prefix_3.part");
+
+    shard_state saved;
+    saved.signature = 0x1234;
+    saved.records = 1'000'000;
+    saved.first_ts = 1716810808000304;
+    saved.last_ts = 1716811147336120;
+    saved.files.push_back({ tmp.path / "trade.csv", { 100, 200, 300 } });
+    saved.state = { 1, 2, 3, 250 };
+    REQUIRE_FALSE(csv_median::save_shard(path, saved));
+    CHECK_FALSE(fs::exists(path.string() + ".tmp"));
+
+    shard_state loaded;
+    REQUIRE_FALSE(csv_median::load_shard(path, loaded));
+    CHECK(loaded.signature == saved.signature);
+    CHECK(loaded.records == saved.records);
+    CHECK(loaded.first_ts == saved.first_ts);
+    CHECK(loaded.last_ts == saved.last_ts);
+    REQUIRE(loaded.files.size() == 1);
+    CHECK(loaded.files[0].path == saved.files[0].path);
+    CHECK(loaded.files[0].source == saved.files[0].source);
+    CHECK(loaded.state == saved.state);
+
+    auto bytes = read_file(path);
+    bytes[bytes.size() / 2] = static_cast<char>(bytes[bytes.size() / 2] ^ 1);
+    write_file(path, bytes);
+    CHECK(csv_median::load_shard(path, loaded) == std::errc::bad_message);
+
+    // Контрольная точка — не часть, хотя хэш у неё верный
+    csv_median::checkpoint other;
+    REQUIRE_FALSE(csv_median::save_checkpoint(path, other));
+    CHECK(csv_median::load_shard(path, loaded) == std::errc::bad_message);
+
+    CHECK(csv_median::load_shard(tmp.path / "missing.part", loaded));
+}
+
+TEST_CASE("shard - order and merge", "[shard]") {
+    const auto make = [] { return histogram_calculator<fixed_price>{}; };
+    std::mt19937 rng{ 41 };
+    std::uniform_int_distribution<fixed_price> value{ 1000, 3000 };
+
+    // Три узла по диапазонам receive_ts и сквозной расчёт для сверки
+    histogram_calculator<fixed_price> sequential;
+    std::vector<fixed_price> boundary;
+    std::vector<shard_state> shards;
+    for (std::uint64_t part = 0; part < 3; ++part) {
+        auto calc = make();
+        for (int i = 0; i < 1000; ++i) {
+            const fixed_price v = value(rng);
+            calc.add(v);
+            sequential.add(v);
+        }
+        boundary.push_back(sequential.median());
+        shards.push_back(make_shard(calc, part * 100, part * 100 + 99));
+    }
+    // Пустой узел и обратный порядок файлов
+    auto empty = make();
+    shards.push_back(make_shard(empty, 0, 0));
+    std::swap(shards[0], shards[2]);
+
+    REQUIRE_FALSE(csv_median::order_shards(shards));
+    REQUIRE(shards.size() == 3);
+    CHECK(shards[0].first_ts == 0);
+    CHECK(shards[2].first_ts == 200);
+
+    SECTION("median after each shard matches one pass") {
+        std::vector<fixed_price> medians;
+        std::vector<std::uint64_t> prefix_sizes;
+        REQUIRE_FALSE(csv_median::merge_shards(shards, make,
+            [&](std::size_t index_, const shard_state&, histogram_calculator<fixed_price>& calc_) {
+                medians.push_back(calc_.median());
+                prefix_sizes.push_back(calc_.engine().size());
+                CHECK(index_ + 1 == medians.size());
+                return std::error_code{};
+            }));
+        CHECK(medians == boundary);
+        CHECK(prefix_sizes == std::vector<std::uint64_t>{ 1000, 2000, 3000 });
+    }
+
+    SECTION("callback error stops the merge") {
+        std::size_t calls = 0;
+        const auto err = csv_median::merge_shards(shards, make,
+            [&](std::size_t, const shard_state&, histogram_calculator<fixed_price>&) {
+                ++calls;
+                return std::make_error_code(std::errc::io_error);
+            });
+        CHECK(err == std::errc::io_error);
+        CHECK(calls == 1);
+    }
+
+    SECTION("corrupt state") {
+        shards[1].state.resize(3);
+        CHECK(csv_median::merge_shards(shards, make,
+            [](std::size_t, const shard_state&, histogram_calculator<fixed_price>&) {
+                return std::error_code{};
+            }) == std::errc::bad_message);
+    }
+
+    SECTION("overlapping ranges and other signature") {
+        auto overlapping = shards;
+        overlapping[1].last_ts = 250;
+        CHECK(csv_median::order_shards(overlapping) == std::errc::invalid_argument);
+
+        auto mixed = shards;
+        mixed[2].signature = 8;
+        CHECK(csv_median::order_shards(mixed) == std::errc::invalid_argument);
+    }
+}
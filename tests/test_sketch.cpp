@@ -0,0 +1,138 @@
+/**
+ * \file test_sketch.cpp
+ * \brief Unit-тесты для tdigest и sketch_calculator
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "median.hpp"
+#include "sketch.hpp"
+
+using csv_median::tdigest;
+using csv_median::sketch_calculator;
+using Catch::Approx;
+
+namespace {
+
+    // Доля значений строго меньше v_ в отсортированном массиве
+    double rank_of(const std::vector<double>& sorted_, double v_) {
+        const auto it = std::lower_bound(sorted_.begin(), sorted_.end(), v_);
+        return static_cast<double>(it - sorted_.begin())
+            / static_cast<double>(sorted_.size());
+    }
+
+}
+
+TEST_CASE("tdigest - exact while centroids are singletons", "[sketch]") {
+    sketch_calculator<double> sketch;
+    csv_median::calculator exact;
+
+    for (const double v : { 5.0, 1.0, 3.0, 2.0, 4.0, 6.0, 0.5, 7.5 }) {
+        sketch.add(v);
+        exact.add(v);
+        REQUIRE(sketch.median() == Approx(exact.median()));
+    }
+}
+
+TEST_CASE("tdigest - median rank error within bound", "[sketch]") {
+    constexpr double error = 0.01;
+    sketch_calculator<double> sketch{ tdigest<double>{ error } };
+    std::vector<double> values;
+
+    std::mt19937 rng{ 17 };
+    std::lognormal_distribution<double> dist{ 0.0, 1.0 };
+
+    for (int i = 0; i < 200000; ++i) {
+        const double v = 60000.0 + 1000.0 * dist(rng);
+        sketch.add(v);
+        values.push_back(v);
+
+        if (i % 20000 == 19999) {
+            std::vector<double> sorted = values;
+            std::sort(sorted.begin(), sorted.end());
+            CHECK(std::abs(rank_of(sorted, sketch.median()) - 0.5) <= error);
+        }
+    }
+}
+
+TEST_CASE("tdigest - merged parts keep the rank error", "[sketch]") {
+    constexpr double error = 0.01;
+    std::mt19937 rng{ 19 };
+    std::lognormal_distribution<double> dist{ 0.0, 1.0 };
+
+    sketch_calculator<double> merged{ tdigest<double>{ error } };
+    std::vector<double> values;
+
+    // Части с разными распределениями, последняя — меньше буфера
+    for (const auto& [shift, count] : { std::pair{ 60000.0, 50000 },
+        std::pair{ 58000.0, 80000 }, std::pair{ 63000.0, 30000 }, std::pair{ 61000.0, 7 } })
+    {
+        sketch_calculator<double> part{ tdigest<double>{ error } };
+        for (int i = 0; i < count; ++i) {
+            const double v = shift + 1000.0 * dist(rng);
+            part.add(v);
+            values.push_back(v);
+        }
+        merged.merge(part);
+
+        std::vector<double> sorted = values;
+        std::sort(sorted.begin(), sorted.end());
+        REQUIRE(merged.engine().size() == values.size());
+        CHECK(std::abs(rank_of(sorted, merged.median()) - 0.5) <= error);
+        CHECK(merged.engine().centroid_count()
+            <= static_cast<std::size_t>(merged.engine().compression()));
+    }
+
+}
+
+TEST_CASE("tdigest - merge of small parts is exact", "[sketch]") {
+    tdigest<double> a{ 0.01 };
+    tdigest<double> b{ 0.01 };
+    for (const double v : { 5.0, 1.0, 3.0 }) {
+        a.insert(v);
+    }
+    for (const double v : { 2.0, 4.0 }) {
+        b.insert(v);
+    }
+    a.merge(b);
+    a.merge(tdigest<double>{ 0.01 });
+
+    CHECK(a.size() == 5);
+    CHECK(a.middle().first == Approx(3.0));
+    CHECK(a.quantile(0.0) == Approx(1.0));
+    CHECK(a.quantile(1.0) == Approx(5.0));
+}
+
+TEST_CASE("tdigest - memory stays bounded", "[sketch]") {
+    tdigest<double> digest{ 0.01 };
+
+    std::mt19937 rng{ 23 };
+    std::uniform_real_distribution<double> dist{ 0.0, 1.0 };
+
+    for (int i = 0; i < 500000; ++i) {
+        digest.insert(dist(rng));
+    }
+
+    // Число центроидов ограничено компрессией, а не числом значений
+    CHECK(digest.centroid_count() <= static_cast<std::size_t>(digest.compression()));
+    CHECK(digest.size() == 500000);
+    CHECK(digest.quantile(0.5) == Approx(0.5).margin(0.01));
+    CHECK(digest.quantile(0.0) >= 0.0);
+    CHECK(digest.quantile(1.0) <= 1.0);
+}
+
+TEST_CASE("tdigest - fixed point prices", "[sketch]") {
+    sketch_calculator<csv_median::fixed_price> sketch;
+
+    sketch.add(100'00000000);
+    sketch.add(100'00000002);
+    CHECK(sketch.median() == 100'00000001);
+
+    sketch.add(100'00000010);
+    CHECK(sketch.median() == 100'00000002);
+}
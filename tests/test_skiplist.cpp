@@ -0,0 +1,120 @@
+/**
+ * \file test_skiplist.cpp
+ * \brief Unit-тесты для indexable_skiplist и skiplist_calculator
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "median.hpp"
+#include "skiplist.hpp"
+
+using csv_median::indexable_skiplist;
+using Catch::Approx;
+
+TEST_CASE("skiplist - select in sorted order", "[skiplist]") {
+    indexable_skiplist<int> list;
+    for (const int v : { 5, 1, 4, 2, 3 }) {
+        list.insert(v);
+    }
+
+    REQUIRE(list.size() == 5);
+    for (std::size_t i = 0; i < 5; ++i) {
+        CHECK(list.select(i) == static_cast<int>(i) + 1);
+    }
+    CHECK(list.middle() == std::pair{ 3, 3 });
+}
+
+TEST_CASE("skiplist - duplicates and erase", "[skiplist]") {
+    indexable_skiplist<int> list;
+    for (const int v : { 2, 2, 1, 2 }) {
+        list.insert(v);
+    }
+
+    CHECK(list.erase(2));
+    CHECK(list.size() == 3);
+    CHECK_FALSE(list.erase(7));
+    CHECK(list.middle() == std::pair{ 2, 2 });
+
+    CHECK(list.erase(1));
+    CHECK(list.middle() == std::pair{ 2, 2 });
+    CHECK(list.erase(2));
+    CHECK(list.erase(2));
+    CHECK(list.empty());
+    CHECK_FALSE(list.erase(2));
+}
+
+TEST_CASE("skiplist - random operations match multiset", "[skiplist]") {
+    indexable_skiplist<int> list;
+    std::multiset<int> reference;
+
+    std::mt19937 rng{ 3 };
+    std::uniform_int_distribution<int> value{ 0, 500 };
+    std::uniform_int_distribution<int> op{ 0, 2 };
+
+    for (int step = 0; step < 20000; ++step) {
+        const int v = value(rng);
+        if (op(rng) == 0 && !reference.empty()) {
+            const bool expected = reference.count(v) > 0;
+            if (expected) {
+                reference.erase(reference.find(v));
+            }
+            CHECK(list.erase(v) == expected);
+        }
+        else {
+            list.insert(v);
+            reference.insert(v);
+        }
+
+        REQUIRE(list.size() == reference.size());
+        if (!reference.empty() && step % 97 == 0) {
+            std::size_t rank = 0;
+            for (const int expected : reference) {
+                REQUIRE(list.select(rank++) == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("skiplist - calculator matches heap backend", "[skiplist]") {
+    csv_median::calculator heap_calc;
+    csv_median::skiplist_calculator<double> list_calc;
+
+    std::mt19937 rng{ 5 };
+    std::uniform_int_distribution<int> value{ 0, 50 };
+
+    for (int i = 0; i < 2000; ++i) {
+        const double price = 100.0 + value(rng) * 0.5;
+        heap_calc.add(price);
+        list_calc.add(price);
+
+        REQUIRE(list_calc.median() == heap_calc.median());
+        REQUIRE(list_calc.is_changed() == heap_calc.is_changed());
+    }
+}
+
+TEST_CASE("skiplist - calculator remove and quantile", "[skiplist]") {
+    csv_median::skiplist_calculator<double> calc;
+    for (int i = 1; i <= 101; ++i) {
+        calc.add(static_cast<double>(i));
+    }
+
+    CHECK(calc.median() == Approx(51.0));
+    CHECK(calc.quantile(0.0) == Approx(1.0));
+    CHECK(calc.quantile(0.25) == Approx(26.0));
+    CHECK(calc.quantile(1.0) == Approx(101.0));
+
+    CHECK(calc.remove(1.0));
+    CHECK_FALSE(calc.remove(1.0));
+    CHECK(calc.count() == 100);
+
+    // [2..101] + 102 → медиана 52
+    calc.add(102.0);
+    CHECK(calc.median() == Approx(52.0));
+    CHECK(calc.is_changed());
+}
@@ -0,0 +1,59 @@
+/**
+ * \file test_spsc.cpp
+ * \brief Unit-тесты для spsc_ring
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <thread>
+
+#include "spsc.hpp"
+
+using csv_median::spsc_ring;
+
+TEST_CASE("spsc - capacity rounds up to a power of two", "[spsc]") {
+    CHECK(spsc_ring<int>{ 0 }.capacity() == 1);
+    CHECK(spsc_ring<int>{ 3 }.capacity() == 4);
+    CHECK(spsc_ring<int>{ 8 }.capacity() == 8);
+}
+
+TEST_CASE("spsc - try_push and try_pop", "[spsc]") {
+    spsc_ring<int> ring{ 2 };
+    int value = 0;
+
+    CHECK_FALSE(ring.try_pop(value));
+    CHECK(ring.try_push(1));
+    CHECK(ring.try_push(2));
+    CHECK_FALSE(ring.try_push(3));
+
+    REQUIRE(ring.try_pop(value));
+    CHECK(value == 1);
+    CHECK(ring.try_push(3));
+    CHECK(ring.pop() == 2);
+    CHECK(ring.pop() == 3);
+    CHECK_FALSE(ring.try_pop(value));
+}
+
+TEST_CASE("spsc - producer and consumer threads keep order", "[spsc]") {
+    constexpr std::uint64_t count = 200'000;
+    spsc_ring<std::uint64_t> ring{ 4 };
+
+    std::thread producer{ [&ring] {
+        for (std::uint64_t i = 1; i <= count; ++i) {
+            ring.push(i);
+        }
+    } };
+
+    bool ordered = true;
+    std::uint64_t sum = 0;
+    for (std::uint64_t i = 1; i <= count; ++i) {
+        const std::uint64_t value = ring.pop();
+        ordered = ordered && (value == i);
+        sum += value;
+    }
+    producer.join();
+
+    CHECK(ordered);
+    CHECK(sum == count * (count + 1) / 2);
+}
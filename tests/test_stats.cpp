@@ -0,0 +1,196 @@
+/**
+ * \file test_stats.cpp
+ * \brief Unit-тесты для running_moments и statistics_calculator
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "stats.hpp"
+
+using csv_median::running_moments;
+using csv_median::statistic;
+using csv_median::statistic_kind;
+using csv_median::statistics_calculator;
+using Catch::Approx;
+
+namespace {
+
+    struct sample {
+        std::uint64_t ts;
+        double        price;
+        double        quantity;
+    };
+
+    // Статистики значений полным перебором, в порядке stats_
+    std::vector<double> brute_values(const std::vector<sample>& all_,
+        const std::vector<statistic>& stats_)
+    {
+        std::vector<double> prices;
+        double notional = 0.0;
+        double volume = 0.0;
+        for (const auto& s : all_) {
+            prices.push_back(s.price);
+            notional += s.price * s.quantity;
+            volume += s.quantity;
+        }
+        std::ranges::sort(prices);
+        const auto n = static_cast<double>(prices.size());
+        double mean = 0.0;
+        for (const double p : prices) {
+            mean += p;
+        }
+        mean /= n;
+        double sq = 0.0;
+        for (const double p : prices) {
+            sq += (p - mean) * (p - mean);
+        }
+
+        std::vector<double> out;
+        for (const auto& stat : stats_) {
+            switch (stat.kind) {
+            case statistic_kind::quantile: {
+                const double q = static_cast<double>(stat.percent) / 100.0;
+                out.push_back(prices[static_cast<std::size_t>(q * (n - 1) + 0.5)]);
+                break;
+            }
+            case statistic_kind::vwap:   out.push_back(notional / volume); break;
+            case statistic_kind::mean:   out.push_back(mean); break;
+            case statistic_kind::stddev: out.push_back(std::sqrt(sq / n)); break;
+            }
+        }
+        return out;
+    }
+
+    const std::vector<statistic> k_all{
+        { statistic_kind::quantile, 5 }, { statistic_kind::quantile, 25 },
+        { statistic_kind::quantile, 75 }, { statistic_kind::quantile, 95 },
+        { statistic_kind::vwap }, { statistic_kind::mean }, { statistic_kind::stddev } };
+
+}
+
+TEST_CASE("statistic - names round trip", "[stats]") {
+    for (const auto* name : { "p01", "p05", "p50", "p99", "vwap", "mean", "stddev" }) {
+        const auto parsed = csv_median::to_statistic(name);
+        REQUIRE(parsed);
+        CHECK(csv_median::statistic_name(*parsed) == name);
+    }
+    CHECK_FALSE(csv_median::to_statistic("p00"));
+    CHECK_FALSE(csv_median::to_statistic("p100"));
+    CHECK_FALSE(csv_median::to_statistic("median"));
+
+    CHECK(csv_median::uses_quantity(k_all));
+    CHECK_FALSE(csv_median::uses_quantity(std::vector<statistic>{ { statistic_kind::mean } }));
+}
+
+TEST_CASE("running_moments - add and remove", "[stats]") {
+    running_moments m;
+    m.add(1.0, 1.0);
+    m.add(2.0, 3.0);
+    m.add(6.0, 0.0);
+    CHECK(m.count() == 3);
+    CHECK(m.mean() == Approx(3.0));
+    CHECK(m.stddev() == Approx(std::sqrt(14.0 / 3.0)));
+    CHECK(m.vwap() == Approx(7.0 / 4.0));
+
+    m.remove(1.0, 1.0);
+    CHECK(m.mean() == Approx(4.0));
+    CHECK(m.stddev() == Approx(2.0));
+    CHECK(m.vwap() == Approx(2.0));
+
+    m.remove(2.0, 3.0);
+    CHECK(m.stddev() == 0.0);
+    CHECK(std::isnan(m.vwap()));
+
+    m.remove(6.0, 0.0);
+    CHECK(m.count() == 0);
+    CHECK(m.mean() == 0.0);
+}
+
+TEST_CASE("statistics_calculator - совпадает с перебором", "[stats]") {
+    std::mt19937_64 rng{ 7 };
+    std::uniform_int_distribution<int> tick{ 0, 400 };
+    std::uniform_real_distribution<double> qty{ 0.01, 5.0 };
+
+    std::vector<sample> all;
+    std::uint64_t ts = 1000;
+    for (int i = 0; i < 3000; ++i) {
+        ts += static_cast<std::uint64_t>(tick(rng) % 7);
+        all.push_back({ ts, 100.0 + tick(rng) * 0.25, qty(rng) });
+    }
+
+    SECTION("за всё время") {
+        statistics_calculator<csv_median::skiplist_calculator<double>> calc{ 0, k_all };
+        csv_median::skiplist_calculator<double> plain;
+        for (std::size_t i = 0; i < all.size(); ++i) {
+            calc.add(all[i].ts, all[i].price, all[i].quantity);
+            plain.add(all[i].price);
+            REQUIRE(calc.is_changed() == plain.is_changed());
+            REQUIRE(calc.median() == plain.median());
+            if (i % 97 == 0) {
+                const auto expected = brute_values({ all.begin(), all.begin() + i + 1 }, k_all);
+                const auto values = calc.values();
+                REQUIRE(values.size() == expected.size());
+                for (std::size_t k = 0; k < values.size(); ++k) {
+                    CHECK(values[k] == Approx(expected[k]).epsilon(1e-12));
+                }
+            }
+        }
+        CHECK(calc.count() == all.size());
+    }
+
+    SECTION("в окне") {
+        constexpr std::uint64_t width = 150;
+        statistics_calculator<csv_median::skiplist_calculator<double>> calc{ width, k_all };
+        csv_median::sliding_window<csv_median::skiplist_calculator<double>> plain{ width };
+        std::size_t first = 0;
+        for (std::size_t i = 0; i < all.size(); ++i) {
+            calc.add(all[i].ts, all[i].price, all[i].quantity);
+            plain.add(all[i].ts, all[i].price);
+            REQUIRE(calc.is_changed() == plain.is_changed());
+            REQUIRE(calc.median() == plain.median());
+
+            while (all[first].ts + width <= all[i].ts) {
+                ++first;
+            }
+            REQUIRE(calc.count() == i + 1 - first);
+            if (i % 31 == 0) {
+                const auto expected = brute_values(
+                    { all.begin() + static_cast<std::ptrdiff_t>(first),
+                      all.begin() + static_cast<std::ptrdiff_t>(i) + 1 }, k_all);
+                const auto values = calc.values();
+                for (std::size_t k = 0; k < values.size(); ++k) {
+                    CHECK(values[k] == Approx(expected[k]).epsilon(1e-9));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("statistics_calculator - fixed price и histogram", "[stats]") {
+    const std::vector<statistic> stats{ { statistic_kind::quantile, 50 }, { statistic_kind::mean } };
+    using fixed = csv_median::fixed_price;
+
+    statistics_calculator<csv_median::skiplist_calculator<fixed>> skiplist{ 0, stats };
+    statistics_calculator<csv_median::histogram_calculator<fixed>> histogram{ 0, stats,
+        csv_median::histogram_calculator<fixed>{ csv_median::tick_histogram<fixed>{ 1'000'000 } } };
+
+    for (const fixed price : { 10'000'000'000, 10'100'000'000, 9'900'000'000, 10'200'000'000 }) {
+        skiplist.add(1, price, 0.0);
+        histogram.add(1, price, 0.0);
+    }
+    CHECK(skiplist.median() == histogram.median());
+
+    const auto a = skiplist.values();
+    const std::vector<double> from_skiplist(a.begin(), a.end());
+    const auto b = histogram.values();
+    CHECK(from_skiplist == std::vector<double>(b.begin(), b.end()));
+    CHECK(from_skiplist[0] == 101.0);
+    CHECK(from_skiplist[1] == Approx(100.5));
+}
@@ -0,0 +1,151 @@
+/**
+ * \file test_uring.cpp
+ * \brief Unit-тесты для io_ring и uring_file_reader
+ *
+ * Без io_uring в ядре или сборке тесты проверяют только откат.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "uring.hpp"
+
+using csv_median::io_ring;
+using csv_median::uring_file_reader;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    /**
+     * \brief Временный файл с заданным содержимым
+     */
+    struct temp_file {
+        fs::path path;
+
+        explicit temp_file(const std::string& content_) {
+            path = fs::temp_directory_path()
+                / ("uring_test_" + std::to_string(
+                    std::chrono::steady_clock::now().time_since_epoch().count()));
+            std::ofstream f{ path, std::ios::binary };
+            f << content_;
+        }
+
+        ~temp_file() {
+            fs::remove(path);
+        }
+    };
+
+    std::string make_content(std::size_t size_) {
+        std::string content(size_, '\0');
+        for (std::size_t i = 0; i < size_; ++i) {
+            content[i] = static_cast<char>('a' + (i * 7 + i / 4096) % 26);
+        }
+        return content;
+    }
+
+}
+
+TEST_CASE("uring - unsupported build or kernel reports not_supported", "[uring]") {
+    io_ring ring;
+    const auto err = ring.open(4);
+    if (err) {
+        CHECK(err == std::errc::not_supported);
+        CHECK_FALSE(ring.is_open());
+        CHECK_FALSE(csv_median::io_uring_supported());
+    }
+    else {
+        CHECK(ring.is_open());
+        CHECK(csv_median::io_uring_supported());
+    }
+}
+
+TEST_CASE("uring - write and read back by offset", "[uring]") {
+    if (!csv_median::io_uring_supported()) {
+        return;
+    }
+
+    temp_file file{ "" };
+    const int fd = ::open(file.path.c_str(), O_RDWR);
+    REQUIRE(fd >= 0);
+
+    io_ring ring;
+    REQUIRE_FALSE(ring.open(4));
+
+    const std::string first = "hello, ";
+    const std::string second = "io_uring";
+    REQUIRE(ring.queue_write(fd, second.data(), second.size(), first.size(), 2));
+    REQUIRE(ring.queue_write(fd, first.data(), first.size(), 0, 1));
+    REQUIRE_FALSE(ring.submit(2));
+
+    std::vector<std::uint64_t> tags;
+    io_ring::completion done{};
+    while (tags.size() < 2) {
+        if (!ring.pop(done)) {
+            REQUIRE_FALSE(ring.submit(1));
+            continue;
+        }
+        CHECK(done.result > 0);
+        tags.push_back(done.tag);
+    }
+    CHECK((tags[0] + tags[1]) == 3);
+
+    char buf[32] = {};
+    REQUIRE(ring.queue_read(fd, buf, sizeof(buf), 0, 7));
+    REQUIRE_FALSE(ring.submit(1));
+    REQUIRE(ring.pop(done));
+    CHECK(done.tag == 7);
+    REQUIRE(done.result == static_cast<int>(first.size() + second.size()));
+    CHECK(std::string(buf, static_cast<std::size_t>(done.result)) == "hello, io_uring");
+
+    ::close(fd);
+}
+
+TEST_CASE("uring - file reader returns the whole file in order", "[uring]") {
+    if (!csv_median::io_uring_supported()) {
+        return;
+    }
+
+    // Больше depth блоков и с невыровненным хвостом
+    const auto content = make_content(5 * csv_median::k_uring_block_size + 12'345);
+    temp_file file{ content };
+
+    for (const bool direct : { false, true }) {
+        uring_file_reader reader;
+        REQUIRE_FALSE(reader.open(file.path, direct, 2));
+
+        std::string result;
+        std::vector<char> chunk(300'001);
+        std::error_code err;
+        while (const auto n = reader.read(chunk.data(), chunk.size(), err)) {
+            result.append(chunk.data(), n);
+        }
+        CHECK_FALSE(err);
+        CHECK(result.size() == content.size());
+        CHECK(result == content);
+    }
+}
+
+TEST_CASE("uring - file reader on empty file", "[uring]") {
+    if (!csv_median::io_uring_supported()) {
+        return;
+    }
+
+    temp_file file{ "" };
+    uring_file_reader reader;
+    REQUIRE_FALSE(reader.open(file.path, false));
+
+    char buf[16];
+    std::error_code err;
+    CHECK(reader.read(buf, sizeof(buf), err) == 0);
+    CHECK_FALSE(err);
+}
@@ -0,0 +1,130 @@
+/**
+ * \file test_window.cpp
+ * \brief Unit-тесты для ring_buffer и sliding_window
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "window.hpp"
+
+using csv_median::ring_buffer;
+using csv_median::sliding_window;
+using csv_median::skiplist_calculator;
+using Catch::Approx;
+
+namespace {
+
+    // Медиана окна (now - width, now] полным перебором
+    double brute_median(const std::vector<std::pair<std::uint64_t, double>>& all_,
+        std::uint64_t now_, std::uint64_t width_)
+    {
+        std::vector<double> values;
+        for (const auto& [ts, price] : all_) {
+            if (ts + width_ > now_) {
+                values.push_back(price);
+            }
+        }
+        std::sort(values.begin(), values.end());
+        const auto n = values.size();
+        return (n % 2 == 0)
+            ? (values[n / 2 - 1] + values[n / 2]) / 2.0
+            : values[(n - 1) / 2];
+    }
+
+}
+
+TEST_CASE("ring_buffer - FIFO order across growth", "[window]") {
+    ring_buffer<int> ring;
+    int next_in = 0;
+    int next_out = 0;
+
+    // Чередуем вставки и извлечения, чтобы голова не была в нуле при росте
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 50; ++i) {
+            ring.push_back(next_in++);
+        }
+        for (int i = 0; i < 30; ++i) {
+            REQUIRE(ring.front() == next_out++);
+            ring.pop_front();
+        }
+    }
+
+    CHECK(ring.size() == 200);
+    CHECK(ring.capacity() == 256);
+    while (!ring.empty()) {
+        REQUIRE(ring.front() == next_out++);
+        ring.pop_front();
+    }
+    CHECK(next_out == next_in);
+}
+
+TEST_CASE("sliding_window - expires records older than width", "[window]") {
+    sliding_window<skiplist_calculator<double>> window{ 100 };
+
+    window.add(1000, 1.0);
+    window.add(1050, 3.0);
+    CHECK(window.median() == Approx(2.0));
+
+    // 1000 выходит из окна (1000 <= 1100 - 100), 1050 остаётся
+    window.add(1100, 5.0);
+    CHECK(window.count() == 2);
+    CHECK(window.median() == Approx(4.0));
+
+    // Большой разрыв — окно содержит только новую запись
+    window.add(5000, 10.0);
+    CHECK(window.count() == 1);
+    CHECK(window.median() == Approx(10.0));
+    CHECK(window.is_changed());
+}
+
+TEST_CASE("sliding_window - same median after expiry is not a change", "[window]") {
+    sliding_window<skiplist_calculator<double>> window{ 10 };
+
+    window.add(100, 7.0);
+    REQUIRE(window.is_changed());
+
+    // Старая 7.0 уходит, новая 7.0 приходит — медиана та же
+    window.add(200, 7.0);
+    CHECK(window.count() == 1);
+    CHECK_FALSE(window.is_changed());
+}
+
+TEST_CASE("sliding_window - matches brute force", "[window]") {
+    constexpr std::uint64_t width = 500;
+    sliding_window<skiplist_calculator<double>> window{ width };
+    std::vector<std::pair<std::uint64_t, double>> all;
+
+    std::mt19937 rng{ 11 };
+    std::uniform_int_distribution<int> step{ 0, 40 };
+    std::uniform_int_distribution<int> value{ 0, 100 };
+
+    std::uint64_t ts = 1'000'000;
+    for (int i = 0; i < 3000; ++i) {
+        ts += static_cast<std::uint64_t>(step(rng));
+        const double price = 50.0 + value(rng) * 0.25;
+
+        window.add(ts, price);
+        all.emplace_back(ts, price);
+
+        REQUIRE(window.median() == brute_median(all, ts, width));
+    }
+}
+
+TEST_CASE("sliding_window - fixed point prices", "[window]") {
+    sliding_window<skiplist_calculator<csv_median::fixed_price>> window{ 1000 };
+
+    window.add(1, 100'00000000);
+    window.add(2, 100'00000002);
+    CHECK(window.median() == 100'00000001);
+
+    // Уходит только ts = 1 (1 <= 1001 - 1000)
+    window.add(1001, 100'00000004);
+    CHECK(window.count() == 2);
+    CHECK(window.median() == 100'00000003);
+}
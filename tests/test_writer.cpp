@@ -0,0 +1,242 @@
+/**
+ * \file test_writer.cpp
+ * \brief Unit-тесты для result_writer
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "writer.hpp"
+
+using csv_median::result_writer;
+using csv_median::write_mode;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    /**
+     * \brief Временная директория, удаляется вместе с содержимым
+     */
+    struct temp_dir {
+        fs::path path;
+
+        temp_dir() {
+            path = fs::temp_directory_path()
+                / ("result_writer_test_" + std::to_string(
+                    std::chrono::steady_clock::now().time_since_epoch().count()));
+            fs::create_directories(path);
+        }
+
+        ~temp_dir() {
+            fs::remove_all(path);
+        }
+    };
+
+    std::string read_file(const fs::path& path_) {
+        std::ifstream f{ path_, std::ios::binary };
+        return { std::istreambuf_iterator<char>{ f }, std::istreambuf_iterator<char>{} };
+    }
+
+}
+
+TEST_CASE("writer - header and fixed-8 lines", "[writer]") {
+    temp_dir tmp;
+    result_writer writer;
+    REQUIRE_FALSE(writer.open(tmp.path, "out.csv"));
+
+    CHECK_FALSE(writer.write(std::uint64_t{ 1 }, 100.5));
+    CHECK_FALSE(writer.write(std::uint64_t{ 2 }, 0.000000016));
+    CHECK_FALSE(writer.write(std::uint64_t{ 3 }, -2.25));
+    CHECK_FALSE(writer.write(std::uint64_t{ 18446744073709551615u },
+        csv_median::fixed_price{ 12'345'678'901 }));
+    CHECK_FALSE(writer.write(std::uint64_t{ 5 }, csv_median::fixed_price{ -1 }));
+    CHECK(writer.written_count() == 5);
+    REQUIRE_FALSE(writer.close());
+
+    CHECK(read_file(tmp.path / "out.csv") ==
+        "receive_ts;price_median\n"
+        "1;100.50000000\n"
+        "2;0.00000002\n"
+        "3;-2.25000000\n"
+        "18446744073709551615;123.45678901\n"
+        "5;-0.00000001\n");
+}
+
+TEST_CASE("writer - double and fixed overloads agree", "[writer]") {
+    temp_dir tmp;
+    result_writer as_double;
+    result_writer as_fixed;
+    REQUIRE_FALSE(as_double.open(tmp.path, "double.csv"));
+    REQUIRE_FALSE(as_fixed.open(tmp.path, "fixed.csv"));
+
+    for (std::int64_t units = -5'000'000; units < 5'000'000; units += 9'973) {
+        const auto ts = static_cast<std::uint64_t>(units + 5'000'000);
+        REQUIRE_FALSE(as_double.write(ts, static_cast<double>(units) / 1e8));
+        REQUIRE_FALSE(as_fixed.write(ts, csv_median::fixed_price{ units }));
+    }
+    REQUIRE_FALSE(as_double.close());
+    REQUIRE_FALSE(as_fixed.close());
+
+    CHECK(read_file(tmp.path / "double.csv") == read_file(tmp.path / "fixed.csv"));
+}
+
+TEST_CASE("writer - output larger than the buffer", "[writer]") {
+    temp_dir tmp;
+    result_writer writer;
+    REQUIRE_FALSE(writer.open(tmp.path, "out.csv"));
+
+    const std::size_t lines = 3 * csv_median::k_write_buffer_size / 16;
+    for (std::size_t i = 0; i < lines; ++i) {
+        REQUIRE_FALSE(writer.write(std::uint64_t{ i }, csv_median::fixed_price{ 100 }));
+    }
+    REQUIRE_FALSE(writer.close());
+
+    const auto content = read_file(tmp.path / "out.csv");
+    CHECK(static_cast<std::size_t>(std::ranges::count(content, '\n')) == lines + 1);
+    CHECK(content.ends_with(std::to_string(lines - 1) + ";0.00000100\n"));
+}
+
+TEST_CASE("writer - write error is reported on flush", "[writer]") {
+    if (!fs::exists("/dev/full")) {
+        return;
+    }
+
+    result_writer writer;
+    REQUIRE_FALSE(writer.open("/dev", "full"));
+
+    // Ошибка проявляется, когда заполненный буфер уходит в write(2)
+    std::error_code err;
+    std::size_t lines = 0;
+    while (!err && lines < csv_median::k_write_buffer_size) {
+        err = writer.write(std::uint64_t{ lines++ }, 1.0);
+    }
+    CHECK(err == std::errc::no_space_on_device);
+    CHECK(writer.flush() == err);
+    CHECK(writer.close() == err);
+}
+
+TEST_CASE("writer - async output matches sync", "[writer]") {
+    temp_dir tmp;
+    result_writer sync_writer;
+    result_writer async_writer{ write_mode::async, 2 };
+    REQUIRE_FALSE(sync_writer.open(tmp.path, "sync.csv"));
+    REQUIRE_FALSE(async_writer.open(tmp.path, "async.csv"));
+
+    // Несколько оборотов двух буферов
+    const std::size_t lines = 5 * csv_median::k_write_buffer_size / 16;
+    for (std::size_t i = 0; i < lines; ++i) {
+        const auto price = csv_median::fixed_price{ static_cast<std::int64_t>(i % 977) };
+        REQUIRE_FALSE(sync_writer.write(std::uint64_t{ i }, price));
+        REQUIRE_FALSE(async_writer.write(std::uint64_t{ i }, price));
+    }
+    CHECK(async_writer.written_count() == lines);
+    REQUIRE_FALSE(sync_writer.close());
+    REQUIRE_FALSE(async_writer.close());
+
+    CHECK(read_file(tmp.path / "async.csv") == read_file(tmp.path / "sync.csv"));
+}
+
+TEST_CASE("writer - async close flushes the tail", "[writer]") {
+    temp_dir tmp;
+    {
+        result_writer writer{ write_mode::async, 4 };
+        REQUIRE_FALSE(writer.open(tmp.path, "out.csv"));
+        REQUIRE_FALSE(writer.write(std::uint64_t{ 7 }, 1.5));
+    }
+
+    CHECK(read_file(tmp.path / "out.csv") == "receive_ts;price_median\n7;1.50000000\n");
+}
+
+TEST_CASE("writer - async write error surfaces later", "[writer]") {
+    if (!fs::exists("/dev/full")) {
+        return;
+    }
+
+    result_writer writer{ write_mode::async, 2 };
+    REQUIRE_FALSE(writer.open("/dev", "full"));
+
+    std::error_code err;
+    for (std::size_t i = 0; !err && i < csv_median::k_write_buffer_size; ++i) {
+        err = writer.write(std::uint64_t{ i }, 1.0);
+    }
+    if (!err) {
+        err = writer.close();
+    }
+    CHECK(err == std::errc::no_space_on_device);
+    CHECK(writer.close() == err);
+}
+
+TEST_CASE("writer - uring output matches sync", "[writer]") {
+    temp_dir tmp;
+    result_writer sync_writer;
+    REQUIRE_FALSE(sync_writer.open(tmp.path, "sync.csv"));
+
+    for (const bool direct : { false, true }) {
+        const std::string name = direct ? "direct.csv" : "uring.csv";
+        result_writer uring_writer{ write_mode::uring, 3, direct };
+        REQUIRE_FALSE(uring_writer.open(tmp.path, name));
+
+        const std::size_t lines = 4 * csv_median::k_write_buffer_size / 16 + 7;
+        for (std::size_t i = 0; i < lines; ++i) {
+            const auto price = csv_median::fixed_price{ static_cast<std::int64_t>(i % 977) };
+            if (!direct) {
+                REQUIRE_FALSE(sync_writer.write(std::uint64_t{ i }, price));
+            }
+            REQUIRE_FALSE(uring_writer.write(std::uint64_t{ i }, price));
+        }
+        REQUIRE_FALSE(uring_writer.close());
+    }
+    REQUIRE_FALSE(sync_writer.close());
+
+    const auto expected = read_file(tmp.path / "sync.csv");
+    CHECK(read_file(tmp.path / "uring.csv") == expected);
+    CHECK(read_file(tmp.path / "direct.csv") == expected);
+}
+
+TEST_CASE("writer - statistics columns after the median", "[writer]") {
+    temp_dir tmp;
+    result_writer writer;
+    const std::vector<std::string> columns{ "p05", "vwap" };
+    writer.set_columns(columns);
+    REQUIRE_FALSE(writer.open(tmp.path, "out.csv"));
+
+    const std::vector<double> values{ 99.5, 100.125 };
+    CHECK_FALSE(writer.write(std::uint64_t{ 1 }, 100.5, values));
+    CHECK_FALSE(writer.write(std::uint64_t{ 2 }, csv_median::fixed_price{ 10'050'000'000 },
+        values));
+    CHECK(writer.written_count() == 2);
+    REQUIRE_FALSE(writer.close());
+
+    CHECK(read_file(tmp.path / "out.csv") ==
+        "receive_ts;price_median;p05;vwap\n"
+        "1;100.50000000;99.50000000;100.12500000\n"
+        "2;100.50000000;99.50000000;100.12500000\n");
+}
+
+TEST_CASE("writer - wide rows across buffer flushes", "[writer]") {
+    temp_dir tmp;
+    result_writer writer;
+    const std::vector<std::string> columns(40, "mean");
+    writer.set_columns(columns);
+    REQUIRE_FALSE(writer.open(tmp.path, "out.csv"));
+
+    const std::vector<double> values(40, 1e300);
+    constexpr std::size_t rows = 1000;
+    for (std::size_t i = 0; i < rows; ++i) {
+        REQUIRE_FALSE(writer.write(std::uint64_t{ i }, 1.0, values));
+    }
+    REQUIRE_FALSE(writer.close());
+
+    const auto content = read_file(tmp.path / "out.csv");
+    CHECK(static_cast<std::size_t>(std::ranges::count(content, '\n')) == rows + 1);
+    CHECK(static_cast<std::size_t>(std::ranges::count(content, ';')) == (rows + 1) * 41);
+}